@@ -0,0 +1,411 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Zero-allocation check for the platform's steady state. Interposes the heap
+ * functions, drives the platform against the fake CA-821x (see fake-ca821x.h)
+ * with a mixed workload, and fails if anything is allocated once warmed up.
+ * Each iteration of the workload:
+ *   - keeps MCPS-DATA requests outstanding, confirmed by the fake's worker,
+ *     while the worker also delivers MCPS-DATA indications
+ *   - sends and receives on the UART, through a pair of pipes
+ *   - logs a message, gets a setting and restarts the alarm
+ *   - runs one main loop iteration, as the examples do
+ *
+ * Allocations after warm-up are reported with the call stacks they came
+ * from, most frequent first. Symbol names need the binary to be linked with
+ * -rdynamic. Logs are discarded while the workload runs. The check runs as its
+ * own node, so the settings and EUI it writes are never those of cliapp's.
+ *
+ * usage: alloc-check [-w warmup-iterations] [-n iterations] [-r rate] [-i nodeid] [-c]
+ *   -i  node ID whose flash files are used (default 99)
+ *   -r  MCPS-DATA indications per second (default 2000)
+ *   -c  print "name,value" lines instead of a table
+ */
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "openthread/platform/alarm-milli.h"
+#include "openthread/platform/logging.h"
+#include "openthread/platform/radio-mac.h"
+#include "openthread/platform/radio.h"
+#include "openthread/platform/settings.h"
+#include "openthread/platform/uart.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "fake-ca821x.h"
+
+enum
+{
+	MAX_STACKS = 32,
+	MAX_FRAMES = 24,
+	SKIP_FRAMES = 2,       //recordAllocation and the interposed function
+	WINDOW = 4,            //MCPS-DATA requests kept outstanding
+	MSDU_LENGTH = 64,
+	SETTINGS_KEY = 0xCA00, //Out of the way of the keys OpenThread uses
+	CHECK_NODE_ID = 99,    //Out of the way of the nodes users start
+	LOOP_TIMEOUT_US = 10000,
+};
+
+struct allocStack
+{
+	void       *mFrames[MAX_FRAMES];
+	int         mDepth;
+	const char *mFunction;
+	uint64_t    mCount;
+	uint64_t    mBytes;
+};
+
+extern void *__libc_malloc(size_t aSize);
+extern void *__libc_calloc(size_t aCount, size_t aSize);
+extern void *__libc_realloc(void *aPtr, size_t aSize);
+extern void *__libc_memalign(size_t aAlignment, size_t aSize);
+extern void  __libc_free(void *aPtr);
+
+static int sArmed = 0;
+static int sStacksLock = 0;
+static __thread int sInHook = 0;
+static uint64_t sWarmupAllocations = 0;
+static uint64_t sAllocations = 0;
+static uint64_t sFrees = 0;
+static uint64_t sUntracedAllocations = 0;
+static struct allocStack sStacks[MAX_STACKS];
+static int sStackCount = 0;
+
+static struct ca821x_dev sDev;
+static otInstance *sInstance;
+static uint32_t sOutstanding = 0;
+static uint8_t sNextHandle = 0;
+static int sUartSending = 0;
+
+//Stacks are kept in a fixed table, as nothing here may allocate
+static void recordAllocation(const char *aFunction, size_t aSize)
+{
+	void *frames[MAX_FRAMES];
+	int depth;
+	int i;
+
+	if (!__atomic_load_n(&sArmed, __ATOMIC_RELAXED))
+	{
+		__atomic_fetch_add(&sWarmupAllocations, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	__atomic_fetch_add(&sAllocations, 1, __ATOMIC_RELAXED);
+
+	//backtrace can itself allocate, which must not be traced again
+	if (sInHook)
+		return;
+
+	sInHook = 1;
+	depth = backtrace(frames, MAX_FRAMES);
+
+	while (__atomic_exchange_n(&sStacksLock, 1, __ATOMIC_ACQUIRE))
+		;
+
+	for (i = 0; i < sStackCount; i++)
+	{
+		if (sStacks[i].mDepth == depth && sStacks[i].mFunction == aFunction &&
+		    memcmp(sStacks[i].mFrames, frames, depth * sizeof(void *)) == 0)
+			break;
+	}
+
+	if (i == sStackCount && sStackCount < MAX_STACKS)
+	{
+		memcpy(sStacks[i].mFrames, frames, depth * sizeof(void *));
+		sStacks[i].mDepth = depth;
+		sStacks[i].mFunction = aFunction;
+		sStackCount++;
+	}
+
+	if (i < sStackCount)
+	{
+		sStacks[i].mCount++;
+		sStacks[i].mBytes += aSize;
+	}
+	else
+	{
+		sUntracedAllocations++;
+	}
+
+	__atomic_store_n(&sStacksLock, 0, __ATOMIC_RELEASE);
+	sInHook = 0;
+}
+
+void *malloc(size_t aSize)
+{
+	recordAllocation("malloc", aSize);
+	return __libc_malloc(aSize);
+}
+
+void *calloc(size_t aCount, size_t aSize)
+{
+	recordAllocation("calloc", aCount * aSize);
+	return __libc_calloc(aCount, aSize);
+}
+
+void *realloc(void *aPtr, size_t aSize)
+{
+	recordAllocation("realloc", aSize);
+	return __libc_realloc(aPtr, aSize);
+}
+
+void *memalign(size_t aAlignment, size_t aSize)
+{
+	recordAllocation("memalign", aSize);
+	return __libc_memalign(aAlignment, aSize);
+}
+
+void *aligned_alloc(size_t aAlignment, size_t aSize)
+{
+	recordAllocation("aligned_alloc", aSize);
+	return __libc_memalign(aAlignment, aSize);
+}
+
+int posix_memalign(void **aPtr, size_t aAlignment, size_t aSize)
+{
+	recordAllocation("posix_memalign", aSize);
+	*aPtr = __libc_memalign(aAlignment, aSize);
+	return *aPtr ? 0 : ENOMEM;
+}
+
+void free(void *aPtr)
+{
+	if (aPtr != NULL && __atomic_load_n(&sArmed, __ATOMIC_RELAXED))
+		__atomic_fetch_add(&sFrees, 1, __ATOMIC_RELAXED);
+	__libc_free(aPtr);
+}
+
+void otPlatMcpsDataConfirm(otInstance *aInstance, uint8_t aMsduHandle, int aStatus)
+{
+	sOutstanding--;
+}
+
+void otPlatUartSendDone(void)
+{
+	sUartSending = 0;
+}
+
+static void sendRequests(void)
+{
+	otDataRequest dataReq;
+
+	while (sOutstanding < WINDOW)
+	{
+		memset(&dataReq, 0, sizeof(dataReq));
+		dataReq.mSrcAddrMode = 3;
+		dataReq.mDst.mAddressMode = 3;
+		dataReq.mMsduLength = MSDU_LENGTH;
+		dataReq.mMsduHandle = sNextHandle++;
+
+		if (otPlatMcpsDataRequest(sInstance, &dataReq) != OT_ERROR_NONE)
+			break;
+		sOutstanding++;
+	}
+}
+
+static void iterate(uint32_t aIteration, int aUartIn, int aUartOut)
+{
+	static const uint8_t uartLine[] = "state\r\n";
+	uint8_t buf[64];
+	uint16_t length = sizeof(buf);
+	struct timeval timeout;
+	struct timeval maxTimeout = {0, LOOP_TIMEOUT_US};
+
+	sendRequests();
+
+	if (!sUartSending && otPlatUartSend(uartLine, sizeof(uartLine) - 1) == OT_ERROR_NONE)
+		sUartSending = 1;
+	(void)write(aUartIn, uartLine, sizeof(uartLine) - 1);
+	while (read(aUartOut, buf, sizeof(buf)) > 0)
+		;
+
+	otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM, "alloc-check iteration %u", aIteration);
+	otPlatSettingsGet(sInstance, SETTINGS_KEY, 0, buf, &length);
+	otPlatAlarmMilliStartAt(sInstance, otPlatAlarmMilliGetNow(), 1);
+
+	posixPlatformProcessDriversQuick(sInstance);
+	posixPlatformGetTimeout(sInstance, &timeout);
+	if (timercmp(&maxTimeout, &timeout, <))
+		timeout = maxTimeout;
+	posixPlatformSleep(sInstance, &timeout);
+}
+
+//Makes pipes stdin and stdout for the UART, returning the ends the check uses
+static int setupUart(int *aUartIn, int *aUartOut)
+{
+	int in[2], out[2];
+
+	if (pipe(in) < 0 || pipe(out) < 0)
+		return -1;
+
+	dup2(in[0], STDIN_FILENO);
+	dup2(out[1], STDOUT_FILENO);
+	close(in[0]);
+	close(out[1]);
+	fcntl(in[1], F_SETFL, O_NONBLOCK);
+	fcntl(out[0], F_SETFL, O_NONBLOCK);
+
+	*aUartIn = in[1];
+	*aUartOut = out[0];
+	return 0;
+}
+
+static int compareStacks(const void *aA, const void *aB)
+{
+	const struct allocStack *a = aA;
+	const struct allocStack *b = aB;
+
+	return (a->mCount < b->mCount) - (a->mCount > b->mCount);
+}
+
+static void printValue(FILE *aStream, const char *aName, unsigned long long aValue, int aCsv)
+{
+	if (aCsv)
+		fprintf(aStream, "%s,%llu\n", aName, aValue);
+	else
+		fprintf(aStream, "%-22s %llu\n", aName, aValue);
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint8_t setting[16] = {0};
+	uint32_t warmup = 1000;
+	uint32_t iterations = 100000;
+	uint32_t rate = 2000;
+	int uartIn, uartOut;
+	int reportFd, nullFd;
+	FILE *report;
+	int csv = 0;
+	int opt;
+
+	NODE_ID = CHECK_NODE_ID;
+
+	while ((opt = getopt(argc, argv, "w:n:r:i:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 'w':
+			warmup = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rate = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			NODE_ID = atoi(optarg);
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-w warmup-iterations] [-n iterations] [-r rate] [-i nodeid] [-c]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	//The report goes to the real stdout, as stdout becomes the UART
+	reportFd = dup(STDOUT_FILENO);
+	nullFd = open("/dev/null", O_WRONLY);
+	if (reportFd < 0 || nullFd < 0 || setupUart(&uartIn, &uartOut) < 0)
+	{
+		perror("alloc-check");
+		return EXIT_FAILURE;
+	}
+
+	fakeCa821xInit(&sDev);
+	PlatformRadioInitWithDev(&sDev);
+	sInstance = otInstanceInitSingle();
+	otPlatRadioEnable(sInstance);
+	posixPlatformAlarmInit();
+	otPlatUartEnable();
+	otPlatSettingsInit(sInstance);
+	otPlatSettingsSet(sInstance, SETTINGS_KEY, setting, sizeof(setting));
+	dup2(nullFd, STDERR_FILENO);
+
+	fakeCa821xInjectIndications(UINT32_MAX, rate, MSDU_LENGTH);
+
+	//Warm-up also loads what backtrace needs, which allocates the first time
+	{
+		void *frames[MAX_FRAMES];
+		backtrace(frames, MAX_FRAMES);
+	}
+
+	for (uint32_t i = 0; i < warmup; i++)
+		iterate(i, uartIn, uartOut);
+
+	__atomic_store_n(&sArmed, 1, __ATOMIC_RELAXED);
+
+	for (uint32_t i = 0; i < iterations; i++)
+		iterate(warmup + i, uartIn, uartOut);
+
+	__atomic_store_n(&sArmed, 0, __ATOMIC_RELAXED);
+
+	//The fake's worker is left running, as it may be blocked handing an indication to this loop
+	otPlatSettingsDelete(sInstance, SETTINGS_KEY, -1);
+
+	report = fdopen(reportFd, "w");
+	if (!csv)
+		fprintf(report, "%u iterations after %u to warm up, %u indications/s\n", iterations, warmup, rate);
+	printValue(report, "warmup_allocations", sWarmupAllocations, csv);
+	printValue(report, "allocations", sAllocations, csv);
+	printValue(report, "frees", sFrees, csv);
+
+	if (sAllocations > 0)
+	{
+		qsort(sStacks, sStackCount, sizeof(sStacks[0]), compareStacks);
+		fprintf(report, "\nAllocations after warm-up:\n");
+
+		for (int i = 0; i < sStackCount; i++)
+		{
+			fprintf(report, "\n%s: %llu times, %llu bytes, from\n", sStacks[i].mFunction,
+			        (unsigned long long)sStacks[i].mCount, (unsigned long long)sStacks[i].mBytes);
+			fflush(report);
+			backtrace_symbols_fd(sStacks[i].mFrames + SKIP_FRAMES, sStacks[i].mDepth - SKIP_FRAMES, reportFd);
+		}
+
+		if (sUntracedAllocations > 0)
+			fprintf(report, "\n%llu more from other stacks, or from within backtrace\n",
+			        (unsigned long long)sUntracedAllocations);
+	}
+
+	fclose(report);
+
+	return sAllocations > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "ca821x_api.h"
+#include "mac_messages.h"
+
+#include "fake-ca821x.h"
+
+enum
+{
+	SYNC_RESPONSE_LENGTH = 32, //Enough for the fixed part of any confirm, all zero means MAC_SUCCESS
+	FRAME_TIMESTAMP_LENGTH = 8,
+};
+
+static pthread_t sWorker;
+static pthread_mutex_t sMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sCond;
+static int sRunning = 0;
+static struct ca821x_dev *sDev;
+
+static uint8_t sConfirmQueue[256];
+static uint8_t sConfirmHead = 0;
+static uint16_t sConfirmCount = 0;
+static uint8_t sConfirmStatus = MAC_SUCCESS;
+static int64_t sConfirmIntervalNs = 0;
+static int64_t sNextConfirmNs = 0;
+static int64_t sConfirmDispatchNs[256];
+
+static uint32_t sIndicationsLeft = 0;
+static int64_t sIndicationIntervalNs = 0;
+static int64_t sNextIndicationNs = 0;
+static uint8_t sIndicationLength = FRAME_TIMESTAMP_LENGTH;
+static uint8_t sIndicationDsn = 0;
+
+static fakeCa821xDispatchHook sDispatchHook = NULL;
+
+static int64_t nowNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//Keeps to the rate, but doesn't burst to catch up after falling behind
+static int64_t nextDue(int64_t aDueNs, int64_t aIntervalNs, int64_t aNowNs)
+{
+	aDueNs += aIntervalNs;
+	return aDueNs < aNowNs ? aNowNs : aDueNs;
+}
+
+static uint8_t confirmFor(uint8_t aRequest)
+{
+	switch (aRequest)
+	{
+	case SPI_MCPS_PURGE_REQUEST:     return SPI_MCPS_PURGE_CONFIRM;
+	case SPI_MLME_GET_REQUEST:       return SPI_MLME_GET_CONFIRM;
+	case SPI_MLME_RESET_REQUEST:     return SPI_MLME_RESET_CONFIRM;
+	case SPI_MLME_RX_ENABLE_REQUEST: return SPI_MLME_RX_ENABLE_CONFIRM;
+	case SPI_MLME_SET_REQUEST:       return SPI_MLME_SET_CONFIRM;
+	case SPI_MLME_START_REQUEST:     return SPI_MLME_START_CONFIRM;
+	case SPI_MLME_POLL_REQUEST:      return SPI_MLME_POLL_CONFIRM;
+	case SPI_HWME_SET_REQUEST:       return SPI_HWME_SET_CONFIRM;
+	case SPI_HWME_GET_REQUEST:       return SPI_HWME_GET_CONFIRM;
+	case SPI_TDME_SETSFR_REQUEST:    return SPI_TDME_SETSFR_CONFIRM;
+	case SPI_TDME_GETSFR_REQUEST:    return SPI_TDME_GETSFR_CONFIRM;
+	default:                         return aRequest;
+	}
+}
+
+static int fakeDownstream(const uint8_t *buf, size_t len, uint8_t *response, struct ca821x_dev *pDeviceRef)
+{
+	if (buf[0] == SPI_MCPS_DATA_REQUEST)
+	{
+		const struct MCPS_DATA_request_pset *dataReq = (const struct MCPS_DATA_request_pset *)(buf + 2);
+
+		pthread_mutex_lock(&sMutex);
+		if (sConfirmCount < sizeof(sConfirmQueue))
+		{
+			sConfirmQueue[(uint8_t)(sConfirmHead + sConfirmCount)] = dataReq->MsduHandle;
+			sConfirmCount++;
+			pthread_cond_signal(&sCond);
+		}
+		pthread_mutex_unlock(&sMutex);
+		return 0;
+	}
+
+	//Other asynchronous requests (eg. scans) are accepted and never confirmed
+	if (response == NULL)
+		return 0;
+
+	memset(response, 0, SYNC_RESPONSE_LENGTH + 2);
+	response[0] = confirmFor(buf[0]);
+	response[1] = SYNC_RESPONSE_LENGTH;
+
+	return 0;
+}
+
+static void dispatchConfirm(uint8_t aMsduHandle, uint8_t aStatus)
+{
+	uint8_t msg[2 + sizeof(struct MCPS_DATA_confirm_pset)] = {0};
+	struct MCPS_DATA_confirm_pset *dataCnf = (struct MCPS_DATA_confirm_pset *)(msg + 2);
+
+	msg[0] = SPI_MCPS_DATA_CONFIRM;
+	msg[1] = sizeof(*dataCnf);
+	dataCnf->MsduHandle = aMsduHandle;
+	dataCnf->Status = aStatus;
+
+	sConfirmDispatchNs[aMsduHandle] = nowNs();
+	ca821x_downstream_dispatch(msg, sizeof(msg), sDev);
+
+	if (sDispatchHook)
+		sDispatchHook(sConfirmDispatchNs[aMsduHandle], nowNs());
+}
+
+static void dispatchIndication(uint8_t aMsduLength, uint8_t aDsn)
+{
+	//The platform reads a security spec from just past the MSDU
+	uint8_t msg[2 + sizeof(struct MCPS_DATA_indication_pset) + sizeof(struct SecSpec)] = {0};
+	struct MCPS_DATA_indication_pset *dataInd = (struct MCPS_DATA_indication_pset *)(msg + 2);
+	int64_t timestamp;
+
+	msg[0] = SPI_MCPS_DATA_INDICATION;
+	msg[1] = offsetof(struct MCPS_DATA_indication_pset, Msdu) + aMsduLength + sizeof(struct SecSpec);
+	dataInd->Src.AddressMode = 3;
+	dataInd->Src.Address[0] = 0x02;
+	dataInd->Dst.AddressMode = 3;
+	dataInd->Dst.Address[0] = 0x01;
+	dataInd->MsduLength = aMsduLength;
+	dataInd->MpduLinkQuality = 0xC0;
+	dataInd->DSN = aDsn;
+
+	timestamp = nowNs();
+	memcpy(dataInd->Msdu, &timestamp, sizeof(timestamp));
+	ca821x_downstream_dispatch(msg, 2 + msg[1], sDev);
+
+	if (sDispatchHook)
+		sDispatchHook(timestamp, nowNs());
+}
+
+static void *fakeWorker(void *aContext)
+{
+	pthread_mutex_lock(&sMutex);
+
+	while (sRunning)
+	{
+		int64_t now = nowNs();
+		int64_t wakeNs = INT64_MAX;
+
+		if (sConfirmCount && sNextConfirmNs <= now)
+		{
+			uint8_t handle = sConfirmQueue[sConfirmHead++];
+			uint8_t status = sConfirmStatus;
+
+			sConfirmCount--;
+			sNextConfirmNs = nextDue(sNextConfirmNs, sConfirmIntervalNs, now);
+
+			//Dispatching blocks until the main thread has handled it, as with the real exchange
+			pthread_mutex_unlock(&sMutex);
+			dispatchConfirm(handle, status);
+			pthread_mutex_lock(&sMutex);
+			continue;
+		}
+
+		if (sIndicationsLeft && sNextIndicationNs <= now)
+		{
+			uint8_t length = sIndicationLength;
+			uint8_t dsn = sIndicationDsn++;
+
+			sIndicationsLeft--;
+			sNextIndicationNs = nextDue(sNextIndicationNs, sIndicationIntervalNs, now);
+
+			pthread_mutex_unlock(&sMutex);
+			dispatchIndication(length, dsn);
+			pthread_mutex_lock(&sMutex);
+			continue;
+		}
+
+		if (sConfirmCount && sNextConfirmNs < wakeNs)
+			wakeNs = sNextConfirmNs;
+		if (sIndicationsLeft && sNextIndicationNs < wakeNs)
+			wakeNs = sNextIndicationNs;
+
+		if (wakeNs == INT64_MAX)
+		{
+			pthread_cond_wait(&sCond, &sMutex);
+		}
+		else
+		{
+			struct timespec deadline = {wakeNs / 1000000000, wakeNs % 1000000000};
+
+			pthread_cond_timedwait(&sCond, &sMutex, &deadline);
+		}
+	}
+
+	pthread_mutex_unlock(&sMutex);
+	return NULL;
+}
+
+int fakeCa821xInit(struct ca821x_dev *aDev)
+{
+	pthread_condattr_t condattr;
+
+	ca821x_api_init(aDev);
+	aDev->ca821x_api_downstream = fakeDownstream;
+	sDev = aDev;
+
+	pthread_condattr_init(&condattr);
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sCond, &condattr);
+	pthread_condattr_destroy(&condattr);
+
+	sRunning = 1;
+	return pthread_create(&sWorker, NULL, fakeWorker, NULL);
+}
+
+void fakeCa821xDeinit(struct ca821x_dev *aDev)
+{
+	pthread_mutex_lock(&sMutex);
+	sRunning = 0;
+	pthread_cond_signal(&sCond);
+	pthread_mutex_unlock(&sMutex);
+
+	pthread_join(sWorker, NULL);
+}
+
+void fakeCa821xSetConfirms(uint32_t aRate, uint8_t aStatus)
+{
+	pthread_mutex_lock(&sMutex);
+	sConfirmIntervalNs = aRate ? 1000000000LL / aRate : 0;
+	sConfirmStatus = aStatus;
+	pthread_mutex_unlock(&sMutex);
+}
+
+void fakeCa821xInjectIndications(uint32_t aCount, uint32_t aRate, uint8_t aMsduLength)
+{
+	pthread_mutex_lock(&sMutex);
+	sIndicationsLeft += aCount;
+	sIndicationIntervalNs = aRate ? 1000000000LL / aRate : 0;
+	sIndicationLength = aMsduLength < FRAME_TIMESTAMP_LENGTH ? FRAME_TIMESTAMP_LENGTH : aMsduLength;
+	sNextIndicationNs = nowNs();
+	pthread_cond_signal(&sCond);
+	pthread_mutex_unlock(&sMutex);
+}
+
+void fakeCa821xSetDispatchHook(fakeCa821xDispatchHook aHook)
+{
+	sDispatchHook = aHook;
+}
+
+int fakeCa821xPinWorker(int aCpu)
+{
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(aCpu, &cpus);
+	return pthread_setaffinity_np(sWorker, sizeof(cpus), &cpus);
+}
+
+int64_t fakeCa821xConfirmDispatchNs(uint8_t aMsduHandle)
+{
+	return sConfirmDispatchNs[aMsduHandle];
+}
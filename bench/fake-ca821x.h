@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines a stand-in CA-821x device for benchmarking the platform
+ *   without hardware.
+ *
+ * The fake answers every synchronous request with MAC_SUCCESS. MCPS-DATA
+ * requests are confirmed, and MCPS-DATA indications generated, from a worker
+ * thread through ca821x_downstream_dispatch, like the real exchange does, so
+ * the platform's worker-to-main handoff is exercised as it is with hardware.
+ */
+
+#ifndef FAKE_CA821X_H_
+#define FAKE_CA821X_H_
+
+#include <stdint.h>
+
+#include "ca821x_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * This method makes @p aDev a fake device and starts its worker thread.
+ *
+ */
+int fakeCa821xInit(struct ca821x_dev *aDev);
+
+/**
+ * This method stops the worker thread. Synchronous requests are still answered.
+ *
+ */
+void fakeCa821xDeinit(struct ca821x_dev *aDev);
+
+/**
+ * This method sets how MCPS-DATA requests are confirmed.
+ *
+ * @param[in]  aRate    The most confirms to deliver per second, 0 for no limit.
+ * @param[in]  aStatus  The status to confirm with.
+ *
+ */
+void fakeCa821xSetConfirms(uint32_t aRate, uint8_t aStatus);
+
+/**
+ * This method makes the worker deliver @p aCount MCPS-DATA indications.
+ * The first 8 bytes of each MSDU hold the CLOCK_MONOTONIC time in ns at which
+ * it was dispatched, so @p aMsduLength must be at least 8.
+ *
+ * @param[in]  aCount       The number of indications.
+ * @param[in]  aRate        The most indications to deliver per second, 0 for no limit.
+ * @param[in]  aMsduLength  The MSDU length.
+ *
+ */
+void fakeCa821xInjectIndications(uint32_t aCount, uint32_t aRate, uint8_t aMsduLength);
+
+/**
+ * This function type is called on the worker thread after each callback has
+ * been dispatched and handled, with the CLOCK_MONOTONIC times in ns at which
+ * the dispatch started and returned.
+ *
+ */
+typedef void (*fakeCa821xDispatchHook)(int64_t aDispatchNs, int64_t aReturnNs);
+
+/**
+ * This method sets a hook called after each dispatch, or NULL for none.
+ *
+ */
+void fakeCa821xSetDispatchHook(fakeCa821xDispatchHook aHook);
+
+/**
+ * This method pins the worker thread to a CPU.
+ *
+ * @returns 0 on success, an errno value otherwise.
+ *
+ */
+int fakeCa821xPinWorker(int aCpu);
+
+/**
+ * This method gets the CLOCK_MONOTONIC time in ns at which the confirm for
+ * @p aMsduHandle was last dispatched.
+ *
+ */
+int64_t fakeCa821xConfirmDispatchNs(uint8_t aMsduHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FAKE_CA821X_H_ */
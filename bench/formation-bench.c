@@ -0,0 +1,659 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Network formation and convergence benchmark. Hosts N simulated nodes in this
+ * process (see posixPlatformNodeCreate), each serviced by its own thread, and
+ * brings them up with a CLI style script. It records when each node attaches
+ * and becomes a router, when the whole network has formed one partition and,
+ * with the split topology, how long two partitions take to merge once they can
+ * hear each other. CPU time is measured per node thread. Memory is reported as
+ * the instance size and the growth of the peak RSS per node.
+ *
+ * Topologies:
+ *   full   every node hears every other
+ *   line   node i hears nodes i-1 and i+1
+ *   grid   nodes on a square grid hear their horizontal and vertical neighbours
+ *   split  two halves that each form a partition, then merge
+ *
+ * The script takes one command per line, with the syntax of the OpenThread
+ * CLI: channel, panid, masterkey, networkname, routerselectionjitter,
+ * routerrole enable|disable, ifconfig up|down and thread start|stop. Lines
+ * starting with # are ignored. The OpenThread CLI only serves one instance per
+ * process, so the commands are run through the API.
+ *
+ * Runs end once the network has formed (and merged), and every node is a
+ * router or the settle time has passed since. Set CASCODA_RANDOM_SEED for
+ * repeatable runs.
+ *
+ * usage: formation-bench [-n nodes] [-T topology] [-s script] [-j jitter] [-w settle-seconds] [-t timeout-seconds] [-c]
+ *   -c  print "name,value" lines instead of a table
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/link.h"
+#include "openthread/thread.h"
+#include "openthread/thread_ftd.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "perf-stats.h"
+
+enum
+{
+	MAX_NODES = 256,
+	MAX_SCRIPT_LINES = 64,
+	MAX_LINE = 128,
+	MAX_ARGS = 4,
+	LINK_QUALITY = 0xD0,
+	SAMPLE_PERIOD_US = 10000,
+};
+
+enum topology
+{
+	TOPOLOGY_FULL,
+	TOPOLOGY_LINE,
+	TOPOLOGY_GRID,
+	TOPOLOGY_SPLIT,
+};
+
+static const char *const sTopologyNames[] = {"full", "line", "grid", "split"};
+static const char *const sRoleNames[] = {"disabled", "detached", "child", "router", "leader"};
+
+struct benchNode
+{
+	struct posixNode *mNode;
+	pthread_t         mThread;
+	otInstance       *mInstance;
+	void             *mInstanceBuffer;
+	size_t            mInstanceSize;
+	uint32_t          mId;
+
+	//Written by the node's thread, read by the main thread
+	int64_t           mAttachNs;    ///< From the start, or -1 until attached
+	int64_t           mRouterNs;    ///< From the start, or -1 until a router or leader
+	uint32_t          mRole;
+	uint32_t          mPartitionId;
+	uint32_t          mDetaches;    ///< Times the node lost its attachment
+	int64_t           mCpuNs;
+	int               mFailed;
+};
+
+static volatile sig_atomic_t isRunning = 1;
+static int      sNodesRunning = 1;
+static int64_t  sStartNs;
+static char     sScript[MAX_SCRIPT_LINES][MAX_LINE];
+static int      sScriptLines = 0;
+
+static void quit(int sig)
+{
+	isRunning = 0;
+}
+
+static void addScriptLine(const char *aLine)
+{
+	if (sScriptLines < MAX_SCRIPT_LINES)
+	{
+		snprintf(sScript[sScriptLines++], MAX_LINE, "%s", aLine);
+	}
+}
+
+static int loadScript(const char *aPath)
+{
+	char line[MAX_LINE];
+	FILE *file = fopen(aPath, "r");
+
+	if (file == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] != '\0' && line[0] != '#')
+			addScriptLine(line);
+	}
+
+	fclose(file);
+	return 0;
+}
+
+static void defaultScript(unsigned int aJitter)
+{
+	char line[MAX_LINE];
+
+	addScriptLine("channel 11");
+	addScriptLine("panid 0xface");
+	addScriptLine("masterkey 00112233445566778899aabbccddeeff");
+	addScriptLine("networkname formation-bench");
+	snprintf(line, sizeof(line), "routerselectionjitter %u", aJitter);
+	addScriptLine(line);
+	addScriptLine("ifconfig up");
+	addScriptLine("thread start");
+}
+
+static otError parseMasterKey(const char *aHex, otMasterKey *aKey)
+{
+	if (strlen(aHex) != 2 * sizeof(aKey->m8))
+		return OT_ERROR_INVALID_ARGS;
+
+	for (size_t i = 0; i < sizeof(aKey->m8); i++)
+	{
+		unsigned int byte;
+
+		if (sscanf(aHex + 2 * i, "%2x", &byte) != 1)
+			return OT_ERROR_INVALID_ARGS;
+		aKey->m8[i] = byte;
+	}
+
+	return OT_ERROR_NONE;
+}
+
+static otError runCommand(otInstance *aInstance, char *aLine)
+{
+	char *argv[MAX_ARGS] = {NULL};
+	char *save = NULL;
+	int argc = 0;
+	otMasterKey key;
+	otError error;
+
+	for (char *arg = strtok_r(aLine, " \t", &save); arg != NULL && argc < MAX_ARGS; arg = strtok_r(NULL, " \t", &save))
+		argv[argc++] = arg;
+
+	if (argc == 0)
+		return OT_ERROR_NONE;
+	if (argc < 2)
+		return OT_ERROR_INVALID_ARGS;
+
+	if (strcmp(argv[0], "channel") == 0)
+		return otLinkSetChannel(aInstance, strtoul(argv[1], NULL, 0));
+	if (strcmp(argv[0], "panid") == 0)
+		return otLinkSetPanId(aInstance, strtoul(argv[1], NULL, 0));
+	if (strcmp(argv[0], "networkname") == 0)
+		return otThreadSetNetworkName(aInstance, argv[1]);
+	if (strcmp(argv[0], "masterkey") == 0)
+		return (error = parseMasterKey(argv[1], &key)) ? error : otThreadSetMasterKey(aInstance, &key);
+
+	if (strcmp(argv[0], "routerselectionjitter") == 0)
+	{
+		otThreadSetRouterSelectionJitter(aInstance, strtoul(argv[1], NULL, 0));
+		return OT_ERROR_NONE;
+	}
+
+	if (strcmp(argv[0], "routerrole") == 0)
+	{
+		otThreadSetRouterRoleEnabled(aInstance, strcmp(argv[1], "enable") == 0);
+		return OT_ERROR_NONE;
+	}
+
+	if (strcmp(argv[0], "ifconfig") == 0)
+		return otIp6SetEnabled(aInstance, strcmp(argv[1], "up") == 0);
+	if (strcmp(argv[0], "thread") == 0)
+		return otThreadSetEnabled(aInstance, strcmp(argv[1], "start") == 0);
+
+	return OT_ERROR_PARSE;
+}
+
+static void stateChanged(uint32_t aFlags, void *aContext)
+{
+	struct benchNode *bench = aContext;
+	otDeviceRole role = otThreadGetDeviceRole(bench->mInstance);
+	int64_t now = perfNowNs(CLOCK_MONOTONIC) - sStartNs;
+
+	if (role >= OT_DEVICE_ROLE_CHILD && __atomic_load_n(&bench->mAttachNs, __ATOMIC_RELAXED) < 0)
+		__atomic_store_n(&bench->mAttachNs, now, __ATOMIC_RELAXED);
+	if (role >= OT_DEVICE_ROLE_ROUTER && __atomic_load_n(&bench->mRouterNs, __ATOMIC_RELAXED) < 0)
+		__atomic_store_n(&bench->mRouterNs, now, __ATOMIC_RELAXED);
+	if (role == OT_DEVICE_ROLE_DETACHED && bench->mRole >= OT_DEVICE_ROLE_CHILD)
+		__atomic_fetch_add(&bench->mDetaches, 1, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&bench->mPartitionId, role >= OT_DEVICE_ROLE_CHILD ? otThreadGetPartitionId(bench->mInstance) : 0,
+	                 __ATOMIC_RELAXED);
+	__atomic_store_n(&bench->mRole, role, __ATOMIC_RELAXED);
+
+	(void)aFlags;
+}
+
+static void *nodeThread(void *aContext)
+{
+	struct benchNode *bench = aContext;
+	struct posixNode *node = bench->mNode;
+	struct timeval maxTimeout = {0, 100000};
+	char line[MAX_LINE];
+	otError error;
+
+	posixPlatformNodeEnter(node);
+	bench->mInstance = otInstanceInit(bench->mInstanceBuffer, &bench->mInstanceSize);
+	if (bench->mInstance == NULL)
+	{
+		fprintf(stderr, "node %u: failed to create an instance\n", bench->mId);
+		__atomic_store_n(&bench->mFailed, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	posixPlatformNodeSetInstance(node, bench->mInstance);
+	otSetStateChangedCallback(bench->mInstance, stateChanged, bench);
+
+	for (int i = 0; i < sScriptLines; i++)
+	{
+		snprintf(line, sizeof(line), "%s", sScript[i]);
+		if ((error = runCommand(bench->mInstance, line)) != OT_ERROR_NONE)
+		{
+			fprintf(stderr, "node %u: \"%s\" failed with error %d\n", bench->mId, sScript[i], error);
+			__atomic_store_n(&bench->mFailed, 1, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+
+	while (__atomic_load_n(&sNodesRunning, __ATOMIC_RELAXED))
+		posixPlatformProcessNodes(&node, 1, &maxTimeout);
+
+	bench->mCpuNs = perfNowNs(CLOCK_THREAD_CPUTIME_ID);
+	otInstanceFinalize(bench->mInstance);
+
+	return NULL;
+}
+
+static void setLink(struct benchNode *aA, struct benchNode *aB, uint8_t aLinkQuality)
+{
+	posixPlatformSimSetLinkQuality(aA->mNode, aB->mNode, aLinkQuality);
+	posixPlatformSimSetLinkQuality(aB->mNode, aA->mNode, aLinkQuality);
+}
+
+static void setupTopology(enum topology aTopology, struct benchNode *aNodes, uint32_t aCount)
+{
+	uint32_t width = 1;
+	uint32_t half = aCount / 2;
+
+	switch (aTopology)
+	{
+	case TOPOLOGY_FULL:
+		posixPlatformSimSetDefaultLinkQuality(LINK_QUALITY);
+		break;
+
+	case TOPOLOGY_LINE:
+		posixPlatformSimSetDefaultLinkQuality(0);
+		for (uint32_t i = 0; i + 1 < aCount; i++)
+			setLink(&aNodes[i], &aNodes[i + 1], LINK_QUALITY);
+		break;
+
+	case TOPOLOGY_GRID:
+		posixPlatformSimSetDefaultLinkQuality(0);
+		while (width * width < aCount)
+			width++;
+		for (uint32_t i = 0; i < aCount; i++)
+		{
+			if ((i + 1) % width != 0 && i + 1 < aCount)
+				setLink(&aNodes[i], &aNodes[i + 1], LINK_QUALITY);
+			if (i + width < aCount)
+				setLink(&aNodes[i], &aNodes[i + width], LINK_QUALITY);
+		}
+		break;
+
+	case TOPOLOGY_SPLIT:
+		posixPlatformSimSetDefaultLinkQuality(0);
+		for (uint32_t i = 0; i < aCount; i++)
+		{
+			for (uint32_t j = i + 1; j < aCount; j++)
+			{
+				if ((i < half) == (j < half))
+					setLink(&aNodes[i], &aNodes[j], LINK_QUALITY);
+			}
+		}
+		break;
+	}
+}
+
+//Lets the two halves of the split topology hear each other
+static void healSplit(struct benchNode *aNodes, uint32_t aCount)
+{
+	uint32_t half = aCount / 2;
+
+	for (uint32_t i = 0; i < half; i++)
+	{
+		for (uint32_t j = half; j < aCount; j++)
+			setLink(&aNodes[i], &aNodes[j], LINK_QUALITY);
+	}
+}
+
+//Whether all nodes in [aBegin, aEnd) are attached to the same partition
+static int isConverged(struct benchNode *aNodes, uint32_t aBegin, uint32_t aEnd)
+{
+	uint32_t partitionId = 0;
+
+	for (uint32_t i = aBegin; i < aEnd; i++)
+	{
+		uint32_t id = __atomic_load_n(&aNodes[i].mPartitionId, __ATOMIC_RELAXED);
+
+		if (__atomic_load_n(&aNodes[i].mRole, __ATOMIC_RELAXED) < OT_DEVICE_ROLE_CHILD)
+			return 0;
+		if (i > aBegin && id != partitionId)
+			return 0;
+		partitionId = id;
+	}
+
+	return 1;
+}
+
+static uint32_t countRole(struct benchNode *aNodes, uint32_t aCount, otDeviceRole aMinRole)
+{
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < aCount; i++)
+	{
+		if (__atomic_load_n(&aNodes[i].mRole, __ATOMIC_RELAXED) >= aMinRole)
+			count++;
+	}
+
+	return count;
+}
+
+static uint32_t countPartitions(struct benchNode *aNodes, uint32_t aCount)
+{
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < aCount; i++)
+	{
+		uint32_t j;
+
+		if (aNodes[i].mRole < OT_DEVICE_ROLE_CHILD)
+			continue;
+
+		for (j = 0; j < i; j++)
+		{
+			if (aNodes[j].mRole >= OT_DEVICE_ROLE_CHILD && aNodes[j].mPartitionId == aNodes[i].mPartitionId)
+				break;
+		}
+
+		if (j == i)
+			count++;
+	}
+
+	return count;
+}
+
+static long maxRssKb(void)
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static void printValue(const char *aName, long long aValue, int aCsv)
+{
+	if (aCsv)
+		printf("%s,%lld\n", aName, aValue);
+	else
+		printf("%-20s %lld\n", aName, aValue);
+}
+
+static void printNodes(struct benchNode *aNodes, uint32_t aCount, int aCsv)
+{
+	char name[64];
+
+	if (!aCsv)
+		printf("%6s %10s %10s %9s %8s %8s\n", "node", "attach_ms", "router_ms", "role", "cpu_ms", "detaches");
+
+	for (uint32_t i = 0; i < aCount; i++)
+	{
+		struct benchNode *bench = &aNodes[i];
+		long long attachMs = bench->mAttachNs < 0 ? -1 : bench->mAttachNs / 1000000;
+		long long routerMs = bench->mRouterNs < 0 ? -1 : bench->mRouterNs / 1000000;
+
+		if (!aCsv)
+		{
+			printf("%6u %10lld %10lld %9s %8lld %8u\n", bench->mId, attachMs, routerMs, sRoleNames[bench->mRole],
+			       (long long)(bench->mCpuNs / 1000000), bench->mDetaches);
+			continue;
+		}
+
+		snprintf(name, sizeof(name), "node%u_attach_ms", bench->mId);
+		printValue(name, attachMs, 1);
+		snprintf(name, sizeof(name), "node%u_router_ms", bench->mId);
+		printValue(name, routerMs, 1);
+		snprintf(name, sizeof(name), "node%u_role", bench->mId);
+		printValue(name, bench->mRole, 1);
+		snprintf(name, sizeof(name), "node%u_cpu_ms", bench->mId);
+		printValue(name, bench->mCpuNs / 1000000, 1);
+		snprintf(name, sizeof(name), "node%u_detaches", bench->mId);
+		printValue(name, bench->mDetaches, 1);
+	}
+}
+
+static void usage(const char *aName)
+{
+	fprintf(stderr,
+	        "usage: %s [-n nodes] [-T full|line|grid|split] [-s script] [-j jitter] [-w settle-seconds] "
+	        "[-t timeout-seconds] [-c]\n",
+	        aName);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct benchNode nodes[MAX_NODES];
+	struct perfSamples attachSamples;
+	struct perfSamples routerSamples;
+	struct perfSamples cpuSamples;
+	enum topology topology = TOPOLOGY_FULL;
+	const char *scriptPath = NULL;
+	uint32_t count = 8;
+	uint32_t jitter = 1;
+	uint32_t settle = 10;
+	uint32_t timeout = 300;
+	int64_t formedNs = -1;
+	int64_t mergedNs = -1;
+	int64_t mergeStartNs = -1;
+	int64_t convergedNs = -1;
+	int64_t deadlineNs;
+	long rssBeforeKb;
+	int failed = 0;
+	int csv = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:T:s:j:w:t:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			for (topology = TOPOLOGY_FULL; topology <= TOPOLOGY_SPLIT; topology++)
+			{
+				if (strcmp(optarg, sTopologyNames[topology]) == 0)
+					break;
+			}
+			if (topology > TOPOLOGY_SPLIT)
+				usage(argv[0]);
+			break;
+		case 's':
+			scriptPath = optarg;
+			break;
+		case 'j':
+			jitter = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			settle = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			timeout = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (count < 1 || count > MAX_NODES || (topology == TOPOLOGY_SPLIT && count < 2))
+	{
+		fprintf(stderr, "node count must be 1 to %d, and at least 2 to split\n", MAX_NODES);
+		return EXIT_FAILURE;
+	}
+
+	if (scriptPath != NULL && loadScript(scriptPath) < 0)
+	{
+		perror(scriptPath);
+		return EXIT_FAILURE;
+	}
+	else if (scriptPath == NULL)
+	{
+		defaultScript(jitter);
+	}
+
+	signal(SIGINT, quit);
+
+	posixPlatformSetOrigArgs(argc, argv);
+	posixPlatformRandomInit();
+	rssBeforeKb = maxRssKb();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		struct benchNode *bench = &nodes[i];
+
+		bench->mId = i + 1;
+		bench->mAttachNs = -1;
+		bench->mRouterNs = -1;
+		bench->mNode = posixPlatformNodeCreate(bench->mId);
+		otInstanceInit(NULL, &bench->mInstanceSize);
+		bench->mInstanceBuffer = calloc(1, bench->mInstanceSize);
+
+		if (bench->mNode == NULL || bench->mInstanceBuffer == NULL)
+		{
+			fprintf(stderr, "failed to create node %u\n", bench->mId);
+			return EXIT_FAILURE;
+		}
+	}
+
+	setupTopology(topology, nodes, count);
+
+	sStartNs = perfNowNs(CLOCK_MONOTONIC);
+	deadlineNs = sStartNs + (int64_t)timeout * 1000000000;
+
+	for (uint32_t i = 0; i < count; i++)
+		pthread_create(&nodes[i].mThread, NULL, nodeThread, &nodes[i]);
+
+	while (isRunning && perfNowNs(CLOCK_MONOTONIC) < deadlineNs)
+	{
+		int64_t now;
+
+		usleep(SAMPLE_PERIOD_US);
+		now = perfNowNs(CLOCK_MONOTONIC);
+
+		for (uint32_t i = 0; i < count; i++)
+			failed |= __atomic_load_n(&nodes[i].mFailed, __ATOMIC_RELAXED);
+		if (failed)
+			break;
+
+		if (formedNs < 0)
+		{
+			if ((topology != TOPOLOGY_SPLIT && isConverged(nodes, 0, count)) ||
+			    (topology == TOPOLOGY_SPLIT && isConverged(nodes, 0, count / 2) &&
+			     isConverged(nodes, count / 2, count)))
+			{
+				formedNs = now - sStartNs;
+
+				if (topology == TOPOLOGY_SPLIT)
+				{
+					healSplit(nodes, count);
+					mergeStartNs = now;
+				}
+				else
+				{
+					convergedNs = now;
+				}
+			}
+		}
+		else if (convergedNs < 0)
+		{
+			if (isConverged(nodes, 0, count))
+			{
+				mergedNs = now - mergeStartNs;
+				convergedNs = now;
+			}
+		}
+		else if (countRole(nodes, count, OT_DEVICE_ROLE_ROUTER) == count ||
+		         now - convergedNs >= (int64_t)settle * 1000000000)
+		{
+			break;
+		}
+	}
+
+	__atomic_store_n(&sNodesRunning, 0, __ATOMIC_RELAXED);
+	for (uint32_t i = 0; i < count; i++)
+		pthread_join(nodes[i].mThread, NULL);
+
+	perfSamplesInit(&attachSamples, count);
+	perfSamplesInit(&routerSamples, count);
+	perfSamplesInit(&cpuSamples, count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (nodes[i].mAttachNs >= 0)
+			perfSamplesAdd(&attachSamples, nodes[i].mAttachNs);
+		if (nodes[i].mRouterNs >= 0)
+			perfSamplesAdd(&routerSamples, nodes[i].mRouterNs);
+		perfSamplesAdd(&cpuSamples, nodes[i].mCpuNs);
+	}
+
+	if (!csv)
+		printf("%u nodes, %s topology\n", count, sTopologyNames[topology]);
+	printValue("nodes", count, csv);
+	printValue("formed_ms", formedNs < 0 ? -1 : formedNs / 1000000, csv);
+	if (topology == TOPOLOGY_SPLIT)
+		printValue("merge_ms", mergedNs < 0 ? -1 : mergedNs / 1000000, csv);
+	printValue("attached", countRole(nodes, count, OT_DEVICE_ROLE_CHILD), csv);
+	printValue("routers", countRole(nodes, count, OT_DEVICE_ROLE_ROUTER), csv);
+	printValue("partitions", countPartitions(nodes, count), csv);
+	printValue("instance_bytes", nodes[0].mInstanceSize, csv);
+	printValue("max_rss_kb", maxRssKb(), csv);
+	printValue("rss_per_node_kb", (maxRssKb() - rssBeforeKb) / count, csv);
+	perfSamplesPrint(&attachSamples, stdout, "attach_ms", 1e6, csv);
+	perfSamplesPrint(&routerSamples, stdout, "router_ms", 1e6, csv);
+	perfSamplesPrint(&cpuSamples, stdout, "cpu_ms", 1e6, csv);
+	printNodes(nodes, count, csv);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		posixPlatformNodeDestroy(nodes[i].mNode);
+		free(nodes[i].mInstanceBuffer);
+	}
+
+	return (!failed && convergedNs >= 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
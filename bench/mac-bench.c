@@ -0,0 +1,249 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * MAC-path microbenchmark. Drives radio.c against a fake CA-821x (see
+ * fake-ca821x.h) whose worker thread delivers confirms and indications at
+ * controlled rates, so it needs no hardware and no OpenThread stack.
+ *
+ * tx: otPlatMcpsDataRequest -> MCPS-DATA.confirm -> otPlatMcpsDataConfirm,
+ *     keeping up to -w requests outstanding.
+ * rx: MCPS-DATA.indication -> otPlatMcpsDataIndication.
+ *
+ * It reports frames/s, CPU time per frame (whole process and main thread),
+ * the handoff latency from the worker dispatching a callback to the main
+ * thread running the upcall, and for tx, the request to confirm latency.
+ *
+ * usage: mac-bench [-m tx|rx] [-n frames] [-r rate] [-w window] [-l length] [-c]
+ *   -r  the most callbacks the fake delivers per second, 0 for no limit (default 0)
+ *   -w  tx requests outstanding at once (default 1)
+ *   -l  MSDU length (default 100)
+ *   -c  print "name,value" lines instead of a table
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#include "openthread/platform/radio-mac.h"
+#include "openthread/platform/radio.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-metrics.h"
+#include "fake-ca821x.h"
+#include "perf-stats.h"
+#include "selfpipe.h"
+
+enum
+{
+	MAX_SAMPLES = 100000,
+	MAX_WINDOW = 255,
+};
+
+static struct ca821x_dev sDev;
+static otInstance *sInstance;
+static int sCsv = 0;
+
+static uint32_t sDone = 0;
+static uint32_t sOutstanding = 0;
+static int64_t sRequestNs[256];
+static struct perfSamples sHandoff;
+static struct perfSamples sRoundTrip;
+
+void otPlatMcpsDataConfirm(otInstance *aInstance, uint8_t aMsduHandle, int aStatus)
+{
+	int64_t now = perfNowNs(CLOCK_MONOTONIC);
+
+	perfSamplesAdd(&sHandoff, now - fakeCa821xConfirmDispatchNs(aMsduHandle));
+	perfSamplesAdd(&sRoundTrip, now - sRequestNs[aMsduHandle]);
+	sOutstanding--;
+	sDone++;
+}
+
+void otPlatMcpsDataIndication(otInstance *aInstance, otDataIndication *aDataIndication)
+{
+	int64_t dispatchNs;
+
+	memcpy(&dispatchNs, aDataIndication->mMsdu, sizeof(dispatchNs));
+	perfSamplesAdd(&sHandoff, perfNowNs(CLOCK_MONOTONIC) - dispatchNs);
+	sDone++;
+}
+
+//The same wait as posixPlatformSleep, for the radio only
+static void serviceRadio(void)
+{
+	fd_set readFds;
+	int maxFd = -1;
+	struct timeval timeout = {0, 100000};
+
+	FD_ZERO(&readFds);
+	selfpipe_UpdateFdSet(&readFds, NULL, &maxFd);
+
+	if (select(maxFd + 1, &readFds, NULL, NULL, &timeout) > 0)
+		selfpipe_pop();
+
+	PlatformRadioProcess();
+}
+
+static void sendRequest(uint32_t aIndex, uint8_t aLength)
+{
+	otDataRequest dataReq;
+
+	memset(&dataReq, 0, sizeof(dataReq));
+	dataReq.mSrcAddrMode = 3;
+	dataReq.mDst.mAddressMode = 3;
+	dataReq.mMsduLength = aLength;
+	dataReq.mMsduHandle = (uint8_t)aIndex;
+
+	sRequestNs[dataReq.mMsduHandle] = perfNowNs(CLOCK_MONOTONIC);
+	if (otPlatMcpsDataRequest(sInstance, &dataReq) == OT_ERROR_NONE)
+		sOutstanding++;
+	else
+		sDone++;
+}
+
+static void printValue(const char *aName, const char *aUnit, double aValue)
+{
+	if (sCsv)
+		printf("%s,%.3f\n", aName, aValue);
+	else
+		printf("%-22s %.3f %s\n", aName, aValue, aUnit);
+}
+
+static int64_t cpuNs(struct rusage *aUsage)
+{
+	return ((int64_t)aUsage->ru_utime.tv_sec + aUsage->ru_stime.tv_sec) * 1000000000LL +
+	       ((int64_t)aUsage->ru_utime.tv_usec + aUsage->ru_stime.tv_usec) * 1000;
+}
+
+int main(int argc, char *argv[])
+{
+	const struct posixMetrics *metrics = posixPlatformGetMetrics();
+	const char *mode = "tx";
+	uint32_t frames = 100000;
+	uint32_t rate = 0;
+	uint32_t window = 1;
+	uint8_t length = 100;
+	uint64_t barrierWaits, barrierWaitNs;
+	int64_t startNs, wallNs, mainCpuNs;
+	struct rusage startUsage, endUsage;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:n:r:w:l:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			mode = optarg;
+			break;
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 'w':
+			window = atoi(optarg);
+			break;
+		case 'l':
+			length = atoi(optarg);
+			break;
+		case 'c':
+			sCsv = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m tx|rx] [-n frames] [-r rate] [-w window] [-l length] [-c]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ((strcmp(mode, "tx") && strcmp(mode, "rx")) || window < 1 || window > MAX_WINDOW || length < 8 || length > 127)
+	{
+		fprintf(stderr, "Mode must be tx or rx, window from 1 to %d, length from 8 to 127\n", MAX_WINDOW);
+		return EXIT_FAILURE;
+	}
+
+	perfSamplesInit(&sHandoff, MAX_SAMPLES);
+	perfSamplesInit(&sRoundTrip, MAX_SAMPLES);
+
+	fakeCa821xInit(&sDev);
+	fakeCa821xSetConfirms(rate, 0);
+	PlatformRadioInitWithDev(&sDev);
+	sInstance = otInstanceInitSingle();
+	otPlatRadioEnable(sInstance);
+
+	barrierWaits = metrics->mBarrierWaits;
+	barrierWaitNs = metrics->mBarrierWaitNs;
+	getrusage(RUSAGE_SELF, &startUsage);
+	mainCpuNs = perfNowNs(CLOCK_THREAD_CPUTIME_ID);
+	startNs = perfNowNs(CLOCK_MONOTONIC);
+
+	if (strcmp(mode, "tx") == 0)
+	{
+		uint32_t sent = 0;
+
+		while (sDone < frames)
+		{
+			while (sOutstanding < window && sent < frames)
+				sendRequest(sent++, length);
+
+			serviceRadio();
+		}
+	}
+	else
+	{
+		fakeCa821xInjectIndications(frames, rate, length);
+
+		while (sDone < frames)
+			serviceRadio();
+	}
+
+	wallNs = perfNowNs(CLOCK_MONOTONIC) - startNs;
+	mainCpuNs = perfNowNs(CLOCK_THREAD_CPUTIME_ID) - mainCpuNs;
+	getrusage(RUSAGE_SELF, &endUsage);
+	barrierWaits = metrics->mBarrierWaits - barrierWaits;
+	barrierWaitNs = metrics->mBarrierWaitNs - barrierWaitNs;
+
+	if (!sCsv)
+		printf("%s: %u frames of %u bytes, rate limit %u/s, window %u\n", mode, frames, length, rate, window);
+	printValue("frames_per_s", "", frames / (wallNs / 1e9));
+	printValue("cpu_us_per_frame", "us", (cpuNs(&endUsage) - cpuNs(&startUsage)) / 1e3 / frames);
+	printValue("main_cpu_us_per_frame", "us", mainCpuNs / 1e3 / frames);
+	printValue("barrier_wait_us", "us", barrierWaits ? barrierWaitNs / 1e3 / barrierWaits : 0);
+	perfSamplesPrint(&sHandoff, stdout, "handoff_us", 1e3, sCsv);
+	if (strcmp(mode, "tx") == 0)
+		perfSamplesPrint(&sRoundTrip, stdout, "request_to_confirm_us", 1e3, sCsv);
+
+	fakeCa821xDeinit(&sDev);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Stand-ins for the OpenThread functions the platform library calls, so
+ * benchmarks can drive the platform without linking the stack. The MAC and
+ * UART upcalls are weak, for benchmarks to override the ones they measure.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/message.h"
+#include "openthread/tasklet.h"
+#include "openthread/udp.h"
+#include "openthread/thread.h"
+#include "openthread/platform/alarm-milli.h"
+#include "openthread/platform/radio-mac.h"
+#include "openthread/platform/uart.h"
+
+static int sInstance;
+
+otInstance *otInstanceInitSingle(void)
+{
+	return (otInstance *)&sInstance;
+}
+
+void otInstanceFinalize(otInstance *aInstance)
+{
+}
+
+void otInstanceReset(otInstance *aInstance)
+{
+}
+
+otError otThreadSetAutoStart(otInstance *aInstance, bool aStartAutomatically)
+{
+	return OT_ERROR_NONE;
+}
+
+void otTaskletsProcess(otInstance *aInstance)
+{
+}
+
+bool otTaskletsArePending(otInstance *aInstance)
+{
+	return false;
+}
+
+otError otSetStateChangedCallback(otInstance *aInstance, otStateChangedCallback aCallback, void *aContext)
+{
+	return OT_ERROR_NONE;
+}
+
+void otRemoveStateChangeCallback(otInstance *aInstance, otStateChangedCallback aCallback, void *aContext)
+{
+}
+
+otDeviceRole otThreadGetDeviceRole(otInstance *aInstance)
+{
+	return OT_DEVICE_ROLE_DISABLED;
+}
+
+void otIp6SetReceiveCallback(otInstance *aInstance, otIp6ReceiveCallback aCallback, void *aCallbackContext)
+{
+}
+
+void otIp6SetReceiveFilterEnabled(otInstance *aInstance, bool aEnabled)
+{
+}
+
+const otNetifAddress *otIp6GetUnicastAddresses(otInstance *aInstance)
+{
+	return NULL;
+}
+
+otMessage *otIp6NewMessage(otInstance *aInstance, bool aLinkSecurityEnabled)
+{
+	return NULL;
+}
+
+otError otIp6Send(otInstance *aInstance, otMessage *aMessage)
+{
+	return OT_ERROR_NO_BUFS;
+}
+
+otError otMessageAppend(otMessage *aMessage, const void *aBuf, uint16_t aLength)
+{
+	return OT_ERROR_NO_BUFS;
+}
+
+uint16_t otMessageGetLength(otMessage *aMessage)
+{
+	return 0;
+}
+
+uint16_t otMessageGetOffset(otMessage *aMessage)
+{
+	return 0;
+}
+
+int otMessageRead(otMessage *aMessage, uint16_t aOffset, void *aBuf, uint16_t aLength)
+{
+	return 0;
+}
+
+void otMessageFree(otMessage *aMessage)
+{
+}
+
+void otMessageGetBufferInfo(otInstance *aInstance, otBufferInfo *aBufferInfo)
+{
+	memset(aBufferInfo, 0, sizeof(*aBufferInfo));
+	aBufferInfo->mTotalBuffers = 44;
+	aBufferInfo->mFreeBuffers = 44;
+}
+
+otMessage *otUdpNewMessage(otInstance *aInstance, bool aLinkSecurityEnabled)
+{
+	return NULL;
+}
+
+otError otUdpOpen(otInstance *aInstance, otUdpSocket *aSocket, otUdpReceive aCallback, void *aContext)
+{
+	return OT_ERROR_NONE;
+}
+
+otError otUdpClose(otUdpSocket *aSocket)
+{
+	return OT_ERROR_NONE;
+}
+
+otError otUdpBind(otUdpSocket *aSocket, otSockAddr *aSockName)
+{
+	return OT_ERROR_NONE;
+}
+
+otError otUdpSend(otUdpSocket *aSocket, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+	return OT_ERROR_NO_BUFS;
+}
+
+void otPlatAlarmMilliFired(otInstance *aInstance)
+{
+}
+
+__attribute__((weak)) void otPlatUartReceived(const uint8_t *aBuf, uint16_t aBufLength)
+{
+}
+
+__attribute__((weak)) void otPlatUartSendDone(void)
+{
+}
+
+__attribute__((weak)) void otPlatMcpsDataIndication(otInstance *aInstance, otDataIndication *aDataIndication)
+{
+}
+
+__attribute__((weak)) void otPlatMcpsDataConfirm(otInstance *aInstance, uint8_t aMsduHandle, int aStatus)
+{
+}
+
+__attribute__((weak)) void otPlatMlmeCommStatusIndication(otInstance *aInstance,
+                                                           otCommStatusIndication *aCommStatusIndication)
+{
+}
+
+__attribute__((weak)) void otPlatMlmeBeaconNotifyIndication(otInstance *aInstance, otBeaconNotify *aBeaconNotify)
+{
+}
+
+__attribute__((weak)) void otPlatMlmeScanConfirm(otInstance *aInstance, otScanConfirm *aScanConfirm)
+{
+}
@@ -0,0 +1,124 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Startup benchmark. Brings up the platform and an OpenThread instance the
+ * same way cliapp does, then reports how long it took to reach each
+ * milestone, up to attaching to the network stored in the node's flash.
+ *
+ * usage: startup-bench [-n nodeid] [-t timeout-seconds] [-c]
+ *   -c  print "milestone,microseconds" lines instead of a table
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/tasklet.h"
+#include "openthread/thread.h"
+#include "openthread/platform/alarm-milli.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+
+static volatile sig_atomic_t isRunning = 1;
+
+static void quit(int sig)
+{
+	isRunning = 0;
+}
+
+static void printCsv(void)
+{
+	for (int i = 0; i < POSIX_MILESTONE_COUNT; i++)
+	{
+		printf("%s,%lld\n", posixPlatformGetMilestoneName(i), (long long)posixPlatformGetMilestoneUs(i));
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	otInstance *OT_INSTANCE;
+	uint32_t timeout = 120;
+	uint32_t deadline;
+	int csv = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:t:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			NODE_ID = atoi(optarg);
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n nodeid] [-t timeout-seconds] [-c]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	signal(SIGINT, quit);
+
+	posixPlatformSetOrigArgs(argc, argv);
+	posixPlatformInitRetry();
+	OT_INSTANCE = otInstanceInitSingle();
+	posixPlatformMarkMilestone(POSIX_MILESTONE_INSTANCE_READY);
+
+	otIp6SetEnabled(OT_INSTANCE, true);
+	otThreadSetEnabled(OT_INSTANCE, true);
+
+	deadline = otPlatAlarmMilliGetNow() + timeout * 1000;
+	while (isRunning && (int32_t)(deadline - otPlatAlarmMilliGetNow()) > 0)
+	{
+		posixPlatformTaskletsProcess(OT_INSTANCE);
+		posixPlatformProcessDrivers(OT_INSTANCE);
+
+		if (otThreadGetDeviceRole(OT_INSTANCE) >= OT_DEVICE_ROLE_CHILD)
+		{
+			posixPlatformMarkMilestone(POSIX_MILESTONE_ATTACHED);
+			break;
+		}
+	}
+
+	if (csv)
+		printCsv();
+	else
+		posixPlatformPrintMilestones(stdout);
+
+	otInstanceFinalize(OT_INSTANCE);
+
+	return posixPlatformGetMilestoneUs(POSIX_MILESTONE_ATTACHED) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Wakeup and cross-thread handoff benchmark. Measures the existing path a
+ * radio callback takes from the ca821x worker thread to the main thread:
+ * selfpipe_push, the main thread waking in select, and the barrier handing
+ * the callback over and back. It uses the fake CA-821x from fake-ca821x.h,
+ * which delivers MCPS-DATA indications at a fixed rate.
+ *
+ * Reported distributions, all from the worker starting a dispatch:
+ *   wakeup    until the main thread's select returned with the selfpipe readable
+ *   handoff   until the upcall ran on the main thread
+ *   roundtrip until the worker got control back
+ * and resume, from the upcall running until the worker got control back.
+ *
+ * Idle, the main thread blocks in select between callbacks. With -s, it
+ * instead spends that many us per loop iteration on synthetic work and polls,
+ * like a loop busy with tasklets. -b adds background threads spinning to load
+ * the CPUs.
+ *
+ * usage: wakeup-bench [-n count] [-r rate] [-s work-us] [-b threads] [-B cpu] [-M cpu] [-W cpu] [-c]
+ *   -B  pin the background threads to this CPU
+ *   -M  pin the main thread to this CPU
+ *   -W  pin the worker thread to this CPU
+ *   -c  print "name,value" lines instead of a table
+ */
+
+#define _GNU_SOURCE 1
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#include "openthread/platform/radio-mac.h"
+#include "openthread/platform/radio.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "fake-ca821x.h"
+#include "perf-stats.h"
+#include "selfpipe.h"
+
+enum
+{
+	MAX_SAMPLES = 100000,
+	MAX_BACKGROUND = 64,
+};
+
+static struct ca821x_dev sDev;
+static volatile int sBackgroundRunning = 1;
+static uint32_t sHandled = 0;
+static int64_t sWakeNs;
+static int64_t sUpcallNs;
+
+static struct perfSamples sWakeup;
+static struct perfSamples sHandoff;
+static struct perfSamples sRoundTrip; //Only touched by the worker
+static struct perfSamples sResume;    //Only touched by the worker
+
+void otPlatMcpsDataIndication(otInstance *aInstance, otDataIndication *aDataIndication)
+{
+	int64_t dispatchNs;
+
+	sUpcallNs = perfNowNs(CLOCK_MONOTONIC);
+	memcpy(&dispatchNs, aDataIndication->mMsdu, sizeof(dispatchNs));
+
+	if (sWakeNs >= dispatchNs)
+		perfSamplesAdd(&sWakeup, sWakeNs - dispatchNs);
+	perfSamplesAdd(&sHandoff, sUpcallNs - dispatchNs);
+	sHandled++;
+}
+
+//Called on the worker once the main thread has released it
+static void handleDispatched(int64_t aDispatchNs, int64_t aReturnNs)
+{
+	perfSamplesAdd(&sRoundTrip, aReturnNs - aDispatchNs);
+	perfSamplesAdd(&sResume, aReturnNs - sUpcallNs);
+}
+
+static void *background(void *aContext)
+{
+	while (sBackgroundRunning)
+		;
+
+	return NULL;
+}
+
+static int pinThread(pthread_t aThread, int aCpu)
+{
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(aCpu, &cpus);
+	return pthread_setaffinity_np(aThread, sizeof(cpus), &cpus);
+}
+
+static void usage(const char *aName)
+{
+	fprintf(stderr, "usage: %s [-n count] [-r rate] [-s work-us] [-b threads] [-B cpu] [-M cpu] [-W cpu] [-c]\n", aName);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t backgroundThreads[MAX_BACKGROUND];
+	uint32_t count = 10000;
+	uint32_t rate = 1000;
+	uint32_t workUs = 0;
+	int backgroundCount = 0;
+	int backgroundCpu = -1;
+	int mainCpu = -1;
+	int workerCpu = -1;
+	int csv = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:s:b:B:M:W:c")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'r':
+			rate = atoi(optarg);
+			break;
+		case 's':
+			workUs = atoi(optarg);
+			break;
+		case 'b':
+			backgroundCount = atoi(optarg);
+			break;
+		case 'B':
+			backgroundCpu = atoi(optarg);
+			break;
+		case 'M':
+			mainCpu = atoi(optarg);
+			break;
+		case 'W':
+			workerCpu = atoi(optarg);
+			break;
+		case 'c':
+			csv = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (backgroundCount < 0 || backgroundCount > MAX_BACKGROUND)
+	{
+		fprintf(stderr, "At most %d background threads\n", MAX_BACKGROUND);
+		return EXIT_FAILURE;
+	}
+
+	perfSamplesInit(&sWakeup, MAX_SAMPLES);
+	perfSamplesInit(&sHandoff, MAX_SAMPLES);
+	perfSamplesInit(&sRoundTrip, MAX_SAMPLES);
+	perfSamplesInit(&sResume, MAX_SAMPLES);
+
+	fakeCa821xInit(&sDev);
+	fakeCa821xSetDispatchHook(handleDispatched);
+	PlatformRadioInitWithDev(&sDev);
+	otPlatRadioEnable(otInstanceInitSingle());
+
+	if ((mainCpu >= 0 && pinThread(pthread_self(), mainCpu)) || (workerCpu >= 0 && fakeCa821xPinWorker(workerCpu)))
+	{
+		fprintf(stderr, "Failed to pin to CPU\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < backgroundCount; i++)
+	{
+		pthread_create(&backgroundThreads[i], NULL, background, NULL);
+		if (backgroundCpu >= 0)
+			pinThread(backgroundThreads[i], backgroundCpu);
+	}
+
+	fakeCa821xInjectIndications(count, rate, 8);
+
+	while (sHandled < count)
+	{
+		fd_set readFds;
+		int maxFd = -1;
+		struct timeval timeout = {0, workUs ? 0 : 100000};
+
+		if (workUs)
+		{
+			int64_t endNs = perfNowNs(CLOCK_MONOTONIC) + (int64_t)workUs * 1000;
+
+			while (perfNowNs(CLOCK_MONOTONIC) < endNs)
+				;
+		}
+
+		FD_ZERO(&readFds);
+		selfpipe_UpdateFdSet(&readFds, NULL, &maxFd);
+
+		if (select(maxFd + 1, &readFds, NULL, NULL, &timeout) > 0)
+		{
+			sWakeNs = perfNowNs(CLOCK_MONOTONIC);
+			selfpipe_pop();
+		}
+
+		PlatformRadioProcess();
+	}
+
+	fakeCa821xDeinit(&sDev);
+	sBackgroundRunning = 0;
+	for (int i = 0; i < backgroundCount; i++)
+		pthread_join(backgroundThreads[i], NULL);
+
+	if (!csv)
+	{
+		printf("%u callbacks at %u/s, main thread %s", count, rate, workUs ? "busy" : "idle");
+		if (workUs)
+			printf(" (%u us per iteration)", workUs);
+		printf(", %d background threads, cpus main %d worker %d background %d\n", backgroundCount, mainCpu,
+		       workerCpu, backgroundCpu);
+	}
+	perfSamplesPrint(&sWakeup, stdout, "wakeup_us", 1e3, csv);
+	perfSamplesPrint(&sHandoff, stdout, "handoff_us", 1e3, csv);
+	perfSamplesPrint(&sResume, stdout, "resume_us", 1e3, csv);
+	perfSamplesPrint(&sRoundTrip, stdout, "roundtrip_us", 1e3, csv);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,527 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * CoAP load generator over OpenThread. One node runs as a server with a
+ * configurable handler cost, another as a client that sends confirmable or
+ * non-confirmable requests, either open-loop at a target rate or closed-loop
+ * with a fixed number of requests outstanding. The client reports requests/s,
+ * retransmissions and latency percentiles.
+ *
+ * OpenThread does not expose its retransmission count, so confirmable
+ * requests that took longer than the CoAP ACK_TIMEOUT are counted as
+ * retransmitted, as they cannot have been answered on the first attempt.
+ *
+ * Both nodes must already be commissioned (eg. with cliapp), this attaches to
+ * the network stored in the node's flash.
+ *
+ * usage: coapperf [-n nodeid] [-c] -s [-w handler-us] [-r response-length]
+ *        coapperf [-n nodeid] [-c] [-N] [-R requests/s | -C concurrency] [-l length] [-t seconds] <server address>
+ *   -s  run as the server
+ *   -w  time each request handler busy-waits for, in us (default 0)
+ *   -r  response payload length (default 0)
+ *   -N  send non-confirmable requests
+ *   -R  open-loop, send at this many requests/s
+ *   -C  closed-loop, keep this many requests outstanding (default 1)
+ *   -l  request payload length (default 16)
+ *   -t  how long to send for (default 10)
+ *   -c  print "name,value" lines instead of a table
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "openthread/coap.h"
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/message.h"
+#include "openthread/tasklet.h"
+#include "openthread/thread.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "perf-stats.h"
+
+#define COAPPERF_URI "perf"
+
+enum
+{
+	MAX_OUTSTANDING = 256,
+	MAX_PAYLOAD = 1024,
+	MAX_SAMPLES = 100000,
+	ACK_TIMEOUT_MS = 2000, //RFC 7252 default, the earliest a retransmission can happen
+	DRAIN_TIMEOUT_MS = 10000,
+};
+
+struct request
+{
+	int     mInUse;
+	int64_t mStartNs;
+};
+
+static volatile sig_atomic_t isRunning = 1;
+static otInstance *OT_INSTANCE;
+static int sCsv = 0;
+static uint8_t sPayload[MAX_PAYLOAD];
+
+static struct
+{
+	uint32_t mCostUs;
+	uint16_t mResponseLength;
+	uint64_t mServed;
+	uint64_t mServedReported;
+	uint64_t mResponseErrors;
+	int64_t  mNextReportNs;
+	otCoapResource mResource;
+} sServer;
+
+static struct
+{
+	otIp6Address mPeer;
+	int      mConfirmable;
+	uint32_t mRate;
+	uint32_t mConcurrency;
+	uint16_t mLength;
+	uint32_t mSeconds;
+	int64_t  mStartNs;
+	int64_t  mEndNs;
+	int64_t  mNextNs;
+	uint32_t mOutstanding;
+	uint64_t mSent;
+	uint64_t mSendErrors;
+	uint64_t mSkipped;
+	uint64_t mCompleted;
+	uint64_t mTimeouts;
+	uint64_t mFailed;
+	uint64_t mRetransmitted;
+	struct request mRequests[MAX_OUTSTANDING];
+	struct perfSamples mLatency;
+} sClient;
+
+static void quit(int sig)
+{
+	isRunning = 0;
+}
+
+static void printValue(const char *aName, const char *aUnit, double aValue)
+{
+	if (sCsv)
+		printf("%s,%.3f\n", aName, aValue);
+	else
+		printf("%-14s %.3f %s\n", aName, aValue, aUnit);
+}
+
+/* Server ------------------------------------------------------------------- */
+
+static void handleRequest(void *aContext, otCoapHeader *aHeader, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+	otCoapHeader responseHeader;
+	otMessage *response;
+	otCoapType type = otCoapHeaderGetType(aHeader);
+	int64_t endNs = perfNowNs(CLOCK_MONOTONIC) + (int64_t)sServer.mCostUs * 1000;
+
+	//Stand-in for application work, which blocks the stack just like this
+	while (perfNowNs(CLOCK_MONOTONIC) < endNs)
+		;
+
+	sServer.mServed++;
+
+	otCoapHeaderInit(&responseHeader,
+	                 type == OT_COAP_TYPE_CONFIRMABLE ? OT_COAP_TYPE_ACKNOWLEDGMENT : OT_COAP_TYPE_NON_CONFIRMABLE,
+	                 OT_COAP_CODE_CHANGED);
+	otCoapHeaderSetMessageId(&responseHeader, otCoapHeaderGetMessageId(aHeader));
+	otCoapHeaderSetToken(&responseHeader, otCoapHeaderGetToken(aHeader), otCoapHeaderGetTokenLength(aHeader));
+
+	if (sServer.mResponseLength)
+		otCoapHeaderSetPayloadMarker(&responseHeader);
+
+	response = otCoapNewMessage(OT_INSTANCE, &responseHeader);
+	if (response == NULL)
+	{
+		sServer.mResponseErrors++;
+		return;
+	}
+
+	if (otMessageAppend(response, sPayload, sServer.mResponseLength) != OT_ERROR_NONE ||
+	    otCoapSendResponse(OT_INSTANCE, response, aMessageInfo) != OT_ERROR_NONE)
+	{
+		sServer.mResponseErrors++;
+		otMessageFree(response);
+	}
+}
+
+static void serverProcess(int64_t *aWakeNs)
+{
+	int64_t nowNs = perfNowNs(CLOCK_MONOTONIC);
+
+	if (nowNs < sServer.mNextReportNs)
+	{
+		*aWakeNs = sServer.mNextReportNs;
+		return;
+	}
+
+	if (sServer.mServed != sServer.mServedReported)
+	{
+		if (sCsv)
+			printf("served_per_s,%llu\n", (unsigned long long)(sServer.mServed - sServer.mServedReported));
+		else
+			printf("%llu requests/s\n", (unsigned long long)(sServer.mServed - sServer.mServedReported));
+		fflush(stdout);
+		sServer.mServedReported = sServer.mServed;
+	}
+
+	sServer.mNextReportNs = nowNs + 1000000000;
+	*aWakeNs = sServer.mNextReportNs;
+}
+
+/* Client ------------------------------------------------------------------- */
+
+static void handleResponse(void *aContext, otCoapHeader *aHeader, otMessage *aMessage,
+                           const otMessageInfo *aMessageInfo, otError aResult)
+{
+	struct request *request = aContext;
+	int64_t latencyNs = perfNowNs(CLOCK_MONOTONIC) - request->mStartNs;
+
+	request->mInUse = 0;
+	sClient.mOutstanding--;
+
+	if (aResult == OT_ERROR_NONE)
+	{
+		sClient.mCompleted++;
+		perfSamplesAdd(&sClient.mLatency, latencyNs);
+
+		if (sClient.mConfirmable && latencyNs >= (int64_t)ACK_TIMEOUT_MS * 1000000)
+			sClient.mRetransmitted++;
+	}
+	else if (aResult == OT_ERROR_RESPONSE_TIMEOUT)
+	{
+		sClient.mTimeouts++;
+	}
+	else
+	{
+		sClient.mFailed++;
+	}
+}
+
+static otError clientSend(void)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otCoapHeader header;
+	otMessageInfo messageInfo;
+	otMessage *message = NULL;
+	struct request *request = NULL;
+
+	for (int i = 0; i < MAX_OUTSTANDING && request == NULL; i++)
+	{
+		if (!sClient.mRequests[i].mInUse)
+			request = &sClient.mRequests[i];
+	}
+
+	if (request == NULL)
+	{
+		sClient.mSkipped++;
+		return OT_ERROR_BUSY;
+	}
+
+	otCoapHeaderInit(&header, sClient.mConfirmable ? OT_COAP_TYPE_CONFIRMABLE : OT_COAP_TYPE_NON_CONFIRMABLE,
+	                 OT_COAP_CODE_POST);
+	otCoapHeaderGenerateToken(&header, 2);
+	otCoapHeaderAppendUriPathOptions(&header, COAPPERF_URI);
+	if (sClient.mLength)
+		otCoapHeaderSetPayloadMarker(&header);
+
+	message = otCoapNewMessage(OT_INSTANCE, &header);
+	if (message == NULL)
+		goto exit;
+
+	error = otMessageAppend(message, sPayload, sClient.mLength);
+	if (error != OT_ERROR_NONE)
+		goto exit;
+
+	memset(&messageInfo, 0, sizeof(messageInfo));
+	messageInfo.mPeerAddr = sClient.mPeer;
+	messageInfo.mPeerPort = OT_DEFAULT_COAP_PORT;
+	messageInfo.mInterfaceId = 1;
+
+	request->mStartNs = perfNowNs(CLOCK_MONOTONIC);
+	error = otCoapSendRequest(OT_INSTANCE, message, &messageInfo, handleResponse, request);
+
+exit:
+	if (error == OT_ERROR_NONE)
+	{
+		request->mInUse = 1;
+		sClient.mOutstanding++;
+		sClient.mSent++;
+	}
+	else
+	{
+		sClient.mSendErrors++;
+		if (message)
+			otMessageFree(message);
+	}
+
+	return error;
+}
+
+/* Returns 0 once the client has finished */
+static int clientProcess(int64_t *aWakeNs)
+{
+	int64_t nowNs = perfNowNs(CLOCK_MONOTONIC);
+
+	if (nowNs >= sClient.mEndNs)
+	{
+		//Let outstanding requests complete, but don't start any more
+		if (sClient.mOutstanding == 0 || nowNs >= sClient.mEndNs + (int64_t)DRAIN_TIMEOUT_MS * 1000000)
+			return 0;
+
+		*aWakeNs = sClient.mEndNs + (int64_t)DRAIN_TIMEOUT_MS * 1000000;
+		return 1;
+	}
+
+	if (sClient.mRate)
+	{
+		int64_t intervalNs = 1000000000LL / sClient.mRate;
+
+		//Open loop: requests are due whether or not earlier ones completed
+		while (sClient.mNextNs <= nowNs)
+		{
+			if (clientSend() == OT_ERROR_NO_BUFS)
+				break;
+			sClient.mNextNs += intervalNs;
+		}
+
+		//Don't try to catch up after a stall, that would just measure a burst
+		if (sClient.mNextNs < nowNs)
+			sClient.mNextNs = nowNs + intervalNs;
+
+		*aWakeNs = sClient.mNextNs;
+	}
+	else
+	{
+		while (sClient.mOutstanding < sClient.mConcurrency)
+		{
+			if (clientSend() != OT_ERROR_NONE)
+			{
+				//Out of buffers, try again shortly
+				*aWakeNs = nowNs + 1000000;
+				break;
+			}
+		}
+	}
+
+	if (*aWakeNs > sClient.mEndNs)
+		*aWakeNs = sClient.mEndNs;
+
+	return 1;
+}
+
+static void clientPrintReport(void)
+{
+	double seconds = (sClient.mEndNs - sClient.mStartNs) / 1e9;
+
+	if (!sCsv)
+	{
+		printf("%s requests, ", sClient.mConfirmable ? "confirmable" : "non-confirmable");
+		if (sClient.mRate)
+			printf("open-loop at %u/s, ", sClient.mRate);
+		else
+			printf("closed-loop with %u outstanding, ", sClient.mConcurrency);
+		printf("%u byte payloads\n", sClient.mLength);
+	}
+
+	printValue("sent", "requests", sClient.mSent);
+	printValue("completed", "requests", sClient.mCompleted);
+	printValue("requests_per_s", "", seconds > 0 ? sClient.mCompleted / seconds : 0);
+	printValue("retransmitted", "requests", sClient.mRetransmitted);
+	printValue("timeouts", "requests", sClient.mTimeouts);
+	printValue("failed", "requests", sClient.mFailed);
+	printValue("unanswered", "requests", sClient.mOutstanding);
+	printValue("send_errors", "", sClient.mSendErrors);
+	printValue("skipped", "requests", sClient.mSkipped);
+	perfSamplesPrint(&sClient.mLatency, stdout, "latency_ms", 1e6, sCsv);
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void usage(const char *aName)
+{
+	fprintf(stderr,
+	        "usage: %s [-n nodeid] [-c] -s [-w handler-us] [-r response-length]\n"
+	        "       %s [-n nodeid] [-c] [-N] [-R requests/s | -C concurrency] [-l length] [-t seconds] <server address>\n",
+	        aName, aName);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	int isServer = 0;
+	int opt;
+
+	sClient.mConfirmable = 1;
+	sClient.mConcurrency = 1;
+	sClient.mLength = 16;
+	sClient.mSeconds = 10;
+
+	while ((opt = getopt(argc, argv, "n:csw:r:NR:C:l:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			NODE_ID = atoi(optarg);
+			break;
+		case 'c':
+			sCsv = 1;
+			break;
+		case 's':
+			isServer = 1;
+			break;
+		case 'w':
+			sServer.mCostUs = atoi(optarg);
+			break;
+		case 'r':
+			sServer.mResponseLength = atoi(optarg);
+			break;
+		case 'N':
+			sClient.mConfirmable = 0;
+			break;
+		case 'R':
+			sClient.mRate = atoi(optarg);
+			break;
+		case 'C':
+			sClient.mConcurrency = atoi(optarg);
+			break;
+		case 'l':
+			sClient.mLength = atoi(optarg);
+			break;
+		case 't':
+			sClient.mSeconds = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (sClient.mLength > MAX_PAYLOAD || sServer.mResponseLength > MAX_PAYLOAD)
+	{
+		fprintf(stderr, "Payload length must be at most %d\n", MAX_PAYLOAD);
+		return EXIT_FAILURE;
+	}
+
+	if (sClient.mConcurrency < 1 || sClient.mConcurrency > MAX_OUTSTANDING)
+	{
+		fprintf(stderr, "Concurrency must be from 1 to %d\n", MAX_OUTSTANDING);
+		return EXIT_FAILURE;
+	}
+
+	if (!isServer && (optind >= argc || otIp6AddressFromString(argv[optind], &sClient.mPeer) != OT_ERROR_NONE))
+		usage(argv[0]);
+
+	signal(SIGINT, quit);
+
+	posixPlatformSetOrigArgs(argc, argv);
+	posixPlatformInitRetry();
+	OT_INSTANCE = otInstanceInitSingle();
+	otIp6SetEnabled(OT_INSTANCE, true);
+	otThreadSetEnabled(OT_INSTANCE, true);
+	otCoapStart(OT_INSTANCE, OT_DEFAULT_COAP_PORT);
+
+	if (isServer)
+	{
+		sServer.mResource.mUriPath = COAPPERF_URI;
+		sServer.mResource.mHandler = handleRequest;
+		otCoapAddResource(OT_INSTANCE, &sServer.mResource);
+	}
+
+	perfSamplesInit(&sClient.mLatency, MAX_SAMPLES);
+
+	while (isRunning && otThreadGetDeviceRole(OT_INSTANCE) < OT_DEVICE_ROLE_CHILD)
+	{
+		posixPlatformTaskletsProcess(OT_INSTANCE);
+		posixPlatformProcessDrivers(OT_INSTANCE);
+	}
+
+	if (isServer)
+	{
+		fprintf(stderr, "Serving coap://[::]:%d/%s\n", OT_DEFAULT_COAP_PORT, COAPPERF_URI);
+	}
+	else
+	{
+		sClient.mStartNs = perfNowNs(CLOCK_MONOTONIC);
+		sClient.mEndNs = sClient.mStartNs + (int64_t)sClient.mSeconds * 1000000000;
+		sClient.mNextNs = sClient.mStartNs;
+	}
+
+	while (isRunning)
+	{
+		struct timeval timeout;
+		int64_t wakeNs = INT64_MAX;
+
+		posixPlatformTaskletsProcess(OT_INSTANCE);
+		posixPlatformProcessDriversQuick(OT_INSTANCE);
+
+		if (isServer)
+			serverProcess(&wakeNs);
+		else if (!clientProcess(&wakeNs))
+			break;
+
+		posixPlatformGetTimeout(OT_INSTANCE, &timeout);
+		if (wakeNs != INT64_MAX)
+		{
+			int64_t waitNs = wakeNs - perfNowNs(CLOCK_MONOTONIC);
+			struct timeval wait = {0, 0};
+
+			if (waitNs > 0)
+			{
+				wait.tv_sec = waitNs / 1000000000;
+				wait.tv_usec = (waitNs % 1000000000) / 1000;
+			}
+
+			if (timercmp(&wait, &timeout, <))
+				timeout = wait;
+		}
+		posixPlatformSleep(OT_INSTANCE, &timeout);
+	}
+
+	if (isServer)
+	{
+		printValue("served", "requests", sServer.mServed);
+		printValue("response_errors", "", sServer.mResponseErrors);
+	}
+	else
+	{
+		clientPrintReport();
+	}
+
+	otCoapStop(OT_INSTANCE);
+	otInstanceFinalize(OT_INSTANCE);
+
+	return (isServer || sClient.mCompleted) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -36,7 +36,10 @@
 #include "openthread/cli.h"
 #include "openthread/tasklet.h"
 
+#include "ca821x-posix-thread/posix-channel.h"
+#include "ca821x-posix-thread/posix-ipc.h"
 #include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-tun.h"
 
 static int isRunning;
 
@@ -45,6 +48,12 @@ static void quit(int sig)
 	isRunning = 0;
 }
 
+static void reinit(otInstance *aInstance, void *aContext)
+{
+	otCliUartInit(aInstance);
+	posixPlatformCliInit(aInstance);
+}
+
 int main(int argc, char *argv[])
 {
     otInstance * OT_INSTANCE;
@@ -54,9 +63,20 @@ int main(int argc, char *argv[])
     signal(SIGINT, quit);
 
     posixPlatformSetOrigArgs(argc, argv);
-    while (posixPlatformInit() < 0) sleep(1);
+    posixPlatformInitRetry();
     OT_INSTANCE = otInstanceInitSingle();
     otCliUartInit(OT_INSTANCE);
+    posixPlatformCliInit(OT_INSTANCE);
+    posixPlatformSetResetHandler(reinit, NULL);
+
+    if (getenv(POSIX_TUN_ENV) != NULL)
+    {
+        posixPlatformTunOpen(OT_INSTANCE, getenv(POSIX_TUN_ENV));
+    }
+    if (getenv(POSIX_IPC_ENV) != NULL)
+    {
+        posixPlatformIpcStart(OT_INSTANCE, getenv(POSIX_IPC_ENV));
+    }
 
     /* Test harness specific config */
 #ifdef TESTHARNESS
@@ -65,10 +85,16 @@ int main(int argc, char *argv[])
     uint8_t extPanId[] = {0x00, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00};
     otSetExtendedPanId(OT_INSTANCE, extPanId);
     otSetChannel(OT_INSTANCE, 20);
+#else
+    if (getenv(POSIX_CHANNEL_ENV) != NULL)
+    {
+        //Moves to the quietest channel a few seconds after startup, before the network is formed
+        posixPlatformChannelSelect(OT_INSTANCE, strtoul(getenv(POSIX_CHANNEL_ENV), NULL, 0), 3, NULL, NULL);
+    }
 #endif
 
 	while(isRunning){
-		otTaskletsProcess(OT_INSTANCE);
+		posixPlatformTaskletsProcess(OT_INSTANCE);
 		posixPlatformProcessDrivers(OT_INSTANCE);
 		/* Simple application code can go here*/
 	}
@@ -79,11 +105,12 @@ int main(int argc, char *argv[])
 	 * (The timeout value can be decreased by application code after GetTimeout is called
 	 *  if necessary, but not increased)
 	 *
-	 *  There is a further example for multithreaded code in mainMultithreaded.c
+	 *  There is a further example for multithreaded code in mainMultithreaded.c,
+	 *  and one for application code written as cooperative tasks in mainTask.c
 	 *
 	 * struct timeval timeout;
 	 * while(1){
-	 *     otTaskletsProcess(aInstance);
+	 *     posixPlatformTaskletsProcess(aInstance);
 	 *     posixPlatformProcessDriversQuick(aInstance);
 	 *
 	 *     //Application code here!
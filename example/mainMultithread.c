@@ -45,6 +45,13 @@ static pthread_t work_thread;
 //as the ot_mutex is already held for them
 static pthread_mutex_t ot_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+//Called from otWorker with the ot_mutex held, after an in-process reset
+static void reinit(otInstance *aInstance, void *aContext)
+{
+	otCliUartInit(aInstance);
+	posixPlatformCliInit(aInstance);
+}
+
 /*
  * otWorker runs the openthread stack, which is protected by the
  * ot_mutex. The sleep function is used while the stack is idle,
@@ -56,7 +63,7 @@ static void *otWorker(void * aContext){
 
 	while(1){
 		pthread_mutex_lock(&ot_mutex);
-			otTaskletsProcess(aInstance);
+			posixPlatformTaskletsProcess(aInstance);
 			posixPlatformProcessDriversQuick(aInstance);
 			posixPlatformGetTimeout(aInstance, &timeout);
 		pthread_mutex_unlock(&ot_mutex);
@@ -71,12 +78,11 @@ int main(int argc, char *argv[])
 {
     otInstance * OT_INSTANCE;
 
-    while (posixPlatformInit() < 0)
-    {
-    	sleep(1);
-    }
+    posixPlatformInitRetry();
     OT_INSTANCE = otInstanceInitSingle();
     otCliUartInit(OT_INSTANCE);
+    posixPlatformCliInit(OT_INSTANCE);
+    posixPlatformSetResetHandler(reinit, NULL);
 
     /* Test harness specific config */
 #ifdef TESTHARNESS
@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * cliapp, with the application written as cooperative tasks instead of code
+ * in the main loop or a second thread. See posix-task.h.
+ *
+ * One task waits for OpenThread state changes, signalled by the state changed
+ * callback, and reports role changes. Another wakes up periodically and
+ * reports the partition. Both call the OpenThread API directly, as tasks run
+ * on the OpenThread thread.
+ *
+ * usage: task-example [nodeid]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/cli.h"
+#include "openthread/tasklet.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-task.h"
+
+#define REPORT_PERIOD_MS 30000
+
+static int isRunning;
+static otInstance *OT_INSTANCE;
+
+static struct posixTaskEvent sStateChanged;
+static uint32_t sChangedFlags;
+
+static void quit(int sig)
+{
+	isRunning = 0;
+}
+
+//Runs on the OpenThread thread, so can signal the task directly
+static void stateChanged(uint32_t aFlags, void *aContext)
+{
+	sChangedFlags |= aFlags;
+	posixTaskEventSignal(&sStateChanged, 0);
+}
+
+//The new instance has none of the old one's callbacks, so the tasks need them again
+static void reinit(otInstance *aInstance, void *aContext)
+{
+	OT_INSTANCE = aInstance;
+	otCliUartInit(aInstance);
+	posixPlatformCliInit(aInstance);
+	otSetStateChangedCallback(OT_INSTANCE, stateChanged, NULL);
+}
+
+static void roleTask(void *aContext)
+{
+	otDeviceRole role = otThreadGetDeviceRole(OT_INSTANCE);
+
+	while (isRunning)
+	{
+		uint32_t flags;
+
+		posixTaskEventWait(&sStateChanged, POSIX_TASK_WAIT_FOREVER);
+		flags = sChangedFlags;
+		sChangedFlags = 0;
+
+		if ((flags & OT_CHANGED_THREAD_ROLE) && otThreadGetDeviceRole(OT_INSTANCE) != role)
+		{
+			role = otThreadGetDeviceRole(OT_INSTANCE);
+			otCliUartOutputFormat("[task] role is now %d\r\n", role);
+		}
+	}
+}
+
+static void reportTask(void *aContext)
+{
+	while (isRunning)
+	{
+		posixTaskSleep(REPORT_PERIOD_MS);
+
+		if (otThreadGetDeviceRole(OT_INSTANCE) >= OT_DEVICE_ROLE_CHILD)
+		{
+			otCliUartOutputFormat("[task] partition %08x, rloc16 %04x\r\n",
+			                      otThreadGetPartitionId(OT_INSTANCE),
+			                      otThreadGetRloc16(OT_INSTANCE));
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc > 1) NODE_ID = atoi(argv[1]);
+	isRunning = 1;
+	signal(SIGINT, quit);
+
+	posixPlatformSetOrigArgs(argc, argv);
+	posixPlatformInitRetry();
+	OT_INSTANCE = otInstanceInitSingle();
+	otCliUartInit(OT_INSTANCE);
+	posixPlatformCliInit(OT_INSTANCE);
+	posixPlatformSetResetHandler(reinit, NULL);
+
+	posixTaskEventInit(&sStateChanged);
+	otSetStateChangedCallback(OT_INSTANCE, stateChanged, NULL);
+
+	if (posixTaskCreate(roleTask, NULL, 0) == NULL || posixTaskCreate(reportTask, NULL, 0) == NULL)
+	{
+		fprintf(stderr, "failed to create the tasks\n");
+		return 1;
+	}
+
+	//The tasks run from within posixPlatformProcessDrivers
+	while(isRunning){
+		posixPlatformTaskletsProcess(OT_INSTANCE);
+		posixPlatformProcessDrivers(OT_INSTANCE);
+	}
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "perf-stats.h"
+
+void perfSamplesInit(struct perfSamples *aSamples, size_t aCapacity)
+{
+	memset(aSamples, 0, sizeof(*aSamples));
+	aSamples->mValues = malloc(aCapacity * sizeof(int64_t));
+	aSamples->mCapacity = aCapacity;
+	aSamples->mRandom = 0x12345678;
+
+	if (aSamples->mValues == NULL)
+	{
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void perfSamplesFree(struct perfSamples *aSamples)
+{
+	free(aSamples->mValues);
+	aSamples->mValues = NULL;
+	aSamples->mCapacity = 0;
+	perfSamplesReset(aSamples);
+}
+
+void perfSamplesReset(struct perfSamples *aSamples)
+{
+	aSamples->mCount = 0;
+	aSamples->mSeen = 0;
+	aSamples->mMin = 0;
+	aSamples->mMax = 0;
+	aSamples->mSorted = 0;
+}
+
+void perfSamplesAdd(struct perfSamples *aSamples, int64_t aValue)
+{
+	uint64_t slot;
+
+	if (aSamples->mSeen == 0 || aValue < aSamples->mMin)
+		aSamples->mMin = aValue;
+	if (aSamples->mSeen == 0 || aValue > aSamples->mMax)
+		aSamples->mMax = aValue;
+
+	aSamples->mSeen++;
+	aSamples->mSorted = 0;
+
+	if (aSamples->mCount < aSamples->mCapacity)
+	{
+		aSamples->mValues[aSamples->mCount++] = aValue;
+		return;
+	}
+
+	//Reservoir sampling, xorshift32 is plenty for choosing a slot
+	aSamples->mRandom ^= aSamples->mRandom << 13;
+	aSamples->mRandom ^= aSamples->mRandom >> 17;
+	aSamples->mRandom ^= aSamples->mRandom << 5;
+
+	//The new sample replaces the one in slot j, for j chosen from all samples seen
+	slot = aSamples->mRandom % aSamples->mSeen;
+	if (slot < aSamples->mCapacity)
+	{
+		aSamples->mValues[slot] = aValue;
+	}
+}
+
+static int compareSamples(const void *a, const void *b)
+{
+	int64_t left = *(const int64_t *)a;
+	int64_t right = *(const int64_t *)b;
+
+	return (left > right) - (left < right);
+}
+
+int64_t perfSamplesPercentile(struct perfSamples *aSamples, double aPercentile)
+{
+	size_t index;
+
+	if (aSamples->mCount == 0)
+	{
+		return 0;
+	}
+
+	if (!aSamples->mSorted)
+	{
+		qsort(aSamples->mValues, aSamples->mCount, sizeof(int64_t), compareSamples);
+		aSamples->mSorted = 1;
+	}
+
+	index = (size_t)(aPercentile / 100.0 * (aSamples->mCount - 1) + 0.5);
+	if (index >= aSamples->mCount)
+	{
+		index = aSamples->mCount - 1;
+	}
+
+	return aSamples->mValues[index];
+}
+
+void perfSamplesPrint(struct perfSamples *aSamples, FILE *aStream, const char *aName, double aDivisor, int aCsv)
+{
+	static const double percentiles[] = {0, 50, 90, 99, 100};
+	static const char *const labels[] = {"min", "p50", "p90", "p99", "max"};
+
+	if (!aCsv)
+	{
+		fprintf(aStream, "%-12s n=%llu", aName, (unsigned long long)aSamples->mSeen);
+	}
+
+	for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+	{
+		int64_t raw = perfSamplesPercentile(aSamples, percentiles[i]);
+		double  value;
+
+		if (aSamples->mSeen != 0 && percentiles[i] == 0)
+			raw = aSamples->mMin;
+		else if (aSamples->mSeen != 0 && percentiles[i] == 100)
+			raw = aSamples->mMax;
+		value = raw / aDivisor;
+
+		if (aCsv)
+			fprintf(aStream, "%s_%s,%.3f\n", aName, labels[i], value);
+		else
+			fprintf(aStream, " %s=%.3f", labels[i], value);
+	}
+
+	if (!aCsv)
+	{
+		fprintf(aStream, "\n");
+	}
+}
+
+int64_t perfNowNs(clockid_t aClock)
+{
+	struct timespec now;
+
+	clock_gettime(aClock, &now);
+	return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the sample and timing helpers shared by the performance examples.
+ */
+
+#ifndef PERF_STATS_H_
+#define PERF_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A bounded set of samples, eg. latencies, for computing percentiles. Once
+ * full, samples are kept by reservoir sampling so the set stays representative
+ * of the whole run.
+ *
+ */
+struct perfSamples
+{
+	int64_t *mValues;
+	size_t   mCount;    ///< Samples currently held
+	size_t   mCapacity;
+	uint64_t mSeen;     ///< Samples ever added
+	int64_t  mMin;      ///< Smallest sample ever added, kept even if dropped from the set
+	int64_t  mMax;      ///< Largest sample ever added
+	uint32_t mRandom;
+	int      mSorted;
+};
+
+/**
+ * This method allocates space for @p aCapacity samples. It exits on failure.
+ *
+ */
+void perfSamplesInit(struct perfSamples *aSamples, size_t aCapacity);
+
+/**
+ * This method frees the samples.
+ *
+ */
+void perfSamplesFree(struct perfSamples *aSamples);
+
+/**
+ * This method forgets all samples, keeping the allocation.
+ *
+ */
+void perfSamplesReset(struct perfSamples *aSamples);
+
+/**
+ * This method adds a sample.
+ *
+ */
+void perfSamplesAdd(struct perfSamples *aSamples, int64_t aValue);
+
+/**
+ * This method gets a percentile of the samples, or 0 if there are none.
+ *
+ * @param[in]  aPercentile  The percentile, from 0 to 100.
+ *
+ */
+int64_t perfSamplesPercentile(struct perfSamples *aSamples, double aPercentile);
+
+/**
+ * This method prints the count, min, p50, p90, p99 and max of the samples,
+ * divided by @p aDivisor, as "<aName> ..." or in CSV as "<aName>_p50,..."
+ * The min and max are exact, the percentiles are of the samples kept.
+ *
+ */
+void perfSamplesPrint(struct perfSamples *aSamples, FILE *aStream, const char *aName, double aDivisor, int aCsv);
+
+/**
+ * This method gets the time of @p aClock in nanoseconds.
+ *
+ */
+int64_t perfNowNs(clockid_t aClock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PERF_STATS_H_ */
@@ -0,0 +1,653 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * iperf-style UDP goodput tool over OpenThread. One node runs as a server,
+ * another as a client that sends it a paced or unpaced stream. The server
+ * measures goodput, loss, jitter (RFC 3550) and one-way latency, prints them
+ * and returns them to the client at the end of the stream. To measure over
+ * several hops, address a server that is several hops away.
+ *
+ * One-way latency uses CLOCK_REALTIME timestamps, so is only meaningful when
+ * both nodes run on the same host or have synchronised clocks. With -e the
+ * server also echoes every packet, and the client reports the round trip
+ * time, which needs no synchronisation.
+ *
+ * Both nodes must already be commissioned (eg. with cliapp), this attaches to
+ * the network stored in the node's flash.
+ *
+ * usage: udpperf [-n nodeid] [-p port] [-c] -s
+ *        udpperf [-n nodeid] [-p port] [-c] [-l length] [-b bits/s] [-t seconds] [-e] <server address>
+ *   -s  run as the server
+ *   -l  UDP payload length, including the 24 byte header (default 64)
+ *   -b  send rate in bits/s of UDP payload, 0 sends as fast as buffers allow (default 0)
+ *   -t  how long to send for (default 10)
+ *   -e  ask the server to echo every packet, to measure round trip time
+ *   -c  print "name,value" lines instead of a table
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/message.h"
+#include "openthread/tasklet.h"
+#include "openthread/thread.h"
+#include "openthread/udp.h"
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "perf-stats.h"
+
+#define UDPPERF_MAGIC 0x43415550 //"CAUP"
+
+enum
+{
+	DEFAULT_PORT = 5001,
+	HEADER_LENGTH = 24,
+	REPORT_FIELDS = 8,
+	REPORT_LENGTH = HEADER_LENGTH + REPORT_FIELDS * 8,
+	MAX_PAYLOAD = 1232, //IPv6 minimum MTU minus IPv6 and UDP headers
+	MAX_SAMPLES = 100000,
+	SEND_BURST = 8,
+	FIN_INTERVAL_MS = 250,
+	FIN_ATTEMPTS = 20,
+	IDLE_REPORT_MS = 5000,
+};
+
+enum
+{
+	FLAG_FIN = 1 << 0,        ///< Last packet of the stream, the server replies with a report
+	FLAG_ECHO = 1 << 1,       ///< The server should echo the header back
+	FLAG_ECHO_REPLY = 1 << 2, ///< An echoed header
+	FLAG_REPORT = 1 << 3,     ///< A server report
+};
+
+struct header
+{
+	uint32_t mMagic;
+	uint32_t mStream;
+	uint32_t mSeq;
+	uint32_t mFlags;
+	int64_t  mTimestamp; ///< CLOCK_REALTIME of the sender, in ns
+};
+
+//Report fields, in the order they are sent
+enum
+{
+	REPORT_RECEIVED,
+	REPORT_LOST,
+	REPORT_OUT_OF_ORDER,
+	REPORT_BYTES,
+	REPORT_DURATION_NS,
+	REPORT_JITTER_NS,
+	REPORT_LATENCY_P50_NS,
+	REPORT_LATENCY_P99_NS,
+};
+
+static volatile sig_atomic_t isRunning = 1;
+static otInstance *OT_INSTANCE;
+static otUdpSocket sSocket;
+static uint16_t sPort = DEFAULT_PORT;
+static int sCsv = 0;
+static uint8_t sPacket[MAX_PAYLOAD];
+
+static struct
+{
+	uint32_t mStream;
+	int      mActive;
+	int      mReported;
+	uint32_t mNextSeq;
+	uint64_t mReceived;
+	uint64_t mOutOfOrder;
+	uint64_t mBytes;
+	int64_t  mFirstNs;
+	int64_t  mLastNs;
+	int64_t  mLastTransitNs;
+	double   mJitterNs;
+	struct perfSamples mLatency;
+} sServer;
+
+static struct
+{
+	otIp6Address mPeer;
+	uint16_t mLength;
+	uint64_t mRate;
+	uint32_t mSeconds;
+	int      mEcho;
+	uint32_t mStream;
+	uint32_t mSeq;
+	int64_t  mStartNs;
+	int64_t  mEndNs;
+	int64_t  mNextNs;
+	int64_t  mIntervalNs;
+	uint32_t mFinAttempts;
+	uint64_t mSent;
+	uint64_t mSendErrors;
+	int      mGotReport;
+	uint64_t mReport[REPORT_FIELDS];
+	struct perfSamples mRtt;
+} sClient;
+
+static void quit(int sig)
+{
+	isRunning = 0;
+}
+
+static void put32(uint8_t *aBuf, uint32_t aValue)
+{
+	for (int i = 0; i < 4; i++)
+		aBuf[i] = aValue >> (24 - 8 * i);
+}
+
+static uint32_t get32(const uint8_t *aBuf)
+{
+	return ((uint32_t)aBuf[0] << 24) | ((uint32_t)aBuf[1] << 16) | ((uint32_t)aBuf[2] << 8) | aBuf[3];
+}
+
+static void put64(uint8_t *aBuf, uint64_t aValue)
+{
+	put32(aBuf, aValue >> 32);
+	put32(aBuf + 4, (uint32_t)aValue);
+}
+
+static uint64_t get64(const uint8_t *aBuf)
+{
+	return ((uint64_t)get32(aBuf) << 32) | get32(aBuf + 4);
+}
+
+static void putHeader(uint8_t *aBuf, const struct header *aHeader)
+{
+	put32(aBuf, aHeader->mMagic);
+	put32(aBuf + 4, aHeader->mStream);
+	put32(aBuf + 8, aHeader->mSeq);
+	put32(aBuf + 12, aHeader->mFlags);
+	put64(aBuf + 16, (uint64_t)aHeader->mTimestamp);
+}
+
+static void getHeader(const uint8_t *aBuf, struct header *aHeader)
+{
+	aHeader->mMagic = get32(aBuf);
+	aHeader->mStream = get32(aBuf + 4);
+	aHeader->mSeq = get32(aBuf + 8);
+	aHeader->mFlags = get32(aBuf + 12);
+	aHeader->mTimestamp = (int64_t)get64(aBuf + 16);
+}
+
+static otError sendPacket(const otIp6Address *aPeer, uint16_t aPeerPort, const uint8_t *aBuf, uint16_t aLength)
+{
+	otError error = OT_ERROR_NO_BUFS;
+	otMessageInfo messageInfo;
+	otMessage *message = otUdpNewMessage(OT_INSTANCE, true);
+
+	if (message == NULL)
+		return error;
+
+	memset(&messageInfo, 0, sizeof(messageInfo));
+	messageInfo.mPeerAddr = *aPeer;
+	messageInfo.mPeerPort = aPeerPort;
+	messageInfo.mInterfaceId = 1;
+
+	error = otMessageAppend(message, aBuf, aLength);
+	if (error == OT_ERROR_NONE)
+		error = otUdpSend(&sSocket, message, &messageInfo);
+
+	if (error != OT_ERROR_NONE)
+		otMessageFree(message);
+
+	return error;
+}
+
+static void printValue(const char *aName, const char *aUnit, double aValue)
+{
+	if (sCsv)
+		printf("%s,%.3f\n", aName, aValue);
+	else
+		printf("%-12s %.3f %s\n", aName, aValue, aUnit);
+}
+
+static void printReport(const uint64_t *aReport)
+{
+	uint64_t expected = aReport[REPORT_RECEIVED] + aReport[REPORT_LOST];
+	double seconds = aReport[REPORT_DURATION_NS] / 1e9;
+
+	printValue("received", "packets", aReport[REPORT_RECEIVED]);
+	printValue("lost", "packets", aReport[REPORT_LOST]);
+	printValue("loss", "%", expected ? 100.0 * aReport[REPORT_LOST] / expected : 0);
+	printValue("reordered", "packets", aReport[REPORT_OUT_OF_ORDER]);
+	printValue("duration", "s", seconds);
+	printValue("goodput", "kbit/s", seconds > 0 ? aReport[REPORT_BYTES] * 8 / seconds / 1000 : 0);
+	printValue("jitter", "ms", aReport[REPORT_JITTER_NS] / 1e6);
+}
+
+/* Server ------------------------------------------------------------------- */
+
+static void serverResetStream(uint32_t aStream)
+{
+	sServer.mStream = aStream;
+	sServer.mActive = 1;
+	sServer.mReported = 0;
+	sServer.mNextSeq = 0;
+	sServer.mReceived = 0;
+	sServer.mOutOfOrder = 0;
+	sServer.mBytes = 0;
+	sServer.mFirstNs = perfNowNs(CLOCK_MONOTONIC);
+	sServer.mLastNs = sServer.mFirstNs;
+	sServer.mJitterNs = 0;
+	perfSamplesReset(&sServer.mLatency);
+}
+
+static void serverFillReport(uint64_t *aReport)
+{
+	aReport[REPORT_RECEIVED] = sServer.mReceived;
+	aReport[REPORT_LOST] = sServer.mNextSeq > sServer.mReceived ? sServer.mNextSeq - sServer.mReceived : 0;
+	aReport[REPORT_OUT_OF_ORDER] = sServer.mOutOfOrder;
+	aReport[REPORT_BYTES] = sServer.mBytes;
+	aReport[REPORT_DURATION_NS] = sServer.mLastNs - sServer.mFirstNs;
+	aReport[REPORT_JITTER_NS] = (uint64_t)sServer.mJitterNs;
+	aReport[REPORT_LATENCY_P50_NS] = perfSamplesPercentile(&sServer.mLatency, 50);
+	aReport[REPORT_LATENCY_P99_NS] = perfSamplesPercentile(&sServer.mLatency, 99);
+}
+
+static void serverPrintReport(void)
+{
+	uint64_t report[REPORT_FIELDS];
+
+	serverFillReport(report);
+
+	if (!sCsv)
+		printf("stream %08x\n", sServer.mStream);
+	printReport(report);
+	perfSamplesPrint(&sServer.mLatency, stdout, "latency_ms", 1e6, sCsv);
+	fflush(stdout);
+
+	sServer.mReported = 1;
+}
+
+static void serverReceive(const struct header *aHeader, uint16_t aLength, const otMessageInfo *aMessageInfo)
+{
+	int64_t nowNs = perfNowNs(CLOCK_MONOTONIC);
+	int64_t transitNs = perfNowNs(CLOCK_REALTIME) - aHeader->mTimestamp;
+
+	if (!sServer.mActive || aHeader->mStream != sServer.mStream)
+	{
+		if (sServer.mActive && !sServer.mReported)
+			serverPrintReport();
+		serverResetStream(aHeader->mStream);
+	}
+
+	if (aHeader->mFlags & FLAG_FIN)
+	{
+		uint8_t reply[REPORT_LENGTH];
+		uint64_t report[REPORT_FIELDS];
+		struct header header = {UDPPERF_MAGIC, aHeader->mStream, aHeader->mSeq, FLAG_REPORT, aHeader->mTimestamp};
+
+		//The FIN carries the number of datagrams sent, so those lost at the end count too
+		if (!sServer.mReported && aHeader->mSeq > sServer.mNextSeq)
+			sServer.mNextSeq = aHeader->mSeq;
+
+		if (!sServer.mReported)
+			serverPrintReport();
+
+		//Sent for every FIN, as the client retries until it gets one
+		serverFillReport(report);
+		putHeader(reply, &header);
+		for (int i = 0; i < REPORT_FIELDS; i++)
+			put64(reply + HEADER_LENGTH + 8 * i, report[i]);
+		sendPacket(&aMessageInfo->mPeerAddr, aMessageInfo->mPeerPort, reply, sizeof(reply));
+		return;
+	}
+
+	if (sServer.mReported)
+		return;
+
+	if (aHeader->mSeq < sServer.mNextSeq)
+		sServer.mOutOfOrder++;
+	else
+		sServer.mNextSeq = aHeader->mSeq + 1;
+
+	//RFC 3550 interarrival jitter, relative transit times cancel out any clock offset
+	if (sServer.mReceived)
+	{
+		int64_t d = transitNs - sServer.mLastTransitNs;
+		sServer.mJitterNs += ((d < 0 ? -d : d) - sServer.mJitterNs) / 16;
+	}
+	else
+	{
+		sServer.mFirstNs = nowNs;
+	}
+
+	sServer.mLastTransitNs = transitNs;
+	sServer.mLastNs = nowNs;
+	sServer.mReceived++;
+	sServer.mBytes += aLength;
+	perfSamplesAdd(&sServer.mLatency, transitNs);
+
+	if (aHeader->mFlags & FLAG_ECHO)
+	{
+		uint8_t reply[HEADER_LENGTH];
+		struct header header = *aHeader;
+
+		header.mFlags = FLAG_ECHO_REPLY;
+		putHeader(reply, &header);
+		sendPacket(&aMessageInfo->mPeerAddr, aMessageInfo->mPeerPort, reply, sizeof(reply));
+	}
+}
+
+static void serverProcess(int64_t *aWakeNs)
+{
+	int64_t idleNs = (int64_t)IDLE_REPORT_MS * 1000000;
+
+	if (!sServer.mActive || sServer.mReported)
+		return;
+
+	//The client went away without a FIN
+	if (perfNowNs(CLOCK_MONOTONIC) - sServer.mLastNs >= idleNs)
+		serverPrintReport();
+	else
+		*aWakeNs = sServer.mLastNs + idleNs;
+}
+
+/* Client ------------------------------------------------------------------- */
+
+static void clientReceive(const struct header *aHeader, const otMessage *aMessage, uint16_t aOffset, uint16_t aLength)
+{
+	if (aHeader->mStream != sClient.mStream)
+		return;
+
+	if (aHeader->mFlags & FLAG_ECHO_REPLY)
+	{
+		perfSamplesAdd(&sClient.mRtt, perfNowNs(CLOCK_REALTIME) - aHeader->mTimestamp);
+	}
+	else if ((aHeader->mFlags & FLAG_REPORT) && aLength >= REPORT_LENGTH && !sClient.mGotReport)
+	{
+		uint8_t report[REPORT_FIELDS * 8];
+
+		otMessageRead((otMessage *)aMessage, aOffset + HEADER_LENGTH, report, sizeof(report));
+		for (int i = 0; i < REPORT_FIELDS; i++)
+			sClient.mReport[i] = get64(report + 8 * i);
+		sClient.mGotReport = 1;
+	}
+}
+
+static otError clientSend(uint32_t aFlags, uint16_t aLength)
+{
+	otError error;
+	struct header header = {UDPPERF_MAGIC, sClient.mStream, sClient.mSeq, aFlags, perfNowNs(CLOCK_REALTIME)};
+
+	putHeader(sPacket, &header);
+	error = sendPacket(&sClient.mPeer, sPort, sPacket, aLength);
+
+	if (error == OT_ERROR_NONE && !(aFlags & FLAG_FIN))
+	{
+		sClient.mSeq++;
+		sClient.mSent++;
+	}
+	else if (error != OT_ERROR_NONE)
+	{
+		sClient.mSendErrors++;
+	}
+
+	return error;
+}
+
+static void clientStart(void)
+{
+	sClient.mStream = (uint32_t)getpid() ^ (uint32_t)perfNowNs(CLOCK_REALTIME);
+	sClient.mStartNs = perfNowNs(CLOCK_MONOTONIC);
+	sClient.mEndNs = sClient.mStartNs + (int64_t)sClient.mSeconds * 1000000000;
+	sClient.mNextNs = sClient.mStartNs;
+	sClient.mIntervalNs = sClient.mRate ? (int64_t)(sClient.mLength * 8 * 1e9 / sClient.mRate) : 0;
+}
+
+/* Returns 0 once the client has finished */
+static int clientProcess(int64_t *aWakeNs)
+{
+	int64_t nowNs = perfNowNs(CLOCK_MONOTONIC);
+	uint32_t flags = sClient.mEcho ? FLAG_ECHO : 0;
+
+	if (nowNs < sClient.mEndNs)
+	{
+		for (int i = 0; i < SEND_BURST && sClient.mNextNs <= nowNs; i++)
+		{
+			//Out of buffers, give the radio a moment to drain them
+			if (clientSend(flags, sClient.mLength) != OT_ERROR_NONE)
+			{
+				*aWakeNs = nowNs + 1000000;
+				return 1;
+			}
+
+			//Paced streams don't try to catch up more than one burst
+			sClient.mNextNs = sClient.mIntervalNs ? sClient.mNextNs + sClient.mIntervalNs : nowNs;
+			if (sClient.mIntervalNs && sClient.mNextNs < nowNs - sClient.mIntervalNs * SEND_BURST)
+				sClient.mNextNs = nowNs;
+		}
+
+		*aWakeNs = sClient.mNextNs < sClient.mEndNs ? sClient.mNextNs : sClient.mEndNs;
+		return 1;
+	}
+
+	if (sClient.mGotReport || sClient.mFinAttempts >= FIN_ATTEMPTS)
+		return 0;
+
+	if (nowNs >= sClient.mNextNs)
+	{
+		clientSend(FLAG_FIN, HEADER_LENGTH);
+		sClient.mFinAttempts++;
+		sClient.mNextNs = nowNs + (int64_t)FIN_INTERVAL_MS * 1000000;
+	}
+
+	*aWakeNs = sClient.mNextNs;
+	return 1;
+}
+
+static void clientPrintReport(void)
+{
+	int64_t endNs = perfNowNs(CLOCK_MONOTONIC);
+	double seconds;
+
+	if (endNs > sClient.mEndNs)
+		endNs = sClient.mEndNs;
+	seconds = (endNs - sClient.mStartNs) / 1e9;
+
+	if (!sCsv)
+		printf("stream %08x to port %u, %u byte payloads\n", sClient.mStream, sPort, sClient.mLength);
+	printValue("sent", "packets", sClient.mSent);
+	printValue("send_errors", "", sClient.mSendErrors);
+	printValue("send_rate", "kbit/s", seconds > 0 ? sClient.mSent * sClient.mLength * 8 / seconds / 1000 : 0);
+
+	if (sClient.mGotReport)
+	{
+		printReport(sClient.mReport);
+		printValue("latency_p50", "ms", (int64_t)sClient.mReport[REPORT_LATENCY_P50_NS] / 1e6);
+		printValue("latency_p99", "ms", (int64_t)sClient.mReport[REPORT_LATENCY_P99_NS] / 1e6);
+	}
+	else
+	{
+		fprintf(stderr, "No report from the server\n");
+	}
+
+	if (sClient.mEcho)
+		perfSamplesPrint(&sClient.mRtt, stdout, "rtt_ms", 1e6, sCsv);
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void handleUdpReceive(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+	int isServer = *(int *)aContext;
+	uint16_t offset = otMessageGetOffset(aMessage);
+	uint16_t length = otMessageGetLength(aMessage) - offset;
+	uint8_t buf[HEADER_LENGTH];
+	struct header header;
+
+	if (length < HEADER_LENGTH || otMessageRead(aMessage, offset, buf, sizeof(buf)) != sizeof(buf))
+		return;
+
+	getHeader(buf, &header);
+	if (header.mMagic != UDPPERF_MAGIC)
+		return;
+
+	if (isServer)
+		serverReceive(&header, length, aMessageInfo);
+	else
+		clientReceive(&header, aMessage, offset, length);
+}
+
+static void usage(const char *aName)
+{
+	fprintf(stderr,
+	        "usage: %s [-n nodeid] [-p port] [-c] -s\n"
+	        "       %s [-n nodeid] [-p port] [-c] [-l length] [-b bits/s] [-t seconds] [-e] <server address>\n",
+	        aName, aName);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	static int isServer = 0;
+	otSockAddr sockName;
+	int opt;
+
+	sClient.mLength = 64;
+	sClient.mSeconds = 10;
+
+	while ((opt = getopt(argc, argv, "n:p:csl:b:t:e")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			NODE_ID = atoi(optarg);
+			break;
+		case 'p':
+			sPort = atoi(optarg);
+			break;
+		case 'c':
+			sCsv = 1;
+			break;
+		case 's':
+			isServer = 1;
+			break;
+		case 'l':
+			sClient.mLength = atoi(optarg);
+			break;
+		case 'b':
+			sClient.mRate = strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			sClient.mSeconds = atoi(optarg);
+			break;
+		case 'e':
+			sClient.mEcho = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (sClient.mLength < HEADER_LENGTH || sClient.mLength > MAX_PAYLOAD)
+	{
+		fprintf(stderr, "Payload length must be from %d to %d\n", HEADER_LENGTH, MAX_PAYLOAD);
+		return EXIT_FAILURE;
+	}
+
+	if (!isServer && (optind >= argc || otIp6AddressFromString(argv[optind], &sClient.mPeer) != OT_ERROR_NONE))
+		usage(argv[0]);
+
+	signal(SIGINT, quit);
+
+	posixPlatformSetOrigArgs(argc, argv);
+	posixPlatformInitRetry();
+	OT_INSTANCE = otInstanceInitSingle();
+	otIp6SetEnabled(OT_INSTANCE, true);
+	otThreadSetEnabled(OT_INSTANCE, true);
+
+	perfSamplesInit(&sServer.mLatency, MAX_SAMPLES);
+	perfSamplesInit(&sClient.mRtt, MAX_SAMPLES);
+
+	memset(&sockName, 0, sizeof(sockName));
+	sockName.mPort = isServer ? sPort : 0;
+	otUdpOpen(OT_INSTANCE, &sSocket, handleUdpReceive, &isServer);
+	otUdpBind(&sSocket, &sockName);
+
+	while (isRunning && otThreadGetDeviceRole(OT_INSTANCE) < OT_DEVICE_ROLE_CHILD)
+	{
+		posixPlatformTaskletsProcess(OT_INSTANCE);
+		posixPlatformProcessDrivers(OT_INSTANCE);
+	}
+
+	if (isServer)
+		fprintf(stderr, "Listening on port %u\n", sPort);
+	else
+		clientStart();
+
+	while (isRunning)
+	{
+		struct timeval timeout;
+		int64_t wakeNs = INT64_MAX;
+
+		posixPlatformTaskletsProcess(OT_INSTANCE);
+		posixPlatformProcessDriversQuick(OT_INSTANCE);
+
+		if (isServer)
+			serverProcess(&wakeNs);
+		else if (!clientProcess(&wakeNs))
+			break;
+
+		posixPlatformGetTimeout(OT_INSTANCE, &timeout);
+		if (wakeNs != INT64_MAX)
+		{
+			int64_t waitNs = wakeNs - perfNowNs(CLOCK_MONOTONIC);
+			struct timeval wait = {0, 0};
+
+			if (waitNs > 0)
+			{
+				wait.tv_sec = waitNs / 1000000000;
+				wait.tv_usec = (waitNs % 1000000000) / 1000;
+			}
+
+			if (timercmp(&wait, &timeout, <))
+				timeout = wait;
+		}
+		posixPlatformSleep(OT_INSTANCE, &timeout);
+	}
+
+	if (isServer && sServer.mActive && !sServer.mReported)
+		serverPrintReport();
+	else if (!isServer)
+		clientPrintReport();
+
+	otUdpClose(&sSocket);
+	otInstanceFinalize(OT_INSTANCE);
+
+	return (isServer || sClient.mGotReport) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
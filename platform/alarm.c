@@ -36,14 +36,19 @@
 
 #include "openthread/platform/alarm-milli.h"
 #include "ca821x-posix-thread/posix-platform.h"
+#include "node.h"
+#include "scheduler.h"
 
-static bool s_is_running = false;
-static uint32_t s_alarm = 0;
+//All nodes share a time base, only the alarm itself is per node
 static struct timeval s_start;
 
 void posixPlatformAlarmInit(void)
 {
-    gettimeofday(&s_start, NULL);
+    //Nodes created later must keep the same time base
+    if (s_start.tv_sec == 0)
+    {
+        gettimeofday(&s_start, NULL);
+    }
 }
 
 uint32_t otPlatAlarmMilliGetNow(void)
@@ -66,19 +71,20 @@ uint32_t otPlatAlarmMilliGetNow(void)
 
 void otPlatAlarmMilliStartAt(otInstance *aInstance, uint32_t t0, uint32_t dt)
 {
-	(void)aInstance;
-    s_alarm = t0 + dt;
-    s_is_running = true;
+    struct posixNode *node = posixNodeFromInstance(aInstance);
+
+    node->mAlarm = t0 + dt;
+    node->mAlarmRunning = true;
 }
 
 void otPlatAlarmMilliStop(otInstance *aInstance)
 {
-	(void)aInstance;
-    s_is_running = false;
+    posixNodeFromInstance(aInstance)->mAlarmRunning = false;
 }
 
 void posixPlatformAlarmUpdateTimeout(struct timeval *aTimeout)
 {
+    struct posixNode *node = posixNodeCurrent();
     int32_t remaining;
 
     if (aTimeout == NULL)
@@ -86,9 +92,9 @@ void posixPlatformAlarmUpdateTimeout(struct timeval *aTimeout)
         return;
     }
 
-    if (s_is_running)
+    if (node->mAlarmRunning)
     {
-    	remaining = (int32_t)(s_alarm - otPlatAlarmMilliGetNow());
+    	remaining = (int32_t)(node->mAlarm - otPlatAlarmMilliGetNow());
 
         if (remaining > 0)
         {
@@ -110,15 +116,17 @@ void posixPlatformAlarmUpdateTimeout(struct timeval *aTimeout)
 
 void posixPlatformAlarmProcess(otInstance *aInstance)
 {
+    struct posixNode *node = posixNodeFromInstance(aInstance);
     int32_t remaining;
 
-    if (s_is_running)
+    if (node->mAlarmRunning)
     {
-    	remaining = (int32_t)(s_alarm - otPlatAlarmMilliGetNow());
+    	remaining = (int32_t)(node->mAlarm - otPlatAlarmMilliGetNow());
 
         if (remaining <= 0)
         {
-            s_is_running = false;
+            node->mAlarmRunning = false;
+            platformSchedWaited(POSIX_SCHED_ALARM, (uint64_t)-remaining * 1000000);
             otPlatAlarmMilliFired(aInstance);
         }
     }
@@ -0,0 +1,277 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements channel selection from an energy scan, see posix-channel.h.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "openthread/link.h"
+#include "openthread/platform/logging.h"
+#include "ca821x_api.h"
+#include "mac_messages.h"
+#include "ca821x-posix-thread/posix-channel.h"
+#include "code_utils.h"
+#include "channel.h"
+#include "node.h"
+
+#define SCAN_ED     0
+#define SCAN_ACTIVE 1
+
+struct posixChannelScan
+{
+	otInstance             *mInstance;
+	posixChannelScanHandler mHandler;
+	void                   *mContext;
+	uint32_t                mChannelMask;
+	uint32_t                mScanned;  ///< Channels the ED scan measured
+	uint8_t                 mDuration;
+	uint8_t                 mScanType; ///< Phase in progress, SCAN_ED then SCAN_ACTIVE
+	bool                    mSelect;
+	uint8_t                 mEnergy[POSIX_CHANNEL_COUNT];
+	uint8_t                 mBeacons[POSIX_CHANNEL_COUNT];
+};
+
+static uint8_t requestScan(struct posixNode *aNode, struct posixChannelScan *aScan)
+{
+	struct SecSpec security;
+
+	memset(&security, 0, sizeof(security));
+
+	return MLME_SCAN_request(aScan->mScanType, aScan->mChannelMask, aScan->mDuration, &security, aNode->mDeviceRef);
+}
+
+static int compareResults(const void *a, const void *b)
+{
+	const struct posixChannelResult *resultA = a;
+	const struct posixChannelResult *resultB = b;
+
+	if (resultA->mScore != resultB->mScore)
+		return resultA->mScore - resultB->mScore;
+	if (resultA->mEnergy != resultB->mEnergy)
+		return resultA->mEnergy - resultB->mEnergy;
+	return resultA->mChannel - resultB->mChannel;
+}
+
+static void rankChannels(const struct posixChannelScan *aScan, struct posixChannelReport *aReport)
+{
+	memset(aReport, 0, sizeof(*aReport));
+
+	for (uint8_t channel = POSIX_CHANNEL_MIN; channel <= POSIX_CHANNEL_MAX; channel++)
+	{
+		struct posixChannelResult *result = &aReport->mChannels[aReport->mCount];
+		uint8_t                    i = channel - POSIX_CHANNEL_MIN;
+
+		if (!(aScan->mScanned & (1UL << channel)))
+			continue;
+
+		result->mChannel = channel;
+		result->mEnergy = aScan->mEnergy[i];
+		result->mBeacons = aScan->mBeacons[i];
+		result->mScore = result->mEnergy + result->mBeacons * POSIX_CHANNEL_BEACON_WEIGHT;
+		aReport->mCount++;
+	}
+
+	qsort(aReport->mChannels, aReport->mCount, sizeof(aReport->mChannels[0]), compareResults);
+}
+
+static void finishScan(struct posixNode *aNode, otError aError)
+{
+	struct posixChannelScan   *scan = aNode->mChannelScan;
+	struct posixChannelReport *report = NULL;
+	struct posixChannelReport  ranking;
+
+	//Cleared first, so that the handler can start another scan
+	aNode->mChannelScan = NULL;
+
+	if (aError == OT_ERROR_NONE)
+	{
+		rankChannels(scan, &ranking);
+		report = &ranking;
+
+		if (ranking.mCount == 0)
+		{
+			aError = OT_ERROR_FAILED;
+			report = NULL;
+		}
+	}
+
+	if (aError == OT_ERROR_NONE && scan->mSelect)
+	{
+		aError = otLinkSetChannel(scan->mInstance, ranking.mChannels[0].mChannel);
+		otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_PLATFORM, "Selected channel %u, energy %u, %u beacons",
+		          ranking.mChannels[0].mChannel, ranking.mChannels[0].mEnergy, ranking.mChannels[0].mBeacons);
+	}
+
+	if (scan->mHandler)
+		scan->mHandler(scan->mInstance, aError, report, scan->mContext);
+
+	free(scan);
+}
+
+static otError startScan(otInstance *            aInstance,
+                         uint32_t                aChannelMask,
+                         uint8_t                 aDuration,
+                         bool                    aSelect,
+                         posixChannelScanHandler aHandler,
+                         void *                  aContext)
+{
+	struct posixNode *       node = posixNodeFromInstance(aInstance);
+	struct posixChannelScan *scan = NULL;
+	otError                  error = OT_ERROR_NONE;
+
+	if (aChannelMask == 0)
+		aChannelMask = POSIX_CHANNEL_MASK_ALL;
+	aChannelMask &= POSIX_CHANNEL_MASK_ALL;
+
+	otEXPECT_ACTION(aChannelMask != 0, error = OT_ERROR_INVALID_ARGS);
+	otEXPECT_ACTION(node->mChannelScan == NULL, error = OT_ERROR_BUSY);
+	otEXPECT_ACTION((scan = calloc(1, sizeof(*scan))) != NULL, error = OT_ERROR_NO_BUFS);
+
+	scan->mInstance = aInstance;
+	scan->mHandler = aHandler;
+	scan->mContext = aContext;
+	scan->mChannelMask = aChannelMask;
+	scan->mDuration = aDuration;
+	scan->mScanType = SCAN_ED;
+	scan->mSelect = aSelect;
+
+	switch (requestScan(node, scan))
+	{
+	case MAC_SUCCESS:
+		break;
+	case MAC_SCAN_IN_PROGRESS:
+		error = OT_ERROR_BUSY;
+		break;
+	default:
+		error = OT_ERROR_FAILED;
+	}
+	otEXPECT(error == OT_ERROR_NONE);
+
+	node->mChannelScan = scan;
+	scan = NULL;
+
+exit:
+	free(scan);
+	return error;
+}
+
+otError posixPlatformChannelScan(otInstance *            aInstance,
+                                 uint32_t                aChannelMask,
+                                 uint8_t                 aDuration,
+                                 posixChannelScanHandler aHandler,
+                                 void *                  aContext)
+{
+	return startScan(aInstance, aChannelMask, aDuration, false, aHandler, aContext);
+}
+
+otError posixPlatformChannelSelect(otInstance *            aInstance,
+                                   uint32_t                aChannelMask,
+                                   uint8_t                 aDuration,
+                                   posixChannelScanHandler aHandler,
+                                   void *                  aContext)
+{
+	return startScan(aInstance, aChannelMask, aDuration, true, aHandler, aContext);
+}
+
+bool platformChannelScanConfirm(struct posixNode *aNode, const struct MLME_SCAN_confirm_pset *aParams)
+{
+	struct posixChannelScan *scan = aNode->mChannelScan;
+
+	if (scan == NULL)
+		return false;
+
+	if (scan->mScanType == SCAN_ED)
+	{
+		uint32_t unscanned = aParams->UnscannedChannels[0] | (aParams->UnscannedChannels[1] << 8) |
+		                     (aParams->UnscannedChannels[2] << 16) |
+		                     ((uint32_t)aParams->UnscannedChannels[3] << 24);
+		uint8_t result = 0;
+
+		if (aParams->Status != MAC_SUCCESS && aParams->Status != MAC_LIMIT_REACHED)
+		{
+			finishScan(aNode, OT_ERROR_FAILED);
+			return true;
+		}
+
+		//The results are in channel order, one for each channel scanned
+		for (uint8_t channel = POSIX_CHANNEL_MIN; channel <= POSIX_CHANNEL_MAX; channel++)
+		{
+			if (!(scan->mChannelMask & (1UL << channel)) || (unscanned & (1UL << channel)))
+				continue;
+			if (result >= aParams->ResultListSize)
+				break;
+
+			scan->mEnergy[channel - POSIX_CHANNEL_MIN] = aParams->ResultList[result++];
+			scan->mScanned |= 1UL << channel;
+		}
+
+		//Count the beacons on the channels that were measured
+		scan->mScanType = SCAN_ACTIVE;
+		if (scan->mScanned == 0 || requestScan(aNode, scan) != MAC_SUCCESS)
+			finishScan(aNode, OT_ERROR_FAILED);
+	}
+	else
+	{
+		bool ok = aParams->Status == MAC_SUCCESS || aParams->Status == MAC_NO_BEACON ||
+		          aParams->Status == MAC_LIMIT_REACHED;
+
+		finishScan(aNode, ok ? OT_ERROR_NONE : OT_ERROR_FAILED);
+	}
+
+	return true;
+}
+
+bool platformChannelBeaconNotify(struct posixNode *aNode, const struct MLME_BEACON_NOTIFY_indication_pset *aParams)
+{
+	struct posixChannelScan *scan = aNode->mChannelScan;
+	uint8_t                  channel = aParams->PanDescriptor.LogicalChannel;
+
+	if (scan == NULL || scan->mScanType != SCAN_ACTIVE)
+		return false;
+
+	if (channel >= POSIX_CHANNEL_MIN && channel <= POSIX_CHANNEL_MAX &&
+	    scan->mBeacons[channel - POSIX_CHANNEL_MIN] < UINT8_MAX)
+	{
+		scan->mBeacons[channel - POSIX_CHANNEL_MIN]++;
+	}
+
+	return true;
+}
+
+void platformChannelReset(struct posixNode *aNode)
+{
+	free(aNode->mChannelScan);
+	aNode->mChannelScan = NULL;
+}
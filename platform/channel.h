@@ -0,0 +1,69 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the radio to hand the platform the
+ *   results of its channel scans, see posix-channel.h.
+ */
+
+#ifndef PLATFORM_CHANNEL_H_
+#define PLATFORM_CHANNEL_H_
+
+#include <stdbool.h>
+
+#include "node.h"
+
+struct MLME_SCAN_confirm_pset;
+struct MLME_BEACON_NOTIFY_indication_pset;
+
+/**
+ * This method takes the scan confirm of a channel scan started by the
+ * platform, moving on to its next phase or finishing it.
+ *
+ * @returns true if the confirm was for the platform, false if it is for OpenThread.
+ *
+ */
+bool platformChannelScanConfirm(struct posixNode *aNode, const struct MLME_SCAN_confirm_pset *aParams);
+
+/**
+ * This method counts a beacon heard by a channel scan started by the platform.
+ *
+ * @returns true if the beacon was for the platform, false if it is for OpenThread.
+ *
+ */
+bool platformChannelBeaconNotify(struct posixNode *aNode, const struct MLME_BEACON_NOTIFY_indication_pset *aParams);
+
+/**
+ * This method cancels the channel scan of a node, if any, without calling its handler.
+ *
+ */
+void platformChannelReset(struct posixNode *aNode);
+
+#endif /* PLATFORM_CHANNEL_H_ */
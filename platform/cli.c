@@ -0,0 +1,255 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the platform CLI user commands.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "openthread/cli.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-metrics.h"
+#include "ca821x-posix-thread/posix-footprint.h"
+#include "ca821x-posix-thread/posix-channel.h"
+#include "ca821x-posix-thread/posix-perf.h"
+
+#define CHANSCAN_DEFAULT_DURATION 3
+
+static void processMacStats(int argc, char *argv[]);
+static void processFootprint(int argc, char *argv[]);
+static void processChanScan(int argc, char *argv[]);
+static void processPerf(int argc, char *argv[]);
+
+static const otCliCommand sCommands[] = {
+	{"macstats", &processMacStats},
+	{"footprint", &processFootprint},
+	{"chanscan", &processChanScan},
+	{"perf", &processPerf},
+};
+
+static otInstance *sInstance;
+
+//Counts at the last 'macstats clear', the metrics themselves only ever increase.
+//Allocated by the first clear, as most processes never need its 14KiB.
+static uint64_t (*sMacStatusBase)[256];
+
+static void processMacStats(int argc, char *argv[])
+{
+	if (argc > 0 && strcmp(argv[0], "clear") == 0)
+	{
+		if (sMacStatusBase == NULL)
+			sMacStatusBase = malloc(POSIX_MAC_PRIMITIVE_COUNT * sizeof(*sMacStatusBase));
+
+		if (sMacStatusBase == NULL)
+		{
+			otCliUartAppendResult(OT_ERROR_NO_BUFS);
+			return;
+		}
+
+		for (int primitive = 0; primitive < POSIX_MAC_PRIMITIVE_COUNT; primitive++)
+		{
+			for (int status = 0; status < 256; status++)
+			{
+				sMacStatusBase[primitive][status] = posixPlatformGetMacStatusCount(primitive, status);
+			}
+		}
+		otCliUartAppendResult(OT_ERROR_NONE);
+		return;
+	}
+
+	if (argc > 0)
+	{
+		otCliUartAppendResult(OT_ERROR_INVALID_ARGS);
+		return;
+	}
+
+	for (int primitive = 0; primitive < POSIX_MAC_PRIMITIVE_COUNT; primitive++)
+	{
+		for (int status = 0; status < 256; status++)
+		{
+			uint64_t count = posixPlatformGetMacStatusCount(primitive, status);
+			const char *name = posixMetricsMacStatusName(status);
+
+			if (sMacStatusBase)
+				count -= sMacStatusBase[primitive][status];
+
+			if (count)
+			{
+				otCliUartOutputFormat("%-18s 0x%02x %-24s %llu\r\n", posixMetricsMacPrimitiveName(primitive), status,
+				                      name ? name : "", (unsigned long long)count);
+			}
+		}
+	}
+
+	otCliUartAppendResult(OT_ERROR_NONE);
+}
+
+static void processFootprint(int argc, char *argv[])
+{
+	struct posixFootprint footprint;
+
+	(void)argv;
+
+	if (argc > 0)
+	{
+		otCliUartAppendResult(OT_ERROR_INVALID_ARGS);
+		return;
+	}
+
+	posixPlatformGetFootprint(NULL, &footprint);
+
+	otCliUartOutputFormat("static     %zu\r\n", footprint.mStatic);
+	otCliUartOutputFormat("node       %zu\r\n", footprint.mNode);
+	otCliUartOutputFormat("flash      %zu\r\n", footprint.mFlash);
+	otCliUartOutputFormat("radio      %zu\r\n", footprint.mRadio);
+	otCliUartOutputFormat("netif      %zu\r\n", footprint.mNetif);
+	otCliUartOutputFormat("ipc        %zu\r\n", footprint.mIpc);
+	otCliUartOutputFormat("trace      %zu\r\n", footprint.mTrace);
+	otCliUartOutputFormat("heap       %zu\r\n", footprint.mHeap);
+	otCliUartOutputFormat("stack peak %zu\r\n", footprint.mStackPeak);
+	otCliUartOutputFormat("driver peak %zu\r\n", footprint.mDriverStackPeak);
+	otCliUartAppendResult(OT_ERROR_NONE);
+}
+
+static void handleChanScan(otInstance *aInstance, otError aError, const struct posixChannelReport *aReport, void *aContext)
+{
+	(void)aInstance;
+	(void)aContext;
+
+	if (aReport)
+	{
+		otCliUartOutputFormat("| Ch | Energy | Beacons | Score |\r\n");
+		otCliUartOutputFormat("+----+--------+---------+-------+\r\n");
+		for (uint8_t i = 0; i < aReport->mCount; i++)
+		{
+			const struct posixChannelResult *result = &aReport->mChannels[i];
+
+			otCliUartOutputFormat("| %2u | %6u | %7u | %5u |\r\n", result->mChannel, result->mEnergy, result->mBeacons,
+			                      result->mScore);
+		}
+	}
+
+	otCliUartAppendResult(aError);
+}
+
+//chanscan [select] [mask] [duration]
+static void processChanScan(int argc, char *argv[])
+{
+	bool     select = false;
+	uint32_t mask = 0;
+	uint8_t  duration = CHANSCAN_DEFAULT_DURATION;
+	otError  error;
+
+	if (argc > 0 && strcmp(argv[0], "select") == 0)
+	{
+		select = true;
+		argc--;
+		argv++;
+	}
+	if (argc > 0)
+		mask = strtoul(argv[0], NULL, 0);
+	if (argc > 1)
+		duration = strtoul(argv[1], NULL, 0);
+
+	if (argc > 2 || duration > 14)
+	{
+		otCliUartAppendResult(OT_ERROR_INVALID_ARGS);
+		return;
+	}
+
+	if (select)
+		error = posixPlatformChannelSelect(sInstance, mask, duration, &handleChanScan, NULL);
+	else
+		error = posixPlatformChannelScan(sInstance, mask, duration, &handleChanScan, NULL);
+
+	//Otherwise the result is appended when the scan finishes
+	if (error != OT_ERROR_NONE)
+		otCliUartAppendResult(error);
+}
+
+//Totals at the last 'perf clear'
+static struct posixPerfStats sPerfBase[POSIX_PERF_OP_COUNT];
+
+static uint64_t perfAverage(uint64_t aTotal, uint64_t aCount)
+{
+	return aCount ? (aTotal + aCount / 2) / aCount : 0;
+}
+
+//perf [clear]
+static void processPerf(int argc, char *argv[])
+{
+	if (argc > 0 && strcmp(argv[0], "clear") == 0)
+	{
+		for (int op = 0; op < POSIX_PERF_OP_COUNT; op++)
+			posixPlatformPerfGetStats(op, &sPerfBase[op]);
+
+		otCliUartAppendResult(OT_ERROR_NONE);
+		return;
+	}
+
+	if (argc > 0)
+	{
+		otCliUartAppendResult(OT_ERROR_INVALID_ARGS);
+		return;
+	}
+
+	otCliUartOutputFormat("source %s, averages per operation\r\n", posixMetricsPerfSourceName(posixPlatformPerfGetSource()));
+	otCliUartOutputFormat("| Operation       |    Count |   Cycles | Instructions | Cache misses |   CPU ns |\r\n");
+	otCliUartOutputFormat("+-----------------+----------+----------+--------------+--------------+----------+\r\n");
+	for (int op = 0; op < POSIX_PERF_OP_COUNT; op++)
+	{
+		struct posixPerfStats stats;
+		uint64_t count;
+
+		posixPlatformPerfGetStats(op, &stats);
+		count = stats.mCount - sPerfBase[op].mCount;
+		for (int counter = 0; counter < POSIX_PERF_COUNTER_COUNT; counter++)
+			stats.mTotals[counter] = perfAverage(stats.mTotals[counter] - sPerfBase[op].mTotals[counter], count);
+
+		otCliUartOutputFormat("| %-15s | %8llu | %8llu | %12llu | %12llu | %8llu |\r\n", posixMetricsPerfOpName(op),
+		                      (unsigned long long)count, (unsigned long long)stats.mTotals[POSIX_PERF_CYCLES],
+		                      (unsigned long long)stats.mTotals[POSIX_PERF_INSTRUCTIONS],
+		                      (unsigned long long)stats.mTotals[POSIX_PERF_CACHE_MISSES],
+		                      (unsigned long long)stats.mTotals[POSIX_PERF_TASK_CLOCK_NS]);
+	}
+
+	otCliUartAppendResult(OT_ERROR_NONE);
+}
+
+void posixPlatformCliInit(otInstance *aInstance)
+{
+	sInstance = aInstance;
+
+	otCliUartSetUserCommands(sCommands, sizeof(sCommands) / sizeof(sCommands[0]));
+}
@@ -0,0 +1,481 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the platform event bus, see posix-events.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "openthread/instance.h"
+#include "openthread/thread.h"
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "events.h"
+#include "node.h"
+
+#define MAX_SUBSCRIBERS       16
+#define DEFAULT_QUEUE_LENGTH  64
+#define STATE_EVENT_MASK      (POSIX_EVENT_MASK(POSIX_EVENT_STATE_CHANGED) | POSIX_EVENT_MASK(POSIX_EVENT_ROLE))
+
+struct eventSlot
+{
+	uint64_t          mSequence;
+	struct posixEvent mEvent;
+};
+
+struct posixEventSubscriber
+{
+	uint32_t          mTypes;
+	uint32_t          mIndexMask;
+	struct eventSlot *mSlots;
+	uint64_t          mHead;      //Next slot to publish to, shared by all publishers
+	uint64_t          mTail;      //Next slot to read, only used by the reader
+
+	//Events that found the queue full, delivered once it has drained
+	uint32_t          mCoalescedTypes;
+	uint32_t          mCoalescedCount[POSIX_EVENT_TYPE_COUNT];
+	uint32_t          mCoalescedStateFlags;
+	uint32_t          mCoalescedNodeId[POSIX_EVENT_TYPE_COUNT];
+	uint8_t           mCurrentRole;  //Latest role published
+	uint8_t           mReadRole;     //Latest role read
+
+	int               mWakeFd;
+	bool              mSleeping;
+	bool              mStopping;
+
+	pthread_t         mThread;
+	posixEventHandler mHandler;
+	void             *mContext;
+};
+
+uint32_t gPosixEventTypes;
+
+static pthread_mutex_t sSubscribeMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct posixEventSubscriber *sSubscribers[MAX_SUBSCRIBERS];
+static uint32_t sPublishing; //Publishers that may be using sSubscribers
+
+static uint64_t nowUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void wake(struct posixEventSubscriber *aSubscriber)
+{
+	uint64_t one = 1;
+
+	if (__atomic_exchange_n(&aSubscriber->mSleeping, false, __ATOMIC_SEQ_CST))
+		(void)write(aSubscriber->mWakeFd, &one, sizeof(one));
+}
+
+//Bounded multi-producer queue, after Vyukov: each slot's sequence says whose turn it is
+static bool enqueue(struct posixEventSubscriber *aSubscriber, const struct posixEvent *aEvent)
+{
+	uint64_t pos = __atomic_load_n(&aSubscriber->mHead, __ATOMIC_RELAXED);
+	struct eventSlot *slot;
+
+	while (1)
+	{
+		int64_t diff;
+
+		slot = &aSubscriber->mSlots[pos & aSubscriber->mIndexMask];
+		diff = (int64_t)(__atomic_load_n(&slot->mSequence, __ATOMIC_ACQUIRE) - pos);
+
+		if (diff == 0)
+		{
+			if (__atomic_compare_exchange_n(&aSubscriber->mHead, &pos, pos + 1, true, __ATOMIC_RELAXED,
+			                                __ATOMIC_RELAXED))
+				break;
+		}
+		else if (diff < 0)
+		{
+			return false;
+		}
+		else
+		{
+			pos = __atomic_load_n(&aSubscriber->mHead, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->mEvent = *aEvent;
+	__atomic_store_n(&slot->mSequence, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static bool dequeue(struct posixEventSubscriber *aSubscriber, struct posixEvent *aEvent)
+{
+	uint64_t pos = aSubscriber->mTail;
+	struct eventSlot *slot = &aSubscriber->mSlots[pos & aSubscriber->mIndexMask];
+
+	if (__atomic_load_n(&slot->mSequence, __ATOMIC_ACQUIRE) != pos + 1)
+		return false;
+
+	*aEvent = slot->mEvent;
+	__atomic_store_n(&slot->mSequence, pos + aSubscriber->mIndexMask + 1, __ATOMIC_RELEASE);
+	aSubscriber->mTail = pos + 1;
+	return true;
+}
+
+static void coalesce(struct posixEventSubscriber *aSubscriber, const struct posixEvent *aEvent)
+{
+	uint32_t *count = &aSubscriber->mCoalescedCount[aEvent->mType];
+
+	if (aEvent->mType == POSIX_EVENT_STATE_CHANGED)
+		__atomic_fetch_or(&aSubscriber->mCoalescedStateFlags, aEvent->mStateFlags, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&aSubscriber->mCoalescedNodeId[aEvent->mType], aEvent->mNodeId, __ATOMIC_RELAXED);
+	if (__atomic_load_n(count, __ATOMIC_RELAXED) < UINT16_MAX)
+		__atomic_fetch_add(count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_or(&aSubscriber->mCoalescedTypes, POSIX_EVENT_MASK(aEvent->mType), __ATOMIC_RELEASE);
+}
+
+static bool takeCoalesced(struct posixEventSubscriber *aSubscriber, struct posixEvent *aEvent)
+{
+	uint32_t types = __atomic_load_n(&aSubscriber->mCoalescedTypes, __ATOMIC_ACQUIRE);
+	uint32_t count;
+	int type;
+
+	if (types == 0)
+		return false;
+
+	type = __builtin_ctz(types);
+	__atomic_fetch_and(&aSubscriber->mCoalescedTypes, ~POSIX_EVENT_MASK(type), __ATOMIC_ACQUIRE);
+	count = __atomic_exchange_n(&aSubscriber->mCoalescedCount[type], 0, __ATOMIC_RELAXED);
+
+	memset(aEvent, 0, sizeof(*aEvent));
+	aEvent->mType = type;
+	aEvent->mCoalesced = (count > UINT16_MAX) ? UINT16_MAX : count;
+	aEvent->mNodeId = __atomic_load_n(&aSubscriber->mCoalescedNodeId[type], __ATOMIC_RELAXED);
+	aEvent->mTimestampUs = nowUs();
+
+	if (type == POSIX_EVENT_STATE_CHANGED)
+	{
+		aEvent->mStateFlags = __atomic_exchange_n(&aSubscriber->mCoalescedStateFlags, 0, __ATOMIC_RELAXED);
+	}
+	else if (type == POSIX_EVENT_ROLE)
+	{
+		aEvent->mRole.mPrevious = aSubscriber->mReadRole;
+		aEvent->mRole.mCurrent = __atomic_load_n(&aSubscriber->mCurrentRole, __ATOMIC_RELAXED);
+	}
+
+	return true;
+}
+
+static bool take(struct posixEventSubscriber *aSubscriber, struct posixEvent *aEvent)
+{
+	if (!dequeue(aSubscriber, aEvent) && !takeCoalesced(aSubscriber, aEvent))
+		return false;
+
+	if (aEvent->mType == POSIX_EVENT_ROLE)
+		aSubscriber->mReadRole = aEvent->mRole.mCurrent;
+
+	return true;
+}
+
+void platformEventPublish(struct posixEvent *aEvent)
+{
+	aEvent->mNodeId = posixNodeGetId(posixNodeCurrent());
+	aEvent->mTimestampUs = nowUs();
+	aEvent->mCoalesced = 0;
+
+	__atomic_fetch_add(&sPublishing, 1, __ATOMIC_SEQ_CST);
+
+	for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		struct posixEventSubscriber *subscriber = __atomic_load_n(&sSubscribers[i], __ATOMIC_ACQUIRE);
+
+		if (subscriber == NULL || !(subscriber->mTypes & POSIX_EVENT_MASK(aEvent->mType)))
+			continue;
+
+		if (aEvent->mType == POSIX_EVENT_ROLE)
+			__atomic_store_n(&subscriber->mCurrentRole, aEvent->mRole.mCurrent, __ATOMIC_RELAXED);
+
+		if (!enqueue(subscriber, aEvent))
+			coalesce(subscriber, aEvent);
+
+		wake(subscriber);
+	}
+
+	__atomic_fetch_sub(&sPublishing, 1, __ATOMIC_RELEASE);
+}
+
+void platformEventLink(uint8_t aPrimitive, uint8_t aStatus)
+{
+	struct posixEvent event;
+
+	if (aStatus == 0 || !platformEventWanted(POSIX_EVENT_LINK))
+		return;
+
+	memset(&event, 0, sizeof(event));
+	event.mType = POSIX_EVENT_LINK;
+	event.mLink.mPrimitive = aPrimitive;
+	event.mLink.mStatus = aStatus;
+	platformEventPublish(&event);
+}
+
+void platformEventSettings(uint16_t aKey, enum posixEventSettingsOperation aOperation)
+{
+	struct posixEvent event;
+
+	if (!platformEventWanted(POSIX_EVENT_SETTINGS))
+		return;
+
+	memset(&event, 0, sizeof(event));
+	event.mType = POSIX_EVENT_SETTINGS;
+	event.mSettings.mKey = aKey;
+	event.mSettings.mOperation = aOperation;
+	platformEventPublish(&event);
+}
+
+static void stateChanged(uint32_t aFlags, void *aContext)
+{
+	struct posixNode *node = aContext;
+	struct posixEvent event;
+
+	if (platformEventWanted(POSIX_EVENT_STATE_CHANGED))
+	{
+		memset(&event, 0, sizeof(event));
+		event.mType = POSIX_EVENT_STATE_CHANGED;
+		event.mStateFlags = aFlags;
+		platformEventPublish(&event);
+	}
+
+	if (aFlags & OT_CHANGED_THREAD_ROLE)
+	{
+		uint8_t role = otThreadGetDeviceRole(node->mEventsInstance);
+
+		if (role != node->mEventsRole && platformEventWanted(POSIX_EVENT_ROLE))
+		{
+			memset(&event, 0, sizeof(event));
+			event.mType = POSIX_EVENT_ROLE;
+			event.mRole.mPrevious = node->mEventsRole;
+			event.mRole.mCurrent = role;
+			platformEventPublish(&event);
+		}
+
+		node->mEventsRole = role;
+	}
+}
+
+void platformEventsProcess(otInstance *aInstance)
+{
+	struct posixNode *node = posixNodeCurrent();
+
+	if (aInstance == NULL || node->mEventsInstance == aInstance ||
+	    !(__atomic_load_n(&gPosixEventTypes, __ATOMIC_RELAXED) & STATE_EVENT_MASK))
+		return;
+
+	//Only tried once per instance, as it only fails when all handler slots are taken
+	node->mEventsInstance = aInstance;
+	node->mEventsRole = otThreadGetDeviceRole(aInstance);
+
+	if (otSetStateChangedCallback(aInstance, stateChanged, node) != OT_ERROR_NONE)
+	{
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "No state changed handler left for the event bus");
+	}
+}
+
+static void *subscriberMain(void *aContext)
+{
+	struct posixEventSubscriber *subscriber = aContext;
+	struct posixEvent event;
+
+	while (posixPlatformEventRead(subscriber, &event, -1) == 0)
+		subscriber->mHandler(&event, subscriber->mContext);
+
+	return NULL;
+}
+
+static void updateTypes(void)
+{
+	uint32_t types = 0;
+
+	for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		if (sSubscribers[i] != NULL)
+			types |= sSubscribers[i]->mTypes;
+	}
+
+	__atomic_store_n(&gPosixEventTypes, types, __ATOMIC_RELAXED);
+}
+
+static void subscriberFree(struct posixEventSubscriber *aSubscriber)
+{
+	if (aSubscriber->mWakeFd >= 0)
+		close(aSubscriber->mWakeFd);
+	free(aSubscriber->mSlots);
+	free(aSubscriber);
+}
+
+struct posixEventSubscriber *posixPlatformEventSubscribe(uint32_t          aTypes,
+                                                         uint32_t          aQueueLength,
+                                                         posixEventHandler aHandler,
+                                                         void             *aContext)
+{
+	struct posixEventSubscriber *subscriber;
+	uint32_t length = 1;
+	int slot = -1;
+
+	if (aQueueLength == 0)
+		aQueueLength = DEFAULT_QUEUE_LENGTH;
+	while (length < aQueueLength && length < (1u << 31))
+		length <<= 1;
+
+	subscriber = calloc(1, sizeof(*subscriber));
+	if (subscriber == NULL)
+		return NULL;
+
+	subscriber->mTypes = aTypes & POSIX_EVENT_MASK_ALL;
+	subscriber->mIndexMask = length - 1;
+	subscriber->mSlots = calloc(length, sizeof(*subscriber->mSlots));
+	subscriber->mWakeFd = eventfd(0, EFD_CLOEXEC);
+	subscriber->mHandler = aHandler;
+	subscriber->mContext = aContext;
+
+	if (subscriber->mSlots == NULL || subscriber->mWakeFd < 0)
+	{
+		subscriberFree(subscriber);
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < length; i++)
+		subscriber->mSlots[i].mSequence = i;
+
+	if (aHandler != NULL && pthread_create(&subscriber->mThread, NULL, subscriberMain, subscriber) != 0)
+	{
+		subscriberFree(subscriber);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&sSubscribeMutex);
+	for (int i = 0; i < MAX_SUBSCRIBERS && slot < 0; i++)
+	{
+		if (sSubscribers[i] == NULL)
+			slot = i;
+	}
+	if (slot >= 0)
+	{
+		__atomic_store_n(&sSubscribers[slot], subscriber, __ATOMIC_RELEASE);
+		updateTypes();
+	}
+	pthread_mutex_unlock(&sSubscribeMutex);
+
+	if (slot < 0)
+	{
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "Too many event subscribers");
+		posixPlatformEventUnsubscribe(subscriber);
+		return NULL;
+	}
+
+	return subscriber;
+}
+
+void posixPlatformEventUnsubscribe(struct posixEventSubscriber *aSubscriber)
+{
+	uint64_t one = 1;
+
+	if (aSubscriber == NULL)
+		return;
+
+	pthread_mutex_lock(&sSubscribeMutex);
+	for (int i = 0; i < MAX_SUBSCRIBERS; i++)
+	{
+		if (sSubscribers[i] == aSubscriber)
+			__atomic_store_n(&sSubscribers[i], NULL, __ATOMIC_SEQ_CST);
+	}
+	updateTypes();
+	pthread_mutex_unlock(&sSubscribeMutex);
+
+	//Publishers only hold on to a subscriber for the duration of one publish
+	while (__atomic_load_n(&sPublishing, __ATOMIC_SEQ_CST) != 0)
+		sched_yield();
+
+	__atomic_store_n(&aSubscriber->mStopping, true, __ATOMIC_SEQ_CST);
+	(void)write(aSubscriber->mWakeFd, &one, sizeof(one));
+
+	if (aSubscriber->mHandler != NULL)
+		pthread_join(aSubscriber->mThread, NULL);
+
+	subscriberFree(aSubscriber);
+}
+
+int posixPlatformEventRead(struct posixEventSubscriber *aSubscriber, struct posixEvent *aEvent, int aTimeoutMs)
+{
+	uint64_t deadline = (aTimeoutMs > 0) ? nowUs() + (uint64_t)aTimeoutMs * 1000 : 0;
+	struct pollfd pfd = {aSubscriber->mWakeFd, POLLIN, 0};
+	uint64_t wakeups;
+
+	while (!__atomic_load_n(&aSubscriber->mStopping, __ATOMIC_RELAXED))
+	{
+		int timeout = aTimeoutMs;
+
+		if (take(aSubscriber, aEvent))
+			return 0;
+		if (aTimeoutMs == 0)
+			break;
+
+		//Publishers only write to the eventfd while the reader says it is sleeping
+		__atomic_store_n(&aSubscriber->mSleeping, true, __ATOMIC_SEQ_CST);
+		if (take(aSubscriber, aEvent))
+		{
+			__atomic_store_n(&aSubscriber->mSleeping, false, __ATOMIC_RELAXED);
+			return 0;
+		}
+
+		if (aTimeoutMs > 0)
+		{
+			uint64_t now = nowUs();
+
+			if (now >= deadline)
+				break;
+			timeout = (int)((deadline - now + 999) / 1000);
+		}
+
+		if (poll(&pfd, 1, timeout) > 0)
+			(void)read(aSubscriber->mWakeFd, &wakeups, sizeof(wakeups));
+	}
+
+	__atomic_store_n(&aSubscriber->mSleeping, false, __ATOMIC_RELAXED);
+	return -1;
+}
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform to publish events.
+ */
+
+#ifndef PLATFORM_EVENTS_H_
+#define PLATFORM_EVENTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "openthread/instance.h"
+#include "ca821x-posix-thread/posix-events.h"
+
+/**
+ * POSIX_EVENT_MASK()s of the types any subscriber wants, so that publishing
+ * costs a single load while nobody listens.
+ *
+ */
+extern uint32_t gPosixEventTypes;
+
+static inline bool platformEventWanted(enum posixEventType aType)
+{
+	return (__atomic_load_n(&gPosixEventTypes, __ATOMIC_RELAXED) & POSIX_EVENT_MASK(aType)) != 0;
+}
+
+/**
+ * This method publishes an event to the subscribers that want it. The node ID
+ * and timestamp are filled in.
+ *
+ */
+void platformEventPublish(struct posixEvent *aEvent);
+
+/**
+ * This method publishes a POSIX_EVENT_LINK event, if wanted and not a success.
+ *
+ */
+void platformEventLink(uint8_t aPrimitive, uint8_t aStatus);
+
+/**
+ * This method publishes a POSIX_EVENT_SETTINGS event, if wanted.
+ *
+ */
+void platformEventSettings(uint16_t aKey, enum posixEventSettingsOperation aOperation);
+
+/**
+ * This method starts capturing state changes of an instance, once they are wanted.
+ *
+ */
+void platformEventsProcess(otInstance *aInstance);
+
+#endif /* PLATFORM_EVENTS_H_ */
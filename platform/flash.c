@@ -41,28 +41,129 @@
 #include "openthread-core-config.h"
 #include "flash.h"
 #include "code_utils.h"
+#include "metrics.h"
+#include "node.h"
 
 #define FLASH_FOLDER "/usr/local/etc/"
 #define FLASH_FILE FLASH_FOLDER ".otConfig"
 
-static int sFlashFd;
 uint32_t sEraseAddress;
 
+#define FLASH_PAGE_SIZE_VALUE 0x800 //For the preprocessor
+
 enum
 {
     FLASH_SIZE = 0x40000,
-    FLASH_PAGE_SIZE = 0x800,
+    FLASH_PAGE_SIZE = FLASH_PAGE_SIZE_VALUE,
     FLASH_PAGE_NUM = 128,
 };
 
+#ifndef CASCODA_FLASH_ERASE_CHUNK_SIZE
+#define CASCODA_FLASH_ERASE_CHUNK_SIZE 0x800
+#endif
+
+#if (FLASH_PAGE_SIZE_VALUE % CASCODA_FLASH_ERASE_CHUNK_SIZE) != 0
+#error "CASCODA_FLASH_ERASE_CHUNK_SIZE must divide the flash page size"
+#endif
+
+//Written over a page to erase it. Being const, it is shared by every process running the binary.
+static const uint8_t sErased[CASCODA_FLASH_ERASE_CHUNK_SIZE] = {[0 ... CASCODA_FLASH_ERASE_CHUNK_SIZE - 1] = 0xFF};
+
+/*
+ * Simulated nodes keep their flash in memory rather than in hundreds of files.
+ * Pages are only allocated once used, as settings only touch a few of them.
+ */
+static otError memFlashInit(struct posixNode *aNode)
+{
+    otError error = OT_ERROR_NONE;
+
+    otEXPECT(aNode->mFlashPages == NULL);
+    aNode->mFlashPages = calloc(FLASH_PAGE_NUM, sizeof(*aNode->mFlashPages));
+    otEXPECT_ACTION(aNode->mFlashPages != NULL, error = OT_ERROR_NO_BUFS);
+
+exit:
+    return error;
+}
+
+static uint32_t memFlashRead(struct posixNode *aNode, uint32_t aAddress, uint8_t *aData, uint32_t aSize)
+{
+    uint32_t done = 0;
+
+    while (done < aSize && aAddress + done < FLASH_SIZE)
+    {
+        uint32_t address = aAddress + done;
+        uint32_t offset = address % FLASH_PAGE_SIZE;
+        uint32_t length = FLASH_PAGE_SIZE - offset;
+        uint8_t *page = aNode->mFlashPages[address / FLASH_PAGE_SIZE];
+
+        if (length > aSize - done)
+        {
+            length = aSize - done;
+        }
+
+        if (page != NULL)
+        {
+            memcpy(aData + done, page + offset, length);
+        }
+        else
+        {
+            memset(aData + done, 0xFF, length);
+        }
+
+        done += length;
+    }
+
+    return done;
+}
+
+void posixNodeFlashFree(struct posixNode *aNode)
+{
+    if (aNode->mFlashPages != NULL)
+    {
+        for (uint16_t index = 0; index < FLASH_PAGE_NUM; index++)
+        {
+            free(aNode->mFlashPages[index]);
+        }
+
+        free(aNode->mFlashPages);
+        aNode->mFlashPages = NULL;
+    }
+}
+
+size_t posixNodeFlashFootprint(struct posixNode *aNode)
+{
+    size_t size = 0;
+
+    if (aNode->mFlashPages != NULL)
+    {
+        size += FLASH_PAGE_NUM * sizeof(*aNode->mFlashPages);
+
+        for (uint16_t index = 0; index < FLASH_PAGE_NUM; index++)
+        {
+            size += (aNode->mFlashPages[index] != NULL) ? FLASH_PAGE_SIZE : 0;
+        }
+    }
+
+    return size;
+}
+
 otError utilsFlashInit(void)
 {
+    struct posixNode *node = posixNodeCurrent();
     otError error = OT_ERROR_NONE;
     char fileName[30];
     struct stat st;
     bool create = false;
     struct timeval tv;
 
+    if (node->mSimulated)
+    {
+        return memFlashInit(node);
+    }
+
+    //Already open, eg. after an in-process reset
+    otEXPECT(node->mFlashFd < 0);
+
     gettimeofday(&tv, NULL);
 
     memset(&st, 0, sizeof(st));
@@ -71,23 +172,23 @@ otError utilsFlashInit(void)
     {
         mkdir(FLASH_FOLDER, 0777);
     }
-    snprintf(fileName, sizeof(fileName), "%s.%02d", FLASH_FILE, NODE_ID);
+    snprintf(fileName, sizeof(fileName), "%s.%02u", FLASH_FILE, posixNodeGetId(node));
 
     if (access(fileName, 0))
     {
         create = true;
     }
 
-    sFlashFd = open(fileName, O_RDWR | O_CREAT, 0666);
-    lseek(sFlashFd, 0, SEEK_SET);
+    node->mFlashFd = open(fileName, O_RDWR | O_CREAT, 0666);
+    lseek(node->mFlashFd, 0, SEEK_SET);
 
-    otEXPECT_ACTION(sFlashFd >= 0, error = OT_ERROR_FAILED);
+    otEXPECT_ACTION(node->mFlashFd >= 0, error = OT_ERROR_FAILED);
 
     if (create)
     {
         for (uint16_t index = 0; index < FLASH_PAGE_NUM; index++)
         {
-            otEXPECT(error = utilsFlashErasePage(index * FLASH_PAGE_SIZE));
+            otEXPECT_ACTION((error = utilsFlashErasePage(index * FLASH_PAGE_SIZE)) == OT_ERROR_NONE, ;);
         }
     }
 
@@ -102,29 +203,36 @@ uint32_t utilsFlashGetSize(void)
 
 otError utilsFlashErasePage(uint32_t aAddress)
 {
+    struct posixNode *node = posixNodeCurrent();
     otError error = OT_ERROR_NONE;
-    //TODO: Improve this quick fix for slow startup due to looping single character file writes
-    static uint8_t buf[FLASH_PAGE_SIZE] = {0};
     uint32_t address;
 
-    //TODO: improve Quick-fix
-    if(buf[0] == 0){
-    	memset(buf, 0xFF, FLASH_PAGE_SIZE);
-    }
-
-    otEXPECT_ACTION(sFlashFd >= 0, error = OT_ERROR_FAILED);
+    otEXPECT_ACTION(node->mFlashFd >= 0 || node->mFlashPages != NULL, error = OT_ERROR_FAILED);
     otEXPECT_ACTION(aAddress < FLASH_SIZE, error = OT_ERROR_INVALID_ARGS);
 
     // Get start address of the flash page that includes aAddress
     address = aAddress & (~(uint32_t)(FLASH_PAGE_SIZE - 1));
 
-    /*
-    for (uint16_t offset = 0; offset < FLASH_PAGE_SIZE; offset++)
+    if (node->mFlashPages != NULL)
     {
-        otEXPECT_ACTION(pwrite(sFlashFd, &buf, 1, address + offset) == 1, error = kThreadError_Failed);
+        uint8_t **page = &node->mFlashPages[address / FLASH_PAGE_SIZE];
+
+        if (*page == NULL)
+        {
+            *page = malloc(FLASH_PAGE_SIZE);
+            otEXPECT_ACTION(*page != NULL, error = OT_ERROR_NO_BUFS);
+        }
+
+        memset(*page, 0xFF, FLASH_PAGE_SIZE);
+        otEXIT_NOW();
+    }
+
+    for (uint32_t offset = 0; offset < FLASH_PAGE_SIZE; offset += sizeof(sErased))
+    {
+        otEXPECT_ACTION(pwrite(node->mFlashFd, sErased, sizeof(sErased), address + offset) == sizeof(sErased),
+                        error = OT_ERROR_FAILED);
+        METRICS_ADD(mFlashBytesWritten, sizeof(sErased));
     }
-    */
-    otEXPECT_ACTION(pwrite(sFlashFd, buf, FLASH_PAGE_SIZE, address) == 1, error = OT_ERROR_FAILED);
 
 exit:
     return error;
@@ -138,31 +246,61 @@ otError utilsFlashStatusWait(uint32_t aTimeout)
 
 uint32_t utilsFlashWrite(uint32_t aAddress, uint8_t *aData, uint32_t aSize)
 {
+    struct posixNode *node = posixNodeCurrent();
     uint32_t ret = 0;
     uint32_t index = 0;
     uint8_t byte;
 
-    otEXPECT_ACTION(sFlashFd >= 0 && aAddress < FLASH_SIZE, ;);
+    otEXPECT_ACTION((node->mFlashFd >= 0 || node->mFlashPages != NULL) && aAddress < FLASH_SIZE, ;);
 
     for (index = 0; index < aSize; index++)
     {
-        otEXPECT_ACTION((ret = utilsFlashRead(aAddress + index, &byte, 1)) == 1, ;);
+        uint32_t address = aAddress + index;
+
+        otEXPECT_ACTION((ret = utilsFlashRead(address, &byte, 1)) == 1, ;);
         // Use bitwise AND to emulate the behavior of flash memory
         byte &= aData[index];
-        otEXPECT_ACTION((ret = (uint32_t)pwrite(sFlashFd, &byte, 1, aAddress + index)) == 1, ;);
+
+        if (node->mFlashPages != NULL)
+        {
+            uint8_t **page = &node->mFlashPages[address / FLASH_PAGE_SIZE];
+
+            if (*page == NULL)
+            {
+                *page = malloc(FLASH_PAGE_SIZE);
+                otEXPECT_ACTION(*page != NULL, ;);
+                memset(*page, 0xFF, FLASH_PAGE_SIZE);
+            }
+
+            (*page)[address % FLASH_PAGE_SIZE] = byte;
+            continue;
+        }
+
+        otEXPECT_ACTION((ret = (uint32_t)pwrite(node->mFlashFd, &byte, 1, address)) == 1, ;);
     }
 
 exit:
+    METRICS_ADD(mFlashBytesWritten, index);
     return index;
 }
 
 uint32_t utilsFlashRead(uint32_t aAddress, uint8_t *aData, uint32_t aSize)
 {
+    struct posixNode *node = posixNodeCurrent();
     uint32_t ret = 0;
 
-    otEXPECT_ACTION(sFlashFd >= 0 && aAddress < FLASH_SIZE, ;);
-    ret = (uint32_t)pread(sFlashFd, aData, aSize, aAddress);
+    otEXPECT_ACTION(aAddress < FLASH_SIZE, ;);
+
+    if (node->mFlashPages != NULL)
+    {
+        ret = memFlashRead(node, aAddress, aData, aSize);
+        otEXIT_NOW();
+    }
+
+    otEXPECT_ACTION(node->mFlashFd >= 0, ;);
+    ret = (uint32_t)pread(node->mFlashFd, aData, aSize, aAddress);
 
 exit:
+    METRICS_ADD(mFlashBytesRead, ret);
     return ret;
 }
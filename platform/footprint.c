@@ -0,0 +1,220 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the memory footprint report, see posix-footprint.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <alloca.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "openthread-core-config.h"
+#include "ca821x-posix-thread/posix-footprint.h"
+#include "footprint.h"
+#include "ipc.h"
+#include "node.h"
+#include "sim-radio.h"
+#include "trace.h"
+#include "tun.h"
+
+#ifndef CASCODA_STACK_PAINT_SIZE
+#define CASCODA_STACK_PAINT_SIZE (64 * 1024)
+#endif
+
+#define STACK_PAINT 0xA5
+#define STACK_GUARD 4096 //Left unpainted above the end of the stack, for the painting itself
+#define STACK_PAINT_THREADS 32
+
+//Provided by the linker, around the .data and .bss of the executable
+extern char __data_start;
+extern char end;
+
+/*
+ * The painted threads are kept in slots rather than in thread-local storage,
+ * so that a node can look at the stack of another thread. A slot is freed when
+ * its thread exits, under sPaintsMutex, so that the stack is never read once
+ * it may be gone.
+ */
+struct platformStackPaint
+{
+	uint8_t *mLow;        ///< Deepest painted byte, NULL while the slot is free
+	uint8_t *mTop;        ///< Top of the stack of the thread
+	uint32_t mGeneration; ///< Bumped each time the slot is freed
+};
+
+static struct platformStackPaint sPaints[STACK_PAINT_THREADS];
+static pthread_mutex_t           sPaintsMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t            sPaintKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t             sPaintKey;
+
+static __thread struct platformStackPaint *sPaint;
+static __thread bool                       sPaintDone;
+
+static void freePaint(void *aPaint)
+{
+	struct platformStackPaint *paint = aPaint;
+
+	pthread_mutex_lock(&sPaintsMutex);
+	paint->mLow = NULL;
+	paint->mGeneration++;
+	pthread_mutex_unlock(&sPaintsMutex);
+}
+
+static void createPaintKey(void)
+{
+	pthread_key_create(&sPaintKey, freePaint);
+}
+
+static __attribute__((noinline)) void paintStack(size_t aSize, uint8_t **aLow)
+{
+	uint8_t *area = alloca(aSize);
+
+	memset(area, STACK_PAINT, aSize);
+	//Keep the memset, which is otherwise dead once this returns
+	__asm__ volatile("" : : "r"(area) : "memory");
+	*aLow = area;
+}
+
+static void paintThread(void)
+{
+	pthread_attr_t attr;
+	void *         stackLow;
+	size_t         stackSize;
+	size_t         size = CASCODA_STACK_PAINT_SIZE;
+	uint8_t *      high = __builtin_frame_address(0);
+	uint8_t *      top = high;
+	uint8_t *      low;
+
+	sPaintDone = true;
+
+	//Don't paint past the end of the stack of a thread created with a small one
+	if (pthread_getattr_np(pthread_self(), &attr) == 0)
+	{
+		if (pthread_attr_getstack(&attr, &stackLow, &stackSize) == 0)
+		{
+			size_t room = high - (uint8_t *)stackLow;
+
+			room = (room > 2 * STACK_GUARD) ? room - 2 * STACK_GUARD : 0;
+			if (size > room)
+				size = room;
+			top = (uint8_t *)stackLow + stackSize;
+		}
+		pthread_attr_destroy(&attr);
+	}
+
+	if (size == 0)
+		return;
+
+	paintStack(size, &low);
+
+	pthread_mutex_lock(&sPaintsMutex);
+	for (size_t i = 0; i < STACK_PAINT_THREADS; i++)
+	{
+		if (sPaints[i].mLow == NULL)
+		{
+			sPaint = &sPaints[i];
+			sPaint->mLow = low;
+			sPaint->mTop = top;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sPaintsMutex);
+
+	if (sPaint != NULL)
+	{
+		pthread_once(&sPaintKeyOnce, createPaintKey);
+		pthread_setspecific(sPaintKey, sPaint);
+	}
+}
+
+void platformFootprintMarkStack(struct platformStackRef *aStack)
+{
+	if (!sPaintDone)
+		paintThread();
+
+	if (sPaint != NULL)
+	{
+		__atomic_store_n(&aStack->mGeneration, sPaint->mGeneration, __ATOMIC_RELAXED);
+		__atomic_store_n(&aStack->mPaint, sPaint, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * The depth is counted from the top of the stack, which includes the frames
+ * above the painted area, such as those of the upcall handlers.
+ */
+static size_t getStackPeak(struct platformStackRef *aStack)
+{
+	struct platformStackPaint *paint = __atomic_load_n(&aStack->mPaint, __ATOMIC_RELAXED);
+	uint32_t                   generation = __atomic_load_n(&aStack->mGeneration, __ATOMIC_RELAXED);
+	size_t                     peak = 0;
+	uint8_t *                  byte;
+
+	if (paint == NULL)
+		return 0;
+
+	pthread_mutex_lock(&sPaintsMutex);
+	if (paint->mLow != NULL && paint->mGeneration == generation)
+	{
+		for (byte = paint->mLow; byte < paint->mTop; byte++)
+		{
+			if (*byte != STACK_PAINT)
+				break;
+		}
+		peak = paint->mTop - byte;
+	}
+	pthread_mutex_unlock(&sPaintsMutex);
+
+	return peak;
+}
+
+void posixPlatformGetFootprint(struct posixNode *aNode, struct posixFootprint *aFootprint)
+{
+	struct posixNode *node = aNode ? aNode : posixNodeCurrent();
+
+	memset(aFootprint, 0, sizeof(*aFootprint));
+
+	aFootprint->mStatic = &end - &__data_start;
+	aFootprint->mNode = node->mSimulated ? sizeof(*node) : 0;
+	aFootprint->mFlash = posixNodeFlashFootprint(node);
+	aFootprint->mRadio = platformSimRadioFootprint(node);
+	aFootprint->mNetif = platformTunFootprint(node);
+	aFootprint->mIpc = platformIpcFootprint(node);
+	aFootprint->mTrace = platformTraceFootprint(node);
+	aFootprint->mHeap = aFootprint->mNode + aFootprint->mFlash + aFootprint->mRadio + aFootprint->mNetif +
+	                    aFootprint->mIpc + aFootprint->mTrace;
+	aFootprint->mStackPeak = getStackPeak(&node->mLoopStack);
+	aFootprint->mDriverStackPeak = getStackPeak(&node->mDriverStack);
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform to measure its memory
+ *   footprint, see posix-footprint.h.
+ */
+
+#ifndef PLATFORM_FOOTPRINT_H_
+#define PLATFORM_FOOTPRINT_H_
+
+#include <stdint.h>
+
+struct platformStackPaint;
+
+/**
+ * A painted thread stack, as recorded by a node for posixPlatformGetFootprint.
+ * The generation tells a thread apart from a later one reusing its slot.
+ *
+ */
+struct platformStackRef
+{
+	struct platformStackPaint *mPaint;
+	uint32_t                   mGeneration;
+};
+
+/**
+ * This method paints the stack below the caller, the first time it is called
+ * on a thread, and records the calling thread in aStack, for
+ * posixPlatformGetFootprint to measure its peak stack depth.
+ *
+ * @param[out]  aStack  Where the node keeps the thread, see node.h.
+ *
+ */
+void platformFootprintMarkStack(struct platformStackRef *aStack);
+
+#endif /* PLATFORM_FOOTPRINT_H_ */
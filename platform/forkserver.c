@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the fork server, see posix-fork-server.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-fork-server.h"
+#include "code_utils.h"
+
+//Receives a request, and the UART descriptors that came with it. Returns how many came, or -1 at the end.
+static int receiveRequest(int aSocket, struct posixForkRequest *aRequest, int aFds[2])
+{
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        buf[CMSG_SPACE(2 * sizeof(int))];
+	} control;
+	struct iovec iov = {aRequest, sizeof(*aRequest)};
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	int count = 0;
+	ssize_t rval;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	do
+	{
+		rval = recvmsg(aSocket, &msg, MSG_CMSG_CLOEXEC);
+	} while (rval < 0 && errno == EINTR);
+
+	if (rval <= 0)
+		return -1;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+		{
+			count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			memcpy(aFds, CMSG_DATA(cmsg), count * sizeof(int));
+		}
+	}
+
+	if (rval != sizeof(*aRequest) || (msg.msg_flags & MSG_CTRUNC))
+	{
+		for (int i = 0; i < count; i++)
+			close(aFds[i]);
+		count = -1;
+		errno = EINVAL;
+	}
+
+	return count;
+}
+
+//Runs in the forked process, before it carries on as the requested node
+static void becomeNode(const struct posixForkRequest *aRequest, int aFds[2], int aFdCount)
+{
+	char nodeId[12];
+
+	//Kept in the environment, so the node keeps its ID if it resets by re-executing itself
+	snprintf(nodeId, sizeof(nodeId), "%u", aRequest->mNodeId);
+	setenv(POSIX_NODE_ID_ENV, nodeId, 1);
+	unsetenv(POSIX_FORK_SERVER_ENV);
+	NODE_ID = aRequest->mNodeId;
+	signal(SIGCHLD, SIG_DFL);
+
+	if (aFdCount > 0)
+	{
+		dup2(aFds[0], STDIN_FILENO);
+		dup2(aFds[aFdCount - 1], STDOUT_FILENO);
+
+		for (int i = 0; i < aFdCount; i++)
+		{
+			if (aFds[i] > STDERR_FILENO)
+				close(aFds[i]);
+		}
+	}
+}
+
+//Serves the requests of one client. Returns 0 in a forked node, -1 in the server once the client is done.
+static int serveClient(int aClient, int aListenFd)
+{
+	struct posixForkRequest request;
+	struct posixForkResponse response;
+	int fds[2];
+	int fdCount;
+
+	while ((fdCount = receiveRequest(aClient, &request, fds)) >= 0)
+	{
+		pid_t pid = fork();
+
+		if (pid == 0)
+		{
+			close(aListenFd);
+			close(aClient);
+			becomeNode(&request, fds, fdCount);
+			return 0;
+		}
+
+		response.mPid = (pid < 0) ? -errno : pid;
+
+		for (int i = 0; i < fdCount; i++)
+			close(fds[i]);
+
+		if (send(aClient, &response, sizeof(response), MSG_NOSIGNAL) < 0)
+			break;
+	}
+
+	return -1;
+}
+
+int posixPlatformForkServer(const char *aSocketPath)
+{
+	struct sockaddr_un address;
+	int listenFd = -1;
+	int rval = -1;
+
+	otEXPECT_ACTION(strlen(aSocketPath) < sizeof(address.sun_path), errno = ENAMETOOLONG);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, aSocketPath);
+
+	listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	otEXPECT(listenFd >= 0);
+
+	unlink(aSocketPath);
+	otEXPECT(bind(listenFd, (struct sockaddr *)&address, sizeof(address)) == 0);
+	otEXPECT(listen(listenFd, SOMAXCONN) == 0);
+
+	//Node processes are reaped by the kernel, the server never waits for them
+	signal(SIGCHLD, SIG_IGN);
+	otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_PLATFORM, "Fork server listening on %s", aSocketPath);
+
+	for (;;)
+	{
+		int client = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+
+		if (client < 0)
+		{
+			otEXPECT(errno == EINTR || errno == ECONNABORTED);
+			continue;
+		}
+
+		if (serveClient(client, listenFd) == 0)
+			return 0;
+
+		close(client);
+	}
+
+exit:
+	otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM, "Fork server on %s failed: %s", aSocketPath, strerror(errno));
+	if (listenFd >= 0)
+		close(listenFd);
+	return rval;
+}
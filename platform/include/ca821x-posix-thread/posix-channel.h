@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines channel selection from an energy scan.
+ *
+ * posixPlatformChannelScan runs an energy detect scan over a set of
+ * channels, followed by an active scan to count the beacons heard on each of
+ * them. Channels are then ranked by a score that combines both: the measured
+ * energy (0-255), plus POSIX_CHANNEL_BEACON_WEIGHT for every beacon heard.
+ * Ties go to the lower energy, then the lower channel.
+ *
+ * posixPlatformChannelSelect does the same, and moves the instance to the
+ * best channel, so that a network formed afterwards starts on the quietest
+ * one. Thread must not be enabled yet. The 'chanscan' CLI command prints the
+ * ranking, and 'chanscan select' selects the best channel. cliapp selects
+ * one at startup when CASCODA_AUTO_CHANNEL is set.
+ *
+ * While a platform scan is running, scans requested by OpenThread fail with
+ * OT_ERROR_BUSY. An in-process reset cancels it, without calling the handler.
+ */
+
+#ifndef POSIX_CHANNEL_H_
+#define POSIX_CHANNEL_H_
+
+#include <stdint.h>
+
+#include "openthread/instance.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_CHANNEL_ENV "CASCODA_AUTO_CHANNEL" ///< Channel mask for cliapp to select from at startup, or 0 for all
+
+#define POSIX_CHANNEL_MIN 11
+#define POSIX_CHANNEL_MAX 26
+#define POSIX_CHANNEL_COUNT (POSIX_CHANNEL_MAX - POSIX_CHANNEL_MIN + 1)
+#define POSIX_CHANNEL_MASK_ALL 0x07fff800 ///< Channels 11 to 26
+
+#define POSIX_CHANNEL_BEACON_WEIGHT 32 ///< Score added for each beacon heard on a channel
+
+/**
+ * This structure is the result of a channel scan for one channel.
+ *
+ */
+struct posixChannelResult
+{
+    uint8_t  mChannel;
+    uint8_t  mEnergy;  ///< Energy measured by the ED scan, 0-255
+    uint8_t  mBeacons; ///< Beacons heard by the active scan, saturating at 255
+    uint16_t mScore;   ///< Lower is better
+};
+
+/**
+ * This structure is the ranking of the scanned channels, best first.
+ * Channels that the radio could not scan are left out.
+ *
+ */
+struct posixChannelReport
+{
+    uint8_t                   mCount;
+    struct posixChannelResult mChannels[POSIX_CHANNEL_COUNT];
+};
+
+/**
+ * This function pointer is called from the platform loop when a channel scan
+ * has finished.
+ *
+ * @param[in]  aInstance  The instance the scan was started on.
+ * @param[in]  aError     OT_ERROR_NONE, or the reason the scan or the
+ *                        selection failed.
+ * @param[in]  aReport    The ranking, or NULL if the scan failed.
+ * @param[in]  aContext   The context passed to posixPlatformChannelScan.
+ *
+ */
+typedef void (*posixChannelScanHandler)(otInstance *                     aInstance,
+                                        otError                          aError,
+                                        const struct posixChannelReport *aReport,
+                                        void *                           aContext);
+
+/**
+ * This function starts a channel scan.
+ *
+ * @param[in]  aInstance     The instance.
+ * @param[in]  aChannelMask  The channels to scan, bit n for channel n, or 0 for all.
+ * @param[in]  aDuration     The scan duration exponent of each channel, as
+ *                           for MLME-SCAN.request, eg. 3 for about 138ms.
+ * @param[in]  aHandler      The function to call with the ranking.
+ * @param[in]  aContext      A context pointer passed to @p aHandler.
+ *
+ * @retval OT_ERROR_NONE          The scan has started.
+ * @retval OT_ERROR_INVALID_ARGS  @p aChannelMask has no channel in 11-26.
+ * @retval OT_ERROR_BUSY          A scan is already running.
+ * @retval OT_ERROR_FAILED        The radio refused the scan.
+ *
+ */
+otError posixPlatformChannelScan(otInstance *            aInstance,
+                                 uint32_t                aChannelMask,
+                                 uint8_t                 aDuration,
+                                 posixChannelScanHandler aHandler,
+                                 void *                  aContext);
+
+/**
+ * This function starts a channel scan, as posixPlatformChannelScan, and
+ * then sets the channel of the instance to the best one. @p aHandler may be
+ * NULL.
+ *
+ */
+otError posixPlatformChannelSelect(otInstance *            aInstance,
+                                   uint32_t                aChannelMask,
+                                   uint8_t                 aDuration,
+                                   posixChannelScanHandler aHandler,
+                                   void *                  aContext);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_CHANNEL_H_
@@ -0,0 +1,166 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the platform event bus.
+ *
+ * OpenThread allows few state changed handlers, and runs them on the stack
+ * thread. The event bus instead fans platform events out to any number of
+ * subscribers, each on its own thread: OpenThread state changes, Thread role
+ * transitions, MAC failures reported by the radio, and settings changes.
+ *
+ * Publishing never blocks or takes a lock. Every subscriber has a bounded
+ * lock-free queue. When a slow subscriber lets it fill up, further events of
+ * a type are coalesced into one event of that type, delivered once the queue
+ * has drained, with mCoalesced set to the number of events merged into it.
+ * A coalesced state change carries all of the merged flags, and a coalesced
+ * role transition goes from the role last delivered to the current one.
+ *
+ * State changes and role transitions are captured from the first pass of the
+ * platform loop after a subscriber for them exists, which needs a free
+ * OpenThread state changed handler slot.
+ */
+
+#ifndef POSIX_EVENTS_H_
+#define POSIX_EVENTS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum posixEventType
+{
+    POSIX_EVENT_STATE_CHANGED, ///< OpenThread state changed callback
+    POSIX_EVENT_ROLE,          ///< The Thread device role changed
+    POSIX_EVENT_LINK,          ///< A MAC request, confirm or indication did not succeed
+    POSIX_EVENT_SETTINGS,      ///< A setting was changed
+    POSIX_EVENT_TYPE_COUNT
+};
+
+#define POSIX_EVENT_MASK(aType) (1u << (aType))
+#define POSIX_EVENT_MASK_ALL    ((1u << POSIX_EVENT_TYPE_COUNT) - 1)
+
+enum posixEventSettingsOperation
+{
+    POSIX_EVENT_SETTINGS_SET,
+    POSIX_EVENT_SETTINGS_ADD,
+    POSIX_EVENT_SETTINGS_DELETE,
+    POSIX_EVENT_SETTINGS_WIPE,
+};
+
+/**
+ * An event, as delivered to a subscriber.
+ *
+ */
+struct posixEvent
+{
+    uint16_t mType;        ///< enum posixEventType
+    uint16_t mCoalesced;   ///< Number of events merged into this one, 0 if none (saturates)
+    uint32_t mNodeId;      ///< Node the event happened on
+    uint64_t mTimestampUs; ///< CLOCK_MONOTONIC time of the event, or of the delivery if coalesced
+
+    union
+    {
+        uint32_t mStateFlags; ///< POSIX_EVENT_STATE_CHANGED: OT_CHANGED_* flags
+
+        struct
+        {
+            uint8_t mPrevious; ///< otDeviceRole
+            uint8_t mCurrent;  ///< otDeviceRole
+        } mRole; ///< POSIX_EVENT_ROLE
+
+        struct
+        {
+            uint8_t mPrimitive; ///< enum posixMacPrimitive, see posix-metrics.h
+            uint8_t mStatus;    ///< Raw MAC status
+        } mLink; ///< POSIX_EVENT_LINK, not set if coalesced
+
+        struct
+        {
+            uint16_t mKey;       ///< Settings key, not set for a wipe
+            uint8_t  mOperation; ///< enum posixEventSettingsOperation
+        } mSettings; ///< POSIX_EVENT_SETTINGS, not set if coalesced
+    };
+};
+
+struct posixEventSubscriber;
+
+/**
+ * Called on the subscriber's own thread for every event.
+ *
+ */
+typedef void (*posixEventHandler)(const struct posixEvent *aEvent, void *aContext);
+
+/**
+ * This function subscribes to events.
+ *
+ * @param[in]  aTypes        POSIX_EVENT_MASK()s of the types wanted.
+ * @param[in]  aQueueLength  Events queued before they are coalesced, rounded
+ *                           up to a power of two. 0 for 64.
+ * @param[in]  aHandler      Run on a thread created for the subscriber, or NULL
+ *                           to read the events with posixPlatformEventRead.
+ * @param[in]  aContext      Passed to aHandler.
+ *
+ * @returns The subscriber, or NULL if it could not be created.
+ *
+ */
+struct posixEventSubscriber *posixPlatformEventSubscribe(uint32_t          aTypes,
+                                                         uint32_t          aQueueLength,
+                                                         posixEventHandler aHandler,
+                                                         void             *aContext);
+
+/**
+ * This function unsubscribes and frees a subscriber, after its handler has
+ * returned. It must not be called from the subscriber's own handler.
+ *
+ */
+void posixPlatformEventUnsubscribe(struct posixEventSubscriber *aSubscriber);
+
+/**
+ * This function takes the next event of a subscriber without a handler. Only
+ * one thread may read a subscriber.
+ *
+ * @param[in]   aSubscriber  The subscriber.
+ * @param[out]  aEvent       The event.
+ * @param[in]   aTimeoutMs   How long to wait for an event, -1 for ever or 0 not to wait.
+ *
+ * @retval 0   aEvent is set.
+ * @retval -1  No event arrived in time, or the subscriber is being unsubscribed.
+ *
+ */
+int posixPlatformEventRead(struct posixEventSubscriber *aSubscriber, struct posixEvent *aEvent, int aTimeoutMs);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_EVENTS_H_
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the memory footprint report of a node.
+ *
+ * posixPlatformGetFootprint breaks down the memory used by the platform for a
+ * node: the static data of the process (shared by all the nodes of a
+ * simulation, and including OpenThread's own instance), the heap and shared
+ * memory held by each platform module for the node, and the peak stack depth
+ * of the threads running its code. The 'footprint' CLI command prints it.
+ *
+ * The stack peaks are measured by painting the stack below the caller with a
+ * pattern the first time a thread enters the loop, or delivers an upcall of a
+ * real device, and later looking for the deepest byte that has been
+ * overwritten. The depth counts from the top of the thread's stack.
+ * CASCODA_STACK_PAINT_SIZE sets how much is painted (64KiB by default, 0
+ * disables the measurement), a peak that deep means the stack went at least
+ * as far. Up to 32 threads are measured at a time.
+ *
+ * The larger platform buffers are sized at compile time, so a build can be
+ * trimmed to a constrained target, see the CMake cache variables in the
+ * Readme.
+ */
+
+#ifndef POSIX_FOOTPRINT_H_
+#define POSIX_FOOTPRINT_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct posixNode;
+
+/**
+ * This structure is a memory footprint report, in bytes.
+ *
+ */
+struct posixFootprint
+{
+    size_t mStatic;          ///< .data and .bss of the process, shared by all its nodes
+    size_t mNode;            ///< The node structure, heap allocated for simulated nodes
+    size_t mFlash;           ///< Flash emulation
+    size_t mRadio;           ///< Simulated radio: attributes, indirect queue, in-flight frames and links
+    size_t mNetif;           ///< Native network interface and its queue
+    size_t mIpc;             ///< Local client server, including the shared packet rings
+    size_t mTrace;           ///< Frame trace buffer
+    size_t mHeap;            ///< Total of the above, except mStatic
+    size_t mStackPeak;       ///< Peak stack depth of the loop thread that last serviced the node, or 0 if not measured
+    size_t mDriverStackPeak; ///< Peak stack depth of the worker thread of a real device, or 0 if not measured
+};
+
+/**
+ * This function gets the memory footprint of a node. Nodes sharing a loop
+ * thread report the same stack peak.
+ *
+ * @param[in]   aNode       The node, or NULL for the current one.
+ * @param[out]  aFootprint  The report.
+ *
+ */
+void posixPlatformGetFootprint(struct posixNode *aNode, struct posixFootprint *aFootprint);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_FOOTPRINT_H_
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the protocol spoken by the fork server.
+ *
+ * With CASCODA_FORK_SERVER=<socket path> set, posixPlatformInit turns the
+ * process into a fork server instead of bringing up a node. It listens on a
+ * SOCK_SEQPACKET unix socket at that path, and forks a node process for each
+ * request. The forked process takes the node ID from the request, its UART
+ * from the descriptors passed with it, and carries on with posixPlatformInit
+ * as if it had been started with that node ID. Everything else, such as the
+ * EUI-64 and flash files, follows from the node ID. Process startup and
+ * dynamic linking are then paid once, by the server.
+ *
+ * A request is one struct posixForkRequest message. It may carry UART
+ * descriptors as SCM_RIGHTS ancillary data: none to share the server's
+ * stdin and stdout, one to use for both, or two for input and output in that
+ * order. The server answers each request with a struct posixForkResponse. A
+ * connection can be used for any number of requests. Both are in host byte
+ * order, as the server is always local.
+ */
+
+#ifndef POSIX_FORK_SERVER_H_
+#define POSIX_FORK_SERVER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_FORK_SERVER_ENV "CASCODA_FORK_SERVER"
+#define POSIX_NODE_ID_ENV     "CASCODA_NODE_ID" ///< Set in forked nodes, and overrides NODE_ID in posixPlatformInit
+
+/**
+ * A request for a node process.
+ *
+ */
+struct posixForkRequest
+{
+    uint32_t mNodeId; ///< NODE_ID of the new node
+};
+
+/**
+ * The answer to a request.
+ *
+ */
+struct posixForkResponse
+{
+    int32_t mPid; ///< The process ID of the new node, or a negative errno if it could not be forked
+};
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_FORK_SERVER_H_
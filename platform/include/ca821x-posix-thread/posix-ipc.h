@@ -0,0 +1,240 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the shared-memory packet interface for local clients.
+ *
+ * With posixPlatformIpcStart, a node serves local client processes on a
+ * SOCK_SEQPACKET unix socket. Each client gets a shared-memory segment
+ * holding a pair of single-producer rings, one towards the stack and one
+ * from it, and a pair of eventfds as doorbells. Clients then send and
+ * receive Thread UDP datagrams on the ports they have bound, by writing and
+ * reading the ring slots in place. The stack thread services all rings
+ * once per loop pass.
+ *
+ * Protocol: after connecting, the server sends one struct posixIpcResponse
+ * with mStatus 0, carrying three descriptors as SCM_RIGHTS ancillary data:
+ * the shared-memory segment (a struct posixIpcShared), the eventfd the
+ * client rings after filling mToStack, and the eventfd the server rings
+ * after filling mFromStack. The client then sends struct posixIpcRequest
+ * messages to bind or unbind ports, each answered with a struct
+ * posixIpcResponse. Closing the socket releases the client. Everything is
+ * in host byte order, as the server is always local.
+ *
+ * The client side is implemented by the ca821x-ipc-client library, with the
+ * posixIpcClient functions below.
+ */
+
+#ifndef POSIX_IPC_H_
+#define POSIX_IPC_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct otInstance; //Clients need no OpenThread headers
+
+#define POSIX_IPC_ENV         "CASCODA_IPC" ///< Socket path, for the example applications to serve clients on
+#define POSIX_IPC_MAGIC       0x43504943U   ///< "CIPC" in little-endian byte order
+#define POSIX_IPC_VERSION     1
+#define POSIX_IPC_SLOTS       64            ///< Slots in each ring, a power of two
+#define POSIX_IPC_MAX_PAYLOAD 1232          ///< UDP payload that fits an unfragmented 1280 byte packet
+#define POSIX_IPC_MAX_PORTS   8             ///< Ports a client can bind
+
+/**
+ * A datagram, as stored in a ring slot.
+ *
+ */
+struct posixIpcDatagram
+{
+    uint8_t  mPeerAddress[16]; ///< Destination when sending, source when received
+    uint16_t mPeerPort;
+    uint16_t mLocalPort;       ///< Bound port to send from, or that received the datagram
+    uint16_t mLength;          ///< Bytes of mPayload used
+    uint8_t  mHopLimit;        ///< 0 for the default when sending
+    uint8_t  mReserved;
+    uint8_t  mPayload[POSIX_IPC_MAX_PAYLOAD];
+};
+
+/**
+ * A single-producer single-consumer ring. mHead and mTail only increase, and
+ * are on separate cache lines, as each is written by one side only.
+ *
+ */
+struct posixIpcRing
+{
+    uint32_t                mHead; ///< Slots filled by the producer
+    uint8_t                 mPad0[60];
+    uint32_t                mTail; ///< Slots released by the consumer
+    uint8_t                 mPad1[60];
+    struct posixIpcDatagram mSlots[POSIX_IPC_SLOTS];
+};
+
+/**
+ * The shared-memory segment of a client.
+ *
+ */
+struct posixIpcShared
+{
+    uint32_t            mMagic;     ///< POSIX_IPC_MAGIC
+    uint32_t            mVersion;   ///< POSIX_IPC_VERSION
+    uint32_t            mSize;      ///< sizeof(struct posixIpcShared)
+    uint32_t            mNodeId;    ///< NODE_ID of the server
+    uint8_t             mPad[48];
+    struct posixIpcRing mToStack;   ///< Filled by the client
+    struct posixIpcRing mFromStack; ///< Filled by the server
+};
+
+enum posixIpcOperation
+{
+    POSIX_IPC_BIND   = 1,
+    POSIX_IPC_UNBIND = 2,
+};
+
+/**
+ * A request from a client.
+ *
+ */
+struct posixIpcRequest
+{
+    uint32_t mOperation; ///< enum posixIpcOperation
+    uint16_t mPort;
+    uint16_t mReserved;
+};
+
+/**
+ * The answer to a request, and the greeting of a new client.
+ *
+ */
+struct posixIpcResponse
+{
+    int32_t mStatus; ///< 0 on success, or a negative errno
+};
+
+/**
+ * This function starts serving local clients for an instance.
+ *
+ * @param[in]  aInstance    The instance.
+ * @param[in]  aSocketPath  Path of the unix socket to listen on, replaced if it exists.
+ *
+ * @retval 0   Clients can connect.
+ * @retval -1  The socket could not be created, errno is set.
+ *
+ */
+int posixPlatformIpcStart(struct otInstance *aInstance, const char *aSocketPath);
+
+/**
+ * This function stops serving local clients, and disconnects them.
+ *
+ */
+void posixPlatformIpcStop(struct otInstance *aInstance);
+
+struct posixIpcClient;
+
+/**
+ * This function connects to a node serving local clients.
+ *
+ * @returns The client, or NULL with errno set.
+ *
+ */
+struct posixIpcClient *posixIpcClientConnect(const char *aSocketPath);
+
+/**
+ * This function disconnects and frees a client.
+ *
+ */
+void posixIpcClientClose(struct posixIpcClient *aClient);
+
+/**
+ * This function binds or unbinds a UDP port, to receive on and send from.
+ *
+ * @retval 0   Success.
+ * @retval -1  Failure, errno is set.
+ *
+ */
+int posixIpcClientBind(struct posixIpcClient *aClient, uint16_t aPort);
+int posixIpcClientUnbind(struct posixIpcClient *aClient, uint16_t aPort);
+
+/**
+ * This function gets the next free slot towards the stack, to be filled in
+ * place. Slots are sent, in order, by posixIpcClientSendCommit.
+ *
+ * @returns The slot, or NULL if the ring is full.
+ *
+ */
+struct posixIpcDatagram *posixIpcClientSendBegin(struct posixIpcClient *aClient);
+
+/**
+ * This function sends the slots taken since the last commit, and rings the doorbell.
+ *
+ */
+void posixIpcClientSendCommit(struct posixIpcClient *aClient);
+
+/**
+ * This function gets the next received datagram. It stays valid until
+ * released by posixIpcClientReceiveDone.
+ *
+ * @returns The datagram, or NULL if there is none.
+ *
+ */
+const struct posixIpcDatagram *posixIpcClientReceive(struct posixIpcClient *aClient);
+
+/**
+ * This function releases the datagrams taken with posixIpcClientReceive.
+ *
+ */
+void posixIpcClientReceiveDone(struct posixIpcClient *aClient);
+
+/**
+ * This function waits for a datagram to be received.
+ *
+ * @param[in]  aTimeoutMs  How long to wait, -1 for ever.
+ *
+ * @retval 0   A datagram is waiting.
+ * @retval -1  Timeout, or the server went away.
+ *
+ */
+int posixIpcClientWait(struct posixIpcClient *aClient, int aTimeoutMs);
+
+/**
+ * This function gets the descriptor that becomes readable when datagrams are
+ * received, to wait in a poll loop of one's own. Read it before taking the
+ * datagrams, to clear it.
+ *
+ */
+int posixIpcClientGetFd(const struct posixIpcClient *aClient);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_IPC_H_
@@ -0,0 +1,335 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the layout of the shared-memory metrics segment.
+ *
+ * Each node publishes its counters in /dev/shm/ca821x-thread-metrics.<NODE_ID>.
+ * The platform updates them with relaxed atomic adds, so readers can map the
+ * segment read-only and scrape it at any time without syscalls into the stack
+ * or taking any lock. Individual counters are always consistent, but
+ * counters are not a snapshot relative to each other.
+ *
+ * The layout is fixed for a given version. Fields are only ever appended,
+ * and the version bumped, so a reader should check mMagic, then mVersion,
+ * and use mSize to know how much of the segment is valid.
+ */
+
+#ifndef POSIX_METRICS_H_
+#define POSIX_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_METRICS_MAGIC      0x5254454D544F4143ULL ///< "CAOTMETR" in little-endian byte order
+#define POSIX_METRICS_VERSION    8
+#define POSIX_METRICS_SHM_PREFIX "/ca821x-thread-metrics."
+
+/**
+ * MAC primitives whose raw status codes are counted in mMacStatus.
+ *
+ */
+enum posixMacPrimitive
+{
+    POSIX_MAC_MLME_GET,
+    POSIX_MAC_MLME_SET,
+    POSIX_MAC_MLME_RESET,
+    POSIX_MAC_MLME_START,
+    POSIX_MAC_MLME_SCAN,
+    POSIX_MAC_MLME_POLL,
+    POSIX_MAC_MCPS_DATA,
+    POSIX_MAC_MCPS_PURGE,
+    POSIX_MAC_MCPS_DATA_CONFIRM,
+    POSIX_MAC_MLME_COMM_STATUS,
+    POSIX_MAC_MLME_SCAN_CONFIRM,
+    POSIX_MAC_PRIMITIVE_COUNT
+};
+
+/**
+ * Sources of work in the platform loop, whose scheduling is counted in the
+ * mSched arrays. See posix-sched.h.
+ *
+ */
+enum posixSchedSource
+{
+    POSIX_SCHED_RADIO,    ///< Radio upcalls, or the messages of a simulated radio
+    POSIX_SCHED_UART,     ///< UART input and output
+    POSIX_SCHED_ALARM,    ///< The OpenThread alarm
+    POSIX_SCHED_TASKLETS, ///< Tasklets run by posixPlatformTaskletsProcess
+    POSIX_SCHED_NETIF,    ///< Packets read from the native network interface
+    POSIX_SCHED_IPC,      ///< Requests of local clients
+    POSIX_SCHED_WORKERS,  ///< Done functions of the worker pool
+    POSIX_SCHED_TASKS,    ///< Cooperative tasks resumed
+    POSIX_SCHED_SOURCE_COUNT
+};
+
+/**
+ * Platform operations whose CPU cost is counted in mPerfOps and mPerfTotals.
+ * See posix-perf.h.
+ *
+ */
+enum posixPerfOp
+{
+    POSIX_PERF_DATA_INDICATION, ///< A received frame, from the radio upcall through OpenThread
+    POSIX_PERF_DATA_REQUEST,    ///< otPlatMcpsDataRequest
+    POSIX_PERF_TASKLETS,        ///< Tasklets run by posixPlatformTaskletsProcess
+    POSIX_PERF_SETTINGS_GET,    ///< otPlatSettingsGet
+    POSIX_PERF_SETTINGS_SET,    ///< otPlatSettingsSet and otPlatSettingsAdd
+    POSIX_PERF_SETTINGS_DELETE, ///< otPlatSettingsDelete
+    POSIX_PERF_SETTINGS_WIPE,   ///< otPlatSettingsWipe
+    POSIX_PERF_OP_COUNT
+};
+
+/**
+ * Counters totalled for each operation in mPerfTotals.
+ *
+ */
+enum posixPerfCounter
+{
+    POSIX_PERF_CYCLES,        ///< CPU cycles, hardware only
+    POSIX_PERF_INSTRUCTIONS,  ///< Instructions retired, hardware only
+    POSIX_PERF_CACHE_MISSES,  ///< Last level cache misses, hardware only
+    POSIX_PERF_TASK_CLOCK_NS, ///< CPU time of the thread
+    POSIX_PERF_COUNTER_COUNT
+};
+
+/**
+ * Where the counters of mPerfTotals come from.
+ *
+ */
+enum posixPerfSource
+{
+    POSIX_PERF_SOURCE_NONE,     ///< Not counted, the platform was built without CASCODA_PERF_COUNTERS
+    POSIX_PERF_SOURCE_CLOCK,    ///< perf_event_open is unavailable, CPU time only, from the thread CPU clock
+    POSIX_PERF_SOURCE_SOFTWARE, ///< No hardware counters, eg. in a VM, CPU time only, from the perf task clock
+    POSIX_PERF_SOURCE_HARDWARE, ///< Hardware counters, and the perf task clock
+};
+
+/**
+ * The shared-memory metrics segment. All counters only increase, except for
+ * the gauges mMessageBuffersTotal and mMessageBuffersUsed, and mPerfSource.
+ *
+ */
+struct posixMetrics
+{
+    uint64_t mMagic;              ///< POSIX_METRICS_MAGIC, written last when the segment is ready
+    uint32_t mVersion;            ///< POSIX_METRICS_VERSION of the writer
+    uint32_t mSize;               ///< sizeof(struct posixMetrics) of the writer
+    uint32_t mNodeId;             ///< NODE_ID of the writer
+    uint32_t mPid;                ///< Process ID of the writer
+    uint64_t mStartTime;          ///< Wall-clock creation time, in microseconds since the epoch
+
+    uint64_t mLoopIterations;     ///< Platform main loop iterations
+    uint64_t mWakeups;            ///< Times the main loop woke up from sleeping
+    uint64_t mRadioFramesIn;      ///< MCPS-DATA.indications passed to OpenThread
+    uint64_t mRadioFramesOut;     ///< MCPS-DATA.requests accepted by the radio
+    uint64_t mBarrierWaits;       ///< Radio callbacks handed over to the main thread
+    uint64_t mBarrierWaitNs;      ///< Total time radio callbacks waited for the main thread
+    uint64_t mSettingsGets;       ///< otPlatSettingsGet calls
+    uint64_t mSettingsSets;       ///< otPlatSettingsSet and otPlatSettingsAdd calls
+    uint64_t mSettingsDeletes;    ///< otPlatSettingsDelete calls
+    uint64_t mSettingsWipes;      ///< otPlatSettingsWipe calls
+    uint64_t mFlashBytesRead;     ///< Bytes read from the flash file
+    uint64_t mFlashBytesWritten;  ///< Bytes written to the flash file, including erases
+    uint64_t mLogMessages;        ///< Log messages printed
+    uint64_t mLogDrops;           ///< Log messages truncated or that failed to print
+    uint64_t mConfirmStatus[256]; ///< MCPS-DATA.confirms, indexed by raw MAC status (see also mMacStatus)
+
+    /* Version 2 */
+    uint64_t mMacStatus[POSIX_MAC_PRIMITIVE_COUNT][256]; ///< Every MAC request, confirm and status indication,
+                                                          ///< indexed by primitive then raw MAC status
+
+    /* Version 3 */
+    uint64_t mWorkSubmitted;      ///< Work submitted to the worker pool
+    uint64_t mWorkStarted;        ///< Work taken by a worker thread
+    uint64_t mWorkFinished;       ///< Work run by a worker thread
+    uint64_t mWorkCompleted;      ///< Work handed back to the OpenThread thread
+    uint64_t mWorkQueuedMax;      ///< Most work ever waiting for a worker at once
+
+    /* Version 4 */
+    uint64_t mTunPacketsIn;       ///< Packets read from the network interface
+    uint64_t mTunBytesIn;         ///< Bytes read from the network interface
+    uint64_t mTunPacketsOut;      ///< Packets written to the network interface
+    uint64_t mTunBytesOut;        ///< Bytes written to the network interface
+    uint64_t mTunDrops;           ///< Packets dropped in either direction
+
+    /* Version 5 */
+    uint64_t mIpcClients;         ///< Local clients accepted
+    uint64_t mIpcToThread;        ///< Datagrams sent by local clients
+    uint64_t mIpcFromThread;      ///< Datagrams passed to local clients
+    uint64_t mIpcDrops;           ///< Datagrams dropped in either direction
+
+    /* Version 6, indexed by enum posixSchedSource */
+    uint64_t mSchedItems[POSIX_SCHED_SOURCE_COUNT];    ///< Work items run, or turns for sources without items
+    uint64_t mSchedTimeNs[POSIX_SCHED_SOURCE_COUNT];   ///< Total time spent running the source
+    uint64_t mSchedYields[POSIX_SCHED_SOURCE_COUNT];   ///< Turns ended by the budget or slice with work left
+    uint64_t mSchedOverruns[POSIX_SCHED_SOURCE_COUNT]; ///< Turns that ran past the slice
+    uint64_t mSchedStarved[POSIX_SCHED_SOURCE_COUNT];  ///< Work that waited past the deadline to run
+
+    /* Version 7, the message buffer pools of every instance, sampled once per pass */
+    uint64_t mMessageBuffersTotal;   ///< Gauge, buffers in the pools
+    uint64_t mMessageBuffersUsed;    ///< Gauge, buffers in use
+    uint64_t mMessageBuffersUsedMax; ///< Most buffers ever in use by one instance
+    uint64_t mMessageBuffersEmpty;   ///< Times a pool was found with no free buffer
+    uint64_t mMessageAllocFailures;  ///< Messages from the platform refused for want of a buffer
+
+    /* Version 8, indexed by enum posixPerfOp then enum posixPerfCounter */
+    uint64_t mPerfSource;                                                ///< enum posixPerfSource of the counters
+    uint64_t mPerfOps[POSIX_PERF_OP_COUNT];                              ///< Operations counted
+    uint64_t mPerfTotals[POSIX_PERF_OP_COUNT][POSIX_PERF_COUNTER_COUNT]; ///< Counter totals of the operations
+};
+
+/**
+ * This function gets a printable name for a MAC primitive.
+ *
+ */
+static inline const char *posixMetricsMacPrimitiveName(int aPrimitive)
+{
+    static const char *const names[POSIX_MAC_PRIMITIVE_COUNT] = {
+        "MLME-GET",          "MLME-SET",         "MLME-RESET",        "MLME-START",
+        "MLME-SCAN",         "MLME-POLL",        "MCPS-DATA",         "MCPS-PURGE",
+        "MCPS-DATA.confirm", "MLME-COMM-STATUS", "MLME-SCAN.confirm",
+    };
+
+    return (aPrimitive >= 0 && aPrimitive < POSIX_MAC_PRIMITIVE_COUNT) ? names[aPrimitive] : "unknown";
+}
+
+/**
+ * This function gets a printable name for a source of work in the platform loop.
+ *
+ */
+static inline const char *posixMetricsSchedSourceName(int aSource)
+{
+    static const char *const names[POSIX_SCHED_SOURCE_COUNT] = {
+        "radio", "uart", "alarm", "tasklets", "netif", "ipc", "workers", "tasks",
+    };
+
+    return (aSource >= 0 && aSource < POSIX_SCHED_SOURCE_COUNT) ? names[aSource] : "unknown";
+}
+
+/**
+ * This function gets a printable name for a platform operation whose CPU cost is counted.
+ *
+ */
+static inline const char *posixMetricsPerfOpName(int aOp)
+{
+    static const char *const names[POSIX_PERF_OP_COUNT] = {
+        "data_indication", "data_request",    "tasklets",        "settings_get",
+        "settings_set",    "settings_delete", "settings_wipe",
+    };
+
+    return (aOp >= 0 && aOp < POSIX_PERF_OP_COUNT) ? names[aOp] : "unknown";
+}
+
+/**
+ * This function gets a printable name for a counter of the CPU cost of an operation.
+ *
+ */
+static inline const char *posixMetricsPerfCounterName(int aCounter)
+{
+    static const char *const names[POSIX_PERF_COUNTER_COUNT] = {
+        "cycles",
+        "instructions",
+        "cache_misses",
+        "task_clock_ns",
+    };
+
+    return (aCounter >= 0 && aCounter < POSIX_PERF_COUNTER_COUNT) ? names[aCounter] : "unknown";
+}
+
+/**
+ * This function gets a printable name for the source of the counters.
+ *
+ */
+static inline const char *posixMetricsPerfSourceName(int aSource)
+{
+    static const char *const names[] = {"none", "clock", "software", "hardware"};
+
+    return (aSource >= 0 && aSource <= POSIX_PERF_SOURCE_HARDWARE) ? names[aSource] : "unknown";
+}
+
+/**
+ * This function gets a printable name for a raw MAC status, or NULL if unknown.
+ *
+ */
+static inline const char *posixMetricsMacStatusName(uint8_t aStatus)
+{
+    switch (aStatus)
+    {
+    case 0x00: return "SUCCESS";
+    case 0xDB: return "COUNTER_ERROR";
+    case 0xDC: return "IMPROPER_KEY_TYPE";
+    case 0xDD: return "IMPROPER_SECURITY_LEVEL";
+    case 0xDE: return "UNSUPPORTED_LEGACY";
+    case 0xDF: return "UNSUPPORTED_SECURITY";
+    case 0xE0: return "BEACON_LOSS";
+    case 0xE1: return "CHANNEL_ACCESS_FAILURE";
+    case 0xE2: return "DENIED";
+    case 0xE3: return "DISABLE_TRX_FAILURE";
+    case 0xE4: return "SECURITY_ERROR";
+    case 0xE5: return "FRAME_TOO_LONG";
+    case 0xE6: return "INVALID_GTS";
+    case 0xE7: return "INVALID_HANDLE";
+    case 0xE8: return "INVALID_PARAMETER";
+    case 0xE9: return "NO_ACK";
+    case 0xEA: return "NO_BEACON";
+    case 0xEB: return "NO_DATA";
+    case 0xEC: return "NO_SHORT_ADDRESS";
+    case 0xED: return "OUT_OF_CAP";
+    case 0xEE: return "PAN_ID_CONFLICT";
+    case 0xEF: return "REALIGNMENT";
+    case 0xF0: return "TRANSACTION_EXPIRED";
+    case 0xF1: return "TRANSACTION_OVERFLOW";
+    case 0xF2: return "TX_ACTIVE";
+    case 0xF3: return "UNAVAILABLE_KEY";
+    case 0xF4: return "UNSUPPORTED_ATTRIBUTE";
+    case 0xF5: return "INVALID_ADDRESS";
+    case 0xF6: return "ON_TIME_TOO_LONG";
+    case 0xF7: return "PAST_TIME";
+    case 0xF8: return "TRACKING_OFF";
+    case 0xF9: return "INVALID_INDEX";
+    case 0xFA: return "LIMIT_REACHED";
+    case 0xFB: return "READ_ONLY";
+    case 0xFC: return "SCAN_IN_PROGRESS";
+    case 0xFD: return "SUPERFRAME_OVERLAP";
+    case 0xFF: return "SYSTEM_ERROR";
+    default:   return NULL;
+    }
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_METRICS_H_
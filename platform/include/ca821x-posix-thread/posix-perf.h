@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the CPU cost counters of the platform hot paths.
+ *
+ * Wall time is a noisy measure of an optimization: it includes waiting for
+ * the radio, the flash file and the scheduler. When the platform is built
+ * with CASCODA_PERF_COUNTERS, it instead counts the cycles, instructions and
+ * cache misses each thread spends in these operations, with perf_event_open
+ * self-monitoring counters:
+ * - a received frame, from the radio upcall through OpenThread;
+ * - otPlatMcpsDataRequest;
+ * - tasklets run by posixPlatformTaskletsProcess;
+ * - otPlatSettingsGet, Set and Add, Delete and Wipe.
+ *
+ * Hardware counters are often unavailable, eg. in a VM or a container. The
+ * counters then fall back to the perf software task clock, or to the thread
+ * CPU clock if perf_event_open itself is not allowed, and only count CPU
+ * time. See enum posixPerfSource.
+ *
+ * An operation nested in another, eg. a settings write made by a tasklet, is
+ * counted in both. Reading the counters takes a syscall at each end of an
+ * operation, which the totals include, so they are for comparing builds
+ * rather than for production.
+ *
+ * The totals are published in the metrics segment, see posix-metrics.h. The
+ * 'perf' CLI command prints the average cost of each operation.
+ */
+
+#ifndef POSIX_PERF_H_
+#define POSIX_PERF_H_
+
+#include <stdint.h>
+
+#include "ca821x-posix-thread/posix-metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * This structure is the CPU cost of an operation, totalled over the times it
+ * ran. Divide by mCount for the average.
+ *
+ */
+struct posixPerfStats
+{
+    uint64_t mCount;                            ///< Times the operation was counted
+    uint64_t mTotals[POSIX_PERF_COUNTER_COUNT]; ///< Indexed by enum posixPerfCounter, 0 if unavailable
+};
+
+/**
+ * This function gets where the counters come from.
+ *
+ * @returns The enum posixPerfSource of the thread that last opened its
+ *          counters, or POSIX_PERF_SOURCE_NONE if nothing has been counted.
+ *
+ */
+enum posixPerfSource posixPlatformPerfGetSource(void);
+
+/**
+ * This function gets the CPU cost of an operation in this process.
+ *
+ * @param[in]   aOp     The operation, one of enum posixPerfOp.
+ * @param[out]  aStats  The totals, all 0 for an unknown operation.
+ *
+ */
+void posixPlatformPerfGetStats(int aOp, struct posixPerfStats *aStats);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_PERF_H_
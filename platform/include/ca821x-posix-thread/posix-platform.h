@@ -35,6 +35,7 @@
 #ifndef POSIX_PLATFORM_H_
 #define POSIX_PLATFORM_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <sys/select.h>
 #include <sys/time.h>
@@ -48,6 +49,9 @@
 extern "C" {
 #endif
 
+struct posixMetrics;
+struct posixNode;
+
 /**
  * Unique node ID.
  *
@@ -60,18 +64,271 @@ extern uint32_t NODE_ID;
  */
 extern uint32_t WELLKNOWN_NODE_ID;
 
+/**
+ * Startup milestones, in the order they are normally reached.
+ *
+ */
+enum posixPlatformMilestone
+{
+    POSIX_MILESTONE_INIT_START,     ///< posixPlatformInit called
+    POSIX_MILESTONE_ALARM_READY,    ///< Alarm initialised
+    POSIX_MILESTONE_UART_READY,     ///< UART enabled
+    POSIX_MILESTONE_EUI_READY,      ///< EUI-64 loaded or generated
+    POSIX_MILESTONE_FLASH_READY,    ///< Flash file open
+    POSIX_MILESTONE_DEVICE_OPEN,    ///< Radio device found and opened
+    POSIX_MILESTONE_MAC_RESET,      ///< MAC reset to a default state
+    POSIX_MILESTONE_INIT_DONE,      ///< posixPlatformInit succeeded
+    POSIX_MILESTONE_INSTANCE_READY, ///< OpenThread instance created (marked by the application)
+    POSIX_MILESTONE_ATTACHED,       ///< Attached to a network (marked by the application)
+    POSIX_MILESTONE_COUNT
+};
+
+/**
+ * This function pointer is called after an in-process reset has recreated the instance.
+ *
+ * @param[in]  aInstance  The new OpenThread instance.
+ * @param[in]  aContext   The context passed to posixPlatformSetResetHandler.
+ *
+ */
+typedef void (*posixPlatformResetHandler)(otInstance *aInstance, void *aContext);
+
 /**
  * This method performs all platform-specific initialization.
  *
  */
 int posixPlatformInit(void);
 
+/**
+ * This method performs posixPlatformInit, retrying with a fast exponential backoff
+ * (from 10ms, doubling up to 1s) until it succeeds, eg. while the radio is plugged in.
+ *
+ */
+void posixPlatformInitRetry(void);
+
+/**
+ * This method turns the process into a fork server listening on @p aSocketPath,
+ * see posix-fork-server.h. posixPlatformInit calls it when CASCODA_FORK_SERVER
+ * is set. It must be called while the process has only one thread.
+ *
+ * @returns 0 in each forked node process, with NODE_ID and the UART set up for
+ *          that node, or -1 if the server failed. It does not otherwise return.
+ *
+ */
+int posixPlatformForkServer(const char *aSocketPath);
+
+/**
+ * This method records the time a startup milestone is reached. Only the first call
+ * for each milestone is recorded.
+ *
+ * @param[in]  aMilestone  The milestone that has been reached.
+ *
+ */
+void posixPlatformMarkMilestone(enum posixPlatformMilestone aMilestone);
+
+/**
+ * This method gets the time a startup milestone was reached.
+ *
+ * @param[in]  aMilestone  The milestone.
+ *
+ * @returns Microseconds since POSIX_MILESTONE_INIT_START, or -1 if not reached.
+ *
+ */
+int64_t posixPlatformGetMilestoneUs(enum posixPlatformMilestone aMilestone);
+
+/**
+ * This method gets a short printable name for a startup milestone.
+ *
+ */
+const char *posixPlatformGetMilestoneName(enum posixPlatformMilestone aMilestone);
+
+/**
+ * This method prints the time taken to reach each startup milestone.
+ *
+ * @param[in]  aStream  The stream to print to, eg. stderr.
+ *
+ */
+void posixPlatformPrintMilestones(FILE *aStream);
+
+/**
+ * This method maps the shared-memory metrics segment for this NODE_ID, see
+ * posix-metrics.h. It is called by posixPlatformInit, and can be disabled by
+ * setting CASCODA_METRICS=0, in which case metrics are only kept in-process.
+ *
+ */
+void posixPlatformMetricsInit(void);
+
+/**
+ * This method gets the metrics of this process.
+ *
+ */
+const struct posixMetrics *posixPlatformGetMetrics(void);
+
+/**
+ * This method gets how many times a MAC primitive has completed with a raw
+ * MAC status, before it was translated into an otError.
+ *
+ * @param[in]  aPrimitive  The primitive, one of enum posixMacPrimitive.
+ * @param[in]  aStatus     The raw MAC status, eg. MAC_CHANNEL_ACCESS_FAILURE.
+ *
+ */
+uint64_t posixPlatformGetMacStatusCount(int aPrimitive, uint8_t aStatus);
+
+/**
+ * This method registers the platform CLI commands (eg. 'macstats') as CLI
+ * user commands. Call it after otCliUartInit.
+ *
+ * @param[in]  aInstance  The OpenThread instance.
+ *
+ */
+void posixPlatformCliInit(otInstance *aInstance);
+
 /**
  * This method stores the original arguments given to the program
  *
  */
 void posixPlatformSetOrigArgs(int argc, char *argv[]);
 
+/**
+ * This method enables in-process resets. When OpenThread requests a reset (CLI reset,
+ * factory reset...), the instance is finalized and recreated with otInstanceInitSingle
+ * from the main loop, keeping the radio device and flash file open, and @p aHandler is
+ * called so the application can redo its own setup (eg. otCliUartInit). The instance
+ * pointer is unchanged. Without a handler, the process is restarted with execvp instead.
+ *
+ * @param[in]  aHandler  The handler to call after the instance has been recreated, or NULL.
+ * @param[in]  aContext  A context pointer passed to @p aHandler.
+ *
+ */
+void posixPlatformSetResetHandler(posixPlatformResetHandler aHandler, void *aContext);
+
+/**
+ * This method returns whether an in-process reset is waiting to be performed.
+ *
+ */
+bool posixPlatformResetPending(void);
+
+/**
+ * This method performs a pending in-process reset, if any. It is called by
+ * posixPlatformProcessDriversQuick.
+ *
+ */
+void posixPlatformProcessReset(otInstance *aInstance);
+
+/**
+ * This method creates a simulated node, so that one process can host many
+ * OpenThread instances. Each node has its own alarm, settings, random streams,
+ * UART and a radio on an in-process simulated medium shared by all simulated
+ * nodes. Flash and the EUI-64 are kept in memory, so a node costs no device or
+ * files. The instance is created with the node entered, which needs OpenThread
+ * to be built with --enable-multiple-instances:
+ *
+ *     posixPlatformNodeEnter(node);
+ *     posixPlatformNodeSetInstance(node, otInstanceInit(buffer, &size));
+ *
+ * after which the nodes are serviced with posixPlatformProcessNodes.
+ *
+ * @param[in]  aNodeId  The node ID, used for deterministic random streams and logging.
+ *
+ * @returns The new node, or NULL if out of memory.
+ *
+ */
+struct posixNode *posixPlatformNodeCreate(uint32_t aNodeId);
+
+/**
+ * This method frees a simulated node. Its instance must have been finalized,
+ * and no thread may pass it to posixPlatformProcessNodes any more. It waits
+ * for a turn of the node that is still running to end.
+ *
+ */
+void posixPlatformNodeDestroy(struct posixNode *aNode);
+
+/**
+ * This method makes a node the one the calling thread is working on. Platform
+ * functions without an instance argument apply to it, so enter a node before
+ * creating its instance, or before calling the OpenThread API for it from
+ * outside posixPlatformProcessNodes.
+ *
+ * @param[in]  aNode  The node, or NULL for the default node used by posixPlatformInit.
+ *
+ */
+void posixPlatformNodeEnter(struct posixNode *aNode);
+
+/**
+ * This method binds an instance to a node.
+ *
+ */
+void posixPlatformNodeSetInstance(struct posixNode *aNode, otInstance *aInstance);
+
+/**
+ * This method gets the instance bound to a node, or NULL.
+ *
+ */
+otInstance *posixPlatformNodeGetInstance(struct posixNode *aNode);
+
+/**
+ * This method gets the ID of a node.
+ *
+ */
+uint32_t posixPlatformNodeGetId(struct posixNode *aNode);
+
+/**
+ * This method gives a simulated node a UART, eg. one end of a socketpair. By
+ * default simulated nodes have none, and their UART output is dropped. The
+ * descriptors are not closed by the platform.
+ *
+ * @param[in]  aInFd   The descriptor to read UART input from, or -1.
+ * @param[in]  aOutFd  The descriptor to write UART output to, or -1.
+ *
+ */
+void posixPlatformNodeSetUart(struct posixNode *aNode, int aInFd, int aOutFd);
+
+/**
+ * This method sets the handler for resets requested by a simulated node. The
+ * handler is called with the finalized instance, and should recreate it in the
+ * same buffer with otInstanceInit and bind it with posixPlatformNodeSetInstance.
+ * Without a handler, the node stays down after a reset.
+ *
+ */
+void posixPlatformNodeSetResetHandler(struct posixNode *aNode, posixPlatformResetHandler aHandler, void *aContext);
+
+/**
+ * This method sets the link quality (as the LQI of received frames) from one
+ * simulated node to another. A link quality of 0 means @p aTo cannot hear @p aFrom.
+ *
+ * @returns 0 on success, -1 if either node is not simulated or out of memory
+ *
+ */
+int posixPlatformSimSetLinkQuality(struct posixNode *aFrom, struct posixNode *aTo, uint8_t aLinkQuality);
+
+/**
+ * This method sets the link quality between simulated nodes that have none set
+ * with posixPlatformSimSetLinkQuality. It defaults to 0xD0, so every node hears
+ * every other; set it to 0 to build a topology out of explicit links.
+ *
+ */
+void posixPlatformSimSetDefaultLinkQuality(uint8_t aLinkQuality);
+
+/**
+ * This method services a set of simulated nodes: it delivers their radio upcalls,
+ * runs their tasklets, UARTs and alarms, then sleeps until one of them has more
+ * work. Nodes may be split between several threads, each calling this with its
+ * own set.
+ *
+ * @param[in]  aNodes        The nodes serviced by this thread.
+ * @param[in]  aCount        The number of nodes.
+ * @param[in]  aMaxTimeout   The longest time to sleep for, or NULL.
+ *
+ */
+void posixPlatformProcessNodes(struct posixNode *const *aNodes, size_t aCount, const struct timeval *aMaxTimeout);
+
+/**
+ * This method runs the queued tasklets, like otTaskletsProcess, and counts
+ * their time and CPU cost for the tasklets source of posix-sched.h and
+ * posix-perf.h. Tasklets run with otTaskletsProcess itself are not counted.
+ *
+ */
+void posixPlatformTaskletsProcess(otInstance *aInstance);
+
 /**
  * This method performs all platform-specific processing.
  *
@@ -129,18 +386,39 @@ int PlatformRadioInit(void);
  */
 int PlatformRadioInitWithDev(struct ca821x_dev *pDeviceRef);
 
+/**
+ * This method loads the EUI-64 from its file, or generates and stores a new one.
+ * It does not need the device, so posixPlatformInit runs it in parallel with device
+ * bring-up. PlatformRadioInitWithDev calls it if it has not been called yet.
+ *
+ */
+void PlatformRadioLoadEui64(void);
+
 /**
  * This method performs radio driver processing.
  *
  */
 int PlatformRadioProcess(void);
 
+/**
+ * This method gets the device used by the radio, or NULL if the radio is not initialised.
+ *
+ */
+struct ca821x_dev *PlatformRadioGetDevice(void);
+
 /**
  * This method cleanly stops the radio
  *
  */
 void PlatformRadioStop(void);
 
+/**
+ * This method detaches the radio from the current instance and resets the MAC,
+ * keeping the device open, for an in-process reset.
+ *
+ */
+void PlatformRadioReset(void);
+
 /**
  * This method restores the terminal to it's pre-openthread state
  *
@@ -153,6 +431,45 @@ void posixPlatformRestoreTerminal(void);
  */
 void posixPlatformRandomInit(void);
 
+/**
+ * This method makes otPlatRandomGet deterministic, seeded from @p aSeed and NODE_ID,
+ * so that benchmark and simulation runs can be reproduced exactly. It can also be
+ * enabled by setting the CASCODA_RANDOM_SEED environment variable. Call it before
+ * posixPlatformInit for the EUI-64 to be deterministic too.
+ *
+ * @param[in]  aSeed  The seed shared by all nodes of a run.
+ *
+ */
+void posixPlatformRandomSetSeed(uint32_t aSeed);
+
+/**
+ * This method also makes otPlatRandomGetTrue deterministic once a seed has been set,
+ * which can also be enabled with CASCODA_RANDOM_SEED_TRUE=1. This makes all
+ * cryptographic material predictable, so must never be used outside of testing.
+ *
+ * @param[in]  aEnable  true to make otPlatRandomGetTrue deterministic.
+ *
+ */
+void posixPlatformRandomSetTrueDeterministic(bool aEnable);
+
+/**
+ * This method submits a top up of the hardware entropy pool from the radio's random
+ * number generator, a small batch at a time, to a refill thread of its own.
+ * The pool is mixed into the host CSPRNG once full. It is called by posixPlatformSleep
+ * just before sleeping, and does nothing unless the sleep is long enough that the
+ * exchanges won't compete with radio traffic, or a top up is still running.
+ *
+ * @param[in]  aTimeout  The time the caller is about to sleep for.
+ *
+ */
+void posixPlatformRandomProcess(struct timeval *aTimeout);
+
+/**
+ * This method gets the number of hardware random bytes mixed into the host CSPRNG so far.
+ *
+ */
+uint32_t posixPlatformRandomGetHwEntropyMixed(void);
+
 /**
  * This method updates the file descriptor sets with file descriptors used by the serial driver.
  *
@@ -169,6 +486,40 @@ void platformUartUpdateFdSet(fd_set *aReadFdSet, fd_set *aWriteFdSet, int *aMaxF
  */
 void platformUartProcess(void);
 
+/**
+ * This method drops any transmission in progress, for an in-process reset.
+ *
+ */
+void platformUartReset(void);
+
+/**
+ * This method adds the descriptors that tasks are waiting for to the fd sets,
+ * and shortens the timeout to the earliest task deadline, or to zero if a task
+ * is ready to run. See posix-task.h.
+ *
+ */
+void platformTaskUpdateFdSet(fd_set *aReadFdSet, fd_set *aWriteFdSet, int *aMaxFd, struct timeval *aTimeout);
+
+/**
+ * This method makes the tasks whose descriptors are set in the result of
+ * select ready to run.
+ *
+ */
+void platformTaskSelected(const fd_set *aReadFdSet, const fd_set *aWriteFdSet);
+
+/**
+ * This method runs the tasks that are ready, or whose timeout has expired.
+ *
+ */
+void platformTaskProcess(void);
+
+/**
+ * This method runs the done functions of the work finished by the worker
+ * pool. See posix-worker.h.
+ *
+ */
+void platformWorkersProcess(void);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the work budgets of the platform loop.
+ *
+ * Each pass of the platform loop gives every source of work a turn. A flood
+ * from one source would otherwise hold up the others for as long as it
+ * lasts, and radio upcalls, which wait for the loop, would be delayed the
+ * most. So each source has a budget:
+ *
+ * - mItems is the most work items a source runs in one turn: radio upcalls,
+ *   reads of UART input, packets read from the network interface, datagrams
+ *   from local clients, worker done functions or task resumes. 0 is unlimited.
+ * - mSliceUs is the most time a source runs in one turn. It is checked
+ *   between items, so a single long item still runs to completion, and is
+ *   counted as an overrun. 0 is unlimited.
+ * - mDeadlineUs is the longest work should wait to run. Work that waits
+ *   longer is counted as starved: a radio upcall waiting for the loop, an
+ *   alarm firing late, or work left behind by a source that ran out of
+ *   budget. 0 disables the check.
+ *
+ * The platform only watches application descriptors for tasks waiting in
+ * posixTaskWaitFd (see posix-task.h), so the tasks budget covers them.
+ *
+ * A source that runs out of budget with work left yields, and the loop
+ * doesn't sleep before its next turn. This is kept for each node, so a loop
+ * servicing several nodes doesn't sleep while any of them has work left. The radio also gets a turn between
+ * each of the other sources, so its latency is bounded by the longest slice
+ * rather than by the whole pass.
+ *
+ * Tasklets are run by the application with posixPlatformTaskletsProcess, and
+ * OpenThread runs all those that are queued at once, so they are only timed,
+ * as are alarms. A UART read is
+ * at most CASCODA_UART_RX_BUFFER_SIZE bytes. The counters are in the metrics
+ * segment, see posix-metrics.h.
+ *
+ * | Source   | Items | Slice  | Deadline |
+ * |----------|-------|--------|----------|
+ * | radio    | 8     | 2ms    | 5ms      |
+ * | uart     | 4     | 2ms    | -        |
+ * | alarm    | -     | 2ms    | 5ms      |
+ * | tasklets | -     | 10ms   | -        |
+ * | netif    | 32    | 2ms    | 20ms     |
+ * | ipc      | 64    | 2ms    | -        |
+ * | workers  | 16    | 2ms    | 20ms     |
+ * | tasks    | 16    | 5ms    | 20ms     |
+ */
+
+#ifndef POSIX_SCHED_H_
+#define POSIX_SCHED_H_
+
+#include <stdint.h>
+
+#include "ca821x-posix-thread/posix-metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * This structure is the budget of a source of work, see above.
+ *
+ */
+struct posixSchedBudget
+{
+    uint32_t mItems;      ///< Work items per turn, or 0 for unlimited
+    uint32_t mSliceUs;    ///< Time per turn, or 0 for unlimited
+    uint32_t mDeadlineUs; ///< Longest wait before work is counted as starved, or 0
+};
+
+/**
+ * This function sets the budget of a source of work, for all nodes. It takes
+ * effect from the next turn of the source.
+ *
+ * @param[in]  aSource  The source.
+ * @param[in]  aBudget  The budget.
+ *
+ * @retval 0   The budget is set.
+ * @retval -1  @p aSource is not a source.
+ *
+ */
+int posixPlatformSchedSetBudget(enum posixSchedSource aSource, const struct posixSchedBudget *aBudget);
+
+/**
+ * This function gets the budget of a source of work.
+ *
+ * @retval 0   @p aBudget is set.
+ * @retval -1  @p aSource is not a source.
+ *
+ */
+int posixPlatformSchedGetBudget(enum posixSchedSource aSource, struct posixSchedBudget *aBudget);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_SCHED_H_
@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines cooperative tasks for application code.
+ *
+ * A task is a function with its own stack, run by the platform loop on the
+ * thread that calls posixPlatformProcessDrivers (or the Quick, GetTimeout and
+ * Sleep functions). It runs until it waits for something, then the loop
+ * carries on with the stack and the other tasks. A task can wait for a time
+ * to pass, for a file descriptor to become ready, or for a posixTaskEvent to
+ * be signalled, eg. by an OpenThread callback. As tasks only ever run on the
+ * OpenThread thread and only switch while waiting, they may call the
+ * OpenThread API freely, without taking locks.
+ *
+ * The wait functions must only be called from a task. Tasks must not call
+ * posixPlatformProcessDrivers or the functions it is made of.
+ */
+
+#ifndef POSIX_TASK_H_
+#define POSIX_TASK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_TASK_STACK_SIZE_DEFAULT (64 * 1024)
+#define POSIX_TASK_WAIT_FOREVER       UINT32_MAX ///< Timeout that never expires
+
+enum posixTaskFdEvent
+{
+    POSIX_TASK_FD_READ  = 1 << 0,
+    POSIX_TASK_FD_WRITE = 1 << 1,
+};
+
+struct posixTask;
+
+/**
+ * The body of a task. The task ends when it returns.
+ *
+ */
+typedef void (*posixTaskFunction)(void *aContext);
+
+/**
+ * Something a task can wait for, usually the completion of an OpenThread
+ * operation. Signalling it wakes every task waiting for it. If no task is
+ * waiting, the signal is kept for the next one that waits.
+ *
+ * Initialise with posixTaskEventInit, or to all zeros.
+ *
+ */
+struct posixTaskEvent
+{
+    bool mSignalled;
+    int  mResult; ///< Value passed to posixTaskEventSignal, eg. an otError
+};
+
+/**
+ * This function creates a task, which starts running on the next pass of the
+ * platform loop. The task is freed when its function returns, so the returned
+ * handle is only valid until then.
+ *
+ * @param[in]  aFunction   The body of the task.
+ * @param[in]  aContext    Passed to aFunction.
+ * @param[in]  aStackSize  Stack size in bytes, or 0 for POSIX_TASK_STACK_SIZE_DEFAULT.
+ *
+ * @returns The new task, or NULL if it could not be allocated.
+ *
+ */
+struct posixTask *posixTaskCreate(posixTaskFunction aFunction, void *aContext, size_t aStackSize);
+
+/**
+ * This function returns the task that is running, or NULL outside of a task.
+ *
+ */
+struct posixTask *posixTaskCurrent(void);
+
+/**
+ * This function lets the platform loop and the other tasks run, and carries on
+ * with the current task on the next pass of the loop.
+ *
+ */
+void posixTaskYield(void);
+
+/**
+ * This function suspends the current task for at least aMilliseconds.
+ *
+ */
+void posixTaskSleep(uint32_t aMilliseconds);
+
+/**
+ * This function suspends the current task until a file descriptor is ready.
+ *
+ * @param[in]  aFd       The file descriptor.
+ * @param[in]  aEvents   POSIX_TASK_FD_READ and/or POSIX_TASK_FD_WRITE.
+ * @param[in]  aTimeout  Timeout in milliseconds, or POSIX_TASK_WAIT_FOREVER.
+ *
+ * @returns The events that are ready, or 0 on timeout.
+ *
+ */
+int posixTaskWaitFd(int aFd, int aEvents, uint32_t aTimeout);
+
+/**
+ * This function initialises an event as not signalled.
+ *
+ */
+void posixTaskEventInit(struct posixTaskEvent *aEvent);
+
+/**
+ * This function signals an event, and wakes the tasks waiting for it. It must
+ * be called on the OpenThread thread, which is where OpenThread callbacks run.
+ *
+ * @param[in]  aEvent   The event.
+ * @param[in]  aResult  Stored in the event's mResult, for the waiting tasks.
+ *
+ */
+void posixTaskEventSignal(struct posixTaskEvent *aEvent, int aResult);
+
+/**
+ * This function suspends the current task until an event is signalled, and
+ * clears the signal.
+ *
+ * @param[in]  aEvent    The event.
+ * @param[in]  aTimeout  Timeout in milliseconds, or POSIX_TASK_WAIT_FOREVER.
+ *
+ * @retval 0   The event was signalled, its mResult is valid.
+ * @retval -1  The timeout expired first.
+ *
+ */
+int posixTaskEventWait(struct posixTaskEvent *aEvent, uint32_t aTimeout);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_TASK_H_
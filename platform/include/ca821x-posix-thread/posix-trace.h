@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the frame trace format, used to follow frames across nodes.
+ *
+ * When CASCODA_TRACE names a file, every node appends a record to it for each
+ * frame it sends, each send confirm and each frame it receives. Several
+ * processes may append to the same file, as records are written whole, and
+ * the nodes of one process are told apart by their node ID. Times are
+ * CLOCK_MONOTONIC, so the records of processes on one machine line up
+ * directly. Each node starts with a POSIX_TRACE_CLOCK record, which ties its
+ * clock to the wall clock and to the boot of its machine, so that traces
+ * from several machines can be aligned too.
+ *
+ * The DSN of a sent frame is read back from the MAC, and the source address
+ * is the one last given to the MAC. ca821x-trace-merge matches each received
+ * frame to the frame sent with the same source address and DSN, and writes a
+ * single timeline with the latency of each hop.
+ *
+ * Tracing costs a PIB read for each frame sent, so it is meant for debugging.
+ * While CASCODA_TRACE is unset, nothing is recorded.
+ */
+
+#ifndef POSIX_TRACE_H_
+#define POSIX_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_TRACE_ENV "CASCODA_TRACE" ///< File that records are appended to
+
+enum posixTraceType
+{
+    POSIX_TRACE_CLOCK   = 1, ///< mMsdu is a posixTraceClock
+    POSIX_TRACE_TX      = 2, ///< A data request accepted by the MAC, mStatus is the TX options
+    POSIX_TRACE_TX_DONE = 3, ///< A data confirm, mStatus is the MAC status
+    POSIX_TRACE_RX      = 4, ///< A data indication, mStatus is the link quality
+};
+
+/**
+ * An 802.15.4 address, laid out as in the ca821x-api.
+ *
+ */
+struct posixTraceAddress
+{
+    uint8_t mMode;       ///< 0 none, 2 short, 3 extended
+    uint8_t mPanId[2];   ///< Little endian
+    uint8_t mAddress[8]; ///< Little endian, the first two bytes of a short address
+};
+
+/**
+ * A trace record, followed by mMsduLength bytes of MSDU. Readers skip mLength
+ * bytes from the start of each record, so records may grow at the end.
+ *
+ */
+struct posixTraceRecord
+{
+    uint16_t                 mLength;     ///< Length of the record, MSDU included
+    uint8_t                  mType;       ///< posixTraceType
+    uint8_t                  mDsn;
+    uint32_t                 mNodeId;
+    uint64_t                 mTimeNs;     ///< CLOCK_MONOTONIC
+    struct posixTraceAddress mSrc;
+    struct posixTraceAddress mDst;
+    uint8_t                  mMsduHandle;
+    uint8_t                  mStatus;
+    uint8_t                  mMsduLength;
+    uint8_t                  mReserved;
+    uint8_t                  mMsdu[];
+};
+
+/**
+ * The MSDU of a POSIX_TRACE_CLOCK record.
+ *
+ */
+struct posixTraceClock
+{
+    uint64_t mRealTimeNs; ///< CLOCK_REALTIME at the same moment as mTimeNs
+    uint8_t  mBootId[16]; ///< The boot ID of the machine, all nodes with the same one share a monotonic clock
+};
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_TRACE_H_
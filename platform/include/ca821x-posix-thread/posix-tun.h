@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the native network interface, which needs no wpantund.
+ *
+ * posixPlatformTunOpen creates a Linux TUN interface for an instance, and
+ * moves IPv6 packets between it and the instance directly, with otIp6Send
+ * and the IPv6 receive callback. The interface is brought up with an MTU of
+ * 1280, and follows the unicast addresses of the instance. Thread control
+ * traffic stays inside the stack. Creating the interface needs
+ * CAP_NET_ADMIN, eg. root or a network namespace of one's own
+ * ("unshare -rn").
+ *
+ * The interface is serviced by the platform loop, which reads and writes a
+ * batch of packets per pass. Its counters are in the metrics segment, see
+ * posix-metrics.h.
+ */
+
+#ifndef POSIX_TUN_H_
+#define POSIX_TUN_H_
+
+#include "openthread/instance.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_TUN_ENV "CASCODA_TUN" ///< Interface name, for the example applications to create one
+
+/**
+ * This function creates the network interface of an instance. It stays bound
+ * to the node of the instance across an in-process reset.
+ *
+ * @param[in]  aInstance  The instance.
+ * @param[in]  aName      The interface name, or NULL for "wpan%d".
+ *
+ * @retval 0   The interface is up.
+ * @retval -1  It could not be created, errno is set.
+ *
+ */
+int posixPlatformTunOpen(otInstance *aInstance, const char *aName);
+
+/**
+ * This function removes the network interface of an instance, if it has one.
+ *
+ */
+void posixPlatformTunClose(otInstance *aInstance);
+
+/**
+ * This function gets the name of the network interface of an instance, or
+ * NULL if it has none.
+ *
+ */
+const char *posixPlatformTunGetName(otInstance *aInstance);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_TUN_H_
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the worker pool, for work too slow for the OpenThread thread.
+ *
+ * A handler running on the OpenThread thread, such as a CoAP or UDP handler,
+ * holds up radio processing for as long as it runs. Expensive parts of it,
+ * such as parsing, crypto or database writes, can instead be submitted as a
+ * struct posixWork. A worker thread runs its function, and its done function
+ * is then run on the OpenThread thread, from the platform loop. Only the done
+ * function may use the OpenThread API.
+ *
+ * Finished work is handed back on a lock-free queue, so workers never block
+ * the OpenThread thread. The pool publishes its counters in the metrics
+ * segment (see posix-metrics.h), from which the queue depths follow:
+ * submitted - started are waiting for a worker, started - finished are being
+ * run, and finished - completed are waiting for the OpenThread thread.
+ */
+
+#ifndef POSIX_WORKER_H_
+#define POSIX_WORKER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSIX_WORKERS_ENV "CASCODA_WORKERS" ///< Number of worker threads, if not given to posixPlatformWorkersStart
+
+typedef void (*posixWorkFunction)(void *aContext);
+
+/**
+ * A piece of work. It is owned by the caller, and must stay valid from
+ * posixPlatformWorkSubmit until its done function has been called.
+ *
+ */
+struct posixWork
+{
+    struct posixWork *mNext;     ///< Used by the pool
+    posixWorkFunction mFunction; ///< Run on a worker thread
+    posixWorkFunction mDone;     ///< Run on the OpenThread thread afterwards, may be NULL
+    void             *mContext;  ///< Passed to both
+};
+
+/**
+ * This function starts the worker threads. It is called with 0 by the first
+ * posixPlatformWorkSubmit if the pool has not been started.
+ *
+ * @param[in]  aThreads  The number of threads, or 0 for CASCODA_WORKERS if
+ *                       set, otherwise one per online CPU.
+ *
+ * @retval 0   The pool is running, possibly with fewer threads if some could not be created.
+ * @retval -1  No thread could be created.
+ *
+ */
+int posixPlatformWorkersStart(unsigned int aThreads);
+
+/**
+ * This function stops the worker threads, after they have run all submitted
+ * work. Done functions that have not run yet still run from the platform loop.
+ *
+ */
+void posixPlatformWorkersStop(void);
+
+/**
+ * This function submits work to the pool. It may be called from any thread
+ * once the pool has been started, otherwise only from the OpenThread thread.
+ *
+ * @param[in]  aWork      The work, which must stay valid until its done function has run.
+ * @param[in]  aFunction  Run on a worker thread.
+ * @param[in]  aDone      Run on the OpenThread thread afterwards, may be NULL.
+ * @param[in]  aContext   Passed to both.
+ *
+ * @retval 0   The work is queued.
+ * @retval -1  The pool could not be started.
+ *
+ */
+int posixPlatformWorkSubmit(struct posixWork *aWork, posixWorkFunction aFunction, posixWorkFunction aDone, void *aContext);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // POSIX_WORKER_H_
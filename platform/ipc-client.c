@@ -0,0 +1,263 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the client side of the shared-memory packet
+ *   interface, see posix-ipc.h. It does not depend on OpenThread or the
+ *   platform, so local clients only link this.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ca821x-posix-thread/posix-ipc.h"
+
+struct posixIpcClient
+{
+	int                    mSocket;
+	int                    mToStackFd;
+	int                    mFromStackFd;
+	struct posixIpcShared *mShared;
+	uint32_t               mSendTaken;    //Slots handed out by SendBegin, not committed yet
+	uint32_t               mReceiveTaken; //Slots handed out by Receive, not released yet
+};
+
+//Receives the greeting, and the segment and doorbells that come with it
+static int receiveGreeting(struct posixIpcClient *aClient)
+{
+	struct posixIpcResponse response;
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        buf[CMSG_SPACE(3 * sizeof(int))];
+	} control;
+	struct iovec iov = {&response, sizeof(response)};
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg = NULL;
+	int fds[3];
+	void *shared;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	if (recvmsg(aClient->mSocket, &msg, MSG_CMSG_CLOEXEC) != sizeof(response))
+		return -1;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	aClient->mToStackFd = fds[1];
+	aClient->mFromStackFd = fds[2];
+
+	shared = mmap(NULL, sizeof(*aClient->mShared), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	close(fds[0]);
+	if (shared == MAP_FAILED)
+		return -1;
+	aClient->mShared = shared;
+
+	if (response.mStatus != 0 || __atomic_load_n(&aClient->mShared->mMagic, __ATOMIC_ACQUIRE) != POSIX_IPC_MAGIC ||
+	    aClient->mShared->mVersion != POSIX_IPC_VERSION || aClient->mShared->mSize != sizeof(*aClient->mShared))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+
+	return 0;
+}
+
+struct posixIpcClient *posixIpcClientConnect(const char *aSocketPath)
+{
+	struct posixIpcClient *client = calloc(1, sizeof(*client));
+	struct sockaddr_un addr = {0};
+	int error;
+
+	if (client == NULL)
+		return NULL;
+
+	client->mToStackFd = -1;
+	client->mFromStackFd = -1;
+
+	if (strlen(aSocketPath) >= sizeof(addr.sun_path))
+	{
+		free(client);
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, aSocketPath);
+
+	client->mSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (client->mSocket < 0 || connect(client->mSocket, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    receiveGreeting(client) < 0)
+	{
+		error = errno;
+		posixIpcClientClose(client);
+		errno = error;
+		return NULL;
+	}
+
+	return client;
+}
+
+void posixIpcClientClose(struct posixIpcClient *aClient)
+{
+	if (aClient == NULL)
+		return;
+
+	if (aClient->mShared != NULL)
+		munmap(aClient->mShared, sizeof(*aClient->mShared));
+	if (aClient->mToStackFd >= 0)
+		close(aClient->mToStackFd);
+	if (aClient->mFromStackFd >= 0)
+		close(aClient->mFromStackFd);
+	if (aClient->mSocket >= 0)
+		close(aClient->mSocket);
+	free(aClient);
+}
+
+static int request(struct posixIpcClient *aClient, enum posixIpcOperation aOperation, uint16_t aPort)
+{
+	struct posixIpcRequest request = {aOperation, aPort, 0};
+	struct posixIpcResponse response;
+
+	if (send(aClient->mSocket, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request) ||
+	    recv(aClient->mSocket, &response, sizeof(response), 0) != sizeof(response))
+	{
+		errno = (errno == 0) ? EPIPE : errno;
+		return -1;
+	}
+
+	if (response.mStatus < 0)
+	{
+		errno = -response.mStatus;
+		return -1;
+	}
+
+	return 0;
+}
+
+int posixIpcClientBind(struct posixIpcClient *aClient, uint16_t aPort)
+{
+	return request(aClient, POSIX_IPC_BIND, aPort);
+}
+
+int posixIpcClientUnbind(struct posixIpcClient *aClient, uint16_t aPort)
+{
+	return request(aClient, POSIX_IPC_UNBIND, aPort);
+}
+
+struct posixIpcDatagram *posixIpcClientSendBegin(struct posixIpcClient *aClient)
+{
+	struct posixIpcRing *ring = &aClient->mShared->mToStack;
+	uint32_t slot = ring->mHead + aClient->mSendTaken;
+
+	if (slot - __atomic_load_n(&ring->mTail, __ATOMIC_ACQUIRE) >= POSIX_IPC_SLOTS)
+		return NULL;
+
+	aClient->mSendTaken++;
+	return &ring->mSlots[slot % POSIX_IPC_SLOTS];
+}
+
+void posixIpcClientSendCommit(struct posixIpcClient *aClient)
+{
+	struct posixIpcRing *ring = &aClient->mShared->mToStack;
+	uint64_t one = 1;
+
+	if (aClient->mSendTaken == 0)
+		return;
+
+	__atomic_store_n(&ring->mHead, ring->mHead + aClient->mSendTaken, __ATOMIC_RELEASE);
+	aClient->mSendTaken = 0;
+	(void)write(aClient->mToStackFd, &one, sizeof(one));
+}
+
+const struct posixIpcDatagram *posixIpcClientReceive(struct posixIpcClient *aClient)
+{
+	struct posixIpcRing *ring = &aClient->mShared->mFromStack;
+	uint32_t slot = ring->mTail + aClient->mReceiveTaken;
+
+	if (slot == __atomic_load_n(&ring->mHead, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	aClient->mReceiveTaken++;
+	return &ring->mSlots[slot % POSIX_IPC_SLOTS];
+}
+
+void posixIpcClientReceiveDone(struct posixIpcClient *aClient)
+{
+	struct posixIpcRing *ring = &aClient->mShared->mFromStack;
+
+	__atomic_store_n(&ring->mTail, ring->mTail + aClient->mReceiveTaken, __ATOMIC_RELEASE);
+	aClient->mReceiveTaken = 0;
+}
+
+int posixIpcClientWait(struct posixIpcClient *aClient, int aTimeoutMs)
+{
+	struct posixIpcRing *ring = &aClient->mShared->mFromStack;
+	struct pollfd fds[2] = {{aClient->mFromStackFd, POLLIN, 0}, {aClient->mSocket, POLLIN, 0}};
+	uint64_t doorbells;
+
+	while (ring->mTail + aClient->mReceiveTaken == __atomic_load_n(&ring->mHead, __ATOMIC_ACQUIRE))
+	{
+		int rval = poll(fds, 2, aTimeoutMs);
+
+		if (rval < 0 && errno == EINTR)
+			continue;
+		//The socket only becomes readable when the server goes away, as requests are synchronous
+		if (rval <= 0 || (fds[1].revents & (POLLIN | POLLHUP)))
+			return -1;
+
+		(void)read(aClient->mFromStackFd, &doorbells, sizeof(doorbells));
+	}
+
+	return 0;
+}
+
+int posixIpcClientGetFd(const struct posixIpcClient *aClient)
+{
+	return aClient->mFromStackFd;
+}
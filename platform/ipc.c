@@ -0,0 +1,539 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the shared-memory packet interface, see posix-ipc.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "openthread/instance.h"
+#include "openthread/message.h"
+#include "openthread/udp.h"
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-ipc.h"
+#include "ipc.h"
+#include "metrics.h"
+#include "node.h"
+#include "scheduler.h"
+
+struct ipcClient;
+
+struct ipcPort
+{
+	struct ipcClient *mClient;
+	uint16_t          mPort;   //0 when unused
+	bool              mOpen;   //mSocket is open in the current instance
+	otUdpSocket       mSocket;
+};
+
+struct ipcClient
+{
+	struct ipcClient      *mNext;
+	struct posixIpc       *mServer;
+	int                    mSocket;
+	int                    mToStackFd;
+	int                    mFromStackFd;
+	struct posixIpcShared *mShared;
+	bool                   mRing;   //Datagrams were queued for the client since the last doorbell
+	struct ipcPort         mPorts[POSIX_IPC_MAX_PORTS];
+};
+
+struct posixIpc
+{
+	int               mListenFd;
+	otInstance       *mInstance; //Instance the ports are open in, NULL after a reset
+	struct ipcClient *mClients;
+	char              mPath[sizeof(((struct sockaddr_un *)0)->sun_path)];
+};
+
+//Runs on the node's thread, from within the stack. The doorbell is rung by the next loop pass.
+static void handleUdpReceive(void *aContext, otMessage *aMessage, const otMessageInfo *aMessageInfo)
+{
+	struct ipcPort *port = aContext;
+	struct posixIpcRing *ring = &port->mClient->mShared->mFromStack;
+	uint32_t head = ring->mHead;
+	uint16_t offset = otMessageGetOffset(aMessage);
+	uint16_t length = otMessageGetLength(aMessage) - offset;
+	struct posixIpcDatagram *datagram;
+
+	if (head - __atomic_load_n(&ring->mTail, __ATOMIC_ACQUIRE) >= POSIX_IPC_SLOTS || length > POSIX_IPC_MAX_PAYLOAD)
+	{
+		METRICS_INC(mIpcDrops);
+		return;
+	}
+
+	datagram = &ring->mSlots[head % POSIX_IPC_SLOTS];
+	memcpy(datagram->mPeerAddress, &aMessageInfo->mPeerAddr, sizeof(datagram->mPeerAddress));
+	datagram->mPeerPort = aMessageInfo->mPeerPort;
+	datagram->mLocalPort = port->mPort;
+	datagram->mHopLimit = aMessageInfo->mHopLimit;
+	datagram->mLength = otMessageRead(aMessage, offset, datagram->mPayload, length);
+
+	__atomic_store_n(&ring->mHead, head + 1, __ATOMIC_RELEASE);
+	port->mClient->mRing = true;
+	METRICS_INC(mIpcFromThread);
+}
+
+static otError portOpen(struct ipcPort *aPort, otInstance *aInstance)
+{
+	otSockAddr sockName;
+	otError error;
+
+	memset(&sockName, 0, sizeof(sockName));
+	sockName.mPort = aPort->mPort;
+
+	error = otUdpOpen(aInstance, &aPort->mSocket, handleUdpReceive, aPort);
+	if (error == OT_ERROR_NONE && (error = otUdpBind(&aPort->mSocket, &sockName)) != OT_ERROR_NONE)
+		otUdpClose(&aPort->mSocket);
+
+	aPort->mOpen = (error == OT_ERROR_NONE);
+	return error;
+}
+
+static void portClose(struct ipcPort *aPort)
+{
+	if (aPort->mOpen)
+		otUdpClose(&aPort->mSocket);
+
+	aPort->mOpen = false;
+	aPort->mPort = 0;
+}
+
+static struct ipcPort *findPort(struct posixIpc *aServer, uint16_t aPort)
+{
+	for (struct ipcClient *client = aServer->mClients; client != NULL; client = client->mNext)
+	{
+		for (int i = 0; i < POSIX_IPC_MAX_PORTS; i++)
+		{
+			if (client->mPorts[i].mPort == aPort)
+				return &client->mPorts[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int32_t handleRequest(struct ipcClient *aClient, const struct posixIpcRequest *aRequest)
+{
+	struct posixIpc *server = aClient->mServer;
+	struct ipcPort *port = (aRequest->mPort != 0) ? findPort(server, aRequest->mPort) : NULL;
+
+	if (aRequest->mPort == 0)
+		return -EINVAL;
+
+	switch (aRequest->mOperation)
+	{
+	case POSIX_IPC_BIND:
+		if (port != NULL)
+			return (port->mClient == aClient) ? 0 : -EADDRINUSE;
+
+		for (int i = 0; i < POSIX_IPC_MAX_PORTS && port == NULL; i++)
+		{
+			if (aClient->mPorts[i].mPort == 0)
+				port = &aClient->mPorts[i];
+		}
+		if (port == NULL)
+			return -ENOSPC;
+
+		port->mPort = aRequest->mPort;
+		if (server->mInstance != NULL && portOpen(port, server->mInstance) != OT_ERROR_NONE)
+		{
+			port->mPort = 0;
+			return -EADDRINUSE;
+		}
+		return 0;
+
+	case POSIX_IPC_UNBIND:
+		if (port == NULL || port->mClient != aClient)
+			return -ENOENT;
+
+		portClose(port);
+		return 0;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+static void clientFree(struct ipcClient *aClient)
+{
+	for (int i = 0; i < POSIX_IPC_MAX_PORTS; i++)
+		portClose(&aClient->mPorts[i]);
+
+	if (aClient->mShared != NULL)
+		munmap(aClient->mShared, sizeof(*aClient->mShared));
+	if (aClient->mToStackFd >= 0)
+		close(aClient->mToStackFd);
+	if (aClient->mFromStackFd >= 0)
+		close(aClient->mFromStackFd);
+	close(aClient->mSocket);
+	free(aClient);
+}
+
+static void acceptClient(struct posixIpc *aServer, int aSocket)
+{
+	struct ipcClient *client = calloc(1, sizeof(*client));
+	struct posixIpcResponse response = {0};
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        buf[CMSG_SPACE(3 * sizeof(int))];
+	} control;
+	struct iovec iov = {&response, sizeof(response)};
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	int memFd = -1;
+
+	if (client == NULL)
+	{
+		close(aSocket);
+		return;
+	}
+
+	client->mServer = aServer;
+	client->mSocket = aSocket;
+	client->mToStackFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	client->mFromStackFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	for (int i = 0; i < POSIX_IPC_MAX_PORTS; i++)
+		client->mPorts[i].mClient = client;
+
+	memFd = memfd_create("ca821x-ipc", MFD_CLOEXEC);
+	if (memFd < 0 || client->mToStackFd < 0 || client->mFromStackFd < 0 ||
+	    ftruncate(memFd, sizeof(*client->mShared)) < 0)
+		goto fail;
+
+	client->mShared = mmap(NULL, sizeof(*client->mShared), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+	if (client->mShared == MAP_FAILED)
+	{
+		client->mShared = NULL;
+		goto fail;
+	}
+
+	client->mShared->mVersion = POSIX_IPC_VERSION;
+	client->mShared->mSize = sizeof(*client->mShared);
+	client->mShared->mNodeId = NODE_ID;
+	__atomic_store_n(&client->mShared->mMagic, POSIX_IPC_MAGIC, __ATOMIC_RELEASE);
+
+	memset(&control, 0, sizeof(control));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), (int[]){memFd, client->mToStackFd, client->mFromStackFd}, 3 * sizeof(int));
+
+	if (sendmsg(aSocket, &msg, MSG_NOSIGNAL) != sizeof(response))
+		goto fail;
+
+	close(memFd);
+	client->mNext = aServer->mClients;
+	aServer->mClients = client;
+	METRICS_INC(mIpcClients);
+	return;
+
+fail:
+	if (memFd >= 0)
+		close(memFd);
+	clientFree(client);
+}
+
+//Returns false once the client has gone away. Sets aMore if datagrams are left for the next turn.
+static bool serviceClient(struct posixIpc *aServer, struct ipcClient *aClient, otInstance *aInstance,
+                          struct platformSchedSlice *aSlice, bool *aMore)
+{
+	struct posixIpcRing *ring = &aClient->mShared->mToStack;
+	struct posixIpcRequest request;
+	struct posixIpcResponse response;
+	uint64_t doorbells;
+	uint32_t head;
+	uint32_t tail = ring->mTail;
+	ssize_t rval;
+
+	while ((rval = recv(aClient->mSocket, &request, sizeof(request), MSG_DONTWAIT)) != 0)
+	{
+		if (rval < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				break;
+			return false;
+		}
+
+		response.mStatus = (rval == sizeof(request)) ? handleRequest(aClient, &request) : -EINVAL;
+		if (send(aClient->mSocket, &response, sizeof(response), MSG_NOSIGNAL | MSG_DONTWAIT) != sizeof(response))
+			return false;
+	}
+
+	if (rval == 0)
+		return false;
+
+	(void)read(aClient->mToStackFd, &doorbells, sizeof(doorbells));
+	head = __atomic_load_n(&ring->mHead, __ATOMIC_ACQUIRE);
+
+	//Each datagram is an item, those past the budget are sent next turn
+	for (; tail != head && head - tail <= POSIX_IPC_SLOTS && platformSchedNext(aSlice); tail++)
+	{
+		const struct posixIpcDatagram *datagram = &ring->mSlots[tail % POSIX_IPC_SLOTS];
+		//The client can still write the slot, so what is checked is read once and only that is used
+		uint16_t length = __atomic_load_n(&datagram->mLength, __ATOMIC_RELAXED);
+		uint16_t localPort = __atomic_load_n(&datagram->mLocalPort, __ATOMIC_RELAXED);
+		struct ipcPort *port = findPort(aServer, localPort);
+		otMessageInfo messageInfo;
+		otMessage *message;
+		otError error = OT_ERROR_NO_BUFS;
+
+		//Clients may only send from their own ports
+		if (port == NULL || port->mClient != aClient || !port->mOpen || length > POSIX_IPC_MAX_PAYLOAD)
+		{
+			METRICS_INC(mIpcDrops);
+			continue;
+		}
+
+		memset(&messageInfo, 0, sizeof(messageInfo));
+		memcpy(&messageInfo.mPeerAddr, datagram->mPeerAddress, sizeof(messageInfo.mPeerAddr));
+		messageInfo.mPeerPort = datagram->mPeerPort;
+		messageInfo.mHopLimit = datagram->mHopLimit;
+		messageInfo.mInterfaceId = 1;
+
+		if ((message = otUdpNewMessage(aInstance, true)) != NULL)
+		{
+			error = otMessageAppend(message, datagram->mPayload, length);
+			if (error == OT_ERROR_NONE)
+				error = otUdpSend(&port->mSocket, message, &messageInfo);
+			if (error != OT_ERROR_NONE)
+				otMessageFree(message);
+		}
+
+		if (error == OT_ERROR_NONE)
+			METRICS_INC(mIpcToThread);
+		else
+			METRICS_INC(mIpcDrops);
+		if (error == OT_ERROR_NO_BUFS)
+			METRICS_INC(mMessageAllocFailures);
+	}
+
+	if (tail != head && head - tail <= POSIX_IPC_SLOTS)
+		*aMore = true;
+
+	__atomic_store_n(&ring->mTail, tail, __ATOMIC_RELEASE);
+	return true;
+}
+
+int posixPlatformIpcStart(otInstance *aInstance, const char *aSocketPath)
+{
+	struct posixNode *node = posixNodeFromInstance(aInstance);
+	struct sockaddr_un addr = {0};
+	struct posixIpc *server;
+	int error;
+
+	if (node->mIpc != NULL)
+	{
+		errno = EEXIST;
+		return -1;
+	}
+
+	if (strlen(aSocketPath) >= sizeof(addr.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	server = calloc(1, sizeof(*server));
+	if (server == NULL)
+		return -1;
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, aSocketPath);
+	strcpy(server->mPath, aSocketPath);
+	unlink(aSocketPath);
+
+	server->mListenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (server->mListenFd < 0 || bind(server->mListenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(server->mListenFd, 16) < 0)
+	{
+		error = errno;
+		otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM, "Failed to serve local clients on %s: %s", aSocketPath,
+		          strerror(error));
+		if (server->mListenFd >= 0)
+			close(server->mListenFd);
+		free(server);
+		errno = error;
+		return -1;
+	}
+
+	server->mInstance = aInstance;
+	node->mIpc = server;
+	return 0;
+}
+
+void posixPlatformIpcStop(otInstance *aInstance)
+{
+	struct posixNode *node = posixNodeFromInstance(aInstance);
+	struct posixIpc *server = node->mIpc;
+
+	if (server == NULL)
+		return;
+
+	while (server->mClients != NULL)
+	{
+		struct ipcClient *client = server->mClients;
+
+		server->mClients = client->mNext;
+		clientFree(client);
+	}
+
+	close(server->mListenFd);
+	unlink(server->mPath);
+	node->mIpc = NULL;
+	free(server);
+}
+
+size_t platformIpcFootprint(struct posixNode *aNode)
+{
+	size_t size = 0;
+
+	if (aNode->mIpc != NULL)
+	{
+		size += sizeof(*aNode->mIpc);
+
+		for (struct ipcClient *client = aNode->mIpc->mClients; client != NULL; client = client->mNext)
+			size += sizeof(*client) + sizeof(*client->mShared);
+	}
+
+	return size;
+}
+
+void platformIpcReset(struct posixNode *aNode)
+{
+	struct posixIpc *server = aNode->mIpc;
+
+	if (server == NULL)
+		return;
+
+	//The sockets went with the old instance
+	for (struct ipcClient *client = server->mClients; client != NULL; client = client->mNext)
+	{
+		for (int i = 0; i < POSIX_IPC_MAX_PORTS; i++)
+			client->mPorts[i].mOpen = false;
+	}
+
+	server->mInstance = NULL;
+}
+
+void platformIpcUpdateFdSet(struct posixNode *aNode, fd_set *aReadFdSet, int *aMaxFd)
+{
+	struct posixIpc *server = aNode->mIpc;
+	int maxFd;
+
+	if (server == NULL)
+		return;
+
+	FD_SET(server->mListenFd, aReadFdSet);
+	maxFd = server->mListenFd;
+
+	for (struct ipcClient *client = server->mClients; client != NULL; client = client->mNext)
+	{
+		FD_SET(client->mSocket, aReadFdSet);
+		FD_SET(client->mToStackFd, aReadFdSet);
+		maxFd = (client->mSocket > maxFd) ? client->mSocket : maxFd;
+		maxFd = (client->mToStackFd > maxFd) ? client->mToStackFd : maxFd;
+	}
+
+	if (aMaxFd != NULL && *aMaxFd < maxFd)
+		*aMaxFd = maxFd;
+}
+
+void platformIpcProcess(struct posixNode *aNode, otInstance *aInstance)
+{
+	struct posixIpc *server = aNode->mIpc;
+	struct ipcClient **link;
+	struct platformSchedSlice slice;
+	bool more = false;
+	int fd;
+
+	if (server == NULL || aInstance == NULL)
+		return;
+
+	//The instance was recreated by an in-process reset
+	if (server->mInstance != aInstance)
+	{
+		server->mInstance = aInstance;
+		for (struct ipcClient *client = server->mClients; client != NULL; client = client->mNext)
+		{
+			for (int i = 0; i < POSIX_IPC_MAX_PORTS; i++)
+			{
+				if (client->mPorts[i].mPort != 0 && !client->mPorts[i].mOpen)
+					portOpen(&client->mPorts[i], aInstance);
+			}
+		}
+	}
+
+	while ((fd = accept4(server->mListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+		acceptClient(server, fd);
+
+	platformSchedBegin(&slice, POSIX_SCHED_IPC);
+	for (link = &server->mClients; *link != NULL;)
+	{
+		struct ipcClient *client = *link;
+		uint64_t one = 1;
+
+		if (!serviceClient(server, client, aInstance, &slice, &more))
+		{
+			*link = client->mNext;
+			clientFree(client);
+			continue;
+		}
+
+		if (client->mRing)
+		{
+			client->mRing = false;
+			(void)write(client->mFromStackFd, &one, sizeof(one));
+		}
+
+		link = &client->mNext;
+	}
+	platformSchedEnd(&slice, more);
+}
@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform loop to service the
+ *   local clients of a node, see posix-ipc.h.
+ */
+
+#ifndef PLATFORM_IPC_H_
+#define PLATFORM_IPC_H_
+
+#include <sys/select.h>
+#include <stddef.h>
+
+#include "openthread/instance.h"
+#include "node.h"
+
+/**
+ * This method gets the memory used by a node's local clients, the
+ * shared-memory segments included.
+ *
+ */
+size_t platformIpcFootprint(struct posixNode *aNode);
+
+/**
+ * This method forgets the UDP sockets of a node's local clients, which are
+ * reopened in the new instance by the next platformIpcProcess.
+ *
+ */
+void platformIpcReset(struct posixNode *aNode);
+
+/**
+ * This method adds the descriptors of a node's local clients to the fd set.
+ *
+ */
+void platformIpcUpdateFdSet(struct posixNode *aNode, fd_set *aReadFdSet, int *aMaxFd);
+
+/**
+ * This method accepts new local clients, handles their requests, sends what
+ * they queued within the IPC budget, and rings the doorbells of those that
+ * received datagrams.
+ *
+ */
+void platformIpcProcess(struct posixNode *aNode, otInstance *aInstance);
+
+#endif /* PLATFORM_IPC_H_ */
@@ -37,6 +37,7 @@
 
 #include "openthread/platform/logging.h"
 #include "code_utils.h"
+#include "metrics.h"
 #include "openthread-core-config.h"
 
 // Macro to append content to end of the log string.
@@ -50,6 +51,7 @@
 void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat, ...)
 {
     struct timeval tv;
+    struct tm tm;
     char timeString[40];
     char logString[512];
     unsigned int offset;
@@ -61,7 +63,8 @@ void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat
     offset = 0;
 
     gettimeofday(&tv, NULL);
-    strftime(timeString, sizeof(timeString), "%Y-%m-%d %H:%M:%S", localtime(&tv.tv_sec));
+    //localtime re-reads the timezone, allocating, on every call; localtime_r only the first time
+    strftime(timeString, sizeof(timeString), "%Y-%m-%d %H:%M:%S", localtime_r(&tv.tv_sec, &tm));
 
     LOG_PRINTF("%s.%06d ", timeString, (uint32_t)tv.tv_usec);
 
@@ -153,9 +156,14 @@ void otPlatLog(otLogLevel aLogLevel, otLogRegion aLogRegion, const char *aFormat
     va_end(args);
 
     otEXPECT_ACTION(charsWritten >= 0, logString[offset] = 0);
+    otEXPECT_ACTION(offset + (unsigned int)charsWritten < sizeof(logString), METRICS_INC(mLogDrops));
 
 exit:
-    fprintf(stderr, "%s\r\n", logString);
+    if (fprintf(stderr, "%s\r\n", logString) < 0)
+    {
+        METRICS_INC(mLogDrops);
+    }
+    METRICS_INC(mLogMessages);
 }
 
 
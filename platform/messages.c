@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the sampling of the message buffer pools into the metrics.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "openthread/message.h"
+#include "messages.h"
+#include "metrics.h"
+
+static void metricsMax(uint64_t *aField, uint64_t aValue)
+{
+	uint64_t max = __atomic_load_n(aField, __ATOMIC_RELAXED);
+
+	while (aValue > max && !__atomic_compare_exchange_n(aField, &max, aValue, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+/*
+ * OpenThread allocates its messages internally, so running out of buffers is
+ * seen by sampling the pool once per pass rather than on each allocation.
+ * The gauges are the sum over the nodes of the process, each node adding the
+ * difference from its last sample.
+ */
+void platformMessagesSample(struct posixNode *aNode, otInstance *aInstance)
+{
+	otBufferInfo info;
+	uint16_t used;
+
+	if (aInstance == NULL)
+		return;
+
+	otMessageGetBufferInfo(aInstance, &info);
+	used = info.mTotalBuffers - info.mFreeBuffers;
+
+	METRICS_ADD(mMessageBuffersTotal, (int64_t)info.mTotalBuffers - aNode->mMessageBuffersTotal);
+	METRICS_ADD(mMessageBuffersUsed, (int64_t)used - aNode->mMessageBuffersUsed);
+	metricsMax(&gPosixMetrics->mMessageBuffersUsedMax, used);
+
+	if (info.mFreeBuffers == 0 && !aNode->mMessageBuffersEmpty)
+		METRICS_INC(mMessageBuffersEmpty);
+
+	aNode->mMessageBuffersTotal = info.mTotalBuffers;
+	aNode->mMessageBuffersUsed = used;
+	aNode->mMessageBuffersEmpty = (info.mFreeBuffers == 0);
+}
+
+void platformMessagesReset(struct posixNode *aNode)
+{
+	METRICS_ADD(mMessageBuffersTotal, -(int64_t)aNode->mMessageBuffersTotal);
+	METRICS_ADD(mMessageBuffersUsed, -(int64_t)aNode->mMessageBuffersUsed);
+
+	aNode->mMessageBuffersTotal = 0;
+	aNode->mMessageBuffersUsed = 0;
+	aNode->mMessageBuffersEmpty = false;
+}
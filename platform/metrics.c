@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the shared-memory metrics segment.
+ *
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "code_utils.h"
+#include "metrics.h"
+
+#define METRICS_ENV "CASCODA_METRICS"
+
+static struct posixMetrics sLocalMetrics;
+static char sShmName[48];
+
+struct posixMetrics *gPosixMetrics = &sLocalMetrics;
+
+static void unlinkMetrics(void)
+{
+	shm_unlink(sShmName);
+}
+
+void posixPlatformMetricsInit(void)
+{
+	const char *metricsEnv = getenv(METRICS_ENV);
+	struct posixMetrics *metrics;
+	struct timeval now;
+	int fd = -1;
+
+	//Mapped once per process, and kept across in-process resets
+	otEXPECT(gPosixMetrics == &sLocalMetrics);
+	otEXPECT(metricsEnv == NULL || atoi(metricsEnv) != 0);
+
+	snprintf(sShmName, sizeof(sShmName), "%s%u", POSIX_METRICS_SHM_PREFIX, NODE_ID);
+
+	fd = shm_open(sShmName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	otEXPECT(fd >= 0);
+	otEXPECT(ftruncate(fd, sizeof(struct posixMetrics)) == 0);
+
+	metrics = mmap(NULL, sizeof(struct posixMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	otEXPECT(metrics != MAP_FAILED);
+
+	//Carry over anything counted before the segment was mapped
+	memcpy(metrics, &sLocalMetrics, sizeof(*metrics));
+
+	gettimeofday(&now, NULL);
+	metrics->mVersion = POSIX_METRICS_VERSION;
+	metrics->mSize = sizeof(struct posixMetrics);
+	metrics->mNodeId = NODE_ID;
+	metrics->mPid = (uint32_t)getpid();
+	metrics->mStartTime = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+	__atomic_store_n(&metrics->mMagic, POSIX_METRICS_MAGIC, __ATOMIC_RELEASE);
+
+	gPosixMetrics = metrics;
+	atexit(unlinkMetrics);
+
+exit:
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+
+	if (gPosixMetrics == &sLocalMetrics && sShmName[0] != '\0')
+	{
+		shm_unlink(sShmName);
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "Failed to create metrics segment %s", sShmName);
+	}
+}
+
+const struct posixMetrics *posixPlatformGetMetrics(void)
+{
+	return gPosixMetrics;
+}
+
+uint64_t posixPlatformGetMacStatusCount(int aPrimitive, uint8_t aStatus)
+{
+	if (aPrimitive < 0 || aPrimitive >= POSIX_MAC_PRIMITIVE_COUNT)
+		return 0;
+
+	return __atomic_load_n(&gPosixMetrics->mMacStatus[aPrimitive][aStatus], __ATOMIC_RELAXED);
+}
@@ -26,17 +26,40 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "openthread/instance.h"
+#include "openthread/platform/alarm-milli.h"
+#include "openthread/platform/logging.h"
 #include "openthread/platform/misc.h"
+#include "openthread/platform/radio-mac.h"
 #include "ca821x-posix-thread/posix-platform.h"
+#include "openthread-core-config.h"
+#include "channel.h"
+#include "ipc.h"
+#include "messages.h"
+#include "node.h"
+#include "tun.h"
+
+#define RESET_REASON_ENV "CASCODA_RESET_REASON"
 
 extern int      gArgumentsCount;
 extern char   **gArguments;
 
-void otPlatReset(otInstance *aInstance)
+static posixPlatformResetHandler sResetHandler = NULL;
+static void *sResetHandlerContext = NULL;
+static bool sResetPending = false;
+
+static otPlatResetReason sResetReason = OT_PLAT_RESET_REASON_POWER_ON;
+static bool sResetReasonRead = false;
+
+static void execReset(void)
 {
 	char *argv[gArgumentsCount + 1];
+	char reason[4];
 
     for (int i = 0; i < gArgumentsCount; ++i)
     {
@@ -45,18 +68,146 @@ void otPlatReset(otInstance *aInstance)
 
     argv[gArgumentsCount] = NULL;
 
+    //Let the new process report the real reason
+    snprintf(reason, sizeof(reason), "%d", OT_PLAT_RESET_REASON_SOFTWARE);
+    setenv(RESET_REASON_ENV, reason, 1);
+
     PlatformRadioStop();
     posixPlatformRestoreTerminal();
 
     execvp(argv[0], argv);
     perror("reset failed");
     exit(EXIT_FAILURE);
-    (void)aInstance;
+}
+
+void posixPlatformSetResetHandler(posixPlatformResetHandler aHandler, void *aContext)
+{
+	sResetHandler = aHandler;
+	sResetHandlerContext = aContext;
+}
+
+bool posixPlatformResetPending(void)
+{
+	return sResetPending;
+}
+
+void posixPlatformProcessReset(otInstance *aInstance)
+{
+	otInstance *newInstance;
+
+	if (!sResetPending)
+	{
+		return;
+	}
+
+	sResetPending = false;
+	otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_PLATFORM, "Performing in-process reset");
+
+	otInstanceFinalize(aInstance);
+	posixNodeCurrent()->mEventsInstance = NULL;
+	platformTunReset(posixNodeCurrent());
+	platformIpcReset(posixNodeCurrent());
+	platformChannelReset(posixNodeCurrent());
+	platformMessagesReset(posixNodeCurrent());
+
+	//Platform state that outlives the instance. The device and flash file stay open.
+	otPlatAlarmMilliStop(aInstance);
+	platformUartReset();
+	PlatformRadioReset();
+
+	sResetReason = OT_PLAT_RESET_REASON_SOFTWARE;
+	sResetReasonRead = true;
+
+#if CASCODA_MULTIPLE_INSTANCES
+	//otPlatReset never leaves a reset pending for the default node in these builds
+	(void)newInstance;
+#else
+	newInstance = otInstanceInitSingle();
+	sResetHandler(newInstance, sResetHandlerContext);
+#endif
+}
+
+void posixNodeProcessReset(struct posixNode *aNode)
+{
+	otInstance *instance = aNode->mInstance;
+
+	if (!aNode->mResetPending)
+	{
+		return;
+	}
+
+	aNode->mResetPending = false;
+	otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_PLATFORM, "Performing reset of node %u", aNode->mNodeId);
+
+	otInstanceFinalize(instance);
+	aNode->mEventsInstance = NULL;
+	platformTunReset(aNode);
+	platformIpcReset(aNode);
+	platformChannelReset(aNode);
+	platformMessagesReset(aNode);
+
+	otPlatAlarmMilliStop(instance);
+	platformUartReset();
+	PlatformRadioReset();
+	aNode->mInstance = NULL;
+
+	//Only the application knows the buffer the instance lives in, so it recreates it
+	if (aNode->mResetHandler != NULL)
+	{
+		aNode->mResetHandler(instance, aNode->mResetContext);
+	}
+	else
+	{
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "Node %u stays down, as it has no reset handler", aNode->mNodeId);
+	}
+}
+
+void otPlatReset(otInstance *aInstance)
+{
+	struct posixNode *node = posixNodeFromInstance(aInstance);
+
+	if (node->mSimulated)
+	{
+		node->mResetPending = true;
+		posixNodeWake(node);
+		return;
+	}
+
+#if CASCODA_MULTIPLE_INSTANCES
+	//Without otInstanceInitSingle the default node cannot be recreated, so restart the whole process
+	execReset();
+#else
+	if (sResetHandler == NULL)
+	{
+		//The application cannot rebuild its state, so restart the whole process
+		execReset();
+	}
+#endif
+
+	//OpenThread may still be on the stack, so the instance is recreated from the main loop
+	sResetPending = true;
 }
 
 otPlatResetReason otPlatGetResetReason(otInstance *aInstance)
 {
-    return OT_PLAT_RESET_REASON_POWER_ON;
+	const char *reasonEnv;
+
+	(void)aInstance;
+
+	if (!sResetReasonRead)
+	{
+		reasonEnv = getenv(RESET_REASON_ENV);
+
+		if (reasonEnv != NULL)
+		{
+			sResetReason = (otPlatResetReason)atoi(reasonEnv);
+			unsetenv(RESET_REASON_ENV);
+		}
+
+		sResetReasonRead = true;
+	}
+
+    return sResetReason;
 }
 
 void otPlatWakeHost(void)
@@ -0,0 +1,236 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the per-node state of the platform, so that one
+ *   process can host many OpenThread instances on a simulated medium.
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "channel.h"
+#include "messages.h"
+#include "node.h"
+#include "sim-radio.h"
+#include "trace.h"
+
+struct posixNode gPosixNodeDefault = {
+	.mFlashFd = -1,
+	.mUartInFd = -1,
+	.mUartOutFd = -1,
+	.mWakeFd = -1,
+};
+
+__thread struct posixNode *gPosixNodeCurrent = NULL;
+
+//The default node is always the head of the list
+static pthread_mutex_t sNodesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct posixNode *posixNodeFromInstance(otInstance *aInstance)
+{
+	struct posixNode *current = posixNodeCurrent();
+	struct posixNode *node;
+
+	if (aInstance == NULL || current->mInstance == aInstance)
+		return current;
+
+	pthread_mutex_lock(&sNodesMutex);
+	for (node = &gPosixNodeDefault; node != NULL; node = node->mNext)
+	{
+		if (node->mInstance == aInstance)
+			break;
+	}
+
+	//An instance not seen before belongs to the node being worked on, bound under the lock so it is bound once
+	if (node == NULL)
+	{
+		node = current;
+
+		if (node->mInstance == NULL)
+			node->mInstance = aInstance;
+	}
+	pthread_mutex_unlock(&sNodesMutex);
+
+	return node;
+}
+
+struct posixNode *posixNodeFromDevice(struct ca821x_dev *aDeviceRef)
+{
+	struct posixNode *node = posixNodeCurrent();
+
+	if (node->mDeviceRef == aDeviceRef)
+		return node;
+
+	pthread_mutex_lock(&sNodesMutex);
+	for (node = &gPosixNodeDefault; node != NULL; node = node->mNext)
+	{
+		if (node->mDeviceRef == aDeviceRef)
+			break;
+	}
+	pthread_mutex_unlock(&sNodesMutex);
+
+	return node ? node : &gPosixNodeDefault;
+}
+
+struct posixNode *posixNodeNext(struct posixNode *aNode)
+{
+	struct posixNode *next;
+
+	if (aNode == NULL)
+		return &gPosixNodeDefault;
+
+	pthread_mutex_lock(&sNodesMutex);
+	next = aNode->mNext;
+	pthread_mutex_unlock(&sNodesMutex);
+
+	return next;
+}
+
+void posixNodeWake(struct posixNode *aNode)
+{
+	uint64_t one = 1;
+	int fd = __atomic_load_n(&aNode->mWakeFd, __ATOMIC_RELAXED);
+
+	if (fd >= 0)
+		(void)write(fd, &one, sizeof(one));
+}
+
+struct posixNode *posixPlatformNodeCreate(uint32_t aNodeId)
+{
+	struct posixNode *node = calloc(1, sizeof(*node));
+	struct posixNode *previous = gPosixNodeCurrent;
+
+	if (node == NULL)
+		return NULL;
+
+	node->mNodeId = aNodeId;
+	node->mSimulated = true;
+	node->mFlashFd = -1;
+	node->mUartInFd = -1;
+	node->mUartOutFd = -1;
+	node->mWakeFd = -1;
+
+	posixNodeRandomInit(node);
+	platformTraceInit();
+
+	if (platformSimRadioInit(node) < 0)
+	{
+		free(node);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&sNodesMutex);
+	node->mNext = gPosixNodeDefault.mNext;
+	gPosixNodeDefault.mNext = node;
+	pthread_mutex_unlock(&sNodesMutex);
+
+	//Brings the simulated MAC to a default state and generates the EUI-64
+	posixNodeEnter(node);
+	posixPlatformAlarmInit();
+	PlatformRadioInitWithDev(&node->mDevice);
+	gPosixNodeCurrent = previous;
+
+	return node;
+}
+
+void posixPlatformNodeDestroy(struct posixNode *aNode)
+{
+	struct posixNode **link;
+
+	if (aNode == NULL || aNode == &gPosixNodeDefault)
+		return;
+
+	pthread_mutex_lock(&sNodesMutex);
+	for (link = &gPosixNodeDefault.mNext; *link != NULL; link = &(*link)->mNext)
+	{
+		if (*link == aNode)
+		{
+			*link = aNode->mNext;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sNodesMutex);
+
+	//The caller must have stopped passing the node to posixPlatformProcessNodes, but a turn may still be running
+	while (__atomic_load_n(&aNode->mBusy, __ATOMIC_ACQUIRE))
+		sched_yield();
+
+	platformSimRadioDeinit(aNode);
+	posixNodeFlashFree(aNode);
+	platformTraceFree(aNode);
+	platformChannelReset(aNode);
+	platformMessagesReset(aNode);
+
+	if (gPosixNodeCurrent == aNode)
+		gPosixNodeCurrent = NULL;
+
+	free(aNode);
+}
+
+void posixPlatformNodeEnter(struct posixNode *aNode)
+{
+	posixNodeEnter(aNode ? aNode : &gPosixNodeDefault);
+}
+
+void posixPlatformNodeSetInstance(struct posixNode *aNode, otInstance *aInstance)
+{
+	aNode->mInstance = aInstance;
+}
+
+otInstance *posixPlatformNodeGetInstance(struct posixNode *aNode)
+{
+	return aNode->mInstance;
+}
+
+uint32_t posixPlatformNodeGetId(struct posixNode *aNode)
+{
+	return posixNodeGetId(aNode);
+}
+
+void posixPlatformNodeSetUart(struct posixNode *aNode, int aInFd, int aOutFd)
+{
+	aNode->mUartInFd = aInFd;
+	aNode->mUartOutFd = aOutFd;
+	aNode->mUartWriteBuffer = NULL;
+	aNode->mUartWriteLength = 0;
+}
+
+void posixPlatformNodeSetResetHandler(struct posixNode *aNode, posixPlatformResetHandler aHandler, void *aContext)
+{
+	aNode->mResetHandler = aHandler;
+	aNode->mResetContext = aContext;
+}
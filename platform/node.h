@@ -0,0 +1,233 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the per-node state of the platform.
+ */
+
+#ifndef PLATFORM_NODE_H_
+#define PLATFORM_NODE_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "openthread/instance.h"
+#include "ca821x_api.h"
+#include "ca821x-posix-thread/posix-metrics.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "footprint.h"
+
+struct simRadio;
+struct posixTun;
+struct posixIpc;
+struct posixTrace;
+struct posixChannelScan;
+
+/**
+ * Everything the platform keeps for one OpenThread instance. A normal process
+ * only ever uses the default node, backed by the real device and NODE_ID's
+ * files. Simulated nodes (see posixPlatformNodeCreate) share the process and
+ * a simulated medium, and keep their flash and EUI-64 in memory.
+ *
+ */
+struct posixNode
+{
+	struct ca821x_dev  mDevice;          ///< Device of a simulated node, or the real device of the default node
+	struct ca821x_dev *mDeviceRef;       ///< Device used by the radio, may be an external one
+	otInstance        *mInstance;        ///< Instance bound to this node, NULL until known
+	otInstance        *mRadioInstance;   ///< Instance the radio delivers upcalls to, NULL while disabled
+	uint32_t           mNodeId;
+	bool               mSimulated;
+
+	//Alarm
+	bool               mAlarmRunning;
+	uint32_t           mAlarm;
+
+	//Flash and settings
+	int                mFlashFd;
+	uint8_t          **mFlashPages;      ///< In-memory flash of a simulated node, pages allocated on first erase
+	uint32_t           mSettingsBaseAddress;
+	uint32_t           mSettingsUsedSize;
+
+	//Radio
+	bool               mRadioInitialised;
+	bool               mIeeeEui64Loaded;
+	uint8_t            mIeeeEui64[8];
+	struct simRadio   *mSimRadio;
+	bool               mTraceDsnKnown;   ///< Whether mTraceDsn follows the MAC's macDSN
+	uint8_t            mTraceDsn;        ///< DSN of the next data frame, for the frame trace
+	struct platformStackRef mDriverStack; ///< Worker thread delivering the upcalls of a real device
+
+	//Random
+	uint64_t           mPrngState;
+	uint64_t           mPrngTrueState;
+
+	//UART
+	bool               mUartEnabled;
+	int                mUartInFd;
+	int                mUartOutFd;
+	const uint8_t     *mUartWriteBuffer;
+	uint16_t           mUartWriteLength;
+
+	//In-process reset
+	bool                      mResetPending;
+	posixPlatformResetHandler mResetHandler;
+	void                     *mResetContext;
+
+	//Network interface, see posix-tun.h
+	struct posixTun   *mTun;
+
+	//Local clients, see posix-ipc.h
+	struct posixIpc   *mIpc;
+
+	//Frame trace, see posix-trace.h
+	struct posixTrace *mTrace;
+
+	//Channel scan in progress, see posix-channel.h
+	struct posixChannelScan *mChannelScan;
+
+	//Message buffer pool of the instance, as last sampled
+	uint16_t           mMessageBuffersTotal;
+	uint16_t           mMessageBuffersUsed;
+	bool               mMessageBuffersEmpty;
+
+	//Work budgets, see scheduler.h
+	uint32_t           mSchedYielded;     ///< Sources that ran out of budget with work left
+	uint64_t           mSchedWaitingSinceNs[POSIX_SCHED_SOURCE_COUNT]; ///< Since when their work has waited, or 0
+
+	//Event bus
+	otInstance        *mEventsInstance;  ///< Instance whose state changes are captured, NULL if none
+	uint8_t            mEventsRole;      ///< Last role seen by the event bus
+
+	int                mWakeFd;          ///< eventfd of the loop servicing this node, or -1
+	bool               mBusy;            ///< Set during the node's turn in posixPlatformProcessNodes
+	struct platformStackRef mLoopStack; ///< Loop thread that last serviced this node
+	struct posixNode  *mNext;
+};
+
+/**
+ * The node the calling thread is working on, NULL for the default node.
+ *
+ */
+extern __thread struct posixNode *gPosixNodeCurrent;
+
+/**
+ * The node used by single-node processes, backed by NODE_ID.
+ *
+ */
+extern struct posixNode gPosixNodeDefault;
+
+/**
+ * This method gets the node the calling thread is working on. Platform calls
+ * that don't take an instance (flash, random, UART...) apply to this node.
+ *
+ */
+static inline struct posixNode *posixNodeCurrent(void)
+{
+	return gPosixNodeCurrent ? gPosixNodeCurrent : &gPosixNodeDefault;
+}
+
+/**
+ * This method makes @p aNode the node the calling thread is working on.
+ *
+ */
+static inline void posixNodeEnter(struct posixNode *aNode)
+{
+	gPosixNodeCurrent = (aNode == &gPosixNodeDefault) ? NULL : aNode;
+}
+
+/**
+ * This method gets the node ID of a node. The default node follows NODE_ID, as
+ * it is normally only final once the application has parsed its arguments.
+ *
+ */
+static inline uint32_t posixNodeGetId(const struct posixNode *aNode)
+{
+	return (aNode == &gPosixNodeDefault) ? NODE_ID : aNode->mNodeId;
+}
+
+/**
+ * This method finds the node of an instance. otInstanceInit calls into the
+ * platform before the application can tell it the new instance, so an unknown
+ * instance is bound to the current node if that has none yet.
+ *
+ * @param[in]  aInstance  The instance, or NULL for the current node.
+ *
+ */
+struct posixNode *posixNodeFromInstance(otInstance *aInstance);
+
+/**
+ * This method finds the node using a device, for the radio upcalls.
+ *
+ */
+struct posixNode *posixNodeFromDevice(struct ca821x_dev *aDeviceRef);
+
+/**
+ * This method iterates over all nodes, starting with the default node.
+ *
+ * @param[in]  aNode  The previous node, or NULL to get the first.
+ *
+ */
+struct posixNode *posixNodeNext(struct posixNode *aNode);
+
+/**
+ * This method wakes the loop servicing a node, if it is asleep.
+ *
+ */
+void posixNodeWake(struct posixNode *aNode);
+
+/**
+ * This method seeds the deterministic random generators of a node, if a seed is set.
+ *
+ */
+void posixNodeRandomInit(struct posixNode *aNode);
+
+/**
+ * This method frees the in-memory flash of a simulated node.
+ *
+ */
+void posixNodeFlashFree(struct posixNode *aNode);
+
+/**
+ * This method gets the heap used by the in-memory flash of a simulated node.
+ *
+ */
+size_t posixNodeFlashFootprint(struct posixNode *aNode);
+
+/**
+ * This method performs a pending reset of a simulated node: the instance is
+ * finalized, and the node's reset handler recreates it.
+ *
+ */
+void posixNodeProcessReset(struct posixNode *aNode);
+
+#endif /* PLATFORM_NODE_H_ */
@@ -0,0 +1,211 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the CPU cost counters, see posix-perf.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "perf.h"
+
+#if CASCODA_PERF_COUNTERS
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+#define PERF_UNOPENED -2
+
+static const struct
+{
+	uint32_t              mType;
+	uint64_t              mConfig;
+	enum posixPerfCounter mCounter;
+} sEvents[] = {
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, POSIX_PERF_CYCLES},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, POSIX_PERF_INSTRUCTIONS},
+	{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, POSIX_PERF_CACHE_MISSES},
+	{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, POSIX_PERF_TASK_CLOCK_NS},
+};
+
+#define PERF_EVENT_COUNT (sizeof(sEvents) / sizeof(sEvents[0]))
+
+//The counters of each thread are a group, read at once from its leader
+static __thread int                  sPerfFds[PERF_EVENT_COUNT];
+static __thread int                  sPerfLeader = PERF_UNOPENED;
+static __thread enum posixPerfSource sPerfSource;
+static __thread uint8_t              sPerfCounters[PERF_EVENT_COUNT]; ///< Counter of each group member, in read order
+static __thread uint8_t              sPerfCount;
+
+static pthread_once_t sPerfKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  sPerfKey;
+
+static void perfClose(void *aUnused)
+{
+	(void)aUnused;
+
+	for (int i = 0; i < sPerfCount; i++)
+		close(sPerfFds[i]);
+
+	sPerfCount = 0;
+	sPerfLeader = PERF_UNOPENED;
+}
+
+static void perfCreateKey(void)
+{
+	pthread_key_create(&sPerfKey, perfClose);
+}
+
+static int perfOpenEvent(size_t aEvent, int aGroupFd)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = sEvents[aEvent].mType;
+	attr.config = sEvents[aEvent].mConfig;
+	attr.read_format = PERF_FORMAT_GROUP;
+	//Allowed unprivileged at the default perf_event_paranoid
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, aGroupFd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void perfAddEvent(size_t aEvent, int aFd)
+{
+	sPerfFds[sPerfCount] = aFd;
+	sPerfCounters[sPerfCount] = sEvents[aEvent].mCounter;
+	sPerfCount++;
+}
+
+/*
+ * Opens the hardware counters with the task clock if the CPU has them, or the
+ * task clock alone, eg. in a VM. If perf_event_open is not allowed at all,
+ * the thread CPU clock is read instead.
+ */
+static void perfOpen(void)
+{
+	int fd;
+
+	sPerfCount = 0;
+	sPerfSource = POSIX_PERF_SOURCE_CLOCK;
+	sPerfLeader = perfOpenEvent(0, -1);
+
+	if (sPerfLeader >= 0)
+	{
+		sPerfSource = POSIX_PERF_SOURCE_HARDWARE;
+		perfAddEvent(0, sPerfLeader);
+
+		for (size_t i = 1; i < PERF_EVENT_COUNT; i++)
+		{
+			if ((fd = perfOpenEvent(i, sPerfLeader)) >= 0)
+				perfAddEvent(i, fd);
+		}
+	}
+	else if ((sPerfLeader = perfOpenEvent(PERF_EVENT_COUNT - 1, -1)) >= 0)
+	{
+		sPerfSource = POSIX_PERF_SOURCE_SOFTWARE;
+		perfAddEvent(PERF_EVENT_COUNT - 1, sPerfLeader);
+	}
+
+	//Closes the counters when the thread exits
+	pthread_once(&sPerfKeyOnce, perfCreateKey);
+	pthread_setspecific(sPerfKey, &sPerfLeader);
+
+	__atomic_store_n(&gPosixMetrics->mPerfSource, sPerfSource, __ATOMIC_RELAXED);
+}
+
+static void perfRead(uint64_t aValues[POSIX_PERF_COUNTER_COUNT])
+{
+	uint64_t group[1 + PERF_EVENT_COUNT];
+	struct timespec now;
+
+	memset(aValues, 0, POSIX_PERF_COUNTER_COUNT * sizeof(aValues[0]));
+
+	if (sPerfLeader >= 0 && read(sPerfLeader, group, sizeof(group)) > 0)
+	{
+		for (uint64_t i = 0; i < group[0] && i < sPerfCount; i++)
+			aValues[sPerfCounters[i]] = group[1 + i];
+	}
+	else if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0)
+	{
+		aValues[POSIX_PERF_TASK_CLOCK_NS] = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	}
+}
+
+void platformPerfBegin(struct platformPerfSample *aSample)
+{
+	if (sPerfLeader == PERF_UNOPENED)
+		perfOpen();
+
+	perfRead(aSample->mValues);
+}
+
+void platformPerfEnd(enum posixPerfOp aOp, const struct platformPerfSample *aSample)
+{
+	uint64_t values[POSIX_PERF_COUNTER_COUNT];
+
+	perfRead(values);
+	METRICS_INC(mPerfOps[aOp]);
+
+	for (int counter = 0; counter < POSIX_PERF_COUNTER_COUNT; counter++)
+	{
+		if (values[counter] > aSample->mValues[counter])
+			METRICS_ADD(mPerfTotals[aOp][counter], values[counter] - aSample->mValues[counter]);
+	}
+}
+
+#endif /* CASCODA_PERF_COUNTERS */
+
+enum posixPerfSource posixPlatformPerfGetSource(void)
+{
+	return (enum posixPerfSource)__atomic_load_n(&gPosixMetrics->mPerfSource, __ATOMIC_RELAXED);
+}
+
+void posixPlatformPerfGetStats(int aOp, struct posixPerfStats *aStats)
+{
+	memset(aStats, 0, sizeof(*aStats));
+
+	if (aOp < 0 || aOp >= POSIX_PERF_OP_COUNT)
+		return;
+
+	aStats->mCount = __atomic_load_n(&gPosixMetrics->mPerfOps[aOp], __ATOMIC_RELAXED);
+
+	for (int counter = 0; counter < POSIX_PERF_COUNTER_COUNT; counter++)
+		aStats->mTotals[counter] = __atomic_load_n(&gPosixMetrics->mPerfTotals[aOp][counter], __ATOMIC_RELAXED);
+}
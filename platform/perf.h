@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform to count the CPU cost
+ *   of its hot paths, see posix-perf.h.
+ */
+
+#ifndef PLATFORM_PERF_H_
+#define PLATFORM_PERF_H_
+
+#include <stdint.h>
+
+#include "openthread-core-config.h"
+#include "ca821x-posix-thread/posix-perf.h"
+
+#ifndef CASCODA_PERF_COUNTERS
+#define CASCODA_PERF_COUNTERS 0
+#endif
+
+#if CASCODA_PERF_COUNTERS
+
+/**
+ * The counters of the calling thread at the start of an operation.
+ *
+ */
+struct platformPerfSample
+{
+	uint64_t mValues[POSIX_PERF_COUNTER_COUNT];
+};
+
+/**
+ * This method reads the counters of the calling thread at the start of an
+ * operation, opening them the first time it is called on the thread.
+ *
+ */
+void platformPerfBegin(struct platformPerfSample *aSample);
+
+/**
+ * This method adds the counters of the calling thread since platformPerfBegin
+ * to the totals of an operation.
+ *
+ */
+void platformPerfEnd(enum posixPerfOp aOp, const struct platformPerfSample *aSample);
+
+#else
+
+struct platformPerfSample
+{
+	uint8_t mUnused;
+};
+
+static inline void platformPerfBegin(struct platformPerfSample *aSample)
+{
+	(void)aSample;
+}
+
+static inline void platformPerfEnd(enum posixPerfOp aOp, const struct platformPerfSample *aSample)
+{
+	(void)aOp;
+	(void)aSample;
+}
+
+#endif /* CASCODA_PERF_COUNTERS */
+
+#endif /* PLATFORM_PERF_H_ */
@@ -36,13 +36,32 @@
 #include <errno.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
 #include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "openthread/platform/alarm-milli.h"
+#include "openthread/platform/logging.h"
+#include "openthread/platform/misc.h"
 #include "openthread/platform/uart.h"
 #include "openthread/tasklet.h"
 #include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-fork-server.h"
 #include "selfpipe.h"
+#include "flash.h"
+#include "events.h"
+#include "metrics.h"
+#include "footprint.h"
+#include "ipc.h"
+#include "messages.h"
+#include "node.h"
+#include "perf.h"
+#include "scheduler.h"
+#include "sim-radio.h"
+#include "trace.h"
+#include "tun.h"
 
 uint32_t NODE_ID = 1;
 uint32_t WELLKNOWN_NODE_ID = 34;
@@ -59,21 +78,119 @@ void posixPlatformSetOrigArgs(int argc, char *argv[]){
 	gArguments = argv;
 }
 
+static bool sStoragePrepared = false;
+static otError sStorageError = OT_ERROR_NONE;
+static bool sForkServerChecked = false;
+
+//Wakes a thread servicing simulated nodes, see posixPlatformProcessNodes
+static __thread int sNodeLoopWakeFd = -1;
+
+//Storage setup only touches files, so can run while the device is brought up
+static void *prepareStorage(void *aContext)
+{
+    PlatformRadioLoadEui64();
+    sStorageError = utilsFlashInit();
+
+    if (sStorageError == OT_ERROR_NONE)
+    {
+        posixPlatformMarkMilestone(POSIX_MILESTONE_FLASH_READY);
+    }
+
+    (void)aContext;
+    return NULL;
+}
+
 int posixPlatformInit(void)
 {
+    pthread_t storageThread;
+    bool storageThreadRunning = false;
+    int status;
+
+    //This initialises the default node, backed by the real device
+    posixPlatformNodeEnter(NULL);
+
+    //In fork server mode, only the forked node processes get past here
+    if (!sForkServerChecked)
+    {
+        const char *forkServerPath = getenv(POSIX_FORK_SERVER_ENV);
+        const char *nodeIdEnv;
+
+        if (forkServerPath != NULL && posixPlatformForkServer(forkServerPath) < 0)
+        {
+            return -1;
+        }
+
+        if ((nodeIdEnv = getenv(POSIX_NODE_ID_ENV)) != NULL)
+        {
+            NODE_ID = strtoul(nodeIdEnv, NULL, 0);
+        }
+
+        sForkServerChecked = true;
+    }
+
+    posixPlatformMarkMilestone(POSIX_MILESTONE_INIT_START);
+    posixPlatformMetricsInit();
+    platformTraceInit();
+    //Latch the reset reason left by a previous process before anything can inherit it
+    otPlatGetResetReason(NULL);
     posixPlatformAlarmInit();
+    posixPlatformMarkMilestone(POSIX_MILESTONE_ALARM_READY);
+    //Random must be ready before the EUI-64 may be generated
+    posixPlatformRandomInit();
+
+    if (!sStoragePrepared)
+    {
+        storageThreadRunning = (pthread_create(&storageThread, NULL, prepareStorage, NULL) == 0);
+        if (!storageThreadRunning)
+        {
+            prepareStorage(NULL);
+        }
+    }
+
     otPlatUartEnable();
-    if(PlatformRadioInit() < 0)
+    posixPlatformMarkMilestone(POSIX_MILESTONE_UART_READY);
+    status = PlatformRadioInit();
+
+    if (storageThreadRunning)
+    {
+        pthread_join(storageThread, NULL);
+    }
+
+    //Settings would otherwise be silently lost, so fail like a missing device
+    if (sStorageError != OT_ERROR_NONE)
+    {
+        otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM, "Failed to open the flash file (error %d)", sStorageError);
+        return -1;
+    }
+    sStoragePrepared = true;
+
+    if(status < 0)
     {
     	return -1;
     }
-    posixPlatformRandomInit();
 
+    posixPlatformMarkMilestone(POSIX_MILESTONE_INIT_DONE);
     return 0;
 }
 
+void posixPlatformInitRetry(void)
+{
+    useconds_t backoff = 10000;
+
+    while (posixPlatformInit() < 0)
+    {
+        usleep(backoff);
+        backoff = (backoff * 2 > 1000000) ? 1000000 : backoff * 2;
+    }
+}
+
 void otTaskletsSignalPending(otInstance *aInstance){
-	selfpipe_push();
+	struct posixNode *node = posixNodeFromInstance(aInstance);
+
+	if(node->mSimulated)
+		posixNodeWake(node);
+	else
+		selfpipe_push();
 }
 
 void posixPlatformGetTimeout(otInstance *aInstance, struct timeval *timeout){
@@ -82,24 +199,75 @@ void posixPlatformGetTimeout(otInstance *aInstance, struct timeval *timeout){
 
 	platformUartUpdateFdSet(&read_fds, &write_fds, &max_fd);
 	selfpipe_UpdateFdSet(&read_fds, &write_fds, &max_fd);
+	platformTunUpdateFdSet(posixNodeCurrent(), &read_fds, &write_fds, &max_fd);
+	platformIpcUpdateFdSet(posixNodeCurrent(), &read_fds, &max_fd);
 	posixPlatformAlarmUpdateTimeout(timeout);
+	platformTaskUpdateFdSet(&read_fds, &write_fds, &max_fd, timeout);
+
+	//A source ran out of budget with work left
+	if (platformSchedPending())
+		timerclear(timeout);
 }
 
 void posixPlatformSleep(otInstance *aInstance, struct timeval *timeout){
     int rval;
 
-    if (!otTaskletsArePending(aInstance))
+    if (!otTaskletsArePending(aInstance) && !posixPlatformResetPending())
     {
+        posixPlatformRandomProcess(timeout);
         rval = select(max_fd + 1, &read_fds, &write_fds, NULL, timeout);
         selfpipe_pop();
+
+        if (rval > 0)
+        {
+            platformTaskSelected(&read_fds, &write_fds);
+        }
+
+        METRICS_INC(mWakeups);
     }
 }
 
+void posixPlatformTaskletsProcess(otInstance *aInstance)
+{
+    struct platformPerfSample perf;
+    uint64_t start = platformSchedNowNs();
+
+    platformPerfBegin(&perf);
+    otTaskletsProcess(aInstance);
+    platformPerfEnd(POSIX_PERF_TASKLETS, &perf);
+    platformSchedMeasure(POSIX_SCHED_TASKLETS, start);
+}
+
+/*
+ * The radio gets a turn between each of the other sources of work, so that
+ * its upcalls wait for at most one slice rather than the whole pass. See
+ * posix-sched.h.
+ */
 void posixPlatformProcessDriversQuick(otInstance *aInstance)
 {
+    uint64_t start;
+
+    platformFootprintMarkStack(&posixNodeCurrent()->mLoopStack);
+
+    METRICS_INC(mLoopIterations);
+    posixPlatformProcessReset(aInstance);
     platformUartProcess();
     PlatformRadioProcess();
+    start = platformSchedNowNs();
     posixPlatformAlarmProcess(aInstance);
+    platformSchedMeasure(POSIX_SCHED_ALARM, start);
+    PlatformRadioProcess();
+    platformEventsProcess(aInstance);
+    platformTunProcess(posixNodeCurrent(), aInstance);
+    PlatformRadioProcess();
+    platformIpcProcess(posixNodeCurrent(), aInstance);
+    PlatformRadioProcess();
+    platformTraceFlush(posixNodeCurrent());
+    platformMessagesSample(posixNodeCurrent(), aInstance);
+    platformWorkersProcess();
+    PlatformRadioProcess();
+    platformTaskProcess();
+    PlatformRadioProcess();
 }
 
 void posixPlatformProcessDrivers(otInstance *aInstance){
@@ -109,3 +277,99 @@ void posixPlatformProcessDrivers(otInstance *aInstance){
 	posixPlatformSleep(aInstance, &timeout);
 }
 
+void posixPlatformProcessNodes(struct posixNode *const *aNodes, size_t aCount, const struct timeval *aMaxTimeout)
+{
+	struct posixNode *previous = gPosixNodeCurrent;
+	struct timeval timeout = {10, 0};
+	fd_set readFds;
+	fd_set writeFds;
+	int maxFd = -1;
+	bool busy = false;
+	uint64_t wakeups;
+
+	if (sNodeLoopWakeFd < 0)
+	{
+		sNodeLoopWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+
+	FD_ZERO(&readFds);
+	FD_ZERO(&writeFds);
+	METRICS_INC(mLoopIterations);
+
+	for (size_t i = 0; i < aCount; i++)
+	{
+		struct posixNode *node = aNodes[i];
+		struct timeval nodeTimeout;
+		uint64_t start;
+
+		//Set before checking for work, so that work arriving later wakes this thread
+		__atomic_store_n(&node->mWakeFd, sNodeLoopWakeFd, __ATOMIC_RELAXED);
+		//posixPlatformNodeDestroy waits for the turn to end
+		__atomic_store_n(&node->mBusy, true, __ATOMIC_SEQ_CST);
+		posixNodeEnter(node);
+		platformFootprintMarkStack(&node->mLoopStack);
+		posixNodeProcessReset(node);
+
+		if (node->mInstance == NULL)
+		{
+			__atomic_store_n(&node->mBusy, false, __ATOMIC_RELEASE);
+			continue;
+		}
+
+		platformSimRadioProcess(node);
+		posixPlatformTaskletsProcess(node->mInstance);
+		platformUartProcess();
+		start = platformSchedNowNs();
+		posixPlatformAlarmProcess(node->mInstance);
+		platformSchedMeasure(POSIX_SCHED_ALARM, start);
+		platformEventsProcess(node->mInstance);
+		platformTunProcess(node, node->mInstance);
+		platformIpcProcess(node, node->mInstance);
+		platformTraceFlush(node);
+		platformMessagesSample(node, node->mInstance);
+
+		platformUartUpdateFdSet(&readFds, &writeFds, &maxFd);
+		platformTunUpdateFdSet(node, &readFds, &writeFds, &maxFd);
+		platformIpcUpdateFdSet(node, &readFds, &maxFd);
+		posixPlatformAlarmUpdateTimeout(&nodeTimeout);
+
+		if (timercmp(&nodeTimeout, &timeout, <))
+		{
+			timeout = nodeTimeout;
+		}
+
+		if (otTaskletsArePending(node->mInstance) || platformSimRadioPending(node) || node->mResetPending ||
+		    platformSchedPending())
+		{
+			busy = true;
+		}
+
+		__atomic_store_n(&node->mBusy, false, __ATOMIC_RELEASE);
+	}
+
+	gPosixNodeCurrent = previous;
+
+	if (busy)
+	{
+		timerclear(&timeout);
+	}
+
+	if (aMaxTimeout != NULL && timercmp(aMaxTimeout, &timeout, <))
+	{
+		timeout = *aMaxTimeout;
+	}
+
+	if (sNodeLoopWakeFd >= 0)
+	{
+		FD_SET(sNodeLoopWakeFd, &readFds);
+		maxFd = (sNodeLoopWakeFd > maxFd) ? sNodeLoopWakeFd : maxFd;
+	}
+
+	if (select(maxFd + 1, &readFds, &writeFds, NULL, &timeout) > 0 &&
+	    sNodeLoopWakeFd >= 0 && FD_ISSET(sNodeLoopWakeFd, &readFds))
+	{
+		(void)read(sNodeLoopWakeFd, &wakeups, sizeof(wakeups));
+	}
+
+	METRICS_INC(mWakeups);
+}
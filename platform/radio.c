@@ -42,11 +42,13 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <string.h>
+#include <time.h>
 
 #include "openthread/thread.h"
 #include "openthread/platform/radio-mac.h"
 #include "openthread/platform/random.h"
 #include "openthread/platform/logging.h"
+#include "openthread-core-config.h"
 
 #include "code_utils.h"
 #include "ca821x_api.h"
@@ -54,6 +56,14 @@
 #include "mac_messages.h"
 #include "ieee_802_15_4.h"
 #include "selfpipe.h"
+#include "events.h"
+#include "metrics.h"
+#include "channel.h"
+#include "footprint.h"
+#include "node.h"
+#include "perf.h"
+#include "scheduler.h"
+#include "trace.h"
 #include "ca821x-posix-thread/posix-platform.h"
 
 #define ARRAY_LENGTH(array) (sizeof((array))/sizeof((array)[0]))
@@ -75,23 +85,16 @@ static enum barrier_waiting
 	NOT_WAITING, WAITING, GREENLIGHT, DONE
 } mbarrier_waiting;
 
-static inline void barrier_main_letWorkerWork(void);
+static inline bool barrier_main_letWorkerWork(void);
+static inline bool barrier_main_workerWaiting(void);
 static inline void barrier_worker_waitForMain(void);
 static inline void barrier_worker_endWork(void);
 //END BARRIER
 
 #define IEEEEUI_FILE "/usr/local/etc/.otEui"
-static uint8_t sIeeeEui64[8];
-
-//For cascoda API
-static struct ca821x_dev s_pDeviceRef;
-static struct ca821x_dev *pDeviceRef = NULL;
 
 static int8_t sNoiseFloor = 127;
 
-static otInstance *OT_INSTANCE = NULL;
-static uint8_t sRadioInitialised = 0;
-
 struct M_KeyDescriptor_thread
 {
 	struct M_KeyTableEntryFixed    Fixed;
@@ -101,23 +104,86 @@ struct M_KeyDescriptor_thread
 	//struct M_KeyUsageDesc          KeyUsageList[2];
 };
 
+/*
+ * The larger structures passed up and down are on the stack by default. With
+ * CASCODA_RADIO_STATIC_UPCALLS they are kept per thread instead, which lowers
+ * the stack peak of every thread servicing nodes. They are never in use twice
+ * on one thread, as upcalls don't nest.
+ */
+#if CASCODA_RADIO_STATIC_UPCALLS
+#define RADIO_UPCALL_STORAGE static __thread
+#else
+#define RADIO_UPCALL_STORAGE
+#endif
+
+//The device, EUI-64 and instance of the radio are kept per node, see node.h
+static inline struct ca821x_dev *radioDevice(otInstance *aInstance)
+{
+	return posixNodeFromInstance(aInstance)->mDeviceRef;
+}
+
+/*
+ * Upcalls from a real device come from its worker thread, and must wait for
+ * the main thread. A simulated medium delivers them from the node's own loop.
+ * The worker's stack is measured for the footprint report too, as the larger
+ * upcall structures live there.
+ */
+static inline void radioUpcallBegin(struct posixNode *aNode)
+{
+	if (!aNode->mSimulated)
+	{
+		platformFootprintMarkStack(&aNode->mDriverStack);
+		barrier_worker_waitForMain();
+	}
+
+	posixNodeEnter(aNode);
+}
+
+static inline void radioUpcallEnd(struct posixNode *aNode)
+{
+	if (!aNode->mSimulated)
+		barrier_worker_endWork();
+}
+
+/* Count the raw MAC status before it is collapsed into an otError */
+static inline uint8_t countMacStatus(enum posixMacPrimitive aPrimitive, uint8_t aStatus)
+{
+	METRICS_INC(mMacStatus[aPrimitive][aStatus]);
+	platformEventLink(aPrimitive, aStatus);
+	return aStatus;
+}
+
+/*
+ * The MCPS-DATA.confirm doesn't carry the DSN, so the frame trace reads macDSN
+ * once and then counts data frames itself. Anything else that may number a
+ * frame, or change macDSN, makes it read macDSN again on the next data frame.
+ */
+static void forgetTraceDsn(otInstance *aInstance)
+{
+	posixNodeFromInstance(aInstance)->mTraceDsnKnown = false;
+}
+
 otError otPlatMlmeGet(otInstance *aInstance, otPibAttr aAttr, uint8_t aIndex, uint8_t *aLen, uint8_t *aBuf)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 	otError otErr;
 
 	//Adaption for security table
 	if(aAttr == OT_PIB_MAC_KEY_TABLE)
 	{
-		struct M_KeyDescriptor_thread caKeyDesc = {0};
+		RADIO_UPCALL_STORAGE struct M_KeyDescriptor_thread caKeyDesc;
 		otKeyTableEntry *otKeyDesc = (otKeyTableEntry*) aBuf;
 		uint8_t flagOffset = 0;
 
+		memset(&caKeyDesc, 0, sizeof(caKeyDesc));
+
 		error = MLME_GET_request_sync(aAttr,
 		                              aIndex,
 		                              aLen,
 		                              (uint8_t*)(&caKeyDesc),
 		                              pDeviceRef);
+		countMacStatus(POSIX_MAC_MLME_GET, error);
 
 		//Convert to ot format
 		otKeyDesc->mKeyIdLookupListEntries = caKeyDesc.Fixed.KeyIdLookupListEntries;
@@ -164,6 +230,7 @@ otError otPlatMlmeGet(otInstance *aInstance, otPibAttr aAttr, uint8_t aIndex, ui
 		                              aLen,
 		                              aBuf,
 		                              pDeviceRef);
+		countMacStatus(POSIX_MAC_MLME_GET, error);
 	}
 
 	switch ( error )
@@ -186,16 +253,22 @@ exit:
 }
 
 otError otPlatMlmeSet(otInstance *aInstance, otPibAttr aAttr, uint8_t aIndex, uint8_t aLen, const uint8_t *aBuf){
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 	otError otErr;
 
+	if(aAttr == macDSN)
+		forgetTraceDsn(aInstance);
+
 	//Adaption for security table
 	if(aAttr == OT_PIB_MAC_KEY_TABLE)
 	{
-		struct M_KeyDescriptor_thread caKeyDesc = {0};
+		RADIO_UPCALL_STORAGE struct M_KeyDescriptor_thread caKeyDesc;
 		const otKeyTableEntry *otKeyDesc = (otKeyTableEntry*) aBuf;
 		uint8_t flagOffset = 0;
 
+		memset(&caKeyDesc, 0, sizeof(caKeyDesc));
+
 		caKeyDesc.Fixed.KeyIdLookupListEntries = otKeyDesc->mKeyIdLookupListEntries;
 		caKeyDesc.Fixed.KeyDeviceListEntries = otKeyDesc->mKeyDeviceListEntries;
 		caKeyDesc.Fixed.KeyUsageListEntries = otKeyDesc->mKeyUsageListEntries;
@@ -247,6 +320,11 @@ otError otPlatMlmeSet(otInstance *aInstance, otPibAttr aAttr, uint8_t aIndex, ui
 		                              pDeviceRef);
 	}
 
+	countMacStatus(POSIX_MAC_MLME_SET, error);
+
+	if (error == MAC_SUCCESS && platformTraceEnabled())
+		platformTraceAttribute(posixNodeFromInstance(aInstance), aAttr, aLen, aBuf);
+
 	switch ( error )
 	{
 	case MAC_SUCCESS:
@@ -272,9 +350,11 @@ otError otPlatMlmeSet(otInstance *aInstance, otPibAttr aAttr, uint8_t aIndex, ui
 
 otError otPlatMlmeReset(otInstance *aInstance, bool setDefaultPib)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 
-	error = MLME_RESET_request_sync(setDefaultPib, pDeviceRef);
+	error = countMacStatus(POSIX_MAC_MLME_RESET, MLME_RESET_request_sync(setDefaultPib, pDeviceRef));
+	forgetTraceDsn(aInstance);
 
 	uint8_t txPow = 8;
 	MLME_SET_request_sync(phyTransmitPower, 0, 1, &txPow, pDeviceRef);
@@ -295,6 +375,7 @@ otError otPlatMlmeReset(otInstance *aInstance, bool setDefaultPib)
 
 otError otPlatMlmeStart(otInstance *aInstance, otStartRequest *aStartReq)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 	otError otErr;
 
@@ -308,6 +389,7 @@ otError otPlatMlmeStart(otInstance *aInstance, otStartRequest *aStartReq)
 	             (struct SecSpec*)  &(aStartReq->mCoordRealignSecurity),
 	             (struct SecSpec*)  &(aStartReq->mBeaconSecurity),
 	                                pDeviceRef);
+	countMacStatus(POSIX_MAC_MLME_START, error);
 
 	switch ( error )
 	{
@@ -334,19 +416,27 @@ otError otPlatMlmeStart(otInstance *aInstance, otStartRequest *aStartReq)
 
 otError otPlatMlmeScan(otInstance *aInstance, otScanRequest *aScanRequest)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 
+	//The platform is scanning for a channel, see posix-channel.h
+	if (posixNodeFromInstance(aInstance)->mChannelScan)
+		return OT_ERROR_BUSY;
+
 	error = MLME_SCAN_request(aScanRequest->mScanType,
 	                          aScanRequest->mScanChannelMask,
 	                          aScanRequest->mScanDuration,
 	       (struct SecSpec*)  &(aScanRequest->mSecSpec),
 	                          pDeviceRef);
+	countMacStatus(POSIX_MAC_MLME_SCAN, error);
+	forgetTraceDsn(aInstance);
 
 	return error == MAC_SUCCESS ? OT_ERROR_NONE : OT_ERROR_FAILED;
 }
 
 otError otPlatMlmePollRequest(otInstance *aInstance, otPollRequest *aPollRequest)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 
 #if CASCODA_CA_VER == 8210
@@ -362,14 +452,19 @@ otError otPlatMlmePollRequest(otInstance *aInstance, otPollRequest *aPollRequest
 	            (struct SecSpec*)  &(aPollRequest->mSecurity),
 	                               pDeviceRef);
 #endif
+	countMacStatus(POSIX_MAC_MLME_POLL, error);
+	forgetTraceDsn(aInstance);
 
 	return (error == MAC_SUCCESS || error == MAC_NO_DATA) ? OT_ERROR_NONE : OT_ERROR_NO_ACK;
 }
 
 otError otPlatMcpsDataRequest(otInstance *aInstance, otDataRequest *aDataRequest)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
+	struct platformPerfSample perf;
 	uint8_t error;
 
+	platformPerfBegin(&perf);
 	error = MCPS_DATA_request(aDataRequest->mSrcAddrMode,
                *(struct FullAddr*) &aDataRequest->mDst,
                                    aDataRequest->mMsduLength,
@@ -378,25 +473,50 @@ otError otPlatMcpsDataRequest(otInstance *aInstance, otDataRequest *aDataRequest
                                    aDataRequest->mTxOptions,
                 (struct SecSpec*)  &(aDataRequest->mSecurity),
                                    pDeviceRef);
+	countMacStatus(POSIX_MAC_MCPS_DATA, error);
+
+	if (error == MAC_SUCCESS)
+		METRICS_INC(mRadioFramesOut);
 
+	if (error == MAC_SUCCESS && platformTraceEnabled())
+	{
+		struct posixNode *node = posixNodeFromInstance(aInstance);
+
+		//The MAC numbers the frame when it is requested, so the DSN is the one before macDSN
+		if (!node->mTraceDsnKnown)
+		{
+			uint8_t len = sizeof(node->mTraceDsn);
+
+			node->mTraceDsnKnown = (MLME_GET_request_sync(macDSN, 0, &len, &node->mTraceDsn, pDeviceRef) == MAC_SUCCESS);
+			node->mTraceDsn--;
+		}
+
+		platformTraceTx(node, aDataRequest, node->mTraceDsn++);
+	}
+
+	platformPerfEnd(POSIX_PERF_DATA_REQUEST, &perf);
 	return (error == MAC_SUCCESS) ? OT_ERROR_NONE : OT_ERROR_INVALID_STATE;
 }
 
 otError otPlatMcpsPurge(otInstance *aInstance, uint8_t aMsduHandle)
 {
+	struct ca821x_dev *pDeviceRef = radioDevice(aInstance);
 	uint8_t error;
 
-	error = MCPS_PURGE_request_sync(&aMsduHandle, pDeviceRef);
+	error = countMacStatus(POSIX_MAC_MCPS_PURGE, MCPS_PURGE_request_sync(&aMsduHandle, pDeviceRef));
 
 	return (error == MAC_SUCCESS) ? OT_ERROR_NONE : OT_ERROR_ALREADY;
 }
 
 static int handleDataIndication(struct MCPS_DATA_indication_pset *params, struct ca821x_dev *pDeviceRef)
 {
+	struct posixNode *node = posixNodeFromDevice(pDeviceRef);
 	int16_t rssi;
-	//TODO: Move this off the stack
-	otDataIndication dataInd = {0};
+	RADIO_UPCALL_STORAGE otDataIndication dataInd;
+	struct platformPerfSample perf;
 
+	platformPerfBegin(&perf);
+	memset(&dataInd, 0, sizeof(dataInd));
 	dataInd.mSrc = *((struct otFullAddr*) &(params->Src));
 	dataInd.mDst = *((struct otFullAddr*) &(params->Dst));
 	dataInd.mMsduLength = params->MsduLength;
@@ -411,18 +531,25 @@ static int handleDataIndication(struct MCPS_DATA_indication_pset *params, struct
 		memset(&(dataInd.mSecurity), 0, sizeof(dataInd.mSecurity));
 	}
 
-	barrier_worker_waitForMain();
-	otPlatMcpsDataIndication(OT_INSTANCE, &dataInd);
-	barrier_worker_endWork();
+	METRICS_INC(mRadioFramesIn);
+
+	radioUpcallBegin(node);
+	if (platformTraceEnabled())
+		platformTraceRx(node, &dataInd, params->MpduLinkQuality);
+	if(node->mRadioInstance)
+		otPlatMcpsDataIndication(node->mRadioInstance, &dataInd);
+	radioUpcallEnd(node);
+	platformPerfEnd(POSIX_PERF_DATA_INDICATION, &perf);
 
 	return 1;
 }
 
 static int handleCommStatusIndication(struct MLME_COMM_STATUS_indication_pset *params, struct ca821x_dev *pDeviceRef)
 {
-	//TODO: Move this off the stack
-	otCommStatusIndication commInd = {0};
+	struct posixNode *node = posixNodeFromDevice(pDeviceRef);
+	RADIO_UPCALL_STORAGE otCommStatusIndication commInd;
 
+	memset(&commInd, 0, sizeof(commInd));
 	memcpy(commInd.mPanId, params->PANId, sizeof(commInd.mPanId));
 	commInd.mDstAddrMode = params->DstAddrMode;
 	commInd.mSrcAddrMode = params->SrcAddrMode;
@@ -430,35 +557,46 @@ static int handleCommStatusIndication(struct MLME_COMM_STATUS_indication_pset *p
 	memcpy(commInd.mSrcAddr, params->SrcAddr, sizeof(commInd.mSrcAddr));
 	memcpy(&commInd.mSecurity, &params->Security, sizeof(commInd.mSecurity));
 
-	commInd.mStatus = params->Status;
+	commInd.mStatus = countMacStatus(POSIX_MAC_MLME_COMM_STATUS, params->Status);
 
 	if(commInd.mSecurity.mSecurityLevel == 0)
 	{
 		memset(&(commInd.mSecurity), 0, sizeof(commInd.mSecurity));
 	}
 
-	barrier_worker_waitForMain();
-	otPlatMlmeCommStatusIndication(OT_INSTANCE, &commInd);
-	barrier_worker_endWork();
+	radioUpcallBegin(node);
+	if(node->mRadioInstance)
+		otPlatMlmeCommStatusIndication(node->mRadioInstance, &commInd);
+	radioUpcallEnd(node);
 
 	return 1;
 }
 
 static int handleDataConfirm(struct MCPS_DATA_confirm_pset *params, struct ca821x_dev *pDeviceRef)   //Async
 {
-	barrier_worker_waitForMain();
-	otPlatMcpsDataConfirm(OT_INSTANCE, params->MsduHandle, params->Status);
-	barrier_worker_endWork();
+	struct posixNode *node = posixNodeFromDevice(pDeviceRef);
+
+	METRICS_INC(mConfirmStatus[params->Status]);
+	countMacStatus(POSIX_MAC_MCPS_DATA_CONFIRM, params->Status);
+
+	radioUpcallBegin(node);
+	if (platformTraceEnabled())
+		platformTraceTxDone(node, params->MsduHandle, params->Status);
+	if(node->mRadioInstance)
+		otPlatMcpsDataConfirm(node->mRadioInstance, params->MsduHandle, params->Status);
+	radioUpcallEnd(node);
 
 	return 1;
 }
 
 static int handleBeaconNotify(struct MLME_BEACON_NOTIFY_indication_pset *params, struct ca821x_dev *pDeviceRef) //Async
 {
-	//TODO: Move this off the stack
-	otBeaconNotify beaconNotify = {0};
+	struct posixNode *node = posixNodeFromDevice(pDeviceRef);
+	RADIO_UPCALL_STORAGE otBeaconNotify beaconNotify;
 	uint8_t sduLenOffset;
 
+	memset(&beaconNotify, 0, sizeof(beaconNotify));
+
 	{
 		uint8_t addrField = ((uint8_t *)params)[23];
 		uint8_t shortaddrs  = addrField & 0x07;
@@ -471,27 +609,33 @@ static int handleBeaconNotify(struct MLME_BEACON_NOTIFY_indication_pset *params,
 	beaconNotify.mSduLength = ((uint8_t *)params)[sduLenOffset];
 	memcpy(beaconNotify.mSdu, &(((uint8_t *)params)[sduLenOffset + 1]), beaconNotify.mSduLength);
 
-	barrier_worker_waitForMain();
-	otPlatMlmeBeaconNotifyIndication(OT_INSTANCE, &beaconNotify);
-	barrier_worker_endWork();
+	radioUpcallBegin(node);
+	if(!platformChannelBeaconNotify(node, params) && node->mRadioInstance)
+		otPlatMlmeBeaconNotifyIndication(node->mRadioInstance, &beaconNotify);
+	radioUpcallEnd(node);
 
 	return 1;
 }
 
 static int handleScanConfirm(struct MLME_SCAN_confirm_pset *params, struct ca821x_dev *pDeviceRef)   //Async
 {
-	barrier_worker_waitForMain();
-	otPlatMlmeScanConfirm(OT_INSTANCE, (otScanConfirm *)params);
-	barrier_worker_endWork();
+	struct posixNode *node = posixNodeFromDevice(pDeviceRef);
+
+	countMacStatus(POSIX_MAC_MLME_SCAN_CONFIRM, params->Status);
+
+	radioUpcallBegin(node);
+	if(!platformChannelScanConfirm(node, params) && node->mRadioInstance)
+		otPlatMlmeScanConfirm(node->mRadioInstance, (otScanConfirm *)params);
+	radioUpcallEnd(node);
 
 	return 1;
 }
 
 void otPlatRadioGetIeeeEui64(otInstance *aInstance, uint8_t *aIeeeEui64)
 {
-	memcpy(aIeeeEui64, sIeeeEui64, sizeof(sIeeeEui64));
+	struct posixNode *node = posixNodeFromInstance(aInstance);
 
-	(void) aInstance;
+	memcpy(aIeeeEui64, node->mIeeeEui64, sizeof(node->mIeeeEui64));
 }
 
 int8_t otPlatRadioGetReceiveSensitivity(otInstance *aInstance){
@@ -500,16 +644,18 @@ int8_t otPlatRadioGetReceiveSensitivity(otInstance *aInstance){
 
 static int driverErrorCallback(int error_number, struct ca821x_dev *pDeviceRef)
 {
+	struct posixNode *node = posixNodeFromDevice(pDeviceRef);
+
 	otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_MAC, "DRIVER FAILED WITH ERROR %d\n\r", error_number);
 
-	if(!sRadioInitialised)
+	if(!node->mRadioInitialised)
 		exit(EXIT_FAILURE);
 
 	otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_MAC, "Attempting restart...\n\r", error_number);
 
 	if(ca821x_util_reset(pDeviceRef) == 0){
-		otThreadSetAutoStart(OT_INSTANCE, true);
-		otInstanceReset(OT_INSTANCE);
+		otThreadSetAutoStart(node->mRadioInstance, true);
+		otInstanceReset(node->mRadioInstance);
 	}
 
 	abort();
@@ -518,29 +664,71 @@ static int driverErrorCallback(int error_number, struct ca821x_dev *pDeviceRef)
 
 void PlatformRadioStop(void)
 {
-	if(sRadioInitialised){
+	//Only the default node has a real device, simulated nodes have nothing to stop
+	struct posixNode *node = &gPosixNodeDefault;
+
+	if(node->mRadioInitialised){
 		//Reset the MAC to a default state
 		otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_MAC, "Resetting & Stopping Radio...\n\r");
-		MLME_RESET_request_sync(1, pDeviceRef);
-		ca821x_util_deinit(pDeviceRef);
-		sRadioInitialised = false;
+		MLME_RESET_request_sync(1, node->mDeviceRef);
+		ca821x_util_deinit(node->mDeviceRef);
+		node->mRadioInitialised = false;
+	}
+}
+
+void PlatformRadioReset(void)
+{
+	struct posixNode *node = posixNodeCurrent();
+
+	node->mRadioInstance = NULL;
+
+	if(node->mRadioInitialised){
+		//Drops the PIB and key table of the old instance
+		otPlatMlmeReset(NULL, true);
+	}
+}
+
+static void generateIeeeEui64(uint8_t *aIeeeEui64)
+{
+	for (int i = 0; i < 4; i += 1)
+	{
+		uint16_t random = otPlatRandomGet();
+		aIeeeEui64[2 * i] = random & 0xFF;
+		aIeeeEui64[2 * i + 1] = (random >> 4) & 0xFF;
 	}
+	aIeeeEui64[0] &= ~1; //Unset Group bit
+	aIeeeEui64[0] |= 2; //Set local bit
 }
 
-void initIeeeEui64(){
+//posixPlatformInit loads the EUI-64 on a helper thread while the device is brought up
+static pthread_mutex_t sIeeeEui64Mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void loadIeeeEui64(struct posixNode *aNode){
 	int file;
+
+	if(aNode->mIeeeEui64Loaded)
+		return;
+
+	//Simulated nodes don't persist their EUI-64, so need no file each
+	if(aNode->mSimulated)
+	{
+		generateIeeeEui64(aNode->mIeeeEui64);
+		aNode->mIeeeEui64Loaded = true;
+		return;
+	}
+
 	uint8_t create = false;
 	size_t fileNameLen = strlen(IEEEEUI_FILE) + 4; //"filename.00\0"
 	char fileName[fileNameLen];
 
-	snprintf(fileName, fileNameLen, "%s.%02u", IEEEEUI_FILE, NODE_ID);
+	snprintf(fileName, fileNameLen, "%s.%02u", IEEEEUI_FILE, posixNodeGetId(aNode));
 
 	if (!access(fileName, R_OK))
 	{
 		uint8_t ret = 0;
 
 		file = open(fileName, O_RDONLY);
-		ret = read(file, sIeeeEui64, 8);
+		ret = read(file, aNode->mIeeeEui64, 8);
 		if(ret != 8)
 		{
 			close(file);
@@ -555,17 +743,24 @@ void initIeeeEui64(){
 	if(create)
 	{
 		file = open(fileName, O_RDWR | O_CREAT, 0666);
-		for (int i = 0; i < 4; i += 1)
-		{
-			uint16_t random = otPlatRandomGet();
-			sIeeeEui64[2 * i] = random & 0xFF;
-			sIeeeEui64[2 * i + 1] = (random >> 4) & 0xFF;
-		}
-		sIeeeEui64[0] &= ~1; //Unset Group bit
-		sIeeeEui64[0] |= 2; //Set local bit
-		write(file, sIeeeEui64, 8);
+		generateIeeeEui64(aNode->mIeeeEui64);
+		write(file, aNode->mIeeeEui64, 8);
 	}
 	close(file);
+	aNode->mIeeeEui64Loaded = true;
+	posixPlatformMarkMilestone(POSIX_MILESTONE_EUI_READY);
+}
+
+//Waits for a load already running on another thread, so the node, its file and the PRNG have one user
+static void initIeeeEui64(struct posixNode *aNode){
+	pthread_mutex_lock(&sIeeeEui64Mutex);
+	loadIeeeEui64(aNode);
+	pthread_mutex_unlock(&sIeeeEui64Mutex);
+}
+
+void PlatformRadioLoadEui64(void)
+{
+	initIeeeEui64(posixNodeCurrent());
 }
 
 int handleWakeupIndication(struct HWME_WAKEUP_indication_pset *params, struct ca821x_dev *pDeviceRef)
@@ -576,10 +771,15 @@ int handleWakeupIndication(struct HWME_WAKEUP_indication_pset *params, struct ca
 
 int PlatformRadioInitWithDev(struct ca821x_dev *apDeviceRef)
 {
-	pDeviceRef = apDeviceRef;
+	struct posixNode *node = posixNodeCurrent();
+	struct ca821x_dev *pDeviceRef = apDeviceRef;
+
+	node->mDeviceRef = pDeviceRef;
 
-	atexit(&PlatformRadioStop);
-	selfpipe_init();
+	if(!node->mSimulated){
+		atexit(&PlatformRadioStop);
+		selfpipe_init();
+	}
 
 	struct ca821x_api_callbacks callbacks = {0};
 	callbacks.MCPS_DATA_indication = &handleDataIndication;
@@ -592,25 +792,28 @@ int PlatformRadioInitWithDev(struct ca821x_dev *apDeviceRef)
 
 	//Reset the MAC to a default state
 	otPlatMlmeReset(NULL, true);
+	posixPlatformMarkMilestone(POSIX_MILESTONE_MAC_RESET);
 
-	initIeeeEui64();
-	sRadioInitialised = 1;
+	initIeeeEui64(node);
+	node->mRadioInitialised = 1;
 
 	return 0;
 }
 
 int PlatformRadioInit(void)
 {
+	struct posixNode *node = posixNodeCurrent();
 	int status;
 
-	status = ca821x_util_init(&s_pDeviceRef, driverErrorCallback);
+	status = ca821x_util_init(&node->mDevice, driverErrorCallback);
 	if(status < 0)
 	{
 		otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM, "No ca821x device found");
 		return status;
 	}
+	posixPlatformMarkMilestone(POSIX_MILESTONE_DEVICE_OPEN);
 
-	return PlatformRadioInitWithDev(&s_pDeviceRef);
+	return PlatformRadioInitWithDev(&node->mDevice);
 }
 
 int8_t otPlatRadioGetRssi(otInstance *aInstance)
@@ -621,29 +824,61 @@ int8_t otPlatRadioGetRssi(otInstance *aInstance)
 otError otPlatRadioEnable(otInstance *aInstance)
 {
 	otError error = OT_ERROR_NONE;
-	OT_INSTANCE = aInstance;
+	posixNodeFromInstance(aInstance)->mRadioInstance = aInstance;
 
 	return error;
 }
 
 bool otPlatRadioIsEnabled(otInstance *aInstance)
 {
-	return (OT_INSTANCE != NULL);
+	return (posixNodeFromInstance(aInstance)->mRadioInstance != NULL);
+}
+
+struct ca821x_dev *PlatformRadioGetDevice(void)
+{
+	struct posixNode *node = posixNodeCurrent();
+
+	return node->mRadioInitialised ? node->mDeviceRef : NULL;
 }
 
 int PlatformRadioProcess(void)
 {
-	barrier_main_letWorkerWork();
+	struct platformSchedSlice slice;
+
+	//Called several times per pass, so keep it cheap when there is nothing to do
+	if (!barrier_main_workerWaiting())
+	{
+		platformSchedIdle(POSIX_SCHED_RADIO);
+		return 0;
+	}
+
+	//Upcalls already waiting are handed over up to the budget, more may arrive meanwhile
+	platformSchedBegin(&slice, POSIX_SCHED_RADIO);
+	while (barrier_main_workerWaiting() && platformSchedNext(&slice))
+	{
+		barrier_main_letWorkerWork();
+	}
+	platformSchedEnd(&slice, barrier_main_workerWaiting());
+
 	return 0;
 }
 
+//Whether the worker thread has an upcall waiting, only a hint without the lock
+static inline bool barrier_main_workerWaiting()
+{
+	return __atomic_load_n(&mbarrier_waiting, __ATOMIC_RELAXED) == WAITING;
+}
+
 //Lets the worker thread work synchronously if there is synchronous work to do
-static inline void barrier_main_letWorkerWork()
+static inline bool barrier_main_letWorkerWork()
 {
+	bool worked = false;
+
 	pthread_mutex_lock(&barrier_mutex);
 
 	if (mbarrier_waiting == WAITING)
 	{
+		worked = true;
 		mbarrier_waiting = GREENLIGHT;
 		pthread_cond_broadcast(&barrier_cond);
 
@@ -656,10 +891,16 @@ static inline void barrier_main_letWorkerWork()
 	mbarrier_waiting = NOT_WAITING;
 	pthread_cond_broadcast(&barrier_cond);
 	pthread_mutex_unlock(&barrier_mutex);
+
+	return worked;
 }
 
 static inline void barrier_worker_waitForMain()
 {
+	struct timespec start, end;
+	uint64_t waitNs;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	pthread_mutex_lock(&barrier_mutex);
 
 	while (mbarrier_waiting != NOT_WAITING)
@@ -675,6 +916,12 @@ static inline void barrier_worker_waitForMain()
 	{
 		pthread_cond_wait(&barrier_cond, &barrier_mutex); //wait for the main thread to signal worker to run
 	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	waitNs = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+	METRICS_INC(mBarrierWaits);
+	METRICS_ADD(mBarrierWaitNs, waitNs);
+	platformSchedWaited(POSIX_SCHED_RADIO, waitNs);
 }
 
 static inline void barrier_worker_endWork()
@@ -36,64 +36,312 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <linux/random.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "openthread/platform/random.h"
+#include "openthread/platform/logging.h"
 #include "ca821x-posix-thread/posix-platform.h"
 #include "code_utils.h"
+#include "node.h"
 #include "ca821x_api.h"
 #include "hwme_tdme.h"
 
+#define RANDOM_SEED_ENV      "CASCODA_RANDOM_SEED"
+#define RANDOM_SEED_TRUE_ENV "CASCODA_RANDOM_SEED_TRUE"
+
+/*
+ * Deterministic mode: once a seed is set, otPlatRandomGet is served by an
+ * xorshift64* generator seeded from the seed and the node ID, so repeated runs
+ * see identical backoffs, jitter and EUI-64s. Each node has its own streams.
+ * otPlatRandomGetTrue has a separate switch and a separate stream, so key
+ * material is never made predictable by accident.
+ */
+static bool     sSeedSet = false;
+static bool     sSeedTrue = false;
+static uint32_t sSeed;
+
+static int sUrandomFd = -1;
+static int sRandomFd = -1;
+
+/*
+ * Hardware entropy pool. The CA821x only returns two random bytes per
+ * synchronous HWME exchange, so rather than fetch them on demand the pool is
+ * topped up a small batch at a time by a refill thread of its own, while the
+ * main loop is idle, and mixed into the kernel CSPRNG (which serves
+ * otPlatRandomGetTrue) once full. Neither callers of the random API nor the
+ * main loop wait on an exchange. Only the refill thread touches the pool.
+ */
+#define HW_ENTROPY_POOL_SIZE      32  //Bytes collected before mixing into the kernel
+#define HW_ENTROPY_BATCH          4   //Max exchanges per idle period
+#define HW_ENTROPY_MIN_IDLE_MS    50  //Only refill if the loop is going to sleep this long
+#define HW_ENTROPY_BITS_PER_BYTE  4   //Conservative entropy credit for each hardware byte
+
+static uint8_t  sHwEntropyPool[HW_ENTROPY_POOL_SIZE];
+static uint8_t  sHwEntropyLength = 0;
+static bool     sHwEntropyUnsupported = false;
+static uint32_t sHwEntropyMixed = 0;
+
+static pthread_mutex_t     sHwEntropyMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t      sHwEntropyCond = PTHREAD_COND_INITIALIZER;
+static bool                sHwEntropyThreadStarted = false;
+static struct ca821x_dev  *sHwEntropyRequest = NULL;    //Device to refill from, NULL while the thread is idle
+
+static uint64_t splitmix64(uint64_t aValue)
+{
+	aValue += 0x9E3779B97F4A7C15ULL;
+	aValue = (aValue ^ (aValue >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	aValue = (aValue ^ (aValue >> 27)) * 0x94D049BB133111EBULL;
+	return aValue ^ (aValue >> 31);
+}
+
+static uint32_t xorshift64star(uint64_t *aState)
+{
+	uint64_t x = *aState;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*aState = x;
+
+	return (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void seedPrng(struct posixNode *aNode)
+{
+	uint64_t base = ((uint64_t)sSeed << 32) | posixNodeGetId(aNode);
+
+	aNode->mPrngState = splitmix64(base);
+	aNode->mPrngTrueState = splitmix64(~base);
+
+	//xorshift gets stuck on an all-zero state
+	if (aNode->mPrngState == 0) aNode->mPrngState = 1;
+	if (aNode->mPrngTrueState == 0) aNode->mPrngTrueState = 1;
+}
+
+void posixNodeRandomInit(struct posixNode *aNode)
+{
+	if (sSeedSet)
+	{
+		seedPrng(aNode);
+	}
+}
+
+static int getUrandomFd(void)
+{
+	if (sUrandomFd < 0)
+	{
+		sUrandomFd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	}
+
+	return sUrandomFd;
+}
+
+static int getRandomFd(void)
+{
+	if (sRandomFd < 0)
+	{
+		sRandomFd = open("/dev/random", O_RDWR | O_CLOEXEC);
+	}
+
+	return sRandomFd;
+}
+
+static void mixHwEntropy(void)
+{
+	union
+	{
+		struct rand_pool_info info;
+		uint8_t raw[sizeof(struct rand_pool_info) + HW_ENTROPY_POOL_SIZE];
+	} entropy;
+	int fd = getRandomFd();
+
+	otEXPECT(fd >= 0);
+
+	entropy.info.entropy_count = sHwEntropyLength * HW_ENTROPY_BITS_PER_BYTE;
+	entropy.info.buf_size = sHwEntropyLength;
+	memcpy(entropy.info.buf, sHwEntropyPool, sHwEntropyLength);
+
+	//Crediting entropy needs CAP_SYS_ADMIN, otherwise the bytes are still mixed in uncredited
+	if (ioctl(fd, RNDADDENTROPY, &entropy.info) < 0)
+	{
+		otEXPECT(write(fd, sHwEntropyPool, sHwEntropyLength) == sHwEntropyLength);
+	}
+
+	__atomic_fetch_add(&sHwEntropyMixed, sHwEntropyLength, __ATOMIC_RELAXED);
+
+exit:
+	memset(sHwEntropyPool, 0, sizeof(sHwEntropyPool));
+	sHwEntropyLength = 0;
+}
+
+void posixPlatformRandomSetSeed(uint32_t aSeed)
+{
+	sSeed = aSeed;
+	sSeedSet = true;
+
+	for (struct posixNode *node = posixNodeNext(NULL); node != NULL; node = posixNodeNext(node))
+	{
+		seedPrng(node);
+	}
+}
+
+void posixPlatformRandomSetTrueDeterministic(bool aEnable)
+{
+	sSeedTrue = aEnable;
+}
+
 void posixPlatformRandomInit(void)
 {
-    //nothing
+	const char *seedEnv = getenv(RANDOM_SEED_ENV);
+	const char *seedTrueEnv = getenv(RANDOM_SEED_TRUE_ENV);
+
+	if (!sSeedSet && seedEnv != NULL && *seedEnv != '\0')
+	{
+		sSeed = (uint32_t)strtoul(seedEnv, NULL, 0);
+		sSeedSet = true;
+	}
+
+	if (seedTrueEnv != NULL && atoi(seedTrueEnv) != 0)
+	{
+		sSeedTrue = true;
+	}
+
+	if (sSeedSet)
+	{
+		//Reseed, as NODE_ID is only final once the application has parsed its arguments
+		seedPrng(&gPosixNodeDefault);
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM,
+		          "Deterministic random mode, seed %u node %u", sSeed, NODE_ID);
+	}
+
+	if (sSeedSet && sSeedTrue)
+	{
+		otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM,
+		          "otPlatRandomGetTrue is DETERMINISTIC - never use this outside of testing");
+	}
+
+	getUrandomFd();
+	getRandomFd();
 }
 
-uint32_t otPlatRandomGet(void)
+//Returns false if the radio has no random number generator
+static bool refillHwEntropy(struct ca821x_dev *pDeviceRef)
 {
+	bool supported = true;
+
+	for (int i = 0; i < HW_ENTROPY_BATCH && sHwEntropyLength < HW_ENTROPY_POOL_SIZE; i++)
+	{
+		uint8_t randomBytes[2];
+		uint8_t length = 0;
 
-	uint8_t length1 = 0;
-	uint8_t length2 = 0;
-
-	union randBytes{
-		uint8_t randb[4];
-		uint32_t rand32i;
-	} randomBytes;
-
-	/*
-    HWME_GET_request_sync(
-    		HWME_RANDOMNUM,
-			&length1,
-			randomBytes.randb,
-			NULL);
-    HWME_GET_request_sync(
-			HWME_RANDOMNUM,
-			&length2,
-			randomBytes.randb + 2,
-			NULL);
-	*/
-
-    if(length1 != 2 || length2 != 2){
-
-    	uint32_t rnum = 0;
-		int fd = open("/dev/urandom", O_RDONLY);
-		if (fd != -1)
+		if (HWME_GET_request_sync(HWME_RANDOMNUM, &length, randomBytes, pDeviceRef) != MAC_SUCCESS ||
+		    length == 0 || length > sizeof(randomBytes))
 		{
-			(void) read(fd, (void *)&rnum, sizeof(rnum));
-			(void) close(fd);
-		}
-		else{
-			assert(0); //All attempts at randomness have failed
+			otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_PLATFORM, "No hardware entropy available from radio");
+			supported = false;
+			break;
 		}
 
-		return rnum;
-    }
+		memcpy(sHwEntropyPool + sHwEntropyLength, randomBytes, length);
+		sHwEntropyLength += length;
+	}
+
+	if (sHwEntropyLength >= HW_ENTROPY_POOL_SIZE)
+	{
+		mixHwEntropy();
+	}
+
+	return supported;
+}
+
+static void *hwEntropyThread(void *aContext)
+{
+	(void)aContext;
+
+	pthread_mutex_lock(&sHwEntropyMutex);
+	while (!sHwEntropyUnsupported)
+	{
+		struct ca821x_dev *pDeviceRef;
+		bool supported;
+
+		while (sHwEntropyRequest == NULL)
+			pthread_cond_wait(&sHwEntropyCond, &sHwEntropyMutex);
+
+		pDeviceRef = sHwEntropyRequest;
+		pthread_mutex_unlock(&sHwEntropyMutex);
+		supported = refillHwEntropy(pDeviceRef);
+		pthread_mutex_lock(&sHwEntropyMutex);
+		sHwEntropyUnsupported = !supported;
+		sHwEntropyRequest = NULL;
+	}
+	pthread_mutex_unlock(&sHwEntropyMutex);
+
+	return NULL;
+}
+
+void posixPlatformRandomProcess(struct timeval *aTimeout)
+{
+	struct ca821x_dev *pDeviceRef = PlatformRadioGetDevice();
+	pthread_t thread;
+
+	if (pDeviceRef == NULL || posixNodeCurrent()->mSimulated ||
+	    (aTimeout != NULL && (aTimeout->tv_sec * 1000 + aTimeout->tv_usec / 1000) < HW_ENTROPY_MIN_IDLE_MS))
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&sHwEntropyMutex);
+
+	//Or still refilling from the last idle period
+	otEXPECT(!sHwEntropyUnsupported && sHwEntropyRequest == NULL);
+
+	if (!sHwEntropyThreadStarted)
+	{
+		otEXPECT(pthread_create(&thread, NULL, hwEntropyThread, NULL) == 0);
+		pthread_detach(thread);
+		sHwEntropyThreadStarted = true;
+	}
+
+	sHwEntropyRequest = pDeviceRef;
+	pthread_cond_signal(&sHwEntropyCond);
+
+exit:
+	pthread_mutex_unlock(&sHwEntropyMutex);
+}
+
+uint32_t posixPlatformRandomGetHwEntropyMixed(void)
+{
+	return __atomic_load_n(&sHwEntropyMixed, __ATOMIC_RELAXED);
+}
+
+uint32_t otPlatRandomGet(void)
+{
+	uint32_t rnum = 0;
+	int fd;
+
+	if (sSeedSet)
+	{
+		return xorshift64star(&posixNodeCurrent()->mPrngState);
+	}
 
-    return randomBytes.rand32i;
+	fd = getUrandomFd();
+	if (fd < 0 || read(fd, (void *)&rnum, sizeof(rnum)) != sizeof(rnum))
+	{
+		assert(0); //All attempts at randomness have failed
+	}
 
+	return rnum;
 }
 
 otError otPlatRandomGetTrue(uint8_t *aOutput, uint16_t aOutputLength){
@@ -101,17 +349,34 @@ otError otPlatRandomGetTrue(uint8_t *aOutput, uint16_t aOutputLength){
 
 	otEXPECT_ACTION(aOutput != NULL, error = OT_ERROR_INVALID_ARGS);
 
-	int fd = open("/dev/random", O_RDONLY);
-	if (fd != -1)
+	if (sSeedSet && sSeedTrue)
 	{
-		(void) read(fd, (void *)aOutput, aOutputLength);
-		(void) close(fd);
+		uint64_t *state = &posixNodeCurrent()->mPrngTrueState;
+
+		for (uint16_t i = 0; i < aOutputLength; i++)
+		{
+			aOutput[i] = (uint8_t)xorshift64star(state);
+		}
+		otEXIT_NOW();
 	}
-	else{
-		error = OT_ERROR_FAILED;
+
+	int fd = getRandomFd();
+	otEXPECT_ACTION(fd >= 0, error = OT_ERROR_FAILED);
+
+	while (aOutputLength > 0)
+	{
+		ssize_t rval = read(fd, (void *)aOutput, aOutputLength);
+
+		if (rval < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		otEXPECT_ACTION(rval > 0, error = OT_ERROR_FAILED);
+		aOutput += rval;
+		aOutputLength -= (uint16_t)rval;
 	}
 
 exit:
 	return error;
 }
-
@@ -0,0 +1,186 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the work budgets of the platform loop, see posix-sched.h.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ca821x-posix-thread/posix-sched.h"
+#include "metrics.h"
+#include "node.h"
+#include "scheduler.h"
+
+static struct posixSchedBudget sBudgets[POSIX_SCHED_SOURCE_COUNT] = {
+	[POSIX_SCHED_RADIO] = {8, 2000, 5000},
+	[POSIX_SCHED_UART] = {4, 2000, 0},
+	[POSIX_SCHED_ALARM] = {0, 2000, 5000},
+	[POSIX_SCHED_TASKLETS] = {0, 10000, 0},
+	[POSIX_SCHED_NETIF] = {32, 2000, 20000},
+	[POSIX_SCHED_IPC] = {64, 2000, 0},
+	[POSIX_SCHED_WORKERS] = {16, 2000, 20000},
+	[POSIX_SCHED_TASKS] = {16, 5000, 20000},
+};
+
+
+uint64_t platformSchedNowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t loadBudget(const uint32_t *aField)
+{
+	return __atomic_load_n(aField, __ATOMIC_RELAXED);
+}
+
+void platformSchedBegin(struct platformSchedSlice *aSlice, enum posixSchedSource aSource)
+{
+	uint32_t sliceUs = loadBudget(&sBudgets[aSource].mSliceUs);
+	uint64_t *waitingSinceNs = &posixNodeCurrent()->mSchedWaitingSinceNs[aSource];
+
+	aSlice->mSource = aSource;
+	aSlice->mItems = 0;
+	aSlice->mMaxItems = loadBudget(&sBudgets[aSource].mItems);
+	aSlice->mStartNs = platformSchedNowNs();
+	aSlice->mEndNs = sliceUs ? aSlice->mStartNs + sliceUs * 1000ULL : UINT64_MAX;
+
+	//Work left behind by the last turn has waited until now
+	if (*waitingSinceNs != 0)
+	{
+		platformSchedWaited(aSource, aSlice->mStartNs - *waitingSinceNs);
+		*waitingSinceNs = aSlice->mStartNs;
+	}
+}
+
+bool platformSchedNext(struct platformSchedSlice *aSlice)
+{
+	if (aSlice->mMaxItems != 0 && aSlice->mItems >= aSlice->mMaxItems)
+		return false;
+
+	//The first item always runs, so that every source makes progress
+	if (aSlice->mItems != 0 && aSlice->mEndNs != UINT64_MAX && platformSchedNowNs() >= aSlice->mEndNs)
+		return false;
+
+	aSlice->mItems++;
+	return true;
+}
+
+void platformSchedGiveBack(struct platformSchedSlice *aSlice)
+{
+	if (aSlice->mItems != 0)
+		aSlice->mItems--;
+}
+
+void platformSchedEnd(struct platformSchedSlice *aSlice, bool aMore)
+{
+	enum posixSchedSource source = aSlice->mSource;
+	uint64_t              now = platformSchedNowNs();
+	struct posixNode     *node = posixNodeCurrent();
+
+	METRICS_ADD(mSchedItems[source], aSlice->mItems);
+	METRICS_ADD(mSchedTimeNs[source], now - aSlice->mStartNs);
+
+	if (now > aSlice->mEndNs)
+		METRICS_INC(mSchedOverruns[source]);
+
+	if (aMore)
+	{
+		METRICS_INC(mSchedYields[source]);
+		node->mSchedYielded |= 1UL << source;
+		if (node->mSchedWaitingSinceNs[source] == 0)
+			node->mSchedWaitingSinceNs[source] = now;
+	}
+	else
+	{
+		node->mSchedYielded &= ~(1UL << source);
+		node->mSchedWaitingSinceNs[source] = 0;
+	}
+}
+
+void platformSchedIdle(enum posixSchedSource aSource)
+{
+	struct posixNode *node = posixNodeCurrent();
+
+	node->mSchedYielded &= ~(1UL << aSource);
+	node->mSchedWaitingSinceNs[aSource] = 0;
+}
+
+void platformSchedMeasure(enum posixSchedSource aSource, uint64_t aStartNs)
+{
+	uint64_t elapsed = platformSchedNowNs() - aStartNs;
+	uint32_t sliceUs = loadBudget(&sBudgets[aSource].mSliceUs);
+
+	METRICS_INC(mSchedItems[aSource]);
+	METRICS_ADD(mSchedTimeNs[aSource], elapsed);
+
+	if (sliceUs && elapsed > sliceUs * 1000ULL)
+		METRICS_INC(mSchedOverruns[aSource]);
+}
+
+void platformSchedWaited(enum posixSchedSource aSource, uint64_t aWaitNs)
+{
+	uint32_t deadlineUs = loadBudget(&sBudgets[aSource].mDeadlineUs);
+
+	if (deadlineUs && aWaitNs > deadlineUs * 1000ULL)
+		METRICS_INC(mSchedStarved[aSource]);
+}
+
+bool platformSchedPending(void)
+{
+	return posixNodeCurrent()->mSchedYielded != 0;
+}
+
+int posixPlatformSchedSetBudget(enum posixSchedSource aSource, const struct posixSchedBudget *aBudget)
+{
+	if ((unsigned)aSource >= POSIX_SCHED_SOURCE_COUNT)
+		return -1;
+
+	__atomic_store_n(&sBudgets[aSource].mItems, aBudget->mItems, __ATOMIC_RELAXED);
+	__atomic_store_n(&sBudgets[aSource].mSliceUs, aBudget->mSliceUs, __ATOMIC_RELAXED);
+	__atomic_store_n(&sBudgets[aSource].mDeadlineUs, aBudget->mDeadlineUs, __ATOMIC_RELAXED);
+	return 0;
+}
+
+int posixPlatformSchedGetBudget(enum posixSchedSource aSource, struct posixSchedBudget *aBudget)
+{
+	if ((unsigned)aSource >= POSIX_SCHED_SOURCE_COUNT)
+		return -1;
+
+	aBudget->mItems = loadBudget(&sBudgets[aSource].mItems);
+	aBudget->mSliceUs = loadBudget(&sBudgets[aSource].mSliceUs);
+	aBudget->mDeadlineUs = loadBudget(&sBudgets[aSource].mDeadlineUs);
+	return 0;
+}
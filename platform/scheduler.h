@@ -0,0 +1,120 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform loop to keep each
+ *   source of work to its budget, see posix-sched.h.
+ */
+
+#ifndef PLATFORM_SCHEDULER_H_
+#define PLATFORM_SCHEDULER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ca821x-posix-thread/posix-sched.h"
+
+/**
+ * A turn of a source of work.
+ *
+ */
+struct platformSchedSlice
+{
+	enum posixSchedSource mSource;
+	uint32_t              mItems;
+	uint32_t              mMaxItems;
+	uint64_t              mStartNs;
+	uint64_t              mEndNs;    ///< When the slice runs out, or UINT64_MAX
+};
+
+/**
+ * This method gets CLOCK_MONOTONIC in nanoseconds.
+ *
+ */
+uint64_t platformSchedNowNs(void);
+
+/**
+ * This method starts the turn of a source.
+ *
+ */
+void platformSchedBegin(struct platformSchedSlice *aSlice, enum posixSchedSource aSource);
+
+/**
+ * This method counts a work item that is ready to run, if the turn has the
+ * budget for it.
+ *
+ * @returns true if the item may run, false if the source should yield.
+ *
+ */
+bool platformSchedNext(struct platformSchedSlice *aSlice);
+
+/**
+ * This method gives back the item counted by the last platformSchedNext, for a
+ * source that then found it had no work left.
+ *
+ */
+void platformSchedGiveBack(struct platformSchedSlice *aSlice);
+
+/**
+ * This method ends the turn of a source.
+ *
+ * @param[in]  aMore  Whether the source has work left, for its next turn.
+ *
+ */
+void platformSchedEnd(struct platformSchedSlice *aSlice, bool aMore);
+
+/**
+ * This method skips the turn of a source that has no work, without timing it.
+ *
+ */
+void platformSchedIdle(enum posixSchedSource aSource);
+
+/**
+ * This method times a source that has no work items, as one turn from
+ * @p aStartNs until now.
+ *
+ */
+void platformSchedMeasure(enum posixSchedSource aSource, uint64_t aStartNs);
+
+/**
+ * This method counts work that waited @p aWaitNs to run as starved, if that
+ * is past the deadline of its source.
+ *
+ */
+void platformSchedWaited(enum posixSchedSource aSource, uint64_t aWaitNs);
+
+/**
+ * This method checks whether a source of the current node yielded with work
+ * left, in which case the loop must not sleep.
+ *
+ */
+bool platformSchedPending(void);
+
+#endif /* PLATFORM_SCHEDULER_H_ */
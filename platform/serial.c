@@ -37,7 +37,10 @@
 #include <signal.h>
 
 #include "openthread/platform/uart.h"
+#include "openthread-core-config.h"
 #include "code_utils.h"
+#include "node.h"
+#include "scheduler.h"
 #include "ca821x-posix-thread/posix-platform.h"
 
 #ifdef OPENTHREAD_TARGET_LINUX
@@ -48,13 +51,13 @@ int unlockpt(int fd);
 char *ptsname(int fd);
 #endif  // OPENTHREAD_TARGET_LINUX
 
-static uint8_t s_receive_buffer[128];
-static const uint8_t *s_write_buffer;
-static uint16_t s_write_length;
-static int s_in_fd;
-static int s_out_fd;
+#ifndef CASCODA_UART_RX_BUFFER_SIZE
+#define CASCODA_UART_RX_BUFFER_SIZE 128
+#endif
 
-static uint8_t s_enabled = false;
+//The terminal settings belong to the process, and so to the default node
+static int s_in_fd = -1;
+static int s_out_fd = -1;
 
 static struct termios original_stdin_termios;
 static struct termios original_stdout_termios;
@@ -77,13 +80,20 @@ void posixPlatformRestoreTerminal(void)
 
 otError otPlatUartEnable(void)
 {
+	struct posixNode *node = posixNodeCurrent();
 	otError error = OT_ERROR_NONE;
     struct termios termios;
 
-    if(s_enabled){
+    if(node->mUartEnabled){
     	return OT_ERROR_ALREADY;
     }
 
+    //Simulated nodes use whatever posixPlatformNodeSetUart gave them, if anything
+    if(node->mSimulated){
+    	node->mUartEnabled = true;
+    	return OT_ERROR_NONE;
+    }
+
 #ifdef OPENTHREAD_TARGET_LINUX
     // Ensure we terminate this process if the
     // parent process dies.
@@ -163,73 +173,112 @@ otError otPlatUartEnable(void)
         otEXPECT_ACTION(tcsetattr(s_out_fd, TCSANOW, &termios) == 0, perror("tcsetattr"); error = OT_ERROR_FAILED);
     }
 
-    if(error == OT_ERROR_NONE) s_enabled = true;
+    if(error == OT_ERROR_NONE) node->mUartEnabled = true;
+    node->mUartInFd = s_in_fd;
+    node->mUartOutFd = s_out_fd;
     return error;
 
 exit:
     close(s_in_fd);
     close(s_out_fd);
-    if(error == OT_ERROR_NONE) s_enabled = true;
+    if(error == OT_ERROR_NONE) node->mUartEnabled = true;
+    node->mUartInFd = s_in_fd;
+    node->mUartOutFd = s_out_fd;
     return error;
 }
 
 otError otPlatUartDisable(void)
 {
+	struct posixNode *node = posixNodeCurrent();
 	otError error = OT_ERROR_NONE;
 
-    close(s_in_fd);
-    close(s_out_fd);
+    if(!node->mSimulated){
+        close(node->mUartInFd);
+        close(node->mUartOutFd);
+        node->mUartInFd = -1;
+        node->mUartOutFd = -1;
+    }
 
-    s_enabled = false;
+    node->mUartEnabled = false;
     return error;
 }
 
 otError otPlatUartSend(const uint8_t *aBuf, uint16_t aBufLength)
 {
+	struct posixNode *node = posixNodeCurrent();
 	otError error = OT_ERROR_NONE;
 
-    otEXPECT_ACTION(s_write_length == 0, error = OT_ERROR_BUSY);
+    otEXPECT_ACTION(node->mUartWriteLength == 0, error = OT_ERROR_BUSY);
 
-    s_write_buffer = aBuf;
-    s_write_length = aBufLength;
+    node->mUartWriteBuffer = aBuf;
+    node->mUartWriteLength = aBufLength;
 
 exit:
     return error;
 }
 
+void platformUartReset(void)
+{
+	struct posixNode *node = posixNodeCurrent();
+
+    node->mUartWriteBuffer = NULL;
+    node->mUartWriteLength = 0;
+}
+
 void platformUartUpdateFdSet(fd_set *aReadFdSet, fd_set *aWriteFdSet, int *aMaxFd)
 {
-    if (aReadFdSet != NULL)
+	struct posixNode *node = posixNodeCurrent();
+
+    if (aReadFdSet != NULL && node->mUartInFd >= 0)
     {
-        FD_SET(s_in_fd, aReadFdSet);
+        FD_SET(node->mUartInFd, aReadFdSet);
 
-        if (aMaxFd != NULL && *aMaxFd < s_in_fd)
+        if (aMaxFd != NULL && *aMaxFd < node->mUartInFd)
         {
-            *aMaxFd = s_in_fd;
+            *aMaxFd = node->mUartInFd;
         }
     }
 
-    if ((aWriteFdSet != NULL) && (s_write_length > 0))
+    if ((aWriteFdSet != NULL) && (node->mUartWriteLength > 0) && node->mUartOutFd >= 0)
     {
-        FD_SET(s_out_fd, aWriteFdSet);
+        FD_SET(node->mUartOutFd, aWriteFdSet);
 
-        if (aMaxFd != NULL && *aMaxFd < s_out_fd)
+        if (aMaxFd != NULL && *aMaxFd < node->mUartOutFd)
         {
-            *aMaxFd = s_out_fd;
+            *aMaxFd = node->mUartOutFd;
         }
     }
 }
 
 void platformUartProcess(void)
 {
+	struct posixNode *node = posixNodeCurrent();
+    //On the stack, as nodes may be processed by several threads at once
+    uint8_t receiveBuffer[CASCODA_UART_RX_BUFFER_SIZE];
+    struct platformSchedSlice slice;
+    bool more = true;
     ssize_t rval;
     const int error_flags = POLLERR | POLLNVAL | POLLHUP;
     struct pollfd pollfd[] =
     {
-        { s_in_fd,  POLLIN  | error_flags, 0 },
-        { s_out_fd, POLLOUT | error_flags, 0 },
+        { node->mUartInFd,  POLLIN  | error_flags, 0 },
+        { node->mUartOutFd, POLLOUT | error_flags, 0 },
     };
 
+    //Without an output, eg. a simulated node without a UART, output is dropped
+    if (node->mUartOutFd < 0 && node->mUartWriteLength > 0)
+    {
+        platformUartReset();
+        otPlatUartSendDone();
+    }
+
+    if (node->mUartInFd < 0 && node->mUartOutFd < 0)
+    {
+        platformSchedIdle(POSIX_SCHED_UART);
+        return;
+    }
+
+    platformSchedBegin(&slice, POSIX_SCHED_UART);
     errno = 0;
 
     rval = poll(pollfd, sizeof(pollfd) / sizeof(*pollfd), 0);
@@ -254,9 +303,10 @@ void platformUartProcess(void)
             exit(EXIT_FAILURE);
         }
 
-        if (pollfd[0].revents & POLLIN)
+        //Each read is an item, so pasted or piped input yields to the other sources
+        while ((pollfd[0].revents & POLLIN) && platformSchedNext(&slice))
         {
-            rval = read(s_in_fd, s_receive_buffer, sizeof(s_receive_buffer));
+            rval = read(node->mUartInFd, receiveBuffer, sizeof(receiveBuffer));
 
             if (rval <= 0)
             {
@@ -264,12 +314,19 @@ void platformUartProcess(void)
                 exit(EXIT_FAILURE);
             }
 
-            otPlatUartReceived(s_receive_buffer, (uint16_t)rval);
+            otPlatUartReceived(receiveBuffer, (uint16_t)rval);
+
+            //The input may be blocking, so only read again if more is waiting
+            if (poll(pollfd, 1, 0) <= 0)
+            {
+                pollfd[0].revents = 0;
+            }
         }
+        more = (pollfd[0].revents & POLLIN) != 0;
 
-        if ((s_write_length > 0) && (pollfd[1].revents & POLLOUT))
+        if ((node->mUartWriteLength > 0) && (pollfd[1].revents & POLLOUT))
         {
-            rval = write(s_out_fd, s_write_buffer, s_write_length);
+            rval = write(node->mUartOutFd, node->mUartWriteBuffer, node->mUartWriteLength);
 
             if (rval <= 0)
             {
@@ -277,13 +334,19 @@ void platformUartProcess(void)
                 exit(EXIT_FAILURE);
             }
 
-            s_write_buffer += (uint16_t)rval;
-            s_write_length -= (uint16_t)rval;
+            node->mUartWriteBuffer += (uint16_t)rval;
+            node->mUartWriteLength -= (uint16_t)rval;
 
-            if (s_write_length == 0)
+            if (node->mUartWriteLength == 0)
             {
                 otPlatUartSendDone();
             }
         }
     }
+    else
+    {
+        more = false;
+    }
+
+    platformSchedEnd(&slice, more);
 }
@@ -42,7 +42,11 @@
 #include "openthread/platform/settings.h"
 
 #include "code_utils.h"
+#include "events.h"
 #include "flash.h"
+#include "metrics.h"
+#include "node.h"
+#include "perf.h"
 
 enum
 {
@@ -102,9 +106,6 @@ struct settingsBlock
 #define SETTINGS_CONFIG_PAGE_NUM                     2
 #endif  // SETTINGS_CONFIG_PAGE_NUM
 
-static uint32_t sSettingsBaseAddress;
-static uint32_t sSettingsUsedSize;
-
 static uint16_t getAlignLength(uint16_t length)
 {
     return (length + 3) & 0xfffc;
@@ -132,25 +133,23 @@ static void initSettings(uint32_t aBase, uint32_t aFlag)
     setSettingsFlag(aBase, aFlag);
 }
 
-static uint32_t swapSettingsBlock(otInstance *aInstance)
+static uint32_t swapSettingsBlock(struct posixNode *aNode)
 {
-    uint32_t oldBase = sSettingsBaseAddress;
+    uint32_t oldBase = aNode->mSettingsBaseAddress;
     uint32_t swapAddress = oldBase;
-    uint32_t usedSize = sSettingsUsedSize;
+    uint32_t usedSize = aNode->mSettingsUsedSize;
     uint8_t pageNum = SETTINGS_CONFIG_PAGE_NUM;
     uint32_t settingsSize = pageNum > 1 ? SETTINGS_CONFIG_PAGE_SIZE * pageNum / 2 :
                             SETTINGS_CONFIG_PAGE_SIZE;
 
-    (void)aInstance;
-
     otEXPECT_ACTION(pageNum > 1, ;);
 
-    sSettingsBaseAddress = (swapAddress == SETTINGS_CONFIG_BASE_ADDRESS) ?
+    aNode->mSettingsBaseAddress = (swapAddress == SETTINGS_CONFIG_BASE_ADDRESS) ?
                            (swapAddress + settingsSize) :
                            SETTINGS_CONFIG_BASE_ADDRESS;
 
-    initSettings(sSettingsBaseAddress, (uint32_t)(kSettingsInSwap));
-    sSettingsUsedSize = kSettingsFlagSize;
+    initSettings(aNode->mSettingsBaseAddress, (uint32_t)(kSettingsInSwap));
+    aNode->mSettingsUsedSize = kSettingsFlagSize;
     swapAddress += kSettingsFlagSize;
 
     while (swapAddress < (oldBase + usedSize))
@@ -189,10 +188,10 @@ static uint32_t swapSettingsBlock(otInstance *aInstance)
             if (valid)
             {
                 utilsFlashRead(swapAddress, addBlock.data, getAlignLength(addBlock.block.length));
-                utilsFlashWrite(sSettingsBaseAddress + sSettingsUsedSize,
+                utilsFlashWrite(aNode->mSettingsBaseAddress + aNode->mSettingsUsedSize,
                                 (uint8_t *)(&addBlock),
                                 getAlignLength(addBlock.block.length) + sizeof(struct settingsBlock));
-                sSettingsUsedSize += (sizeof(struct settingsBlock) + getAlignLength(addBlock.block.length));
+                aNode->mSettingsUsedSize += (sizeof(struct settingsBlock) + getAlignLength(addBlock.block.length));
             }
         }
         else if (addBlock.block.flag == 0xff)
@@ -203,14 +202,23 @@ static uint32_t swapSettingsBlock(otInstance *aInstance)
         swapAddress += getAlignLength(addBlock.block.length);
     }
 
-    setSettingsFlag(sSettingsBaseAddress, (uint32_t)(kSettingsInUse));
+    setSettingsFlag(aNode->mSettingsBaseAddress, (uint32_t)(kSettingsInUse));
     setSettingsFlag(oldBase, (uint32_t)(kSettingsNotUse));
 
 exit:
-    return settingsSize - sSettingsUsedSize;
+    return settingsSize - aNode->mSettingsUsedSize;
 }
 
-static otError addSetting(otInstance *aInstance, uint16_t aKey, bool aIndex0, const uint8_t *aValue,
+//Flash has no instance argument, so settings make the node of their instance current
+static struct posixNode *settingsNode(otInstance *aInstance)
+{
+    struct posixNode *node = posixNodeFromInstance(aInstance);
+
+    posixNodeEnter(node);
+    return node;
+}
+
+static otError addSetting(struct posixNode *aNode, uint16_t aKey, bool aIndex0, const uint8_t *aValue,
                               uint16_t aValueLength)
 {
     otError error = OT_ERROR_NONE;
@@ -235,28 +243,28 @@ static otError addSetting(otInstance *aInstance, uint16_t aKey, bool aIndex0, co
     addBlock.block.flag &= (~kBlockAddBeginFlag);
     addBlock.block.length = aValueLength;
 
-    if ((sSettingsUsedSize + getAlignLength(addBlock.block.length) + sizeof(struct settingsBlock)) >=
+    if ((aNode->mSettingsUsedSize + getAlignLength(addBlock.block.length) + sizeof(struct settingsBlock)) >=
         settingsSize)
     {
-        otEXPECT_ACTION(swapSettingsBlock(aInstance) >= (getAlignLength(addBlock.block.length) + sizeof(struct settingsBlock)),
+        otEXPECT_ACTION(swapSettingsBlock(aNode) >= (getAlignLength(addBlock.block.length) + sizeof(struct settingsBlock)),
                      error = OT_ERROR_NO_BUFS);
     }
 
-    utilsFlashWrite(sSettingsBaseAddress + sSettingsUsedSize,
+    utilsFlashWrite(aNode->mSettingsBaseAddress + aNode->mSettingsUsedSize,
                     (uint8_t *)(&addBlock.block),
                     sizeof(struct settingsBlock));
 
     memset(addBlock.data, 0xff, kSettingsBlockDataSize);
     memcpy(addBlock.data, aValue, addBlock.block.length);
 
-    utilsFlashWrite(sSettingsBaseAddress + sSettingsUsedSize + sizeof(struct settingsBlock),
+    utilsFlashWrite(aNode->mSettingsBaseAddress + aNode->mSettingsUsedSize + sizeof(struct settingsBlock),
                     (uint8_t *)(addBlock.data), getAlignLength(addBlock.block.length));
 
     addBlock.block.flag &= (~kBlockAddCompleteFlag);
-    utilsFlashWrite(sSettingsBaseAddress + sSettingsUsedSize,
+    utilsFlashWrite(aNode->mSettingsBaseAddress + aNode->mSettingsUsedSize,
                     (uint8_t *)(&addBlock.block),
                     sizeof(struct settingsBlock));
-    sSettingsUsedSize += (sizeof(struct settingsBlock) + getAlignLength(addBlock.block.length));
+    aNode->mSettingsUsedSize += (sizeof(struct settingsBlock) + getAlignLength(addBlock.block.length));
 
 exit:
     return error;
@@ -269,10 +277,9 @@ void otPlatSettingsInit(otInstance *aInstance)
     uint32_t settingsSize = SETTINGS_CONFIG_PAGE_NUM > 1 ?
                             SETTINGS_CONFIG_PAGE_SIZE * SETTINGS_CONFIG_PAGE_NUM / 2 :
                             SETTINGS_CONFIG_PAGE_SIZE;
+    struct posixNode *node = settingsNode(aInstance);
 
-    (void)aInstance;
-
-    sSettingsBaseAddress = SETTINGS_CONFIG_BASE_ADDRESS;
+    node->mSettingsBaseAddress = SETTINGS_CONFIG_BASE_ADDRESS;
 
     utilsFlashInit();
 
@@ -280,8 +287,8 @@ void otPlatSettingsInit(otInstance *aInstance)
     {
         uint32_t blockFlag;
 
-        sSettingsBaseAddress += settingsSize * index;
-        utilsFlashRead(sSettingsBaseAddress, (uint8_t *)(&blockFlag), sizeof(blockFlag));
+        node->mSettingsBaseAddress += settingsSize * index;
+        utilsFlashRead(node->mSettingsBaseAddress, (uint8_t *)(&blockFlag), sizeof(blockFlag));
 
         if (blockFlag == kSettingsInUse)
         {
@@ -291,21 +298,21 @@ void otPlatSettingsInit(otInstance *aInstance)
 
     if (index == 2)
     {
-        initSettings(sSettingsBaseAddress, (uint32_t)(kSettingsInUse));
+        initSettings(node->mSettingsBaseAddress, (uint32_t)(kSettingsInUse));
     }
 
-    sSettingsUsedSize = kSettingsFlagSize;
+    node->mSettingsUsedSize = kSettingsFlagSize;
 
-    while (sSettingsUsedSize < settingsSize)
+    while (node->mSettingsUsedSize < settingsSize)
     {
         struct settingsBlock block;
 
-        utilsFlashRead(sSettingsBaseAddress + sSettingsUsedSize,
+        utilsFlashRead(node->mSettingsBaseAddress + node->mSettingsUsedSize,
                        (uint8_t *)(&block), sizeof(block));
 
         if (!(block.flag & kBlockAddBeginFlag))
         {
-            sSettingsUsedSize += (getAlignLength(block.length) + sizeof(struct settingsBlock));
+            node->mSettingsUsedSize += (getAlignLength(block.length) + sizeof(struct settingsBlock));
         }
         else
         {
@@ -332,16 +339,15 @@ otError otPlatSettingsAbandonChange(otInstance *aInstance)
     return OT_ERROR_NONE;
 }
 
-otError otPlatSettingsGet(otInstance *aInstance, uint16_t aKey, int aIndex, uint8_t *aValue, uint16_t *aValueLength)
+//Not counted as a settings get, so otPlatSettingsAdd can use it
+static otError getSetting(struct posixNode *aNode, uint16_t aKey, int aIndex, uint8_t *aValue, uint16_t *aValueLength)
 {
     otError error = OT_ERROR_NOT_FOUND;
-    uint32_t address = sSettingsBaseAddress + kSettingsFlagSize;
+    uint32_t address = aNode->mSettingsBaseAddress + kSettingsFlagSize;
     uint16_t valueLength = 0;
     int index = 0;
 
-    (void)aInstance;
-
-    while (address < (sSettingsBaseAddress + sSettingsUsedSize))
+    while (address < (aNode->mSettingsBaseAddress + aNode->mSettingsUsedSize))
     {
         struct settingsBlock block;
 
@@ -391,29 +397,70 @@ otError otPlatSettingsGet(otInstance *aInstance, uint16_t aKey, int aIndex, uint
     return error;
 }
 
+otError otPlatSettingsGet(otInstance *aInstance, uint16_t aKey, int aIndex, uint8_t *aValue, uint16_t *aValueLength)
+{
+    otError error;
+    struct platformPerfSample perf;
+
+    METRICS_INC(mSettingsGets);
+    platformPerfBegin(&perf);
+    error = getSetting(settingsNode(aInstance), aKey, aIndex, aValue, aValueLength);
+    platformPerfEnd(POSIX_PERF_SETTINGS_GET, &perf);
+    return error;
+}
+
 otError otPlatSettingsSet(otInstance *aInstance, uint16_t aKey, const uint8_t *aValue, uint16_t aValueLength)
 {
-    return addSetting(aInstance, aKey, true, aValue, aValueLength);
+    otError error;
+    struct platformPerfSample perf;
+
+    METRICS_INC(mSettingsSets);
+    platformPerfBegin(&perf);
+    error = addSetting(settingsNode(aInstance), aKey, true, aValue, aValueLength);
+
+    if (error == OT_ERROR_NONE)
+    {
+        platformEventSettings(aKey, POSIX_EVENT_SETTINGS_SET);
+    }
+
+    platformPerfEnd(POSIX_PERF_SETTINGS_SET, &perf);
+    return error;
 }
 
 otError otPlatSettingsAdd(otInstance *aInstance, uint16_t aKey, const uint8_t *aValue, uint16_t aValueLength)
 {
     uint16_t length;
     bool index0;
+    otError error;
+    struct platformPerfSample perf;
+
+    METRICS_INC(mSettingsSets);
+    platformPerfBegin(&perf);
 
-    index0 = (otPlatSettingsGet(aInstance, aKey, 0, NULL, &length) == OT_ERROR_NOT_FOUND ? true : false);
-    return addSetting(aInstance, aKey, index0, aValue, aValueLength);
+    index0 = (getSetting(settingsNode(aInstance), aKey, 0, NULL, &length) == OT_ERROR_NOT_FOUND ? true : false);
+    error = addSetting(settingsNode(aInstance), aKey, index0, aValue, aValueLength);
+
+    if (error == OT_ERROR_NONE)
+    {
+        platformEventSettings(aKey, POSIX_EVENT_SETTINGS_ADD);
+    }
+
+    platformPerfEnd(POSIX_PERF_SETTINGS_SET, &perf);
+    return error;
 }
 
 otError otPlatSettingsDelete(otInstance *aInstance, uint16_t aKey, int aIndex)
 {
+    struct posixNode *node = settingsNode(aInstance);
     otError error = OT_ERROR_NOT_FOUND;
-    uint32_t address = sSettingsBaseAddress + kSettingsFlagSize;
+    uint32_t address = node->mSettingsBaseAddress + kSettingsFlagSize;
     int index = 0;
+    struct platformPerfSample perf;
 
-    (void)aInstance;
+    METRICS_INC(mSettingsDeletes);
+    platformPerfBegin(&perf);
 
-    while (address < (sSettingsBaseAddress + sSettingsUsedSize))
+    while (address < (node->mSettingsBaseAddress + node->mSettingsUsedSize))
     {
         struct settingsBlock block;
 
@@ -448,13 +495,26 @@ otError otPlatSettingsDelete(otInstance *aInstance, uint16_t aKey, int aIndex)
         address += (getAlignLength(block.length) + sizeof(struct settingsBlock));
     }
 
+    if (error == OT_ERROR_NONE)
+    {
+        platformEventSettings(aKey, POSIX_EVENT_SETTINGS_DELETE);
+    }
+
+    platformPerfEnd(POSIX_PERF_SETTINGS_DELETE, &perf);
     return error;
 }
 
 void otPlatSettingsWipe(otInstance *aInstance)
 {
-    initSettings(sSettingsBaseAddress, (uint32_t)(kSettingsInUse));
+    struct posixNode *node = settingsNode(aInstance);
+    struct platformPerfSample perf;
+
+    METRICS_INC(mSettingsWipes);
+    platformPerfBegin(&perf);
+    initSettings(node->mSettingsBaseAddress, (uint32_t)(kSettingsInUse));
     otPlatSettingsInit(aInstance);
+    platformEventSettings(0, POSIX_EVENT_SETTINGS_WIPE);
+    platformPerfEnd(POSIX_PERF_SETTINGS_WIPE, &perf);
 }
 
 
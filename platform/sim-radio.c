@@ -0,0 +1,985 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements a simulated 802.15.4 medium for simulated nodes. It
+ *   stands in for the CA-821x behind each node's ca821x_dev, answering the
+ *   MAC primitives the radio layer uses, so radio.c runs unmodified on top.
+ *
+ *   It is a functional model rather than a timing one: frames are delivered
+ *   to every node on the same channel that can hear the sender, addressed to
+ *   it and listening, without collisions or security processing. Indirect
+ *   frames are held until polled for, and scans complete at once.
+ *
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "openthread/platform/alarm-milli.h"
+#include "ca821x_api.h"
+#include "mac_messages.h"
+#include "ieee_802_15_4.h"
+#include "node.h"
+#include "scheduler.h"
+#include "sim-radio.h"
+
+#define SIM_DEFAULT_LINK_QUALITY  0xD0
+#define SIM_INDIRECT_TIMEOUT_MS   7680  //macTransactionPersistenceTime at its default
+#define SIM_MAX_BEACON_PAYLOAD    52
+#define SIM_BROADCAST             0xFFFF
+
+enum
+{
+	SIM_TXOPT_ACKREQ   = 0x01,
+	SIM_TXOPT_INDIRECT = 0x04,
+};
+
+enum
+{
+	SIM_SCAN_ED      = 0,
+	SIM_SCAN_ACTIVE  = 1,
+	SIM_SCAN_PASSIVE = 2,
+};
+
+enum
+{
+	SIM_ADDR_MODE_SHORT = 2,
+	SIM_ADDR_MODE_EXT   = 3,
+};
+
+struct simMessage
+{
+	struct simMessage *mNext;
+	uint16_t           mLength;
+	uint8_t            mBuf[];
+};
+
+struct simAttribute
+{
+	struct simAttribute *mNext;
+	uint8_t              mAttribute;
+	uint8_t              mIndex;
+	uint8_t              mLength;
+	uint8_t              mValue[];
+};
+
+struct simIndirect
+{
+	struct simIndirect *mNext;
+	uint32_t            mExpiry;
+	uint16_t            mLength;
+	uint8_t             mDsn;       //Given when requested, as by the real MAC
+	uint8_t             mRequest[]; //The whole MCPS-DATA.request
+};
+
+struct simLink
+{
+	struct simLink   *mNext;
+	struct posixNode *mFrom;
+	uint8_t           mLinkQuality;
+};
+
+struct simRadio
+{
+	struct posixNode    *mNode;
+	struct simRadio     *mNext;
+
+	uint8_t              mChannel;
+	uint16_t             mPanId;
+	uint16_t             mShortAddress;
+	uint8_t              mExtAddress[8];
+	bool                 mRxOnWhenIdle;
+	bool                 mStarted;
+	bool                 mPanCoordinator;
+	uint8_t              mDsn;
+	uint8_t              mBsn;
+	uint8_t              mBeaconPayloadLength;
+	uint8_t              mBeaconPayload[SIM_MAX_BEACON_PAYLOAD];
+	struct simAttribute *mAttributes;
+
+	struct simIndirect  *mIndirect;
+	struct simMessage   *mQueueHead;
+	struct simMessage   *mQueueTail;
+	struct simLink      *mLinks;      //Links into this node that differ from the default
+};
+
+//The medium is shared by every thread servicing nodes, and all of it is under one lock
+static pthread_mutex_t  sMediumMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct simRadio *sMedium = NULL;
+static uint8_t          sDefaultLinkQuality = SIM_DEFAULT_LINK_QUALITY;
+
+static uint16_t getLe16(const uint8_t *aBuf)
+{
+	return (uint16_t)(aBuf[0] | (aBuf[1] << 8));
+}
+
+static void putLe16(uint8_t *aBuf, uint16_t aValue)
+{
+	aBuf[0] = aValue & 0xFF;
+	aBuf[1] = aValue >> 8;
+}
+
+static uint8_t linkQuality(struct simRadio *aFrom, struct simRadio *aTo)
+{
+	for (struct simLink *link = aTo->mLinks; link != NULL; link = link->mNext)
+	{
+		if (link->mFrom == aFrom->mNode)
+			return link->mLinkQuality;
+	}
+
+	return sDefaultLinkQuality;
+}
+
+static bool addressMatches(struct simRadio *aRadio, const struct FullAddr *aAddress)
+{
+	uint16_t panId = getLe16(aAddress->PANId);
+
+	if (panId != SIM_BROADCAST && panId != aRadio->mPanId)
+		return false;
+
+	switch (aAddress->AddressMode)
+	{
+	case SIM_ADDR_MODE_SHORT:
+	{
+		uint16_t shortAddress = getLe16(aAddress->Address);
+		return shortAddress == SIM_BROADCAST || shortAddress == aRadio->mShortAddress;
+	}
+
+	case SIM_ADDR_MODE_EXT:
+		return memcmp(aAddress->Address, aRadio->mExtAddress, sizeof(aRadio->mExtAddress)) == 0;
+
+	default:
+		//Frames without a destination go to the PAN coordinator
+		return aRadio->mPanCoordinator;
+	}
+}
+
+static bool isBroadcast(const struct FullAddr *aAddress)
+{
+	return aAddress->AddressMode == SIM_ADDR_MODE_SHORT && getLe16(aAddress->Address) == SIM_BROADCAST;
+}
+
+static void enqueue(struct simRadio *aRadio, const uint8_t *aBuf, uint16_t aLength)
+{
+	struct simMessage *message = malloc(sizeof(*message) + aLength);
+
+	if (message == NULL)
+		return;
+
+	message->mNext = NULL;
+	message->mLength = aLength;
+	memcpy(message->mBuf, aBuf, aLength);
+
+	if (aRadio->mQueueTail)
+		aRadio->mQueueTail->mNext = message;
+	else
+		aRadio->mQueueHead = message;
+	aRadio->mQueueTail = message;
+
+	posixNodeWake(aRadio->mNode);
+}
+
+static void queueDataConfirm(struct simRadio *aRadio, uint8_t aMsduHandle, uint8_t aStatus)
+{
+	uint8_t msg[2 + sizeof(struct MCPS_DATA_confirm_pset)] = {0};
+	struct MCPS_DATA_confirm_pset *dataCnf = (struct MCPS_DATA_confirm_pset *)(msg + 2);
+
+	msg[0] = SPI_MCPS_DATA_CONFIRM;
+	msg[1] = sizeof(*dataCnf);
+	dataCnf->MsduHandle = aMsduHandle;
+	dataCnf->Status = aStatus;
+
+	enqueue(aRadio, msg, sizeof(msg));
+}
+
+static void queueDataIndication(struct simRadio *aFrom,
+                                struct simRadio *aTo,
+                                const uint8_t   *aRequest,
+                                uint16_t         aRequestLength,
+                                uint8_t          aDsn,
+                                uint8_t          aLinkQuality)
+{
+	const struct MCPS_DATA_request_pset *dataReq = (const struct MCPS_DATA_request_pset *)(aRequest + 2);
+	uint8_t msg[2 + sizeof(struct MCPS_DATA_indication_pset) + sizeof(struct SecSpec)] = {0};
+	struct MCPS_DATA_indication_pset *dataInd = (struct MCPS_DATA_indication_pset *)(msg + 2);
+	size_t securityOffset = 2 + offsetof(struct MCPS_DATA_request_pset, Msdu) + dataReq->MsduLength;
+	size_t securityLength = 0;
+
+	dataInd->Src.AddressMode = dataReq->SrcAddrMode;
+	putLe16(dataInd->Src.PANId, aFrom->mPanId);
+
+	if (dataReq->SrcAddrMode == SIM_ADDR_MODE_SHORT)
+		putLe16(dataInd->Src.Address, aFrom->mShortAddress);
+	else if (dataReq->SrcAddrMode == SIM_ADDR_MODE_EXT)
+		memcpy(dataInd->Src.Address, aFrom->mExtAddress, sizeof(aFrom->mExtAddress));
+
+	dataInd->Dst = dataReq->Dst;
+	dataInd->MsduLength = dataReq->MsduLength;
+	dataInd->MpduLinkQuality = aLinkQuality;
+	dataInd->DSN = aDsn;
+	memcpy(dataInd->Msdu, dataReq->Msdu, dataReq->MsduLength);
+
+	//The security spec follows the MSDU, and is cut short when security is off
+	if (aRequestLength > securityOffset)
+	{
+		securityLength = aRequestLength - securityOffset;
+		if (securityLength > sizeof(struct SecSpec))
+			securityLength = sizeof(struct SecSpec);
+		memcpy(dataInd->Msdu + dataReq->MsduLength, aRequest + securityOffset, securityLength);
+	}
+
+	msg[0] = SPI_MCPS_DATA_INDICATION;
+	msg[1] = offsetof(struct MCPS_DATA_indication_pset, Msdu) + dataReq->MsduLength + sizeof(struct SecSpec);
+
+	enqueue(aTo, msg, 2 + msg[1]);
+}
+
+static uint8_t transmit(struct simRadio *aFrom, const uint8_t *aRequest, uint16_t aRequestLength)
+{
+	const struct MCPS_DATA_request_pset *dataReq = (const struct MCPS_DATA_request_pset *)(aRequest + 2);
+	uint8_t dsn = aFrom->mDsn++;
+	bool acked = false;
+
+	for (struct simRadio *to = sMedium; to != NULL; to = to->mNext)
+	{
+		uint8_t lq;
+
+		if (to == aFrom || to->mChannel != aFrom->mChannel || !to->mRxOnWhenIdle)
+			continue;
+
+		if ((lq = linkQuality(aFrom, to)) == 0 || !addressMatches(to, &dataReq->Dst))
+			continue;
+
+		queueDataIndication(aFrom, to, aRequest, aRequestLength, dsn, lq);
+		acked = true;
+	}
+
+	if ((dataReq->TxOptions & SIM_TXOPT_ACKREQ) && !isBroadcast(&dataReq->Dst) && !acked)
+		return MAC_NO_ACK;
+
+	return MAC_SUCCESS;
+}
+
+static void dataRequest(struct simRadio *aRadio, const uint8_t *aRequest, uint16_t aRequestLength)
+{
+	const struct MCPS_DATA_request_pset *dataReq = (const struct MCPS_DATA_request_pset *)(aRequest + 2);
+	struct simIndirect *indirect;
+
+	if (!(dataReq->TxOptions & SIM_TXOPT_INDIRECT))
+	{
+		queueDataConfirm(aRadio, dataReq->MsduHandle, transmit(aRadio, aRequest, aRequestLength));
+		return;
+	}
+
+	//Held until the destination polls for it
+	indirect = malloc(sizeof(*indirect) + aRequestLength);
+	if (indirect == NULL)
+	{
+		queueDataConfirm(aRadio, dataReq->MsduHandle, MAC_TRANSACTION_OVERFLOW);
+		return;
+	}
+
+	indirect->mExpiry = otPlatAlarmMilliGetNow() + SIM_INDIRECT_TIMEOUT_MS;
+	indirect->mLength = aRequestLength;
+	indirect->mDsn = aRadio->mDsn++;
+	memcpy(indirect->mRequest, aRequest, aRequestLength);
+	indirect->mNext = aRadio->mIndirect;
+	aRadio->mIndirect = indirect;
+}
+
+static uint8_t pollRequest(struct simRadio *aRadio, const struct FullAddr *aCoordAddress)
+{
+	struct simRadio *coord;
+	struct simIndirect **found = NULL;
+	struct simIndirect *indirect;
+	const struct MCPS_DATA_request_pset *dataReq;
+
+	for (coord = sMedium; coord != NULL; coord = coord->mNext)
+	{
+		if (coord != aRadio && coord->mChannel == aRadio->mChannel && addressMatches(coord, aCoordAddress) &&
+		    linkQuality(aRadio, coord) != 0)
+			break;
+	}
+
+	if (coord == NULL)
+		return MAC_NO_ACK;
+
+	//New frames are pushed to the front, so the last match is the oldest
+	for (struct simIndirect **link = &coord->mIndirect; *link != NULL; link = &(*link)->mNext)
+	{
+		dataReq = (const struct MCPS_DATA_request_pset *)((*link)->mRequest + 2);
+		if (addressMatches(aRadio, &dataReq->Dst))
+			found = link;
+	}
+
+	if (found == NULL)
+		return MAC_NO_DATA;
+
+	indirect = *found;
+	*found = indirect->mNext;
+	dataReq = (const struct MCPS_DATA_request_pset *)(indirect->mRequest + 2);
+
+	queueDataIndication(coord, aRadio, indirect->mRequest, indirect->mLength, indirect->mDsn, linkQuality(coord, aRadio));
+	queueDataConfirm(coord, dataReq->MsduHandle, MAC_SUCCESS);
+	free(indirect);
+
+	return MAC_SUCCESS;
+}
+
+static uint8_t purgeRequest(struct simRadio *aRadio, uint8_t aMsduHandle)
+{
+	for (struct simIndirect **link = &aRadio->mIndirect; *link != NULL; link = &(*link)->mNext)
+	{
+		struct simIndirect *indirect = *link;
+
+		if (((const struct MCPS_DATA_request_pset *)(indirect->mRequest + 2))->MsduHandle == aMsduHandle)
+		{
+			*link = indirect->mNext;
+			free(indirect);
+			return MAC_SUCCESS;
+		}
+	}
+
+	return MAC_INVALID_HANDLE;
+}
+
+static void queueBeacon(struct simRadio *aScanner, struct simRadio *aCoord, uint8_t aLinkQuality)
+{
+	uint8_t msg[2 + 255] = {0};
+	struct MLME_BEACON_NOTIFY_indication_pset *beaconInd = (struct MLME_BEACON_NOTIFY_indication_pset *)(msg + 2);
+	struct PanDescriptor *panDesc = &beaconInd->PanDescriptor;
+	uint8_t *pendAddrSpec;
+
+	beaconInd->BSN = aCoord->mBsn++;
+	panDesc->Coord.AddressMode = SIM_ADDR_MODE_SHORT;
+	putLe16(panDesc->Coord.PANId, aCoord->mPanId);
+	putLe16(panDesc->Coord.Address, aCoord->mShortAddress);
+	panDesc->LogicalChannel = aCoord->mChannel;
+	//Beaconless PAN: beacon and superframe order 15, final CAP slot 15
+	putLe16(panDesc->SuperframeSpec, 0x0FFF | (aCoord->mPanCoordinator ? 0x4000 : 0));
+	panDesc->LinkQuality = aLinkQuality;
+
+	//Without security, the pending address spec follows the security level directly
+	pendAddrSpec = &panDesc->Security.SecurityLevel + 1;
+	pendAddrSpec[0] = 0;
+	pendAddrSpec[1] = aCoord->mBeaconPayloadLength;
+	memcpy(pendAddrSpec + 2, aCoord->mBeaconPayload, aCoord->mBeaconPayloadLength);
+
+	msg[0] = SPI_MLME_BEACON_NOTIFY_INDICATION;
+	msg[1] = (pendAddrSpec + 2 + aCoord->mBeaconPayloadLength) - (msg + 2);
+
+	enqueue(aScanner, msg, 2 + msg[1]);
+}
+
+static void scanRequest(struct simRadio *aRadio, const struct MLME_SCAN_request_pset *aScanReq)
+{
+	uint8_t msg[2 + sizeof(struct MLME_SCAN_confirm_pset)] = {0};
+	struct MLME_SCAN_confirm_pset *scanCnf = (struct MLME_SCAN_confirm_pset *)(msg + 2);
+	uint32_t channels = aScanReq->ScanChannels[0] | (aScanReq->ScanChannels[1] << 8) |
+	                    (aScanReq->ScanChannels[2] << 16) | ((uint32_t)aScanReq->ScanChannels[3] << 24);
+	uint8_t beacons = 0;
+
+	scanCnf->Status = MAC_SUCCESS;
+	scanCnf->ScanType = aScanReq->ScanType;
+
+	for (uint8_t channel = 11; channel <= 26; channel++)
+	{
+		uint16_t energy = 0;
+
+		if (!(channels & (1UL << channel)))
+			continue;
+
+		for (struct simRadio *other = sMedium; other != NULL; other = other->mNext)
+		{
+			uint8_t lq;
+
+			if (other == aRadio || other->mChannel != channel || (lq = linkQuality(other, aRadio)) == 0)
+				continue;
+
+			//Energy is modelled as how busy the channel is with audible nodes
+			energy += 0x20;
+
+			if ((aScanReq->ScanType == SIM_SCAN_ACTIVE || aScanReq->ScanType == SIM_SCAN_PASSIVE) && other->mStarted)
+			{
+				queueBeacon(aRadio, other, lq);
+				beacons++;
+			}
+		}
+
+		if (aScanReq->ScanType == SIM_SCAN_ED)
+			scanCnf->ResultList[scanCnf->ResultListSize++] = energy > 0xFF ? 0xFF : energy;
+	}
+
+	if (aScanReq->ScanType != SIM_SCAN_ED && beacons == 0)
+		scanCnf->Status = MAC_NO_BEACON;
+
+	msg[0] = SPI_MLME_SCAN_CONFIRM;
+	msg[1] = offsetof(struct MLME_SCAN_confirm_pset, ResultList) + scanCnf->ResultListSize;
+
+	enqueue(aRadio, msg, 2 + msg[1]);
+}
+
+static struct simAttribute **findAttribute(struct simRadio *aRadio, uint8_t aAttribute, uint8_t aIndex)
+{
+	struct simAttribute **link;
+
+	for (link = &aRadio->mAttributes; *link != NULL; link = &(*link)->mNext)
+	{
+		if ((*link)->mAttribute == aAttribute && (*link)->mIndex == aIndex)
+			break;
+	}
+
+	return link;
+}
+
+static uint8_t setRequest(struct simRadio *aRadio, const struct MLME_SET_request_pset *aSetReq)
+{
+	const uint8_t *value = aSetReq->PIBAttributeValue;
+	uint8_t length = aSetReq->PIBAttributeLength;
+	struct simAttribute **link;
+	struct simAttribute *attribute;
+
+	switch (aSetReq->PIBAttribute)
+	{
+	case phyCurrentChannel:
+		aRadio->mChannel = value[0];
+		return MAC_SUCCESS;
+
+	case macPANId:
+		aRadio->mPanId = getLe16(value);
+		return MAC_SUCCESS;
+
+	case macShortAddress:
+		aRadio->mShortAddress = getLe16(value);
+		return MAC_SUCCESS;
+
+	case macRxOnWhenIdle:
+		aRadio->mRxOnWhenIdle = value[0];
+		return MAC_SUCCESS;
+
+	case nsIEEEAddress:
+		memcpy(aRadio->mExtAddress, value, sizeof(aRadio->mExtAddress));
+		return MAC_SUCCESS;
+
+	case macDSN:
+		aRadio->mDsn = value[0];
+		return MAC_SUCCESS;
+
+	case macBeaconPayload:
+		if (length > SIM_MAX_BEACON_PAYLOAD)
+			return MAC_INVALID_PARAMETER;
+		memcpy(aRadio->mBeaconPayload, value, length);
+		aRadio->mBeaconPayloadLength = length;
+		return MAC_SUCCESS;
+
+	case macBeaconPayloadLength:
+		if (value[0] > SIM_MAX_BEACON_PAYLOAD)
+			return MAC_INVALID_PARAMETER;
+		aRadio->mBeaconPayloadLength = value[0];
+		return MAC_SUCCESS;
+	}
+
+	//Everything else (eg. the security tables) is only stored to be read back
+	link = findAttribute(aRadio, aSetReq->PIBAttribute, aSetReq->PIBAttributeIndex);
+	attribute = realloc(*link, sizeof(*attribute) + length);
+	if (attribute == NULL)
+		return MAC_SYSTEM_ERROR;
+
+	if (*link == NULL)
+		attribute->mNext = NULL;
+
+	attribute->mAttribute = aSetReq->PIBAttribute;
+	attribute->mIndex = aSetReq->PIBAttributeIndex;
+	attribute->mLength = length;
+	memcpy(attribute->mValue, value, length);
+	*link = attribute;
+
+	return MAC_SUCCESS;
+}
+
+static void getRequest(struct simRadio *aRadio, const struct MLME_GET_request_pset *aGetReq, struct MLME_GET_confirm_pset *aGetCnf)
+{
+	uint8_t *value = aGetCnf->PIBAttributeValue;
+	struct simAttribute *attribute;
+
+	aGetCnf->Status = MAC_SUCCESS;
+	aGetCnf->PIBAttribute = aGetReq->PIBAttribute;
+	aGetCnf->PIBAttributeIndex = aGetReq->PIBAttributeIndex;
+
+	switch (aGetReq->PIBAttribute)
+	{
+	case phyCurrentChannel:
+		value[0] = aRadio->mChannel;
+		aGetCnf->PIBAttributeLength = 1;
+		return;
+
+	case macPANId:
+		putLe16(value, aRadio->mPanId);
+		aGetCnf->PIBAttributeLength = 2;
+		return;
+
+	case macShortAddress:
+		putLe16(value, aRadio->mShortAddress);
+		aGetCnf->PIBAttributeLength = 2;
+		return;
+
+	case macRxOnWhenIdle:
+		value[0] = aRadio->mRxOnWhenIdle;
+		aGetCnf->PIBAttributeLength = 1;
+		return;
+
+	case nsIEEEAddress:
+		memcpy(value, aRadio->mExtAddress, sizeof(aRadio->mExtAddress));
+		aGetCnf->PIBAttributeLength = sizeof(aRadio->mExtAddress);
+		return;
+
+	case macDSN:
+		value[0] = aRadio->mDsn;
+		aGetCnf->PIBAttributeLength = 1;
+		return;
+
+	case macBeaconPayload:
+		memcpy(value, aRadio->mBeaconPayload, aRadio->mBeaconPayloadLength);
+		aGetCnf->PIBAttributeLength = aRadio->mBeaconPayloadLength;
+		return;
+
+	case macBeaconPayloadLength:
+		value[0] = aRadio->mBeaconPayloadLength;
+		aGetCnf->PIBAttributeLength = 1;
+		return;
+	}
+
+	attribute = *findAttribute(aRadio, aGetReq->PIBAttribute, aGetReq->PIBAttributeIndex);
+	if (attribute != NULL)
+	{
+		memcpy(value, attribute->mValue, attribute->mLength);
+		aGetCnf->PIBAttributeLength = attribute->mLength;
+	}
+	else if (aGetReq->PIBAttributeIndex > 0)
+	{
+		//Table entries that were never written are past the end of the table
+		aGetCnf->Status = MAC_INVALID_INDEX;
+		aGetCnf->PIBAttributeLength = 0;
+	}
+	else
+	{
+		value[0] = 0;
+		aGetCnf->PIBAttributeLength = 1;
+	}
+}
+
+static void resetRequest(struct simRadio *aRadio)
+{
+	struct simIndirect *indirect;
+	struct simAttribute *attribute;
+
+	while ((indirect = aRadio->mIndirect) != NULL)
+	{
+		aRadio->mIndirect = indirect->mNext;
+		free(indirect);
+	}
+
+	while ((attribute = aRadio->mAttributes) != NULL)
+	{
+		aRadio->mAttributes = attribute->mNext;
+		free(attribute);
+	}
+
+	//The extended address is the device's own, so survives a reset
+	aRadio->mChannel = 11;
+	aRadio->mPanId = SIM_BROADCAST;
+	aRadio->mShortAddress = SIM_BROADCAST;
+	aRadio->mRxOnWhenIdle = false;
+	aRadio->mStarted = false;
+	aRadio->mPanCoordinator = false;
+	aRadio->mBeaconPayloadLength = 0;
+}
+
+//The confirm for requests the medium has nothing to model for
+static uint8_t confirmFor(uint8_t aRequest)
+{
+	switch (aRequest)
+	{
+	case SPI_MLME_RX_ENABLE_REQUEST:
+		return SPI_MLME_RX_ENABLE_CONFIRM;
+	case SPI_TDME_SETSFR_REQUEST:
+		return SPI_TDME_SETSFR_CONFIRM;
+	case SPI_TDME_GETSFR_REQUEST:
+		return SPI_TDME_GETSFR_CONFIRM;
+	default:
+		return aRequest | 0x10;
+	}
+}
+
+static int simDownstream(const uint8_t *buf, size_t len, uint8_t *response, struct ca821x_dev *pDeviceRef)
+{
+	struct simRadio *radio = posixNodeFromDevice(pDeviceRef)->mSimRadio;
+	const uint8_t *pset = buf + 2;
+	uint8_t *rpset = response ? response + 2 : NULL;
+
+	if (radio == NULL || len < 2)
+		return -1;
+
+	pthread_mutex_lock(&sMediumMutex);
+
+	switch (buf[0])
+	{
+	case SPI_MCPS_DATA_REQUEST:
+		dataRequest(radio, buf, len);
+		break;
+
+	case SPI_MLME_SCAN_REQUEST:
+		scanRequest(radio, (const struct MLME_SCAN_request_pset *)pset);
+		break;
+
+	case SPI_MLME_SET_REQUEST:
+	{
+		const struct MLME_SET_request_pset *setReq = (const struct MLME_SET_request_pset *)pset;
+		struct MLME_SET_confirm_pset *setCnf = (struct MLME_SET_confirm_pset *)rpset;
+
+		setCnf->Status = setRequest(radio, setReq);
+		setCnf->PIBAttribute = setReq->PIBAttribute;
+		setCnf->PIBAttributeIndex = setReq->PIBAttributeIndex;
+		response[0] = SPI_MLME_SET_CONFIRM;
+		response[1] = sizeof(*setCnf);
+		break;
+	}
+
+	case SPI_MLME_GET_REQUEST:
+	{
+		struct MLME_GET_confirm_pset *getCnf = (struct MLME_GET_confirm_pset *)rpset;
+
+		getRequest(radio, (const struct MLME_GET_request_pset *)pset, getCnf);
+		response[0] = SPI_MLME_GET_CONFIRM;
+		response[1] = offsetof(struct MLME_GET_confirm_pset, PIBAttributeValue) + getCnf->PIBAttributeLength;
+		break;
+	}
+
+	case SPI_MLME_RESET_REQUEST:
+		resetRequest(radio);
+		response[0] = SPI_MLME_RESET_CONFIRM;
+		response[1] = 1;
+		rpset[0] = MAC_SUCCESS;
+		break;
+
+	case SPI_MLME_START_REQUEST:
+	{
+		const struct MLME_START_request_pset *startReq = (const struct MLME_START_request_pset *)pset;
+
+		radio->mPanId = getLe16(startReq->PANId);
+		radio->mChannel = startReq->LogicalChannel;
+		radio->mPanCoordinator = startReq->PANCoordinator;
+		radio->mStarted = true;
+		response[0] = SPI_MLME_START_CONFIRM;
+		response[1] = 1;
+		rpset[0] = MAC_SUCCESS;
+		break;
+	}
+
+	case SPI_MLME_POLL_REQUEST:
+		response[0] = SPI_MLME_POLL_CONFIRM;
+		response[1] = 1;
+		rpset[0] = pollRequest(radio, &((const struct MLME_POLL_request_pset *)pset)->CoordAddress);
+		break;
+
+	case SPI_MCPS_PURGE_REQUEST:
+	{
+		struct MCPS_PURGE_confirm_pset *purgeCnf = (struct MCPS_PURGE_confirm_pset *)rpset;
+
+		purgeCnf->MsduHandle = pset[0];
+		purgeCnf->Status = purgeRequest(radio, pset[0]);
+		response[0] = SPI_MCPS_PURGE_CONFIRM;
+		response[1] = sizeof(*purgeCnf);
+		break;
+	}
+
+	case SPI_HWME_SET_REQUEST:
+		response[0] = SPI_HWME_SET_CONFIRM;
+		response[1] = sizeof(struct HWME_SET_confirm_pset);
+		rpset[0] = MAC_SUCCESS;
+		rpset[1] = pset[0];
+		break;
+
+	case SPI_HWME_GET_REQUEST:
+		response[0] = SPI_HWME_GET_CONFIRM;
+		response[1] = 3;
+		rpset[0] = MAC_UNSUPPORTED_ATTRIBUTE;
+		rpset[1] = pset[0];
+		rpset[2] = 0;
+		break;
+
+	default:
+		if (response)
+		{
+			response[0] = confirmFor(buf[0]);
+			response[1] = 1;
+			rpset[0] = MAC_SUCCESS;
+		}
+		break;
+	}
+
+	pthread_mutex_unlock(&sMediumMutex);
+	return 0;
+}
+
+int platformSimRadioInit(struct posixNode *aNode)
+{
+	struct simRadio *radio = calloc(1, sizeof(*radio));
+
+	if (radio == NULL)
+		return -1;
+
+	radio->mNode = aNode;
+	radio->mDsn = posixNodeGetId(aNode) & 0xFF;
+	resetRequest(radio);
+
+	ca821x_api_init(&aNode->mDevice);
+	aNode->mDevice.ca821x_api_downstream = &simDownstream;
+	aNode->mDeviceRef = &aNode->mDevice;
+	aNode->mSimRadio = radio;
+
+	pthread_mutex_lock(&sMediumMutex);
+	radio->mNext = sMedium;
+	sMedium = radio;
+	pthread_mutex_unlock(&sMediumMutex);
+
+	return 0;
+}
+
+void platformSimRadioDeinit(struct posixNode *aNode)
+{
+	struct simRadio *radio = aNode->mSimRadio;
+	struct simMessage *message;
+	struct simLink *link;
+
+	if (radio == NULL)
+		return;
+
+	pthread_mutex_lock(&sMediumMutex);
+
+	for (struct simRadio **r = &sMedium; *r != NULL; r = &(*r)->mNext)
+	{
+		if (*r == radio)
+		{
+			*r = radio->mNext;
+			break;
+		}
+	}
+
+	//Other radios may still hold links from this node
+	for (struct simRadio *other = sMedium; other != NULL; other = other->mNext)
+	{
+		for (struct simLink **l = &other->mLinks; *l != NULL;)
+		{
+			if ((*l)->mFrom == aNode)
+			{
+				link = *l;
+				*l = link->mNext;
+				free(link);
+			}
+			else
+			{
+				l = &(*l)->mNext;
+			}
+		}
+	}
+
+	resetRequest(radio);
+
+	pthread_mutex_unlock(&sMediumMutex);
+
+	while ((message = radio->mQueueHead) != NULL)
+	{
+		radio->mQueueHead = message->mNext;
+		free(message);
+	}
+
+	while ((link = radio->mLinks) != NULL)
+	{
+		radio->mLinks = link->mNext;
+		free(link);
+	}
+
+	free(radio);
+	aNode->mSimRadio = NULL;
+}
+
+size_t platformSimRadioFootprint(struct posixNode *aNode)
+{
+	struct simRadio *radio = aNode->mSimRadio;
+	size_t size;
+
+	if (radio == NULL)
+		return 0;
+
+	pthread_mutex_lock(&sMediumMutex);
+
+	size = sizeof(*radio);
+	for (struct simAttribute *attribute = radio->mAttributes; attribute != NULL; attribute = attribute->mNext)
+		size += sizeof(*attribute) + attribute->mLength;
+	for (struct simIndirect *indirect = radio->mIndirect; indirect != NULL; indirect = indirect->mNext)
+		size += sizeof(*indirect) + indirect->mLength;
+	for (struct simMessage *message = radio->mQueueHead; message != NULL; message = message->mNext)
+		size += sizeof(*message) + message->mLength;
+	for (struct simLink *link = radio->mLinks; link != NULL; link = link->mNext)
+		size += sizeof(*link);
+
+	pthread_mutex_unlock(&sMediumMutex);
+
+	return size;
+}
+
+bool platformSimRadioProcess(struct posixNode *aNode)
+{
+	struct simRadio *radio = aNode->mSimRadio;
+	struct simMessage *message;
+	struct platformSchedSlice slice;
+	uint32_t now = otPlatAlarmMilliGetNow();
+
+	if (radio == NULL)
+		return false;
+
+	pthread_mutex_lock(&sMediumMutex);
+
+	for (struct simIndirect **l = &radio->mIndirect; *l != NULL;)
+	{
+		struct simIndirect *indirect = *l;
+
+		if ((int32_t)(now - indirect->mExpiry) >= 0)
+		{
+			*l = indirect->mNext;
+			queueDataConfirm(radio,
+			                 ((const struct MCPS_DATA_request_pset *)(indirect->mRequest + 2))->MsduHandle,
+			                 MAC_TRANSACTION_EXPIRED);
+			free(indirect);
+		}
+		else
+		{
+			l = &indirect->mNext;
+		}
+	}
+
+	//Dispatch outside of the lock, as the handlers may well transmit
+	message = radio->mQueueHead;
+	radio->mQueueHead = NULL;
+	radio->mQueueTail = NULL;
+
+	pthread_mutex_unlock(&sMediumMutex);
+
+	if (message == NULL)
+		return false;
+
+	platformSchedBegin(&slice, POSIX_SCHED_RADIO);
+	while (message != NULL && platformSchedNext(&slice))
+	{
+		struct simMessage *next = message->mNext;
+
+		ca821x_downstream_dispatch(message->mBuf, message->mLength, aNode->mDeviceRef);
+		free(message);
+		message = next;
+	}
+	platformSchedEnd(&slice, message != NULL);
+
+	//Out of budget, put the rest back in front of what was queued meanwhile
+	if (message != NULL)
+	{
+		struct simMessage *last = message;
+
+		while (last->mNext != NULL)
+			last = last->mNext;
+
+		pthread_mutex_lock(&sMediumMutex);
+		last->mNext = radio->mQueueHead;
+		if (radio->mQueueHead == NULL)
+			radio->mQueueTail = last;
+		radio->mQueueHead = message;
+		pthread_mutex_unlock(&sMediumMutex);
+	}
+
+	return true;
+}
+
+bool platformSimRadioPending(struct posixNode *aNode)
+{
+	struct simRadio *radio = aNode->mSimRadio;
+	bool pending;
+
+	if (radio == NULL)
+		return false;
+
+	pthread_mutex_lock(&sMediumMutex);
+	pending = (radio->mQueueHead != NULL);
+	pthread_mutex_unlock(&sMediumMutex);
+
+	return pending;
+}
+
+int posixPlatformSimSetLinkQuality(struct posixNode *aFrom, struct posixNode *aTo, uint8_t aLinkQuality)
+{
+	struct simRadio *to = aTo->mSimRadio;
+	struct simLink *link;
+	int rval = 0;
+
+	if (to == NULL || aFrom->mSimRadio == NULL)
+		return -1;
+
+	pthread_mutex_lock(&sMediumMutex);
+
+	for (link = to->mLinks; link != NULL; link = link->mNext)
+	{
+		if (link->mFrom == aFrom)
+			break;
+	}
+
+	if (link == NULL && (link = calloc(1, sizeof(*link))) != NULL)
+	{
+		link->mFrom = aFrom;
+		link->mNext = to->mLinks;
+		to->mLinks = link;
+	}
+
+	if (link != NULL)
+		link->mLinkQuality = aLinkQuality;
+	else
+		rval = -1;
+
+	pthread_mutex_unlock(&sMediumMutex);
+
+	return rval;
+}
+
+void posixPlatformSimSetDefaultLinkQuality(uint8_t aLinkQuality)
+{
+	pthread_mutex_lock(&sMediumMutex);
+	sDefaultLinkQuality = aLinkQuality;
+	pthread_mutex_unlock(&sMediumMutex);
+}
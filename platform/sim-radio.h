@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform to attach simulated
+ *   nodes to the simulated medium, see posixPlatformNodeCreate.
+ */
+
+#ifndef PLATFORM_SIM_RADIO_H_
+#define PLATFORM_SIM_RADIO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "node.h"
+
+/**
+ * This method attaches a simulated node to the simulated medium, in place of a device.
+ *
+ */
+int platformSimRadioInit(struct posixNode *aNode);
+
+/**
+ * This method detaches a simulated node from the simulated medium.
+ *
+ */
+void platformSimRadioDeinit(struct posixNode *aNode);
+
+/**
+ * This method gets the heap used by the simulated radio of a node, with its
+ * queued messages.
+ *
+ */
+size_t platformSimRadioFootprint(struct posixNode *aNode);
+
+/**
+ * This method delivers the confirms and indications the medium has queued for a node.
+ *
+ * @returns true if anything was delivered.
+ *
+ */
+bool platformSimRadioProcess(struct posixNode *aNode);
+
+/**
+ * This method returns whether the medium has anything queued for a node.
+ *
+ */
+bool platformSimRadioPending(struct posixNode *aNode);
+
+#endif /* PLATFORM_SIM_RADIO_H_ */
@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file records the time taken to reach each startup milestone.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "ca821x-posix-thread/posix-platform.h"
+
+static const char *sMilestoneNames[POSIX_MILESTONE_COUNT] = {
+	"init-start",
+	"alarm-ready",
+	"uart-ready",
+	"eui-ready",
+	"flash-ready",
+	"device-open",
+	"mac-reset",
+	"init-done",
+	"instance-ready",
+	"attached",
+};
+
+//Monotonic timestamps in microseconds, 0 if not reached. Written from the init threads.
+static int64_t sMilestones[POSIX_MILESTONE_COUNT];
+
+static int64_t monotonicUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void posixPlatformMarkMilestone(enum posixPlatformMilestone aMilestone)
+{
+	int64_t expected = 0;
+
+	if (aMilestone >= POSIX_MILESTONE_COUNT)
+	{
+		return;
+	}
+
+	//Only the first time a milestone is reached counts, eg. across init retries
+	__atomic_compare_exchange_n(&sMilestones[aMilestone], &expected, monotonicUs(),
+	                            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+int64_t posixPlatformGetMilestoneUs(enum posixPlatformMilestone aMilestone)
+{
+	int64_t start = __atomic_load_n(&sMilestones[POSIX_MILESTONE_INIT_START], __ATOMIC_RELAXED);
+	int64_t time;
+
+	if (aMilestone >= POSIX_MILESTONE_COUNT)
+	{
+		return -1;
+	}
+
+	time = __atomic_load_n(&sMilestones[aMilestone], __ATOMIC_RELAXED);
+
+	return (start == 0 || time == 0) ? -1 : time - start;
+}
+
+const char *posixPlatformGetMilestoneName(enum posixPlatformMilestone aMilestone)
+{
+	return aMilestone < POSIX_MILESTONE_COUNT ? sMilestoneNames[aMilestone] : "unknown";
+}
+
+void posixPlatformPrintMilestones(FILE *aStream)
+{
+	for (int i = 0; i < POSIX_MILESTONE_COUNT; i++)
+	{
+		int64_t time = posixPlatformGetMilestoneUs(i);
+
+		if (time < 0)
+		{
+			fprintf(aStream, "%-16s -\n", sMilestoneNames[i]);
+		}
+		else
+		{
+			fprintf(aStream, "%-16s %10.3f ms\n", sMilestoneNames[i], time / 1000.0);
+		}
+	}
+}
@@ -0,0 +1,378 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements cooperative tasks, see posix-task.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-task.h"
+#include "scheduler.h"
+
+enum taskState
+{
+	TASK_RUNNABLE,
+	TASK_WAITING,
+	TASK_DONE,
+};
+
+struct posixTask
+{
+	struct posixTask      *mNext;
+	ucontext_t             mContext;
+	void                  *mStack;     //Including the guard page
+	size_t                 mStackSize; //Including the guard page
+	posixTaskFunction      mFunction;
+	void                  *mArg;
+	enum taskState         mState;
+	bool                   mTimedOut;
+	uint64_t               mDeadline;  //Monotonic ms, 0 for none
+	int                    mWaitFd;    //-1 when not waiting for a descriptor
+	int                    mWaitEvents;
+	int                    mReadyEvents;
+	struct posixTaskEvent *mWaitEvent;
+};
+
+//Tasks belong to the thread running the platform loop, so none of this is shared
+static __thread struct posixTask *sTasks;
+//Created since the last pass. Kept apart, as a task may create others while platformTaskProcess walks sTasks
+static __thread struct posixTask *sNewTasks;
+static __thread struct posixTask *sCurrent;
+static __thread ucontext_t        sLoopContext;
+
+static uint64_t nowMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void taskEntry(void)
+{
+	struct posixTask *task = sCurrent;
+
+	task->mFunction(task->mArg);
+	task->mState = TASK_DONE;
+	//Returning resumes the loop through uc_link
+}
+
+static void taskFree(struct posixTask *aTask)
+{
+	munmap(aTask->mStack, aTask->mStackSize);
+	free(aTask);
+}
+
+//Switches back to the loop until the task is made runnable again
+static void taskWait(struct posixTask *aTask, uint32_t aTimeout)
+{
+	aTask->mState = TASK_WAITING;
+	aTask->mTimedOut = false;
+	aTask->mDeadline = (aTimeout == POSIX_TASK_WAIT_FOREVER) ? 0 : nowMs() + aTimeout;
+
+	swapcontext(&aTask->mContext, &sLoopContext);
+
+	aTask->mDeadline = 0;
+}
+
+struct posixTask *posixTaskCreate(posixTaskFunction aFunction, void *aContext, size_t aStackSize)
+{
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	struct posixTask *task;
+
+	if (aStackSize == 0)
+		aStackSize = POSIX_TASK_STACK_SIZE_DEFAULT;
+
+	task = calloc(1, sizeof(*task));
+	if (task == NULL)
+		return NULL;
+
+	//The lowest page is left inaccessible, so that an overflow faults instead of corrupting the heap
+	task->mStackSize = ((aStackSize + pageSize - 1) / pageSize + 1) * pageSize;
+	task->mStack = mmap(NULL, task->mStackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+
+	if (task->mStack == MAP_FAILED)
+	{
+		free(task);
+		return NULL;
+	}
+
+	mprotect(task->mStack, pageSize, PROT_NONE);
+	getcontext(&task->mContext);
+	task->mContext.uc_stack.ss_sp = (uint8_t *)task->mStack + pageSize;
+	task->mContext.uc_stack.ss_size = task->mStackSize - pageSize;
+	task->mContext.uc_link = &sLoopContext;
+	makecontext(&task->mContext, taskEntry, 0);
+
+	task->mFunction = aFunction;
+	task->mArg = aContext;
+	task->mState = TASK_RUNNABLE;
+	task->mWaitFd = -1;
+	task->mNext = sNewTasks;
+	sNewTasks = task;
+
+	return task;
+}
+
+struct posixTask *posixTaskCurrent(void)
+{
+	return sCurrent;
+}
+
+void posixTaskYield(void)
+{
+	struct posixTask *task = sCurrent;
+
+	assert(task != NULL);
+	swapcontext(&task->mContext, &sLoopContext);
+}
+
+void posixTaskSleep(uint32_t aMilliseconds)
+{
+	assert(sCurrent != NULL);
+	taskWait(sCurrent, aMilliseconds);
+}
+
+int posixTaskWaitFd(int aFd, int aEvents, uint32_t aTimeout)
+{
+	struct posixTask *task = sCurrent;
+
+	assert(task != NULL);
+	assert(aFd >= 0 && aFd < FD_SETSIZE);
+
+	task->mWaitFd = aFd;
+	task->mWaitEvents = aEvents & (POSIX_TASK_FD_READ | POSIX_TASK_FD_WRITE);
+	task->mReadyEvents = 0;
+	taskWait(task, aTimeout);
+	task->mWaitFd = -1;
+
+	return task->mReadyEvents;
+}
+
+void posixTaskEventInit(struct posixTaskEvent *aEvent)
+{
+	aEvent->mSignalled = false;
+	aEvent->mResult = 0;
+}
+
+void posixTaskEventSignal(struct posixTaskEvent *aEvent, int aResult)
+{
+	bool woken = false;
+
+	aEvent->mResult = aResult;
+
+	for (struct posixTask *task = sTasks; task != NULL; task = task->mNext)
+	{
+		if (task->mState == TASK_WAITING && task->mWaitEvent == aEvent)
+		{
+			task->mState = TASK_RUNNABLE;
+			woken = true;
+		}
+	}
+
+	//Kept for the next waiter if nobody was waiting
+	aEvent->mSignalled = !woken;
+}
+
+int posixTaskEventWait(struct posixTaskEvent *aEvent, uint32_t aTimeout)
+{
+	struct posixTask *task = sCurrent;
+
+	assert(task != NULL);
+
+	if (!aEvent->mSignalled)
+	{
+		task->mWaitEvent = aEvent;
+		taskWait(task, aTimeout);
+		task->mWaitEvent = NULL;
+
+		if (task->mTimedOut)
+			return -1;
+	}
+
+	aEvent->mSignalled = false;
+	return 0;
+}
+
+void platformTaskUpdateFdSet(fd_set *aReadFdSet, fd_set *aWriteFdSet, int *aMaxFd, struct timeval *aTimeout)
+{
+	uint64_t deadline = 0;
+
+	if (sNewTasks != NULL)
+	{
+		timerclear(aTimeout);
+		return;
+	}
+
+	for (struct posixTask *task = sTasks; task != NULL; task = task->mNext)
+	{
+		if (task->mState == TASK_RUNNABLE)
+		{
+			timerclear(aTimeout);
+			return;
+		}
+
+		if (task->mState != TASK_WAITING)
+			continue;
+
+		if (task->mDeadline != 0 && (deadline == 0 || task->mDeadline < deadline))
+			deadline = task->mDeadline;
+
+		if (task->mWaitFd >= 0)
+		{
+			if (task->mWaitEvents & POSIX_TASK_FD_READ)
+				FD_SET(task->mWaitFd, aReadFdSet);
+			if (task->mWaitEvents & POSIX_TASK_FD_WRITE)
+				FD_SET(task->mWaitFd, aWriteFdSet);
+			if (aMaxFd != NULL && *aMaxFd < task->mWaitFd)
+				*aMaxFd = task->mWaitFd;
+		}
+	}
+
+	if (deadline != 0)
+	{
+		uint64_t now = nowMs();
+		uint64_t remaining = (deadline > now) ? deadline - now : 0;
+		struct timeval taskTimeout = {remaining / 1000, (remaining % 1000) * 1000};
+
+		if (timercmp(&taskTimeout, aTimeout, <))
+			*aTimeout = taskTimeout;
+	}
+}
+
+void platformTaskSelected(const fd_set *aReadFdSet, const fd_set *aWriteFdSet)
+{
+	for (struct posixTask *task = sTasks; task != NULL; task = task->mNext)
+	{
+		int ready = 0;
+
+		if (task->mState != TASK_WAITING || task->mWaitFd < 0)
+			continue;
+
+		if ((task->mWaitEvents & POSIX_TASK_FD_READ) && FD_ISSET(task->mWaitFd, aReadFdSet))
+			ready |= POSIX_TASK_FD_READ;
+		if ((task->mWaitEvents & POSIX_TASK_FD_WRITE) && FD_ISSET(task->mWaitFd, aWriteFdSet))
+			ready |= POSIX_TASK_FD_WRITE;
+
+		if (ready)
+		{
+			task->mReadyEvents = ready;
+			task->mState = TASK_RUNNABLE;
+		}
+	}
+}
+
+void platformTaskProcess(void)
+{
+	struct posixTask **link = &sTasks;
+	struct posixTask **skipped = NULL;
+	struct platformSchedSlice slice;
+	uint64_t now = 0;
+
+	//Tasks created since the last pass go first
+	if (sNewTasks != NULL)
+	{
+		struct posixTask *last = sNewTasks;
+
+		while (last->mNext != NULL)
+			last = last->mNext;
+
+		last->mNext = sTasks;
+		sTasks = sNewTasks;
+		sNewTasks = NULL;
+	}
+
+	if (sTasks == NULL)
+		return;
+
+	platformSchedBegin(&slice, POSIX_SCHED_TASKS);
+
+	//Tasks created by these only start on the next pass
+	while (*link != NULL)
+	{
+		struct posixTask *task = *link;
+
+		if (task->mState == TASK_WAITING && task->mDeadline != 0)
+		{
+			if (now == 0)
+				now = nowMs();
+
+			if (now >= task->mDeadline)
+			{
+				task->mTimedOut = true;
+				task->mState = TASK_RUNNABLE;
+			}
+		}
+
+		if (task->mState == TASK_RUNNABLE && skipped == NULL)
+		{
+			if (platformSchedNext(&slice))
+			{
+				sCurrent = task;
+				swapcontext(&sLoopContext, &task->mContext);
+				sCurrent = NULL;
+			}
+			else
+			{
+				skipped = link;
+			}
+		}
+
+		if (task->mState == TASK_DONE)
+		{
+			*link = task->mNext;
+			taskFree(task);
+		}
+		else
+		{
+			link = &task->mNext;
+		}
+	}
+
+	platformSchedEnd(&slice, skipped != NULL);
+
+	//Out of budget, so the tasks that were skipped go first next time
+	if (skipped != NULL && skipped != &sTasks)
+	{
+		*link = sTasks;
+		sTasks = *skipped;
+		*skipped = NULL;
+	}
+}
@@ -0,0 +1,319 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the frame trace, see posix-trace.h.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "openthread/platform/logging.h"
+#include "ca821x_api.h"
+#include "ieee_802_15_4.h"
+#include "openthread-core-config.h"
+#include "trace.h"
+
+#ifndef CASCODA_TRACE_BUFFER_SIZE
+#define CASCODA_TRACE_BUFFER_SIZE 8192
+#endif
+
+#define TRACE_BUFFER_SIZE CASCODA_TRACE_BUFFER_SIZE //Flushed whole, in one append, so records of several processes don't mix
+
+enum
+{
+	TRACE_ADDR_MODE_SHORT = 2,
+	TRACE_ADDR_MODE_EXT   = 3,
+};
+
+struct posixTrace
+{
+	uint8_t  mPanId[2];
+	uint8_t  mShortAddress[2];
+	uint8_t  mExtAddress[8];
+	uint32_t mUsed;
+	uint8_t  mBuffer[TRACE_BUFFER_SIZE];
+};
+
+int gPosixTraceFd = -1;
+
+static pthread_once_t sTraceOnce = PTHREAD_ONCE_INIT;
+static bool sWriteFailed = false;
+
+static uint64_t nowNs(clockid_t aClock)
+{
+	struct timespec ts;
+
+	clock_gettime(aClock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int hexDigit(char aChar)
+{
+	if (aChar >= '0' && aChar <= '9')
+		return aChar - '0';
+	if (aChar >= 'a' && aChar <= 'f')
+		return aChar - 'a' + 10;
+	return -1;
+}
+
+static void readBootId(uint8_t *aBootId)
+{
+	char text[40] = {0};
+	unsigned int nibble = 0;
+	FILE *file = fopen("/proc/sys/kernel/random/boot_id", "r");
+
+	if (file == NULL)
+		return;
+
+	//A UUID, the dashes are skipped
+	if (fgets(text, sizeof(text), file) != NULL)
+	{
+		for (const char *c = text; *c != '\0' && nibble < 32; c++)
+		{
+			int digit = hexDigit(*c);
+
+			if (digit < 0)
+				continue;
+			aBootId[nibble / 2] |= digit << ((nibble & 1) ? 0 : 4);
+			nibble++;
+		}
+	}
+
+	fclose(file);
+}
+
+static void writeOut(struct posixTrace *aTrace)
+{
+	uint32_t offset = 0;
+
+	while (offset < aTrace->mUsed)
+	{
+		ssize_t rval = write(gPosixTraceFd, aTrace->mBuffer + offset, aTrace->mUsed - offset);
+
+		if (rval < 0 && errno == EINTR)
+			continue;
+
+		if (rval <= 0)
+		{
+			if (!sWriteFailed)
+				otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "Trace write failed, records dropped");
+			sWriteFailed = true;
+			break;
+		}
+
+		offset += rval;
+	}
+
+	aTrace->mUsed = 0;
+}
+
+static struct posixTraceRecord *addRecord(struct posixTrace *aTrace, struct posixNode *aNode, uint8_t aType, uint8_t aMsduLength)
+{
+	struct posixTraceRecord *record;
+	//Kept aligned for the next record
+	uint16_t length = (offsetof(struct posixTraceRecord, mMsdu) + aMsduLength + 7) & ~7;
+
+	if (aTrace->mUsed + length > sizeof(aTrace->mBuffer))
+		writeOut(aTrace);
+
+	record = (struct posixTraceRecord *)(aTrace->mBuffer + aTrace->mUsed);
+	memset(record, 0, length);
+	record->mLength = length;
+	record->mType = aType;
+	record->mNodeId = posixNodeGetId(aNode);
+	record->mTimeNs = nowNs(CLOCK_MONOTONIC);
+	record->mMsduLength = aMsduLength;
+	aTrace->mUsed += length;
+
+	return record;
+}
+
+static struct posixTrace *getTrace(struct posixNode *aNode)
+{
+	struct posixTraceRecord *record;
+	struct posixTraceClock clock = {0};
+
+	if (aNode->mTrace != NULL)
+		return aNode->mTrace;
+
+	if ((aNode->mTrace = calloc(1, sizeof(*aNode->mTrace))) == NULL)
+		return NULL;
+
+	memset(aNode->mTrace->mShortAddress, 0xFF, sizeof(aNode->mTrace->mShortAddress));
+
+	record = addRecord(aNode->mTrace, aNode, POSIX_TRACE_CLOCK, sizeof(clock));
+	clock.mRealTimeNs = nowNs(CLOCK_REALTIME);
+	readBootId(clock.mBootId);
+	memcpy(record->mMsdu, &clock, sizeof(clock));
+
+	return aNode->mTrace;
+}
+
+static void flushDefault(void)
+{
+	platformTraceFlush(&gPosixNodeDefault);
+}
+
+static void openTrace(void)
+{
+	const char *path = getenv(POSIX_TRACE_ENV);
+	int fd;
+
+	if (path == NULL || path[0] == '\0')
+		return;
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) < 0)
+	{
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "Failed to open trace %s", path);
+		return;
+	}
+
+	__atomic_store_n(&gPosixTraceFd, fd, __ATOMIC_RELAXED);
+	atexit(flushDefault);
+}
+
+void platformTraceInit(void)
+{
+	pthread_once(&sTraceOnce, openTrace);
+}
+
+void platformTraceAttribute(struct posixNode *aNode, uint8_t aAttribute, uint8_t aLength, const uint8_t *aValue)
+{
+	struct posixTrace *trace;
+	uint8_t *cached;
+	uint8_t size;
+
+	switch (aAttribute)
+	{
+	case macPANId:
+		size = sizeof(trace->mPanId);
+		break;
+	case macShortAddress:
+		size = sizeof(trace->mShortAddress);
+		break;
+	case nsIEEEAddress:
+		size = sizeof(trace->mExtAddress);
+		break;
+	default:
+		return;
+	}
+
+	if (aLength < size || (trace = getTrace(aNode)) == NULL)
+		return;
+
+	if (aAttribute == macPANId)
+		cached = trace->mPanId;
+	else if (aAttribute == macShortAddress)
+		cached = trace->mShortAddress;
+	else
+		cached = trace->mExtAddress;
+
+	memcpy(cached, aValue, size);
+}
+
+void platformTraceTx(struct posixNode *aNode, const otDataRequest *aDataRequest, uint8_t aDsn)
+{
+	struct posixTrace *trace = getTrace(aNode);
+	struct posixTraceRecord *record;
+
+	if (trace == NULL)
+		return;
+
+	record = addRecord(trace, aNode, POSIX_TRACE_TX, aDataRequest->mMsduLength);
+	record->mDsn = aDsn;
+	record->mSrc.mMode = aDataRequest->mSrcAddrMode;
+	memcpy(record->mSrc.mPanId, trace->mPanId, sizeof(trace->mPanId));
+
+	if (aDataRequest->mSrcAddrMode == TRACE_ADDR_MODE_SHORT)
+		memcpy(record->mSrc.mAddress, trace->mShortAddress, sizeof(trace->mShortAddress));
+	else if (aDataRequest->mSrcAddrMode == TRACE_ADDR_MODE_EXT)
+		memcpy(record->mSrc.mAddress, trace->mExtAddress, sizeof(trace->mExtAddress));
+
+	//otFullAddr is laid out as posixTraceAddress
+	memcpy(&record->mDst, &aDataRequest->mDst, sizeof(record->mDst));
+	record->mMsduHandle = aDataRequest->mMsduHandle;
+	record->mStatus = aDataRequest->mTxOptions;
+	memcpy(record->mMsdu, aDataRequest->mMsdu, aDataRequest->mMsduLength);
+}
+
+void platformTraceTxDone(struct posixNode *aNode, uint8_t aMsduHandle, uint8_t aStatus)
+{
+	struct posixTrace *trace = getTrace(aNode);
+	struct posixTraceRecord *record;
+
+	if (trace == NULL)
+		return;
+
+	record = addRecord(trace, aNode, POSIX_TRACE_TX_DONE, 0);
+	record->mMsduHandle = aMsduHandle;
+	record->mStatus = aStatus;
+}
+
+void platformTraceRx(struct posixNode *aNode, const otDataIndication *aDataInd, uint8_t aLinkQuality)
+{
+	struct posixTrace *trace = getTrace(aNode);
+	struct posixTraceRecord *record;
+
+	if (trace == NULL)
+		return;
+
+	record = addRecord(trace, aNode, POSIX_TRACE_RX, aDataInd->mMsduLength);
+	record->mDsn = aDataInd->mDSN;
+	memcpy(&record->mSrc, &aDataInd->mSrc, sizeof(record->mSrc));
+	memcpy(&record->mDst, &aDataInd->mDst, sizeof(record->mDst));
+	record->mStatus = aLinkQuality;
+	memcpy(record->mMsdu, aDataInd->mMsdu, aDataInd->mMsduLength);
+}
+
+void platformTraceFlush(struct posixNode *aNode)
+{
+	if (aNode->mTrace != NULL && aNode->mTrace->mUsed > 0)
+		writeOut(aNode->mTrace);
+}
+
+size_t platformTraceFootprint(struct posixNode *aNode)
+{
+	return aNode->mTrace ? sizeof(*aNode->mTrace) : 0;
+}
+
+void platformTraceFree(struct posixNode *aNode)
+{
+	platformTraceFlush(aNode);
+	free(aNode->mTrace);
+	aNode->mTrace = NULL;
+}
@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform to record frame traces.
+ */
+
+#ifndef PLATFORM_TRACE_H_
+#define PLATFORM_TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "openthread/platform/radio-mac.h"
+#include "ca821x-posix-thread/posix-trace.h"
+#include "node.h"
+
+/**
+ * The file records are appended to, or -1 while tracing is off, so that the
+ * radio pays a single load for it.
+ *
+ */
+extern int gPosixTraceFd;
+
+static inline bool platformTraceEnabled(void)
+{
+	return __atomic_load_n(&gPosixTraceFd, __ATOMIC_RELAXED) >= 0;
+}
+
+/**
+ * This method opens the file named by CASCODA_TRACE, once per process.
+ *
+ */
+void platformTraceInit(void);
+
+/**
+ * This method notes a PIB attribute given to the MAC, to know the source
+ * address of the frames sent.
+ *
+ */
+void platformTraceAttribute(struct posixNode *aNode, uint8_t aAttribute, uint8_t aLength, const uint8_t *aValue);
+
+/**
+ * This method records a data request accepted by the MAC.
+ *
+ * @param[in]  aDsn  The DSN the MAC gave the frame.
+ *
+ */
+void platformTraceTx(struct posixNode *aNode, const otDataRequest *aDataRequest, uint8_t aDsn);
+
+/**
+ * This method records a data confirm.
+ *
+ */
+void platformTraceTxDone(struct posixNode *aNode, uint8_t aMsduHandle, uint8_t aStatus);
+
+/**
+ * This method records a data indication.
+ *
+ */
+void platformTraceRx(struct posixNode *aNode, const otDataIndication *aDataInd, uint8_t aLinkQuality);
+
+/**
+ * This method writes out the records of a node, once per pass of the loop.
+ *
+ */
+void platformTraceFlush(struct posixNode *aNode);
+
+/**
+ * This method gets the heap used by the trace state of a node.
+ *
+ */
+size_t platformTraceFootprint(struct posixNode *aNode);
+
+/**
+ * This method writes out and frees the trace state of a node being destroyed.
+ *
+ */
+void platformTraceFree(struct posixNode *aNode);
+
+#endif /* PLATFORM_TRACE_H_ */
@@ -0,0 +1,406 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the native network interface, see posix-tun.h.
+ *
+ */
+
+#define _GNU_SOURCE 1
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <linux/if_tun.h>
+
+#include "openthread/instance.h"
+#include "openthread/ip6.h"
+#include "openthread/message.h"
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-tun.h"
+#include "openthread-core-config.h"
+#include "metrics.h"
+#include "node.h"
+#include "scheduler.h"
+#include "tun.h"
+
+#ifndef CASCODA_TUN_BATCH
+#define CASCODA_TUN_BATCH 32
+#endif
+
+#define TUN_MTU           1280
+#define TUN_BATCH         CASCODA_TUN_BATCH //Packets read per loop pass, and queued for writing
+#define TUN_MAX_ADDRESSES 16
+
+//struct in6_ifreq of linux/ipv6.h, which clashes with netinet/in.h
+struct tunIn6Ifreq
+{
+	struct in6_addr mAddress;
+	uint32_t        mPrefixLength;
+	int             mIfIndex;
+};
+
+struct tunPacket
+{
+	uint16_t mLength;
+	uint8_t  mData[TUN_MTU];
+};
+
+struct posixTun
+{
+	int          mFd;
+	int          mControlFd;  //AF_INET6 socket for the address ioctls
+	int          mIfIndex;
+	char         mName[IFNAMSIZ];
+	otInstance  *mInstance;   //Instance the callbacks are registered with, NULL after a reset
+
+	struct tunIn6Ifreq mAddresses[TUN_MAX_ADDRESSES]; //Addresses set on the interface
+	int                mAddressCount;
+
+	struct tunPacket mQueue[TUN_BATCH]; //Received from the stack, waiting to be written
+	unsigned int     mQueueHead;
+	unsigned int     mQueueCount;
+	uint8_t          mReadBuffer[TUN_MTU];
+};
+
+static void tunDrop(void)
+{
+	METRICS_INC(mTunDrops);
+}
+
+static void flushQueue(struct posixTun *aTun)
+{
+	while (aTun->mQueueCount > 0)
+	{
+		struct tunPacket *packet = &aTun->mQueue[aTun->mQueueHead];
+		ssize_t rval = write(aTun->mFd, packet->mData, packet->mLength);
+
+		if (rval < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+			break;
+
+		if (rval == packet->mLength)
+		{
+			METRICS_INC(mTunPacketsOut);
+			METRICS_ADD(mTunBytesOut, rval);
+		}
+		else
+		{
+			tunDrop();
+		}
+
+		aTun->mQueueHead = (aTun->mQueueHead + 1) % TUN_BATCH;
+		aTun->mQueueCount--;
+	}
+}
+
+//Runs on the node's thread, from within the stack. Writes are batched by the next loop pass.
+static void handleReceive(otMessage *aMessage, void *aContext)
+{
+	struct posixTun *tun = aContext;
+	uint16_t length = otMessageGetLength(aMessage);
+	struct tunPacket *packet;
+
+	if (tun->mQueueCount == TUN_BATCH || length > TUN_MTU)
+	{
+		tunDrop();
+		otMessageFree(aMessage);
+		return;
+	}
+
+	packet = &tun->mQueue[(tun->mQueueHead + tun->mQueueCount) % TUN_BATCH];
+	packet->mLength = otMessageRead(aMessage, 0, packet->mData, length);
+	tun->mQueueCount++;
+	otMessageFree(aMessage);
+}
+
+static bool tunHasAddress(const struct posixTun *aTun, const otIp6Address *aAddress)
+{
+	for (int i = 0; i < aTun->mAddressCount; i++)
+	{
+		if (!memcmp(&aTun->mAddresses[i].mAddress, aAddress, sizeof(*aAddress)))
+			return true;
+	}
+
+	return false;
+}
+
+//Makes the interface addresses match the unicast addresses of the instance
+static void syncAddresses(struct posixTun *aTun)
+{
+	const otNetifAddress *address;
+	int i = 0;
+
+	while (i < aTun->mAddressCount)
+	{
+		bool present = false;
+
+		for (address = otIp6GetUnicastAddresses(aTun->mInstance); address != NULL; address = address->mNext)
+		{
+			if (!memcmp(&aTun->mAddresses[i].mAddress, &address->mAddress, sizeof(address->mAddress)))
+				present = true;
+		}
+
+		if (present)
+		{
+			i++;
+			continue;
+		}
+
+		ioctl(aTun->mControlFd, SIOCDIFADDR, &aTun->mAddresses[i]);
+		aTun->mAddresses[i] = aTun->mAddresses[--aTun->mAddressCount];
+	}
+
+	for (address = otIp6GetUnicastAddresses(aTun->mInstance); address != NULL; address = address->mNext)
+	{
+		struct tunIn6Ifreq *request;
+
+		if (tunHasAddress(aTun, &address->mAddress))
+			continue;
+
+		if (aTun->mAddressCount == TUN_MAX_ADDRESSES)
+		{
+			otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "%s: too many addresses", aTun->mName);
+			break;
+		}
+
+		request = &aTun->mAddresses[aTun->mAddressCount];
+		memcpy(&request->mAddress, &address->mAddress, sizeof(request->mAddress));
+		request->mPrefixLength = address->mPrefixLength;
+		request->mIfIndex = aTun->mIfIndex;
+
+		if (ioctl(aTun->mControlFd, SIOCSIFADDR, request) == 0 || errno == EEXIST)
+			aTun->mAddressCount++;
+	}
+}
+
+static void handleStateChanged(uint32_t aFlags, void *aContext)
+{
+	if (aFlags & (OT_CHANGED_IP6_ADDRESS_ADDED | OT_CHANGED_IP6_ADDRESS_REMOVED))
+		syncAddresses(aContext);
+}
+
+static void tunBind(struct posixTun *aTun, otInstance *aInstance)
+{
+	aTun->mInstance = aInstance;
+	otIp6SetReceiveFilterEnabled(aInstance, true);
+	otIp6SetReceiveCallback(aInstance, handleReceive, aTun);
+
+	if (otSetStateChangedCallback(aInstance, handleStateChanged, aTun) != OT_ERROR_NONE)
+		otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "%s: no state changed handler left, addresses not followed", aTun->mName);
+
+	syncAddresses(aTun);
+}
+
+static void tunFree(struct posixTun *aTun)
+{
+	if (aTun->mFd >= 0)
+		close(aTun->mFd);
+	if (aTun->mControlFd >= 0)
+		close(aTun->mControlFd);
+	free(aTun);
+}
+
+int posixPlatformTunOpen(otInstance *aInstance, const char *aName)
+{
+	struct posixNode *node = posixNodeFromInstance(aInstance);
+	struct posixTun *tun;
+	struct ifreq ifr;
+	int error;
+
+	if (node->mTun != NULL)
+	{
+		errno = EEXIST;
+		return -1;
+	}
+
+	tun = calloc(1, sizeof(*tun));
+	if (tun == NULL)
+		return -1;
+
+	tun->mControlFd = -1;
+	tun->mFd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (tun->mFd < 0)
+		goto fail;
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+	strncpy(ifr.ifr_name, aName ? aName : "wpan%d", IFNAMSIZ - 1);
+	if (ioctl(tun->mFd, TUNSETIFF, &ifr) < 0)
+		goto fail;
+	memcpy(tun->mName, ifr.ifr_name, IFNAMSIZ);
+
+	tun->mControlFd = socket(AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (tun->mControlFd < 0 || ioctl(tun->mControlFd, SIOCGIFINDEX, &ifr) < 0)
+		goto fail;
+	tun->mIfIndex = ifr.ifr_ifindex;
+
+	ifr.ifr_mtu = TUN_MTU;
+	if (ioctl(tun->mControlFd, SIOCSIFMTU, &ifr) < 0)
+		goto fail;
+
+	if (ioctl(tun->mControlFd, SIOCGIFFLAGS, &ifr) < 0)
+		goto fail;
+	ifr.ifr_flags |= IFF_UP;
+	if (ioctl(tun->mControlFd, SIOCSIFFLAGS, &ifr) < 0)
+		goto fail;
+
+	node->mTun = tun;
+	tunBind(tun, aInstance);
+	otPlatLog(OT_LOG_LEVEL_INFO, OT_LOG_REGION_PLATFORM, "Network interface %s is up", tun->mName);
+	return 0;
+
+fail:
+	error = errno;
+	otPlatLog(OT_LOG_LEVEL_CRIT, OT_LOG_REGION_PLATFORM, "Failed to create the network interface: %s", strerror(error));
+	tunFree(tun);
+	errno = error;
+	return -1;
+}
+
+void posixPlatformTunClose(otInstance *aInstance)
+{
+	struct posixNode *node = posixNodeFromInstance(aInstance);
+	struct posixTun *tun = node->mTun;
+
+	if (tun == NULL)
+		return;
+
+	if (tun->mInstance != NULL)
+	{
+		otIp6SetReceiveCallback(tun->mInstance, NULL, NULL);
+		otRemoveStateChangeCallback(tun->mInstance, handleStateChanged, tun);
+	}
+
+	node->mTun = NULL;
+	tunFree(tun);
+}
+
+const char *posixPlatformTunGetName(otInstance *aInstance)
+{
+	struct posixTun *tun = posixNodeFromInstance(aInstance)->mTun;
+
+	return tun ? tun->mName : NULL;
+}
+
+size_t platformTunFootprint(struct posixNode *aNode)
+{
+	return aNode->mTun ? sizeof(*aNode->mTun) : 0;
+}
+
+void platformTunReset(struct posixNode *aNode)
+{
+	if (aNode->mTun != NULL)
+	{
+		aNode->mTun->mInstance = NULL;
+		aNode->mTun->mQueueCount = 0;
+	}
+}
+
+void platformTunUpdateFdSet(struct posixNode *aNode, fd_set *aReadFdSet, fd_set *aWriteFdSet, int *aMaxFd)
+{
+	struct posixTun *tun = aNode->mTun;
+
+	if (tun == NULL)
+		return;
+
+	FD_SET(tun->mFd, aReadFdSet);
+	if (tun->mQueueCount > 0)
+		FD_SET(tun->mFd, aWriteFdSet);
+
+	if (aMaxFd != NULL && *aMaxFd < tun->mFd)
+		*aMaxFd = tun->mFd;
+}
+
+void platformTunProcess(struct posixNode *aNode, otInstance *aInstance)
+{
+	struct posixTun *tun = aNode->mTun;
+	struct platformSchedSlice slice;
+	bool more = true;
+
+	if (tun == NULL || aInstance == NULL)
+		return;
+
+	//The instance was recreated by an in-process reset
+	if (tun->mInstance != aInstance)
+		tunBind(tun, aInstance);
+
+	flushQueue(tun);
+
+	platformSchedBegin(&slice, POSIX_SCHED_NETIF);
+	for (int i = 0; i < TUN_BATCH && platformSchedNext(&slice); i++)
+	{
+		ssize_t length = read(tun->mFd, tun->mReadBuffer, sizeof(tun->mReadBuffer));
+		otMessage *message;
+		otError error;
+
+		if (length <= 0)
+		{
+			//Drained, the empty read isn't an item
+			platformSchedGiveBack(&slice);
+			more = false;
+			break;
+		}
+
+		METRICS_INC(mTunPacketsIn);
+		METRICS_ADD(mTunBytesIn, length);
+
+		message = otIp6NewMessage(aInstance, true);
+		if (message == NULL)
+		{
+			METRICS_INC(mMessageAllocFailures);
+			tunDrop();
+			continue;
+		}
+
+		if (otMessageAppend(message, tun->mReadBuffer, (uint16_t)length) != OT_ERROR_NONE)
+		{
+			METRICS_INC(mMessageAllocFailures);
+			tunDrop();
+			otMessageFree(message);
+			continue;
+		}
+
+		//Takes ownership of the message, even on failure
+		error = otIp6Send(aInstance, message);
+		if (error == OT_ERROR_NO_BUFS)
+			METRICS_INC(mMessageAllocFailures);
+		if (error != OT_ERROR_NONE)
+			tunDrop();
+	}
+	platformSchedEnd(&slice, more);
+}
@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief
+ *   This file defines the helpers used by the platform loop to service the
+ *   native network interface of a node, see posix-tun.h.
+ */
+
+#ifndef PLATFORM_TUN_H_
+#define PLATFORM_TUN_H_
+
+#include <sys/select.h>
+#include <stddef.h>
+
+#include "openthread/instance.h"
+#include "node.h"
+
+/**
+ * This method gets the heap used by a node's network interface.
+ *
+ */
+size_t platformTunFootprint(struct posixNode *aNode);
+
+/**
+ * This method forgets the instance of a node's network interface, which is
+ * bound to the new instance by the next platformTunProcess.
+ *
+ */
+void platformTunReset(struct posixNode *aNode);
+
+/**
+ * This method adds the descriptor of a node's network interface to the fd sets.
+ *
+ */
+void platformTunUpdateFdSet(struct posixNode *aNode, fd_set *aReadFdSet, fd_set *aWriteFdSet, int *aMaxFd);
+
+/**
+ * This method writes the packets queued for a node's network interface, and
+ * passes a batch of the packets read from it to the instance.
+ *
+ */
+void platformTunProcess(struct posixNode *aNode, otInstance *aInstance);
+
+#endif /* PLATFORM_TUN_H_ */
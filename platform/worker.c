@@ -0,0 +1,230 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *   This file implements the worker pool, see posix-worker.h.
+ *
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#include "openthread/platform/logging.h"
+#include "ca821x-posix-thread/posix-platform.h"
+#include "ca821x-posix-thread/posix-worker.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "selfpipe.h"
+
+#define MAX_WORKERS 64
+
+static pthread_mutex_t sQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  sQueueCond = PTHREAD_COND_INITIALIZER;
+static struct posixWork *sQueueHead; //Waiting for a worker, in order
+static struct posixWork *sQueueTail;
+static uint64_t sQueued;
+static bool sStopping;
+
+static pthread_t sWorkers[MAX_WORKERS];
+
+//Finished work whose done functions didn't fit in the budget of the last pass, oldest first
+static struct posixWork *sDeferred;
+static unsigned int sWorkerCount;
+
+//Finished work, newest first. Pushed by the workers and taken as a whole by the OpenThread thread.
+static struct posixWork *sCompleted;
+
+static void pushCompleted(struct posixWork *aWork)
+{
+	struct posixWork *head = __atomic_load_n(&sCompleted, __ATOMIC_RELAXED);
+
+	do
+	{
+		aWork->mNext = head;
+	} while (!__atomic_compare_exchange_n(&sCompleted, &head, aWork, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	//Only the first one after the queue is taken needs to wake the loop
+	if (head == NULL)
+		selfpipe_push();
+}
+
+static void *workerMain(void *aContext)
+{
+	struct posixWork *work;
+
+	(void)aContext;
+
+	while (1)
+	{
+		pthread_mutex_lock(&sQueueMutex);
+		while (sQueueHead == NULL && !sStopping)
+			pthread_cond_wait(&sQueueCond, &sQueueMutex);
+
+		work = sQueueHead;
+		if (work != NULL)
+		{
+			sQueueHead = work->mNext;
+			if (sQueueHead == NULL)
+				sQueueTail = NULL;
+			sQueued--;
+		}
+		pthread_mutex_unlock(&sQueueMutex);
+
+		if (work == NULL)
+			break;
+
+		METRICS_INC(mWorkStarted);
+		work->mFunction(work->mContext);
+		METRICS_INC(mWorkFinished);
+		pushCompleted(work);
+	}
+
+	return NULL;
+}
+
+int posixPlatformWorkersStart(unsigned int aThreads)
+{
+	const char *env;
+
+	if (sWorkerCount > 0)
+		return 0;
+
+	if (aThreads == 0 && (env = getenv(POSIX_WORKERS_ENV)) != NULL)
+		aThreads = strtoul(env, NULL, 0);
+	if (aThreads == 0)
+	{
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		aThreads = (cpus > 0) ? (unsigned int)cpus : 1;
+	}
+	if (aThreads > MAX_WORKERS)
+		aThreads = MAX_WORKERS;
+
+	sStopping = false;
+
+	while (sWorkerCount < aThreads)
+	{
+		if (pthread_create(&sWorkers[sWorkerCount], NULL, workerMain, NULL) != 0)
+		{
+			otPlatLog(OT_LOG_LEVEL_WARN, OT_LOG_REGION_PLATFORM, "Only started %u of %u workers", sWorkerCount, aThreads);
+			break;
+		}
+		sWorkerCount++;
+	}
+
+	return (sWorkerCount > 0) ? 0 : -1;
+}
+
+void posixPlatformWorkersStop(void)
+{
+	pthread_mutex_lock(&sQueueMutex);
+	sStopping = true;
+	pthread_cond_broadcast(&sQueueCond);
+	pthread_mutex_unlock(&sQueueMutex);
+
+	for (unsigned int i = 0; i < sWorkerCount; i++)
+		pthread_join(sWorkers[i], NULL);
+
+	sWorkerCount = 0;
+}
+
+int posixPlatformWorkSubmit(struct posixWork *aWork, posixWorkFunction aFunction, posixWorkFunction aDone, void *aContext)
+{
+	if (sWorkerCount == 0 && posixPlatformWorkersStart(0) < 0)
+		return -1;
+
+	aWork->mNext = NULL;
+	aWork->mFunction = aFunction;
+	aWork->mDone = aDone;
+	aWork->mContext = aContext;
+	METRICS_INC(mWorkSubmitted);
+
+	pthread_mutex_lock(&sQueueMutex);
+	if (sQueueTail != NULL)
+		sQueueTail->mNext = aWork;
+	else
+		sQueueHead = aWork;
+	sQueueTail = aWork;
+
+	if (++sQueued > __atomic_load_n(&gPosixMetrics->mWorkQueuedMax, __ATOMIC_RELAXED))
+		__atomic_store_n(&gPosixMetrics->mWorkQueuedMax, sQueued, __ATOMIC_RELAXED);
+
+	pthread_cond_signal(&sQueueCond);
+	pthread_mutex_unlock(&sQueueMutex);
+
+	return 0;
+}
+
+void platformWorkersProcess(void)
+{
+	struct posixWork *work = __atomic_exchange_n(&sCompleted, NULL, __ATOMIC_ACQUIRE);
+	struct posixWork *ordered = NULL;
+	struct platformSchedSlice slice;
+
+	//Reverse, so that done functions run in the order the work finished
+	while (work != NULL)
+	{
+		struct posixWork *next = work->mNext;
+
+		work->mNext = ordered;
+		ordered = work;
+		work = next;
+	}
+
+	//Work left over by the last pass, which finished first
+	if (sDeferred != NULL)
+	{
+		struct posixWork **tail = &sDeferred;
+
+		while (*tail != NULL)
+			tail = &(*tail)->mNext;
+		*tail = ordered;
+		ordered = sDeferred;
+		sDeferred = NULL;
+	}
+
+	if (ordered == NULL)
+		return;
+
+	platformSchedBegin(&slice, POSIX_SCHED_WORKERS);
+	while (ordered != NULL && platformSchedNext(&slice))
+	{
+		work = ordered;
+		ordered = work->mNext;
+
+		METRICS_INC(mWorkCompleted);
+		if (work->mDone != NULL)
+			work->mDone(work->mContext);
+	}
+	platformSchedEnd(&slice, ordered != NULL);
+
+	sDeferred = ordered;
+}
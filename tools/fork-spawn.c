@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Asks a fork server (see posix-fork-server.h) for node processes. Each node
+ * gets this tool's stdin and stdout as its UART, eg. to run a node behind a
+ * pty or a pair of FIFOs, or shares the server's with -n. The tool exits once
+ * the nodes are forked; they keep running under the server. Their process IDs
+ * are printed to stderr, as stdout belongs to the nodes.
+ *
+ * usage: ca821x-spawn [-S socket] [-n] node-id...
+ *   -S  the server's socket, by default $CASCODA_FORK_SERVER
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ca821x-posix-thread/posix-fork-server.h"
+
+static int connectServer(const char *aSocketPath)
+{
+	struct sockaddr_un address;
+	int fd;
+
+	if (strlen(aSocketPath) >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, aSocketPath);
+
+	if ((fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+
+	if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int spawn(int aServer, uint32_t aNodeId, int aShareUart)
+{
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        buf[CMSG_SPACE(2 * sizeof(int))];
+	} control;
+	struct posixForkRequest request = {aNodeId};
+	struct posixForkResponse response;
+	struct iovec iov = {&request, sizeof(request)};
+	struct msghdr msg = {0};
+	int fds[2] = {STDIN_FILENO, STDOUT_FILENO};
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (!aShareUart)
+	{
+		struct cmsghdr *cmsg;
+
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	}
+
+	if (sendmsg(aServer, &msg, MSG_NOSIGNAL) != sizeof(request))
+		return -1;
+
+	if (recv(aServer, &response, sizeof(response), 0) != sizeof(response))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+
+	if (response.mPid < 0)
+	{
+		errno = -response.mPid;
+		return -1;
+	}
+
+	return response.mPid;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *socketPath = getenv(POSIX_FORK_SERVER_ENV);
+	int shareUart = 0;
+	int server;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "S:n")) != -1)
+	{
+		switch (opt)
+		{
+		case 'S':
+			socketPath = optarg;
+			break;
+		case 'n':
+			shareUart = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-S socket] [-n] node-id...\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (socketPath == NULL || optind >= argc)
+	{
+		fprintf(stderr, "usage: %s [-S socket] [-n] node-id...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if ((server = connectServer(socketPath)) < 0)
+	{
+		perror(socketPath);
+		return EXIT_FAILURE;
+	}
+
+	for (int i = optind; i < argc; i++)
+	{
+		uint32_t nodeId = strtoul(argv[i], NULL, 0);
+		int pid = spawn(server, nodeId, shareUart);
+
+		if (pid < 0)
+		{
+			fprintf(stderr, "node %u: %s\n", nodeId, strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		fprintf(stderr, "node %u pid %d\n", nodeId, pid);
+	}
+
+	close(server);
+	return EXIT_SUCCESS;
+}
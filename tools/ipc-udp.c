@@ -0,0 +1,168 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Sends and receives Thread UDP datagrams through a node serving local
+ * clients (see posix-ipc.h), like a minimal netcat. Received datagrams are
+ * printed with their source. With a destination, every line read from stdin
+ * is sent to it as one datagram.
+ *
+ * usage: ca821x-udp [-S socket] -p port [address port]
+ *   -S  the node's socket, by default $CASCODA_IPC
+ *   -p  the local port to bind
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ca821x-posix-thread/posix-ipc.h"
+
+static void usage(const char *aName)
+{
+	fprintf(stderr, "usage: %s [-S socket] -p port [address port]\n", aName);
+	exit(EXIT_FAILURE);
+}
+
+static void printReceived(struct posixIpcClient *aClient)
+{
+	const struct posixIpcDatagram *datagram;
+	char address[INET6_ADDRSTRLEN];
+
+	while ((datagram = posixIpcClientReceive(aClient)) != NULL)
+	{
+		inet_ntop(AF_INET6, datagram->mPeerAddress, address, sizeof(address));
+		printf("[%s]:%u -> %u, %u bytes: %.*s\n", address, datagram->mPeerPort, datagram->mLocalPort, datagram->mLength,
+		       (int)datagram->mLength, (const char *)datagram->mPayload);
+	}
+
+	posixIpcClientReceiveDone(aClient);
+	fflush(stdout);
+}
+
+static int sendLine(struct posixIpcClient *aClient, const uint8_t *aPeer, uint16_t aPeerPort, uint16_t aLocalPort,
+                    const char *aLine)
+{
+	struct posixIpcDatagram *datagram = posixIpcClientSendBegin(aClient);
+	size_t length = strlen(aLine);
+
+	if (datagram == NULL)
+		return -1;
+
+	if (length > 0 && aLine[length - 1] == '\n')
+		length--;
+	if (length > POSIX_IPC_MAX_PAYLOAD)
+		length = POSIX_IPC_MAX_PAYLOAD;
+
+	memcpy(datagram->mPeerAddress, aPeer, sizeof(datagram->mPeerAddress));
+	datagram->mPeerPort = aPeerPort;
+	datagram->mLocalPort = aLocalPort;
+	datagram->mHopLimit = 0;
+	datagram->mLength = length;
+	memcpy(datagram->mPayload, aLine, length);
+	posixIpcClientSendCommit(aClient);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *socketPath = getenv(POSIX_IPC_ENV);
+	struct posixIpcClient *client;
+	uint8_t peer[16];
+	uint16_t peerPort = 0;
+	uint16_t port = 0;
+	int sending = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "S:p:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'S':
+			socketPath = optarg;
+			break;
+		case 'p':
+			port = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (socketPath == NULL || port == 0 || (argc - optind != 0 && argc - optind != 2))
+		usage(argv[0]);
+
+	if (argc - optind == 2)
+	{
+		if (inet_pton(AF_INET6, argv[optind], peer) != 1)
+			usage(argv[0]);
+		peerPort = strtoul(argv[optind + 1], NULL, 0);
+		sending = 1;
+	}
+
+	if ((client = posixIpcClientConnect(socketPath)) == NULL)
+	{
+		fprintf(stderr, "%s: %s\n", socketPath, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (posixIpcClientBind(client, port) < 0)
+	{
+		fprintf(stderr, "port %u: %s\n", port, strerror(errno));
+		posixIpcClientClose(client);
+		return EXIT_FAILURE;
+	}
+
+	while (1)
+	{
+		struct pollfd fds[2] = {{posixIpcClientGetFd(client), POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+		char line[POSIX_IPC_MAX_PAYLOAD + 2];
+
+		if (poll(fds, sending ? 2 : 1, -1) < 0 && errno != EINTR)
+			break;
+
+		if ((fds[0].revents & POLLIN) && posixIpcClientWait(client, 0) == 0)
+			printReceived(client);
+
+		if ((fds[1].revents & (POLLIN | POLLHUP)) && sending)
+		{
+			if (fgets(line, sizeof(line), stdin) == NULL)
+				break;
+			if (sendLine(client, peer, peerPort, port, line) < 0)
+				fprintf(stderr, "dropped, the ring is full\n");
+		}
+	}
+
+	posixIpcClientClose(client);
+	return EXIT_SUCCESS;
+}
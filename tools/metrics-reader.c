@@ -0,0 +1,602 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Reader for the shared-memory metrics segments published by each node, see
+ * posix-metrics.h. It only maps the segments read-only, so never interferes
+ * with the nodes it reads.
+ *
+ * usage: ca821x-metrics [-P] [-p port] [nodeid...]
+ *   With no node IDs, every segment found in /dev/shm is read.
+ *   -P       print in the Prometheus text format instead of a table
+ *   -p port  serve the Prometheus text format over HTTP on this port
+ */
+
+#define _DEFAULT_SOURCE 1
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ca821x-posix-thread/posix-metrics.h"
+
+#define MAX_NODES 1024
+
+//What a writer of each layout version fills in, see posix-metrics.h. Older writers only have mConfirmStatus.
+#define METRICS_HAS_MAC_STATUS(aVersion) ((aVersion) >= 2)
+#define METRICS_HAS_SCHED(aVersion) ((aVersion) >= 6)
+#define METRICS_HAS_MESSAGE_BUFFERS(aVersion) ((aVersion) >= 7)
+#define METRICS_HAS_PERF(aVersion) ((aVersion) >= 8)
+
+struct metricField
+{
+	const char *mName;
+	const char *mHelp;
+	size_t      mOffset;
+};
+
+#define METRIC_FIELD(aField, aName, aHelp) { aName, aHelp, offsetof(struct posixMetrics, aField) }
+
+static const struct metricField sFields[] = {
+	METRIC_FIELD(mLoopIterations,   "loop_iterations",     "Platform main loop iterations"),
+	METRIC_FIELD(mWakeups,          "wakeups",             "Times the main loop woke up from sleeping"),
+	METRIC_FIELD(mRadioFramesIn,    "radio_frames_in",     "Frames received from the radio"),
+	METRIC_FIELD(mRadioFramesOut,   "radio_frames_out",    "Frames accepted by the radio for transmission"),
+	METRIC_FIELD(mBarrierWaits,     "barrier_waits",       "Radio callbacks handed over to the main thread"),
+	METRIC_FIELD(mBarrierWaitNs,    "barrier_wait_ns",     "Total time radio callbacks waited for the main thread"),
+	METRIC_FIELD(mSettingsGets,     "settings_gets",       "Settings reads"),
+	METRIC_FIELD(mSettingsSets,     "settings_sets",       "Settings writes"),
+	METRIC_FIELD(mSettingsDeletes,  "settings_deletes",    "Settings deletions"),
+	METRIC_FIELD(mSettingsWipes,    "settings_wipes",      "Settings wipes"),
+	METRIC_FIELD(mFlashBytesRead,   "flash_bytes_read",    "Bytes read from the flash file"),
+	METRIC_FIELD(mFlashBytesWritten,"flash_bytes_written", "Bytes written to the flash file"),
+	METRIC_FIELD(mLogMessages,      "log_messages",        "Log messages printed"),
+	METRIC_FIELD(mLogDrops,         "log_drops",           "Log messages truncated or that failed to print"),
+	METRIC_FIELD(mWorkSubmitted,    "work_submitted",      "Work submitted to the worker pool"),
+	METRIC_FIELD(mWorkStarted,      "work_started",        "Work taken by a worker thread"),
+	METRIC_FIELD(mWorkFinished,     "work_finished",       "Work run by a worker thread"),
+	METRIC_FIELD(mWorkCompleted,    "work_completed",      "Work handed back to the OpenThread thread"),
+	METRIC_FIELD(mTunPacketsIn,     "tun_packets_in",      "Packets read from the network interface"),
+	METRIC_FIELD(mTunBytesIn,       "tun_bytes_in",        "Bytes read from the network interface"),
+	METRIC_FIELD(mTunPacketsOut,    "tun_packets_out",     "Packets written to the network interface"),
+	METRIC_FIELD(mTunBytesOut,      "tun_bytes_out",       "Bytes written to the network interface"),
+	METRIC_FIELD(mTunDrops,         "tun_drops",           "Packets dropped in either direction"),
+	METRIC_FIELD(mIpcClients,       "ipc_clients",         "Local clients accepted"),
+	METRIC_FIELD(mIpcToThread,      "ipc_to_thread",       "Datagrams sent by local clients"),
+	METRIC_FIELD(mIpcFromThread,    "ipc_from_thread",     "Datagrams passed to local clients"),
+	METRIC_FIELD(mIpcDrops,         "ipc_drops",           "Datagrams dropped in either direction"),
+	METRIC_FIELD(mMessageBuffersEmpty,  "message_buffers_empty",  "Times a message buffer pool was found empty"),
+	METRIC_FIELD(mMessageAllocFailures, "message_alloc_failures", "Messages from the platform refused for want of a buffer"),
+};
+
+//Fields that are gauges rather than counters
+static const struct metricField sGaugeFields[] = {
+	METRIC_FIELD(mMessageBuffersTotal,  "message_buffers_total",    "Buffers in the message buffer pools"),
+	METRIC_FIELD(mMessageBuffersUsed,   "message_buffers_used",     "Message buffers in use"),
+	METRIC_FIELD(mMessageBuffersUsedMax,"message_buffers_used_max", "Most message buffers ever in use by one instance"),
+};
+
+//Per source of work in the platform loop, see posix-sched.h
+#define SCHED_FIELD(aField, aName, aHelp) { aName, aHelp, offsetof(struct posixMetrics, aField[0]) }
+
+static const struct metricField sSchedFields[] = {
+	SCHED_FIELD(mSchedItems,    "sched_items",    "Work items run by a source of the platform loop"),
+	SCHED_FIELD(mSchedTimeNs,   "sched_time_ns",  "Time spent running a source of the platform loop"),
+	SCHED_FIELD(mSchedYields,   "sched_yields",   "Turns ended by the budget or slice with work left"),
+	SCHED_FIELD(mSchedOverruns, "sched_overruns", "Turns that ran past the slice"),
+	SCHED_FIELD(mSchedStarved,  "sched_starved",  "Work that waited past the deadline to run"),
+};
+
+struct node
+{
+	const struct posixMetrics *mMetrics;
+	size_t                     mMapSize;
+};
+
+//Queue depths of the worker pool, derived from its counters
+enum
+{
+	WORK_QUEUED,
+	WORK_RUNNING,
+	WORK_DONE_PENDING,
+	WORK_QUEUED_MAX,
+	WORK_GAUGE_COUNT
+};
+
+static const struct metricField sWorkGauges[WORK_GAUGE_COUNT] = {
+	{"work_queued",       "Work waiting for a worker thread", 0},
+	{"work_running",      "Work being run by a worker thread", 0},
+	{"work_done_pending", "Finished work waiting for the OpenThread thread", 0},
+	{"work_queued_max",   "Most work ever waiting for a worker at once", 0},
+};
+
+static struct node sNodes[MAX_NODES];
+static int sNodeCount = 0;
+
+static uint64_t readField(const struct posixMetrics *aMetrics, size_t aOffset)
+{
+	if (aOffset + sizeof(uint64_t) > aMetrics->mSize)
+	{
+		return 0;
+	}
+
+	return __atomic_load_n((const uint64_t *)((const uint8_t *)aMetrics + aOffset), __ATOMIC_RELAXED);
+}
+
+static void readWorkGauges(const struct posixMetrics *aMetrics, uint64_t aGauges[WORK_GAUGE_COUNT])
+{
+	//Read in the reverse order of updates, so that no difference is negative
+	uint64_t completed = readField(aMetrics, offsetof(struct posixMetrics, mWorkCompleted));
+	uint64_t finished = readField(aMetrics, offsetof(struct posixMetrics, mWorkFinished));
+	uint64_t started = readField(aMetrics, offsetof(struct posixMetrics, mWorkStarted));
+	uint64_t submitted = readField(aMetrics, offsetof(struct posixMetrics, mWorkSubmitted));
+
+	aGauges[WORK_QUEUED] = submitted - started;
+	aGauges[WORK_RUNNING] = started - finished;
+	aGauges[WORK_DONE_PENDING] = finished - completed;
+	aGauges[WORK_QUEUED_MAX] = readField(aMetrics, offsetof(struct posixMetrics, mWorkQueuedMax));
+}
+
+static void mapNode(const char *aShmName)
+{
+	const struct posixMetrics *metrics;
+	struct stat st;
+	int fd;
+
+	if (sNodeCount >= MAX_NODES)
+	{
+		return;
+	}
+
+	fd = shm_open(aShmName, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		fprintf(stderr, "%s: not found\n", aShmName);
+		return;
+	}
+
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < offsetof(struct posixMetrics, mLoopIterations))
+	{
+		close(fd);
+		return;
+	}
+
+	metrics = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (metrics == MAP_FAILED)
+	{
+		return;
+	}
+
+	if (__atomic_load_n(&metrics->mMagic, __ATOMIC_ACQUIRE) != POSIX_METRICS_MAGIC ||
+	    metrics->mSize > (size_t)st.st_size)
+	{
+		fprintf(stderr, "%s: not a valid metrics segment\n", aShmName);
+		munmap((void *)metrics, st.st_size);
+		return;
+	}
+
+	sNodes[sNodeCount].mMetrics = metrics;
+	sNodes[sNodeCount].mMapSize = st.st_size;
+	sNodeCount++;
+}
+
+static void mapAllNodes(void)
+{
+	const char *prefix = POSIX_METRICS_SHM_PREFIX + 1;
+	struct dirent *entry;
+	DIR *dir = opendir("/dev/shm");
+
+	if (dir == NULL)
+	{
+		return;
+	}
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		char shmName[NAME_MAX + 2];
+
+		if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0)
+		{
+			snprintf(shmName, sizeof(shmName), "/%s", entry->d_name);
+			mapNode(shmName);
+		}
+	}
+
+	closedir(dir);
+}
+
+static void printTable(FILE *aStream)
+{
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		const struct posixMetrics *metrics = sNodes[i].mMetrics;
+
+		fprintf(aStream, "node %u (pid %u, layout v%u)\n", metrics->mNodeId, metrics->mPid, metrics->mVersion);
+
+		uint64_t gauges[WORK_GAUGE_COUNT];
+
+		for (size_t f = 0; f < sizeof(sFields) / sizeof(sFields[0]); f++)
+		{
+			fprintf(aStream, "  %-24s %llu\n", sFields[f].mName,
+			        (unsigned long long)readField(metrics, sFields[f].mOffset));
+		}
+
+		readWorkGauges(metrics, gauges);
+		for (int g = 0; g < WORK_GAUGE_COUNT; g++)
+		{
+			fprintf(aStream, "  %-24s %llu\n", sWorkGauges[g].mName, (unsigned long long)gauges[g]);
+		}
+
+		for (size_t f = 0; f < sizeof(sGaugeFields) / sizeof(sGaugeFields[0]) && METRICS_HAS_MESSAGE_BUFFERS(metrics->mVersion); f++)
+		{
+			fprintf(aStream, "  %-24s %llu\n", sGaugeFields[f].mName,
+			        (unsigned long long)readField(metrics, sGaugeFields[f].mOffset));
+		}
+
+		for (int source = 0; source < POSIX_SCHED_SOURCE_COUNT && METRICS_HAS_SCHED(metrics->mVersion); source++)
+		{
+			fprintf(aStream, "  sched %-8s", posixMetricsSchedSourceName(source));
+			for (size_t f = 0; f < sizeof(sSchedFields) / sizeof(sSchedFields[0]); f++)
+			{
+				fprintf(aStream, " %s %llu", sSchedFields[f].mName + strlen("sched_"),
+				        (unsigned long long)readField(metrics, sSchedFields[f].mOffset + source * sizeof(uint64_t)));
+			}
+			fprintf(aStream, "\n");
+		}
+
+		if (METRICS_HAS_PERF(metrics->mVersion))
+		{
+			fprintf(aStream, "  perf source %s\n",
+			        posixMetricsPerfSourceName(readField(metrics, offsetof(struct posixMetrics, mPerfSource))));
+		}
+
+		for (int op = 0; op < POSIX_PERF_OP_COUNT && METRICS_HAS_PERF(metrics->mVersion); op++)
+		{
+			uint64_t count = readField(metrics, offsetof(struct posixMetrics, mPerfOps[op]));
+
+			if (count == 0)
+				continue;
+
+			//Averages per operation
+			fprintf(aStream, "  perf %-16s n %llu", posixMetricsPerfOpName(op), (unsigned long long)count);
+			for (int counter = 0; counter < POSIX_PERF_COUNTER_COUNT; counter++)
+			{
+				fprintf(aStream, " %s %.0f", posixMetricsPerfCounterName(counter),
+				        (double)readField(metrics, offsetof(struct posixMetrics, mPerfTotals[op][counter])) / count);
+			}
+			fprintf(aStream, "\n");
+		}
+
+		for (int status = 0; status < 256 && !METRICS_HAS_MAC_STATUS(metrics->mVersion); status++)
+		{
+			uint64_t count = readField(metrics, offsetof(struct posixMetrics, mConfirmStatus[status]));
+
+			if (count)
+			{
+				fprintf(aStream, "  confirm status 0x%02x %llu\n", status, (unsigned long long)count);
+			}
+		}
+
+		for (int primitive = 0; primitive < POSIX_MAC_PRIMITIVE_COUNT && METRICS_HAS_MAC_STATUS(metrics->mVersion); primitive++)
+		{
+			for (int status = 0; status < 256; status++)
+			{
+				uint64_t count = readField(metrics, offsetof(struct posixMetrics, mMacStatus[primitive][status]));
+				const char *name = posixMetricsMacStatusName(status);
+
+				if (count)
+				{
+					fprintf(aStream, "  %-18s 0x%02x %-24s %llu\n", posixMetricsMacPrimitiveName(primitive), status,
+					        name ? name : "", (unsigned long long)count);
+				}
+			}
+		}
+	}
+}
+
+static void printPrometheus(FILE *aStream)
+{
+	for (size_t f = 0; f < sizeof(sFields) / sizeof(sFields[0]); f++)
+	{
+		fprintf(aStream, "# HELP ca821x_thread_%s_total %s\n", sFields[f].mName, sFields[f].mHelp);
+		fprintf(aStream, "# TYPE ca821x_thread_%s_total counter\n", sFields[f].mName);
+
+		for (int i = 0; i < sNodeCount; i++)
+		{
+			fprintf(aStream, "ca821x_thread_%s_total{node=\"%u\"} %llu\n", sFields[f].mName, sNodes[i].mMetrics->mNodeId,
+			        (unsigned long long)readField(sNodes[i].mMetrics, sFields[f].mOffset));
+		}
+	}
+
+	for (int g = 0; g < WORK_GAUGE_COUNT; g++)
+	{
+		fprintf(aStream, "# HELP ca821x_thread_%s %s\n", sWorkGauges[g].mName, sWorkGauges[g].mHelp);
+		fprintf(aStream, "# TYPE ca821x_thread_%s gauge\n", sWorkGauges[g].mName);
+
+		for (int i = 0; i < sNodeCount; i++)
+		{
+			uint64_t gauges[WORK_GAUGE_COUNT];
+
+			readWorkGauges(sNodes[i].mMetrics, gauges);
+			fprintf(aStream, "ca821x_thread_%s{node=\"%u\"} %llu\n", sWorkGauges[g].mName, sNodes[i].mMetrics->mNodeId,
+			        (unsigned long long)gauges[g]);
+		}
+	}
+
+	for (size_t f = 0; f < sizeof(sGaugeFields) / sizeof(sGaugeFields[0]); f++)
+	{
+		fprintf(aStream, "# HELP ca821x_thread_%s %s\n", sGaugeFields[f].mName, sGaugeFields[f].mHelp);
+		fprintf(aStream, "# TYPE ca821x_thread_%s gauge\n", sGaugeFields[f].mName);
+
+		for (int i = 0; i < sNodeCount; i++)
+		{
+			if (!METRICS_HAS_MESSAGE_BUFFERS(sNodes[i].mMetrics->mVersion))
+				continue;
+
+			fprintf(aStream, "ca821x_thread_%s{node=\"%u\"} %llu\n", sGaugeFields[f].mName,
+			        sNodes[i].mMetrics->mNodeId, (unsigned long long)readField(sNodes[i].mMetrics, sGaugeFields[f].mOffset));
+		}
+	}
+
+	for (size_t f = 0; f < sizeof(sSchedFields) / sizeof(sSchedFields[0]); f++)
+	{
+		fprintf(aStream, "# HELP ca821x_thread_%s_total %s\n", sSchedFields[f].mName, sSchedFields[f].mHelp);
+		fprintf(aStream, "# TYPE ca821x_thread_%s_total counter\n", sSchedFields[f].mName);
+
+		for (int i = 0; i < sNodeCount; i++)
+		{
+			for (int source = 0; source < POSIX_SCHED_SOURCE_COUNT && METRICS_HAS_SCHED(sNodes[i].mMetrics->mVersion); source++)
+			{
+				fprintf(aStream, "ca821x_thread_%s_total{node=\"%u\",source=\"%s\"} %llu\n", sSchedFields[f].mName,
+				        sNodes[i].mMetrics->mNodeId, posixMetricsSchedSourceName(source),
+				        (unsigned long long)readField(sNodes[i].mMetrics,
+				                                      sSchedFields[f].mOffset + source * sizeof(uint64_t)));
+			}
+		}
+	}
+
+	fprintf(aStream, "# HELP ca821x_thread_perf_source Source of the CPU cost counters, 0 none, 1 clock, 2 software, 3 hardware\n");
+	fprintf(aStream, "# TYPE ca821x_thread_perf_source gauge\n");
+
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		if (METRICS_HAS_PERF(sNodes[i].mMetrics->mVersion))
+		{
+			fprintf(aStream, "ca821x_thread_perf_source{node=\"%u\"} %llu\n", sNodes[i].mMetrics->mNodeId,
+			        (unsigned long long)readField(sNodes[i].mMetrics, offsetof(struct posixMetrics, mPerfSource)));
+		}
+	}
+
+	fprintf(aStream, "# HELP ca821x_thread_perf_ops_total Platform operations whose CPU cost is counted\n");
+	fprintf(aStream, "# TYPE ca821x_thread_perf_ops_total counter\n");
+
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		for (int op = 0; op < POSIX_PERF_OP_COUNT && METRICS_HAS_PERF(sNodes[i].mMetrics->mVersion); op++)
+		{
+			fprintf(aStream, "ca821x_thread_perf_ops_total{node=\"%u\",op=\"%s\"} %llu\n", sNodes[i].mMetrics->mNodeId,
+			        posixMetricsPerfOpName(op),
+			        (unsigned long long)readField(sNodes[i].mMetrics, offsetof(struct posixMetrics, mPerfOps[op])));
+		}
+	}
+
+	for (int counter = 0; counter < POSIX_PERF_COUNTER_COUNT; counter++)
+	{
+		const char *name = posixMetricsPerfCounterName(counter);
+
+		fprintf(aStream, "# HELP ca821x_thread_perf_%s_total Total %s of platform operations\n", name, name);
+		fprintf(aStream, "# TYPE ca821x_thread_perf_%s_total counter\n", name);
+
+		for (int i = 0; i < sNodeCount; i++)
+		{
+			for (int op = 0; op < POSIX_PERF_OP_COUNT && METRICS_HAS_PERF(sNodes[i].mMetrics->mVersion); op++)
+			{
+				fprintf(aStream, "ca821x_thread_perf_%s_total{node=\"%u\",op=\"%s\"} %llu\n", name,
+				        sNodes[i].mMetrics->mNodeId, posixMetricsPerfOpName(op),
+				        (unsigned long long)readField(sNodes[i].mMetrics,
+				                                      offsetof(struct posixMetrics, mPerfTotals[op][counter])));
+			}
+		}
+	}
+
+	fprintf(aStream, "# HELP ca821x_thread_mac_data_confirms_total MCPS-DATA.confirms by raw MAC status, from writers without mac_status\n");
+	fprintf(aStream, "# TYPE ca821x_thread_mac_data_confirms_total counter\n");
+
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		for (int status = 0; status < 256 && !METRICS_HAS_MAC_STATUS(sNodes[i].mMetrics->mVersion); status++)
+		{
+			uint64_t count = readField(sNodes[i].mMetrics, offsetof(struct posixMetrics, mConfirmStatus[status]));
+
+			if (count)
+			{
+				fprintf(aStream, "ca821x_thread_mac_data_confirms_total{node=\"%u\",status=\"0x%02x\"} %llu\n",
+				        sNodes[i].mMetrics->mNodeId, status, (unsigned long long)count);
+			}
+		}
+	}
+
+	fprintf(aStream, "# HELP ca821x_thread_mac_status_total MAC requests, confirms and status indications by raw MAC status\n");
+	fprintf(aStream, "# TYPE ca821x_thread_mac_status_total counter\n");
+
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		for (int primitive = 0; primitive < POSIX_MAC_PRIMITIVE_COUNT && METRICS_HAS_MAC_STATUS(sNodes[i].mMetrics->mVersion);
+		     primitive++)
+		{
+			for (int status = 0; status < 256; status++)
+			{
+				uint64_t count =
+				    readField(sNodes[i].mMetrics, offsetof(struct posixMetrics, mMacStatus[primitive][status]));
+
+				if (count)
+				{
+					fprintf(aStream,
+					        "ca821x_thread_mac_status_total{node=\"%u\",primitive=\"%s\",status=\"0x%02x\"} %llu\n",
+					        sNodes[i].mMetrics->mNodeId, posixMetricsMacPrimitiveName(primitive), status,
+					        (unsigned long long)count);
+				}
+			}
+		}
+	}
+}
+
+static int serve(int aPort, char **aNodeIds, int aNodeIdCount)
+{
+	struct sockaddr_in6 addr;
+	int one = 1;
+	int listenFd = socket(AF_INET6, SOCK_STREAM, 0);
+
+	if (listenFd < 0)
+	{
+		perror("socket");
+		return EXIT_FAILURE;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin6_family = AF_INET6;
+	addr.sin6_addr = in6addr_any;
+	addr.sin6_port = htons(aPort);
+	setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd, 8) < 0)
+	{
+		perror("bind");
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	while (1)
+	{
+		char request[1024];
+		char *body = NULL;
+		size_t bodyLength = 0;
+		FILE *stream;
+		int fd = accept(listenFd, NULL, NULL);
+
+		if (fd < 0)
+		{
+			continue;
+		}
+
+		//The request itself doesn't matter, every path returns the metrics
+		(void)read(fd, request, sizeof(request));
+
+		//Rescan so nodes that started or stopped since the last scrape are picked up
+		for (int i = 0; i < sNodeCount; i++)
+		{
+			munmap((void *)sNodes[i].mMetrics, sNodes[i].mMapSize);
+		}
+		sNodeCount = 0;
+
+		if (aNodeIdCount == 0)
+		{
+			mapAllNodes();
+		}
+
+		for (int i = 0; i < aNodeIdCount; i++)
+		{
+			char shmName[64];
+
+			snprintf(shmName, sizeof(shmName), "%s%s", POSIX_METRICS_SHM_PREFIX, aNodeIds[i]);
+			mapNode(shmName);
+		}
+
+		stream = open_memstream(&body, &bodyLength);
+		printPrometheus(stream);
+		fclose(stream);
+
+		dprintf(fd, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+		        bodyLength);
+		(void)write(fd, body, bodyLength);
+		free(body);
+		close(fd);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	int prometheus = 0;
+	int port = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "Pp:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'P':
+			prometheus = 1;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-P] [-p port] [nodeid...]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (port)
+	{
+		return serve(port, argv + optind, argc - optind);
+	}
+
+	if (optind == argc)
+	{
+		mapAllNodes();
+	}
+
+	for (int i = optind; i < argc; i++)
+	{
+		char shmName[64];
+
+		snprintf(shmName, sizeof(shmName), "%s%s", POSIX_METRICS_SHM_PREFIX, argv[i]);
+		mapNode(shmName);
+	}
+
+	if (prometheus)
+		printPrometheus(stdout);
+	else
+		printTable(stdout);
+
+	return sNodeCount ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,708 @@
+/*
+ *  Copyright (c) 2018, Cascoda Ltd.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. Neither the name of the copyright holder nor the
+ *     names of its contributors may be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Merges the frame traces of several nodes into one timeline, see
+ * posix-trace.h. Each received frame is matched to the frame sent with the
+ * same source address and DSN, giving the latency of each hop.
+ *
+ * Nodes of one machine share a monotonic clock. The clocks of other machines
+ * are first aligned by the wall clock, then, where frames went both ways
+ * between them and the first machine, by half the difference of the fastest
+ * hop each way.
+ *
+ * usage: ca821x-trace-merge [-f chrome|pcapng] [-o output] trace...
+ *   -f  chrome (the default) writes the Chrome trace event format, for
+ *       chrome://tracing or Perfetto; pcapng writes one interface per node,
+ *       with the latency of each hop in the comment of the received frame
+ *   -o  the output file, by default stdout
+ * A summary of the hops between each pair of nodes goes to stderr.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ca821x-posix-thread/posix-trace.h"
+
+#define MAX_HOP_NS     10000000000LL //Indirect frames wait for the child to poll
+#define CLOCK_SLACK_NS 50000000LL    //Error allowed in the clocks of other machines
+#define MAX_NODES      1024
+#define MAX_DOMAINS    64
+
+#define LINKTYPE_IEEE802_15_4_NOFCS 230
+
+struct traceEntry
+{
+	struct posixTraceRecord mRecord; //mTimeNs is on the clock of the first machine once aligned
+	uint8_t                 mMsdu[256];
+	int64_t                 mOwnTimeNs;
+	int                     mDomain;
+	long                    mHopFrom; //Index of the matching TX of an RX, or -1
+};
+
+struct clockDomain
+{
+	uint8_t mBootId[16];
+	int64_t mRealOffsetNs; //Wall clock minus monotonic clock
+	int64_t mOffsetNs;     //Added to align with the first machine
+};
+
+struct nodeClock
+{
+	uint32_t mNodeId;
+	int      mDomain;
+};
+
+struct linkStats
+{
+	uint32_t mFrom;
+	uint32_t mTo;
+	uint64_t mCount;
+	int64_t  mMinNs;
+	int64_t  mMaxNs;
+	int64_t  mTotalNs;
+};
+
+static struct traceEntry *sEntries;
+static size_t sEntryCount;
+static long *sTxIndex;
+static size_t sTxCount;
+
+static struct clockDomain sDomains[MAX_DOMAINS];
+static int sDomainCount;
+static struct nodeClock sNodes[MAX_NODES];
+static int sNodeCount;
+
+static void usage(const char *aName)
+{
+	fprintf(stderr, "usage: %s [-f chrome|pcapng] [-o output] trace...\n", aName);
+	exit(EXIT_FAILURE);
+}
+
+static int addressLength(uint8_t aMode)
+{
+	return (aMode == 3) ? 8 : (aMode == 2) ? 2 : 0;
+}
+
+static int findDomain(const uint8_t *aBootId, int64_t aRealOffsetNs)
+{
+	for (int i = 0; i < sDomainCount; i++)
+	{
+		if (memcmp(sDomains[i].mBootId, aBootId, sizeof(sDomains[i].mBootId)) == 0)
+			return i;
+	}
+
+	if (sDomainCount == MAX_DOMAINS)
+		return 0;
+
+	memcpy(sDomains[sDomainCount].mBootId, aBootId, sizeof(sDomains[sDomainCount].mBootId));
+	sDomains[sDomainCount].mRealOffsetNs = aRealOffsetNs;
+	return sDomainCount++;
+}
+
+/* Nodes are numbered in the order they are first seen, which is also their pcapng interface */
+static int nodeIndex(uint32_t aNodeId)
+{
+	int i;
+
+	for (i = 0; i < sNodeCount; i++)
+	{
+		if (sNodes[i].mNodeId == aNodeId)
+			return i;
+	}
+
+	if (sNodeCount == MAX_NODES)
+		return 0;
+
+	sNodes[i].mNodeId = aNodeId;
+	sNodes[i].mDomain = 0;
+	return sNodeCount++;
+}
+
+static int readTrace(const char *aPath)
+{
+	FILE *file = fopen(aPath, "rb");
+	uint8_t buffer[sizeof(struct posixTraceRecord) + sizeof(((struct traceEntry *)0)->mMsdu)];
+	const size_t header = offsetof(struct posixTraceRecord, mMsdu);
+
+	if (file == NULL)
+	{
+		perror(aPath);
+		return -1;
+	}
+
+	while (fread(buffer, header, 1, file) == 1)
+	{
+		struct posixTraceRecord *record = (struct posixTraceRecord *)buffer;
+		struct traceEntry *entry;
+		int node;
+
+		if (record->mLength < header || record->mLength > sizeof(buffer) ||
+		    fread(buffer + header, record->mLength - header, 1, file) != 1)
+		{
+			fprintf(stderr, "%s: truncated or corrupt after %zu records\n", aPath, sEntryCount);
+			break;
+		}
+
+		if (record->mMsduLength > record->mLength - header)
+			continue;
+
+		if ((sEntryCount & 1023) == 0)
+		{
+			sEntries = realloc(sEntries, (sEntryCount + 1024) * sizeof(*sEntries));
+			if (sEntries == NULL)
+			{
+				perror("realloc");
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		entry = &sEntries[sEntryCount++];
+		memcpy(&entry->mRecord, record, sizeof(entry->mRecord));
+		memcpy(entry->mMsdu, record->mMsdu, record->mMsduLength);
+		entry->mOwnTimeNs = record->mTimeNs;
+		entry->mHopFrom = -1;
+		node = nodeIndex(record->mNodeId);
+
+		if (record->mType == POSIX_TRACE_CLOCK && record->mMsduLength >= sizeof(struct posixTraceClock))
+		{
+			struct posixTraceClock clock;
+
+			memcpy(&clock, record->mMsdu, sizeof(clock));
+			sNodes[node].mDomain = findDomain(clock.mBootId, clock.mRealTimeNs - record->mTimeNs);
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+static void applyOffsets(void)
+{
+	for (size_t i = 0; i < sEntryCount; i++)
+		sEntries[i].mRecord.mTimeNs = sEntries[i].mOwnTimeNs + sDomains[sEntries[i].mDomain].mOffsetNs;
+}
+
+static int compareKey(const struct traceEntry *aLeft, const struct traceEntry *aRight)
+{
+	const struct posixTraceRecord *left = &aLeft->mRecord;
+	const struct posixTraceRecord *right = &aRight->mRecord;
+
+	if (left->mSrc.mMode != right->mSrc.mMode)
+		return left->mSrc.mMode - right->mSrc.mMode;
+	if (left->mDsn != right->mDsn)
+		return left->mDsn - right->mDsn;
+	return memcmp(left->mSrc.mAddress, right->mSrc.mAddress, addressLength(left->mSrc.mMode));
+}
+
+static int compareTx(const void *aLeft, const void *aRight)
+{
+	const struct traceEntry *left = &sEntries[*(const long *)aLeft];
+	const struct traceEntry *right = &sEntries[*(const long *)aRight];
+	int rval = compareKey(left, right);
+
+	if (rval != 0)
+		return rval;
+	return ((int64_t)left->mRecord.mTimeNs > (int64_t)right->mRecord.mTimeNs) -
+	       ((int64_t)left->mRecord.mTimeNs < (int64_t)right->mRecord.mTimeNs);
+}
+
+static int compareTime(const void *aLeft, const void *aRight)
+{
+	int64_t left = ((const struct traceEntry *)aLeft)->mRecord.mTimeNs;
+	int64_t right = ((const struct traceEntry *)aRight)->mRecord.mTimeNs;
+
+	return (left > right) - (left < right);
+}
+
+/* Match every RX to the latest TX with its key that could have caused it */
+static void matchHops(void)
+{
+	sTxCount = 0;
+	for (size_t i = 0; i < sEntryCount; i++)
+	{
+		if (sEntries[i].mRecord.mType == POSIX_TRACE_TX)
+			sTxIndex[sTxCount++] = i;
+	}
+
+	qsort(sTxIndex, sTxCount, sizeof(*sTxIndex), compareTx);
+
+	for (size_t i = 0; i < sEntryCount; i++)
+	{
+		struct traceEntry *rx = &sEntries[i];
+		size_t low = 0;
+		size_t high = sTxCount;
+
+		rx->mHopFrom = -1;
+		if (rx->mRecord.mType != POSIX_TRACE_RX)
+			continue;
+
+		//First TX with a key after the RX's, or the same key and a later time
+		while (low < high)
+		{
+			size_t middle = (low + high) / 2;
+			const struct traceEntry *tx = &sEntries[sTxIndex[middle]];
+			int rval = compareKey(tx, rx);
+
+			if (rval < 0 || (rval == 0 && (int64_t)(tx->mRecord.mTimeNs - rx->mRecord.mTimeNs) <= CLOCK_SLACK_NS))
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		while (low-- > 0)
+		{
+			const struct traceEntry *tx = &sEntries[sTxIndex[low]];
+
+			if (compareKey(tx, rx) != 0 || (int64_t)(rx->mRecord.mTimeNs - tx->mRecord.mTimeNs) > MAX_HOP_NS)
+				break;
+
+			if (tx->mRecord.mNodeId != rx->mRecord.mNodeId)
+			{
+				rx->mHopFrom = sTxIndex[low];
+				break;
+			}
+		}
+	}
+}
+
+/* Refine the wall clock alignment of other machines with the hops to and from the first */
+static void alignDomains(void)
+{
+	for (int domain = 1; domain < sDomainCount; domain++)
+	{
+		int64_t minTo = INT64_MAX;
+		int64_t minFrom = INT64_MAX;
+
+		for (size_t i = 0; i < sEntryCount; i++)
+		{
+			const struct traceEntry *rx = &sEntries[i];
+			const struct traceEntry *tx;
+			int64_t latency;
+
+			if (rx->mHopFrom < 0)
+				continue;
+
+			tx = &sEntries[rx->mHopFrom];
+			latency = rx->mRecord.mTimeNs - tx->mRecord.mTimeNs;
+
+			if (tx->mDomain == 0 && rx->mDomain == domain && latency < minTo)
+				minTo = latency;
+			else if (tx->mDomain == domain && rx->mDomain == 0 && latency < minFrom)
+				minFrom = latency;
+		}
+
+		if (minTo != INT64_MAX && minFrom != INT64_MAX)
+			sDomains[domain].mOffsetNs -= (minTo - minFrom) / 2;
+	}
+}
+
+static void formatAddress(char *aBuf, size_t aSize, const struct posixTraceAddress *aAddress)
+{
+	if (aAddress->mMode == 2)
+	{
+		snprintf(aBuf, aSize, "0x%04x", aAddress->mAddress[0] | (aAddress->mAddress[1] << 8));
+	}
+	else if (aAddress->mMode == 3)
+	{
+		//Extended addresses are little endian, and printed most significant byte first
+		for (int i = 0; i < 8; i++)
+			snprintf(aBuf + 2 * i, aSize - 2 * i, "%02x", aAddress->mAddress[7 - i]);
+	}
+	else
+	{
+		snprintf(aBuf, aSize, "none");
+	}
+}
+
+static double toUs(int64_t aNs)
+{
+	return aNs / 1000.0;
+}
+
+static void writeChrome(FILE *aOut, int64_t aOriginNs)
+{
+	const char *separator = "";
+	long flow = 0;
+
+	fprintf(aOut, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		fprintf(aOut, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%" PRIu32 ",\"args\":{\"name\":\"node %" PRIu32 "\"}}",
+		        separator, sNodes[i].mNodeId, sNodes[i].mNodeId);
+		separator = ",\n";
+	}
+
+	for (size_t i = 0; i < sEntryCount; i++)
+	{
+		const struct traceEntry *entry = &sEntries[i];
+		const struct posixTraceRecord *record = &entry->mRecord;
+		double ts = toUs(record->mTimeNs - aOriginNs);
+		char src[20];
+		char dst[20];
+
+		formatAddress(src, sizeof(src), &record->mSrc);
+		formatAddress(dst, sizeof(dst), &record->mDst);
+
+		switch (record->mType)
+		{
+		case POSIX_TRACE_TX:
+			fprintf(aOut, "%s{\"name\":\"tx\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%" PRIu32 ",\"tid\":0,\"ts\":%.3f,"
+			        "\"args\":{\"dsn\":%u,\"src\":\"%s\",\"dst\":\"%s\",\"length\":%u,\"handle\":%u}}",
+			        separator, record->mNodeId, ts, record->mDsn, src, dst, record->mMsduLength, record->mMsduHandle);
+			break;
+
+		case POSIX_TRACE_TX_DONE:
+			fprintf(aOut, "%s{\"name\":\"tx done\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%" PRIu32 ",\"tid\":0,\"ts\":%.3f,"
+			        "\"args\":{\"handle\":%u,\"status\":%u}}",
+			        separator, record->mNodeId, ts, record->mMsduHandle, record->mStatus);
+			break;
+
+		case POSIX_TRACE_RX:
+			if (entry->mHopFrom < 0)
+			{
+				fprintf(aOut, "%s{\"name\":\"rx unmatched\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%" PRIu32 ",\"tid\":0,\"ts\":%.3f,"
+				        "\"args\":{\"dsn\":%u,\"src\":\"%s\",\"length\":%u}}",
+				        separator, record->mNodeId, ts, record->mDsn, src, record->mMsduLength);
+			}
+			else
+			{
+				const struct posixTraceRecord *tx = &sEntries[entry->mHopFrom].mRecord;
+				double txTs = toUs(tx->mTimeNs - aOriginNs);
+
+				//Hops overlap, so they are async slices on the receiver with an arrow from the sender
+				fprintf(aOut, "%s{\"name\":\"hop %" PRIu32 "->%" PRIu32 "\",\"cat\":\"hop\",\"ph\":\"b\",\"id\":%ld,"
+				        "\"pid\":%" PRIu32 ",\"tid\":1,\"ts\":%.3f,\"args\":{\"dsn\":%u,\"src\":\"%s\",\"dst\":\"%s\","
+				        "\"length\":%u,\"latency_us\":%.3f,\"link_quality\":%u}}",
+				        separator, tx->mNodeId, record->mNodeId, flow, record->mNodeId, txTs, record->mDsn, src, dst,
+				        record->mMsduLength, ts - txTs, record->mStatus);
+				separator = ",\n";
+				fprintf(aOut, "%s{\"name\":\"hop %" PRIu32 "->%" PRIu32 "\",\"cat\":\"hop\",\"ph\":\"e\",\"id\":%ld,"
+				        "\"pid\":%" PRIu32 ",\"tid\":1,\"ts\":%.3f}",
+				        separator, tx->mNodeId, record->mNodeId, flow, record->mNodeId, ts);
+				fprintf(aOut, "%s{\"name\":\"frame\",\"cat\":\"hop\",\"ph\":\"s\",\"id\":%ld,\"pid\":%" PRIu32
+				        ",\"tid\":0,\"ts\":%.3f}",
+				        separator, flow, tx->mNodeId, txTs);
+				fprintf(aOut, "%s{\"name\":\"frame\",\"cat\":\"hop\",\"ph\":\"f\",\"bp\":\"e\",\"id\":%ld,\"pid\":%" PRIu32
+				        ",\"tid\":0,\"ts\":%.3f}",
+				        separator, flow, record->mNodeId, ts);
+				flow++;
+			}
+			break;
+
+		default:
+			continue;
+		}
+
+		separator = ",\n";
+	}
+
+	fprintf(aOut, "\n]}\n");
+}
+
+static void writeBlock(FILE *aOut, uint32_t aType, const void *aBody, uint32_t aLength)
+{
+	static const uint8_t padding[4];
+	uint32_t padded = (aLength + 3) & ~3;
+	uint32_t total = padded + 12;
+
+	fwrite(&aType, sizeof(aType), 1, aOut);
+	fwrite(&total, sizeof(total), 1, aOut);
+	fwrite(aBody, aLength, 1, aOut);
+	fwrite(padding, padded - aLength, 1, aOut);
+	fwrite(&total, sizeof(total), 1, aOut);
+}
+
+static size_t putOption(uint8_t *aBuf, uint16_t aCode, const void *aValue, uint16_t aLength)
+{
+	memcpy(aBuf, &aCode, sizeof(aCode));
+	memcpy(aBuf + 2, &aLength, sizeof(aLength));
+	memcpy(aBuf + 4, aValue, aLength);
+	memset(aBuf + 4 + aLength, 0, ((aLength + 3) & ~3) - aLength);
+	return 4 + ((aLength + 3) & ~3);
+}
+
+static size_t putAddress(uint8_t *aBuf, const struct posixTraceAddress *aAddress, bool aWithPan)
+{
+	size_t length = 0;
+
+	if (aWithPan)
+	{
+		memcpy(aBuf, aAddress->mPanId, sizeof(aAddress->mPanId));
+		length += sizeof(aAddress->mPanId);
+	}
+
+	memcpy(aBuf + length, aAddress->mAddress, addressLength(aAddress->mMode));
+	return length + addressLength(aAddress->mMode);
+}
+
+/*
+ * Rebuilds the MAC frame around the MSDU. The MSDU is before MAC security, so
+ * the frame is written unsecured, and the payload decodes without the key.
+ */
+static size_t buildFrame(uint8_t *aFrame, const struct posixTraceRecord *aRecord, const uint8_t *aMsdu)
+{
+	const struct posixTraceAddress *src = &aRecord->mSrc;
+	const struct posixTraceAddress *dst = &aRecord->mDst;
+	bool panIdCompression = src->mMode != 0 && dst->mMode != 0 && memcmp(src->mPanId, dst->mPanId, 2) == 0;
+	bool broadcast = dst->mMode == 2 && dst->mAddress[0] == 0xFF && dst->mAddress[1] == 0xFF;
+	uint16_t frameControl = 0x0001; //Data frame
+	size_t length = 3;
+
+	if (aRecord->mType == POSIX_TRACE_TX && (aRecord->mStatus & 0x01) && !broadcast)
+		frameControl |= 1 << 5;
+	if (panIdCompression)
+		frameControl |= 1 << 6;
+	frameControl |= (dst->mMode & 3) << 10;
+	frameControl |= (src->mMode & 3) << 14;
+
+	aFrame[0] = frameControl & 0xFF;
+	aFrame[1] = frameControl >> 8;
+	aFrame[2] = aRecord->mDsn;
+	if (dst->mMode != 0)
+		length += putAddress(aFrame + length, dst, true);
+	if (src->mMode != 0)
+		length += putAddress(aFrame + length, src, !panIdCompression);
+
+	memcpy(aFrame + length, aMsdu, aRecord->mMsduLength);
+	return length + aRecord->mMsduLength;
+}
+
+static void writePcapng(FILE *aOut)
+{
+	struct
+	{
+		uint32_t mMagic;
+		uint16_t mMajor;
+		uint16_t mMinor;
+		int64_t  mSectionLength;
+	} section = {0x1A2B3C4D, 1, 0, -1};
+	uint8_t body[512];
+	int64_t realOffsetNs = sDomainCount ? sDomains[0].mRealOffsetNs : 0;
+
+	writeBlock(aOut, 0x0A0D0D0A, &section, sizeof(section));
+
+	for (int i = 0; i < sNodeCount; i++)
+	{
+		uint16_t linkType = LINKTYPE_IEEE802_15_4_NOFCS;
+		uint8_t resolution = 9; //Nanoseconds
+		char name[32];
+		size_t length = 8;
+
+		memset(body, 0, 8);
+		memcpy(body, &linkType, sizeof(linkType));
+		snprintf(name, sizeof(name), "node %" PRIu32, sNodes[i].mNodeId);
+		length += putOption(body + length, 2, name, strlen(name));
+		length += putOption(body + length, 9, &resolution, sizeof(resolution));
+		length += putOption(body + length, 0, NULL, 0);
+		writeBlock(aOut, 1, body, length);
+	}
+
+	for (size_t i = 0; i < sEntryCount; i++)
+	{
+		const struct traceEntry *entry = &sEntries[i];
+		const struct posixTraceRecord *record = &entry->mRecord;
+		uint64_t timestamp = record->mTimeNs + realOffsetNs;
+		uint32_t header[5];
+		char comment[128];
+		size_t length;
+
+		if (record->mType != POSIX_TRACE_TX && record->mType != POSIX_TRACE_RX)
+			continue;
+
+		header[0] = nodeIndex(record->mNodeId);
+		header[1] = timestamp >> 32;
+		header[2] = (uint32_t)timestamp;
+		length = sizeof(header);
+		header[3] = header[4] = buildFrame(body + length, record, entry->mMsdu);
+		memcpy(body, header, sizeof(header));
+		length = (length + header[3] + 3) & ~3;
+
+		if (record->mType == POSIX_TRACE_TX)
+			snprintf(comment, sizeof(comment), "tx by node %" PRIu32, record->mNodeId);
+		else if (entry->mHopFrom < 0)
+			snprintf(comment, sizeof(comment), "rx by node %" PRIu32 ", sender unknown", record->mNodeId);
+		else
+			snprintf(comment, sizeof(comment), "hop %" PRIu32 "->%" PRIu32 ", latency %.3f us",
+			         sEntries[entry->mHopFrom].mRecord.mNodeId, record->mNodeId,
+			         toUs(record->mTimeNs - sEntries[entry->mHopFrom].mRecord.mTimeNs));
+
+		memset(body + sizeof(header) + header[3], 0, length - sizeof(header) - header[3]);
+		length += putOption(body + length, 1, comment, strlen(comment));
+		length += putOption(body + length, 0, NULL, 0);
+		writeBlock(aOut, 6, body, length);
+	}
+}
+
+static void printSummary(void)
+{
+	struct linkStats *links = calloc(sNodeCount * sNodeCount + 1, sizeof(*links));
+	size_t linkCount = 0;
+	uint64_t unmatched = 0;
+
+	for (size_t i = 0; links != NULL && i < sEntryCount; i++)
+	{
+		const struct traceEntry *rx = &sEntries[i];
+		const struct posixTraceRecord *tx;
+		struct linkStats *link;
+		int64_t latency;
+
+		if (rx->mRecord.mType != POSIX_TRACE_RX)
+			continue;
+
+		if (rx->mHopFrom < 0)
+		{
+			unmatched++;
+			continue;
+		}
+
+		tx = &sEntries[rx->mHopFrom].mRecord;
+		latency = rx->mRecord.mTimeNs - tx->mTimeNs;
+
+		for (link = links; link < links + linkCount; link++)
+		{
+			if (link->mFrom == tx->mNodeId && link->mTo == rx->mRecord.mNodeId)
+				break;
+		}
+
+		if (link == links + linkCount)
+		{
+			if (linkCount == (size_t)sNodeCount * sNodeCount)
+				continue;
+			linkCount++;
+			link->mFrom = tx->mNodeId;
+			link->mTo = rx->mRecord.mNodeId;
+			link->mMinNs = INT64_MAX;
+			link->mMaxNs = INT64_MIN;
+		}
+
+		link->mCount++;
+		link->mTotalNs += latency;
+		if (latency < link->mMinNs)
+			link->mMinNs = latency;
+		if (latency > link->mMaxNs)
+			link->mMaxNs = latency;
+	}
+
+	fprintf(stderr, "%8s %8s %10s %12s %12s %12s\n", "from", "to", "frames", "min_us", "avg_us", "max_us");
+	for (size_t i = 0; i < linkCount; i++)
+	{
+		fprintf(stderr, "%8" PRIu32 " %8" PRIu32 " %10" PRIu64 " %12.3f %12.3f %12.3f\n", links[i].mFrom, links[i].mTo,
+		        links[i].mCount, toUs(links[i].mMinNs), toUs(links[i].mTotalNs) / links[i].mCount, toUs(links[i].mMaxNs));
+	}
+	fprintf(stderr, "%" PRIu64 " frames received with no matching send\n", unmatched);
+
+	free(links);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *format = "chrome";
+	FILE *out = stdout;
+	int64_t originNs = INT64_MAX;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'f':
+			format = optarg;
+			break;
+		case 'o':
+			if ((out = fopen(optarg, "wb")) == NULL)
+			{
+				perror(optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind >= argc || (strcmp(format, "chrome") != 0 && strcmp(format, "pcapng") != 0))
+		usage(argv[0]);
+
+	for (int i = optind; i < argc; i++)
+	{
+		if (readTrace(argv[i]) < 0)
+			return EXIT_FAILURE;
+	}
+
+	//Other machines start aligned by the wall clock
+	for (int i = 1; i < sDomainCount; i++)
+		sDomains[i].mOffsetNs = sDomains[i].mRealOffsetNs - sDomains[0].mRealOffsetNs;
+
+	for (size_t i = 0; i < sEntryCount; i++)
+		sEntries[i].mDomain = sNodes[nodeIndex(sEntries[i].mRecord.mNodeId)].mDomain;
+
+	if ((sTxIndex = malloc((sEntryCount + 1) * sizeof(*sTxIndex))) == NULL)
+	{
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+
+	applyOffsets();
+	qsort(sEntries, sEntryCount, sizeof(*sEntries), compareTime);
+	matchHops();
+
+	if (sDomainCount > 1)
+	{
+		alignDomains();
+		applyOffsets();
+		qsort(sEntries, sEntryCount, sizeof(*sEntries), compareTime);
+		matchHops();
+	}
+
+	for (size_t i = 0; i < sEntryCount; i++)
+	{
+		if ((int64_t)sEntries[i].mRecord.mTimeNs < originNs)
+			originNs = sEntries[i].mRecord.mTimeNs;
+	}
+
+	if (strcmp(format, "pcapng") == 0)
+		writePcapng(out);
+	else
+		writeChrome(out, originNs);
+
+	printSummary();
+
+	if (out != stdout)
+		fclose(out);
+	free(sTxIndex);
+	free(sEntries);
+
+	return EXIT_SUCCESS;
+}